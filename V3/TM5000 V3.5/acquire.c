@@ -0,0 +1,381 @@
+/*
+ * TM5000 GPIB Control System - Pipelined Acquisition
+ * Version 3.5
+ * Trigger-all-then-read-all cycle for the continuous monitor
+ *
+ * Reading one slot at a time costs the sum of every meter's conversion
+ * time.  Here each due slot is sent its trigger first, so all of them
+ * convert at once, and the readings are collected in order of expected
+ * completion.  A rack of four DM5120s then costs about one conversion
+ * plus four bus transfers per cycle instead of four conversions.
+ *
+ * Synchronized mode goes one step further: the meters are put into
+ * bus-triggered mode and one Group Execute Trigger starts them all in
+ * the same bus message, so readings with the same sample number were
+ * taken at the same moment - what dual-trace math and correlation
+ * between slots assume.  Every cycle records the spread between the
+ * moments the slots were seen to finish converting.
+ *
+ * Version History:
+ * 3.5 - Initial implementation overlapping instrument conversion times
+ * 3.5 - Synchronized sampling with one Group Execute Trigger per cycle
+ */
+
+#include "acquire.h"
+#include "gpib.h"
+#include "modules.h"
+#include "reduce.h"
+#include "scheduler.h"
+#include "shadow.h"
+#include "timebase.h"
+
+int g_acquire_mode = ACQ_MODE_PIPELINED;
+
+static acquire_stats g_acquire_stats;
+static char g_acquire_response[GPIB_BUFFER_SIZE];
+
+static acquire_skew_record g_skew_log[ACQ_SKEW_LOG];
+static int g_skew_head = 0;          /* Next record written */
+static int g_skew_count = 0;
+
+static unsigned int g_sync_mask = 0; /* Slots currently in bus-triggered mode */
+
+/* trigger starts one conversion; the reading then waits in the
+ * instrument's output buffer until it is addressed to talk.
+ * sync_setup puts the instrument into bus-triggered mode, NULL if it
+ * cannot take part in a synchronized cycle; trigger_field is the shadow
+ * field it overwrites. */
+typedef struct {
+    unsigned char module_type;
+    char *trigger;
+    char *sync_setup;
+    unsigned long trigger_field;
+} acquire_driver;
+
+static const acquire_driver acquire_drivers[] = {
+    { MOD_DM5120, "X",    "TRIGGER GET,ONE",  SH_DM5120_TRIGGER },
+    { MOD_DM5010, "VAL?", "TRIG:SOUR BUS",    SH_DM5010_TRIGGER },
+    { MOD_DC5009, "SEND", NULL,               0 },
+    { MOD_DC5010, "SEND", NULL,               0 }
+};
+#define NUM_ACQUIRE_DRIVERS (sizeof(acquire_drivers) / sizeof(acquire_drivers[0]))
+
+static const acquire_driver *acquire_driver_for(int slot) {
+    unsigned char type = g_system->modules[slot].module_type;
+    int i;
+
+    /* A reducing meter is read once per block, not once per cycle, and a
+     * counter logging both inputs switches between its two reads */
+    if (reduce_enabled(slot) || dc5010_logs_both(slot)) return NULL;
+
+    /* A buffered or streaming DM5120 belongs to its buffer state machine */
+    if (type == MOD_DM5120 && (g_dm5120_config[slot].stream_mode ||
+        (g_dm5120_config[slot].buffer_enabled && g_dm5120_config[slot].buffer_size > 1))) {
+        return NULL;
+    }
+    for (i = 0; i < (int)NUM_ACQUIRE_DRIVERS; i++) {
+        if (acquire_drivers[i].module_type == type) return &acquire_drivers[i];
+    }
+    return NULL;
+}
+
+int acquire_can_pipeline(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return acquire_driver_for(slot) != NULL;
+}
+
+int acquire_can_sync(int slot) {
+    const acquire_driver *drv;
+
+    if (slot < 0 || slot >= 10) return 0;
+    drv = acquire_driver_for(slot);
+    return drv && drv->sync_setup;
+}
+
+/* Insert slot into order[] by expected completion */
+static void acquire_order_insert(int *order, unsigned long *due, int count, int slot) {
+    int j;
+
+    for (j = count; j > 0 && (long)(due[slot] - due[order[j - 1]]) < 0; j--) {
+        order[j] = order[j - 1];
+    }
+    order[j] = slot;
+}
+
+/* Read back a slot whose conversion is over */
+static int acquire_read(int slot, acquire_result *r) {
+    int address = g_system->modules[slot].gpib_address;
+
+    if (gpib_read(address, g_acquire_response, sizeof(g_acquire_response)) > 0 &&
+        parse_reading_value(g_acquire_response, &r->value)) {
+        r->ok = 1;
+    }
+    r->done_ms = tb_now_ms();
+    return r->ok;
+}
+
+/* One slot at a time, for when the list poll goes unanswered */
+static int acquire_collect(int slot, acquire_result *r) {
+    int address = g_system->modules[slot].gpib_address;
+
+    if (gpib_wait_ready_since(address, r->trigger_ms) != 0) {
+        r->done_ms = tb_now_ms();
+        return 0;
+    }
+    r->ready_ms = tb_now_ms();
+    return acquire_read(slot, r);
+}
+
+/* Phase 2 of both cycles.  Slots still converting are serial polled in
+ * one list per round and each is read back in the round its busy bit is
+ * seen clear - the measured end of its conversion, to within a round.
+ * The spread of those instants is the cycle's skew. */
+static unsigned int acquire_collect_all(const int *order, int count, unsigned long cycle_start,
+                                        acquire_result *results, int mode) {
+    acquire_skew_record *rec;
+    int pending[10];
+    int addresses[10];
+    unsigned char status[10];
+    unsigned char seen_busy[10];
+    unsigned long conversion;
+    unsigned long elapsed;
+    unsigned long now;
+    unsigned long first = 0, last = 0;
+    unsigned int ok_mask = 0;
+    int num_pending = count;
+    int read = 0;
+    int i, j, k, n;
+
+    for (j = 0; j < count; j++) {
+        pending[j] = order[j];
+        seen_busy[order[j]] = 0;
+    }
+
+    /* Nothing to learn from polls before the soonest slot is nearly done */
+    if (count > 0) {
+        conversion = sched_conversion_ms(order[0]);
+        conversion -= conversion >> 2;
+        elapsed = tb_elapsed_ms(results[order[0]].trigger_ms);
+        if (elapsed < conversion) delay((unsigned int)(conversion - elapsed));
+    }
+
+    while (num_pending > 0) {
+        for (j = 0; j < num_pending; j++) {
+            addresses[j] = g_system->modules[pending[j]].gpib_address;
+        }
+        n = gpib_spoll_list(addresses, num_pending, status);
+        now = tb_now_ms();
+
+        k = 0;
+        for (j = 0; j < num_pending; j++) {
+            i = pending[j];
+            if (j >= n) {
+                if (acquire_collect(i, &results[i])) ok_mask |= 1 << i;
+                continue;
+            }
+            gpib_service_note(addresses[j], status[j]);
+
+            if (status[j] & GPIB_STB_BUSY) {
+                if (tb_elapsed_ms(results[i].trigger_ms) >= gpib_timeout_ms(addresses[j])) {
+                    gpib_get_completion(addresses[j])->timeouts++;
+                    gpib_health_report(addresses[j], 0);
+                    results[i].done_ms = now;
+                    continue;
+                }
+                seen_busy[i] = 1;
+                pending[k++] = i;
+                continue;
+            }
+
+            /* Seen busy before, so the instant times the conversion */
+            results[i].ready_ms = now;
+            if (seen_busy[i] && g_system->modules[i].module_type == MOD_DM5120) {
+                dm5120_timing_learn(i, now - results[i].trigger_ms);
+            }
+            if (acquire_read(i, &results[i])) ok_mask |= 1 << i;
+        }
+        num_pending = k;
+        if (num_pending > 0) delay(GPIB_POLL_INTERVAL_MS);
+    }
+
+    for (j = 0; j < count; j++) {
+        i = order[j];
+        if (!(ok_mask & (1 << i))) continue;
+        if (read == 0 || (long)(results[i].ready_ms - first) < 0) first = results[i].ready_ms;
+        if (read == 0 || (long)(results[i].ready_ms - last) > 0) last = results[i].ready_ms;
+        read++;
+    }
+
+    g_acquire_stats.cycles++;
+    g_acquire_stats.slot_reads += read;
+    g_acquire_stats.slot_failures += count - read;
+    g_acquire_stats.last_ms = (unsigned int)tb_elapsed_ms(cycle_start);
+    g_acquire_stats.last_slots = count;
+    g_acquire_stats.total_ms += g_acquire_stats.last_ms;
+
+    if (read > 1) {
+        g_acquire_stats.last_skew_ms = (unsigned int)(last - first);
+        g_acquire_stats.skew_cycles++;
+        g_acquire_stats.total_skew_ms += g_acquire_stats.last_skew_ms;
+        if (g_acquire_stats.last_skew_ms > g_acquire_stats.max_skew_ms) {
+            g_acquire_stats.max_skew_ms = g_acquire_stats.last_skew_ms;
+        }
+
+        rec = &g_skew_log[g_skew_head];
+        rec->time_ms = results[order[0]].time_ms;
+        rec->skew_ms = g_acquire_stats.last_skew_ms;
+        rec->slots = (unsigned char)read;
+        rec->mode = (unsigned char)mode;
+        g_skew_head = (g_skew_head + 1) % ACQ_SKEW_LOG;
+        if (g_skew_count < ACQ_SKEW_LOG) g_skew_count++;
+    }
+    return ok_mask;
+}
+
+unsigned int acquire_pipelined(unsigned int slot_mask, acquire_result *results) {
+    const acquire_driver *drv;
+    unsigned long due[10];
+    unsigned long cycle_start = 0;
+    int order[10];
+    int count = 0;
+    int address;
+    int i;
+
+    /* Phase 1 - start every conversion */
+    for (i = 0; i < 10; i++) {
+        if (!(slot_mask & (1 << i))) continue;
+        results[i].ok = 0;
+        results[i].value = 0.0;
+
+        drv = acquire_driver_for(i);
+        address = g_system->modules[i].gpib_address;
+        if (!drv || !gpib_health_ok(address)) continue;
+
+        results[i].time_ms = session_time_ms();
+        results[i].trigger_ms = tb_now_ms();
+        if (count == 0) cycle_start = results[i].trigger_ms;
+        gpib_write_nowait(address, drv->trigger);
+
+        due[i] = results[i].trigger_ms + sched_conversion_ms(i);
+        acquire_order_insert(order, due, count, i);
+        count++;
+    }
+    if (count == 0) return 0;
+
+    return acquire_collect_all(order, count, cycle_start, results, ACQ_MODE_PIPELINED);
+}
+
+unsigned int acquire_sync_setup(unsigned int slot_mask) {
+    const acquire_driver *drv;
+    int address;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (!(slot_mask & (1 << i)) || (g_sync_mask & (1 << i))) continue;
+        drv = acquire_driver_for(i);
+        address = g_system->modules[i].gpib_address;
+        if (!drv || !drv->sync_setup || !gpib_health_ok(address)) continue;
+
+        gpib_write(address, drv->sync_setup);
+        shadow_forget(address, drv->trigger_field);
+        g_sync_mask |= 1 << i;
+    }
+    return g_sync_mask;
+}
+
+/* Back to the trigger set up in the module's configuration */
+void acquire_sync_restore(void) {
+    int address;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (!(g_sync_mask & (1 << i))) continue;
+        address = g_system->modules[i].gpib_address;
+
+        switch (g_system->modules[i].module_type) {
+            case MOD_DM5120:
+                dm5120_set_trigger(address, g_dm5120_config[i].trigger_source ? "EXT" : "TALK",
+                                   g_dm5120_config[i].trigger_mode ? "ONE" : "CONT");
+                break;
+            case MOD_DM5010:
+                dm5010_set_trigger(address, g_dm5010_config[i].trigger_mode == 0 ? "IMM" :
+                                   (g_dm5010_config[i].trigger_mode == 1 ? "EXT" : "BUS"));
+                break;
+        }
+    }
+    g_sync_mask = 0;
+}
+
+unsigned int acquire_sync_mask(void) {
+    return g_sync_mask;
+}
+
+unsigned int acquire_synchronized(unsigned int slot_mask, acquire_result *results) {
+    unsigned long due[10];
+    unsigned long trigger_ms;
+    unsigned long time_ms;
+    int addresses[10];
+    int order[10];
+    int count = 0;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (!(slot_mask & (1 << i))) continue;
+        results[i].ok = 0;
+        results[i].value = 0.0;
+        if (!(g_sync_mask & (1 << i)) ||
+            !gpib_health_ok(g_system->modules[i].gpib_address)) {
+            continue;
+        }
+        addresses[count++] = g_system->modules[i].gpib_address;
+    }
+    if (count == 0) return 0;
+
+    /* Phase 1 - one bus message starts every conversion */
+    time_ms = session_time_ms();
+    trigger_ms = tb_now_ms();
+    gpib_trigger_list(addresses, count);
+
+    count = 0;
+    for (i = 0; i < 10; i++) {
+        if (!(slot_mask & (1 << i)) || !(g_sync_mask & (1 << i)) ||
+            !gpib_health_ok(g_system->modules[i].gpib_address)) {
+            continue;
+        }
+        results[i].time_ms = time_ms;
+        results[i].trigger_ms = trigger_ms;
+        due[i] = trigger_ms + sched_conversion_ms(i);
+        acquire_order_insert(order, due, count, i);
+        count++;
+    }
+
+    return acquire_collect_all(order, count, trigger_ms, results, ACQ_MODE_SYNC);
+}
+
+int acquire_skew_count(void) {
+    return g_skew_count;
+}
+
+acquire_skew_record *acquire_skew_at(int index) {
+    if (index < 0 || index >= g_skew_count) return NULL;
+    return &g_skew_log[(g_skew_head + ACQ_SKEW_LOG - 1 - index) % ACQ_SKEW_LOG];
+}
+
+acquire_stats *acquire_get_stats(void) {
+    return &g_acquire_stats;
+}
+
+void acquire_reset_stats(void) {
+    memset(&g_acquire_stats, 0, sizeof(g_acquire_stats));
+    g_skew_head = 0;
+    g_skew_count = 0;
+}
+
+const char *acquire_mode_name(int mode) {
+    switch (mode) {
+        case ACQ_MODE_SERIAL:    return "SERIAL";
+        case ACQ_MODE_PIPELINED: return "PIPELINED";
+        case ACQ_MODE_SYNC:      return "SYNC";
+        default:                 return "?";
+    }
+}
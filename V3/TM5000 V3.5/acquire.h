@@ -0,0 +1,87 @@
+/*
+ * TM5000 GPIB Control System - Pipelined Acquisition
+ * Version 3.5
+ * Header file for the trigger-all-then-read-all monitor cycle
+ *
+ * Version History:
+ * 3.5 - Initial implementation overlapping instrument conversion times
+ * 3.5 - Synchronized sampling with one Group Execute Trigger per cycle
+ */
+
+#ifndef ACQUIRE_H
+#define ACQUIRE_H
+
+#include "tm5000.h"
+
+/* Acquisition modes for the continuous monitor */
+#define ACQ_MODE_SERIAL     0     /* Write, wait, read one slot at a time */
+#define ACQ_MODE_PIPELINED  1     /* Trigger every due slot, then read all */
+#define ACQ_MODE_SYNC       2     /* One GET to every bus-triggered meter */
+#define ACQ_NUM_MODES       3
+
+#define ACQ_SKEW_LOG        64    /* Cycles kept in the skew record */
+
+typedef struct {
+    float value;
+    unsigned long trigger_ms;     /* Timebase ms when the conversion was started */
+    unsigned long time_ms;        /* Same moment, ms from session start */
+    unsigned long ready_ms;       /* Timebase ms the busy bit was seen clear */
+    unsigned long done_ms;        /* Timebase ms when the reading was in */
+    unsigned char ok;
+} acquire_result;
+
+/* Spread between the sample instants of one cycle.  A slot's instant is
+ * the serial poll round that first found its conversion finished, so
+ * the spread is measured to within one round - a list poll plus the
+ * reads of the slots that finished before it. */
+typedef struct {
+    unsigned long time_ms;        /* Session ms of the cycle */
+    unsigned int skew_ms;
+    unsigned char slots;
+    unsigned char mode;           /* ACQ_MODE_* */
+} acquire_skew_record;
+
+typedef struct {
+    unsigned long cycles;
+    unsigned long slot_reads;     /* Readings collected over all cycles */
+    unsigned long slot_failures;  /* Slots triggered whose reading never came */
+    unsigned long total_ms;       /* First trigger to last reading, summed */
+    unsigned long skew_cycles;    /* Cycles with two or more readings */
+    unsigned long total_skew_ms;
+    unsigned int last_ms;
+    unsigned int last_slots;      /* Slots triggered in the last cycle */
+    unsigned int last_skew_ms;
+    unsigned int max_skew_ms;
+} acquire_stats;
+
+extern int g_acquire_mode;
+
+/* Slot has a trigger command and can take part in a pipelined cycle */
+int acquire_can_pipeline(int slot);
+
+/* Trigger every slot in slot_mask, then read them back in order of
+ * expected completion.  results is indexed by slot; returns the mask of
+ * slots that produced a reading. */
+unsigned int acquire_pipelined(unsigned int slot_mask, acquire_result *results);
+
+/* Synchronized mode - acquire_sync_setup puts the slots in slot_mask that
+ * can take a bus trigger into bus-triggered mode and returns that mask;
+ * acquire_sync_restore puts them back to their configured trigger. */
+int acquire_can_sync(int slot);
+unsigned int acquire_sync_setup(unsigned int slot_mask);
+void acquire_sync_restore(void);
+unsigned int acquire_sync_mask(void);
+
+/* One Group Execute Trigger to every slot in slot_mask, then read them
+ * back.  Same results and return value as acquire_pipelined. */
+unsigned int acquire_synchronized(unsigned int slot_mask, acquire_result *results);
+
+/* Skew record, index 0 = most recent cycle */
+int acquire_skew_count(void);
+acquire_skew_record *acquire_skew_at(int index);
+
+acquire_stats *acquire_get_stats(void);
+void acquire_reset_stats(void);
+const char *acquire_mode_name(int mode);
+
+#endif /* ACQUIRE_H */
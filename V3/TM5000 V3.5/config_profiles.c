@@ -14,6 +14,7 @@
 #include "config_profiles.h"
 #include "data.h"
 #include "modules.h"
+#include "gpib.h"
 #include <stdlib.h>
 
 /* Global profile management state */
@@ -477,6 +478,15 @@ int apply_config_profile(config_profile *profile) {
         g_system->modules[i].gpib_address = profile->gpib_addresses[i];
     }
     
+    gpib_build_device_table();
+    
+    /* Send the restored settings to the instruments, one batch per module */
+    for (i = 0; i < 10; i++) {
+        if (g_system->modules[i].enabled) {
+            apply_module_config(i);
+        }
+    }
+    
     return PROFILE_SUCCESS;
 }
 
@@ -9,25 +9,135 @@
  * 3.2 - Fixed load/save module activation issues, removed legacy format support, fixed CSV parsing bug with pipe delimiters
  * 3.3 - Fixed fseek reliability issues in configuration and measurement data loading
  * 3.5 - Enhanced data export with metadata, real-time streaming, and compression support
+ * 3.5 - Per-sample timestamps stored as 16/32-bit deltas beside module_data
+ * 3.5 - Ring buffer mode keeps the most recent samples with O(1) append
+ * 3.5 - Spill slots hand every stored sample to the session file
+ * 3.5 - Single ingest path for acquired samples with per-slot counters
+ * 3.5 - Learned DM5120 READ cycle times saved with the settings
+ * 3.5 - Named per-slot channels stored beside module_data, saved as extra columns
  */
 
 #include "data.h"
 #include "modules.h"
+#include "gpib.h"
+#include "timebase.h"
+#include "spill.h"
+
+/* Sample timestamps are ms from the session start.  Each slot keeps the
+ * first timestamp in time_base_ms and one delta per sample after it -
+ * 16 bits (2 bytes/sample) until a gap longer than 65 s appears, then
+ * the column is widened to 32 bits once. */
+#define TIME_DELTA16_MAX 0xFFFFU
+
+static unsigned long g_session_start_ms = 0;
+static time_t g_session_start_time = 0;     /* Wall clock at the same moment */
+
+/* Last decoded position per slot so sequential module_time_ms() is O(1) */
+static unsigned int g_time_cursor_index[10];
+static unsigned long g_time_cursor_ms[10];
+
+/* Channel table per slot - a count of 0 or 1 is module_data alone */
+static slot_channel g_channels[10][MAX_SLOT_CHANNELS];
+static unsigned char g_channel_count[10];
+
+static void free_slot_channels(int slot) {
+    int c;
+    
+    for (c = 1; c < MAX_SLOT_CHANNELS; c++) {
+        if (g_channels[slot][c].data) _ffree(g_channels[slot][c].data);
+    }
+    memset(g_channels[slot], 0, sizeof(g_channels[slot]));
+    g_channel_count[slot] = 0;
+}
+
+/* Forget the values given for the next sample - a channel not given
+ * again stores 0 rather than the previous sample's value */
+static void clear_channel_next(int slot) {
+    int c;
+    
+    for (c = 1; c < MAX_SLOT_CHANNELS; c++) {
+        g_channels[slot][c].next = 0.0;
+        g_channels[slot][c].valid = 0;
+    }
+}
+
+static void free_module_times(int slot) {
+    if (g_system->modules[slot].module_time) {
+        _ffree(g_system->modules[slot].module_time);
+        g_system->modules[slot].module_time = NULL;
+    }
+    g_system->modules[slot].module_time_count = 0;
+    g_system->modules[slot].time_wide = 0;
+    g_time_cursor_index[slot] = 0;
+}
+
+static void allocate_module_times(int slot, unsigned int size) {
+    free_module_times(slot);
+    g_system->modules[slot].module_time = _fmalloc(size * sizeof(unsigned int));
+}
+
+/* One-time switch to 32-bit deltas; 0 if there is no memory for it */
+static int widen_module_times(int slot) {
+    tm5000_module *m = &g_system->modules[slot];
+    unsigned long far *wide;
+    unsigned int far *narrow = (unsigned int far *)m->module_time;
+    unsigned int i;
+
+    wide = (unsigned long far *)_fmalloc(m->module_data_size * sizeof(unsigned long));
+    if (!wide) return 0;
+
+    for (i = 0; i < m->module_time_count; i++) {
+        wide[i] = narrow[i];
+    }
+    _ffree(m->module_time);
+    m->module_time = wide;
+    m->time_wide = 1;
+    return 1;
+}
+
+/* Physical position of logical sample index - oldest is index 0 */
+static unsigned int module_data_pos(tm5000_module *m, unsigned int index) {
+    unsigned int pos = m->module_data_head + index;
+
+    if (pos >= m->module_data_size) pos -= m->module_data_size;
+    return pos;
+}
+
+static unsigned long module_time_delta(int slot, unsigned int index) {
+    tm5000_module *m = &g_system->modules[slot];
+    unsigned int pos = module_data_pos(m, index);
+
+    if (m->time_wide) return ((unsigned long far *)m->module_time)[pos];
+    return ((unsigned int far *)m->module_time)[pos];
+}
+
+static void set_time_delta(tm5000_module *m, unsigned int pos, unsigned long delta) {
+    if (m->time_wide) {
+        ((unsigned long far *)m->module_time)[pos] = delta;
+    } else {
+        ((unsigned int far *)m->module_time)[pos] = (unsigned int)delta;
+    }
+}
 
 /* Allocate memory buffer for a module's data */
 int allocate_module_buffer(int slot, unsigned int size) {
     if (slot < 0 || slot >= 10) return 0;
     
-    /* Free existing buffer if present */
+    /* Free existing buffer if present - its channels go with it */
     if (g_system->modules[slot].module_data) {
         _ffree(g_system->modules[slot].module_data);
     }
+    free_slot_channels(slot);
     
     /* Allocate new buffer */
     g_system->modules[slot].module_data = (float far *)_fmalloc(size * sizeof(float));
     if (g_system->modules[slot].module_data) {
         g_system->modules[slot].module_data_size = size;
         g_system->modules[slot].module_data_count = 0;
+        g_system->modules[slot].module_data_head = 0;
+        
+        /* Timestamps are optional - without them time is index x rate */
+        allocate_module_times(slot, size);
         return 1;  /* Success */
     }
     
@@ -44,24 +154,515 @@ void free_module_buffer(int slot) {
         g_system->modules[slot].module_data_size = 0;
         g_system->modules[slot].module_data_count = 0;
     }
+    free_module_times(slot);
+    free_slot_channels(slot);
 }
 
-/* Store a data value in a module's buffer */
+/* Store a data value in a module's buffer, stamped now */
 void store_module_data(int slot, float value) {
-    if (slot < 0 || slot >= 10) return;
-    if (!g_system->modules[slot].module_data) return;
+    store_module_sample(slot, value, session_time_ms());
+}
+
+/* Store a data value taken at time_ms (ms from session start).  A full
+ * buffer drops the sample, or in ring mode overwrites the oldest.
+ * Returns 0 if the sample was dropped. */
+int store_module_sample(int slot, float value, unsigned long time_ms) {
+    tm5000_module *m;
+    unsigned long delta;
+    unsigned int pos;
+    int full;
+    int c;
     
-    if (g_system->modules[slot].module_data_count < g_system->modules[slot].module_data_size) {
-        g_system->modules[slot].module_data[g_system->modules[slot].module_data_count] = value;
-        g_system->modules[slot].module_data_count++;
-        g_system->modules[slot].last_reading = value;
+    if (slot < 0 || slot >= 10) return 0;
+    m = &g_system->modules[slot];
+    if (!m->module_data || m->module_data_size == 0) return 0;
+    
+    if (m->module_data_count < m->module_data_size) {
+        pos = module_data_pos(m, m->module_data_count);
+        full = 0;
+    } else if (m->ring) {
+        pos = m->module_data_head;
+        full = 1;
+    } else {
+        return 0;
     }
+    
+    /* Column stays in step with the data or is dropped for this run */
+    if (m->module_time && m->module_time_count == m->module_data_count) {
+        if (m->module_time_count == 0) {
+            m->time_base_ms = time_ms;
+            delta = 0;
+        } else {
+            delta = time_ms - m->time_last_ms;
+            if ((long)delta < 0) delta = 0;
+        }
+        if (delta > TIME_DELTA16_MAX && !m->time_wide && !widen_module_times(slot)) {
+            delta = TIME_DELTA16_MAX;   /* No memory - clamp the gap */
+        }
+        if (full) {
+            /* Sample 1 becomes the oldest - its time is the new base */
+            m->time_base_ms = m->module_data_size > 1 ?
+                              m->time_base_ms + module_time_delta(slot, 1) : time_ms;
+            g_time_cursor_index[slot] = 0;
+        } else {
+            m->module_time_count++;
+        }
+        set_time_delta(m, pos, delta);
+        m->time_last_ms = time_ms;
+    }
+    
+    m->module_data[pos] = value;
+    for (c = 1; c < g_channel_count[slot]; c++) {
+        g_channels[slot][c].data[pos] = g_channels[slot][c].next;
+    }
+    clear_channel_next(slot);
+    if (full) {
+        m->module_data_head = module_data_pos(m, 1);
+    } else {
+        m->module_data_count++;
+    }
+    m->last_reading = value;
+    
+    if (m->spill) spill_sample_stored(slot);
+    return 1;
+}
+
+/* Acquisition ingest - every reading a driver returns during a session
+ * comes through here exactly once.  Restores from disk (load_data, spill
+ * paging) go to store_module_sample directly and are not counted.
+ * Statistics are kept per channel; the sample counters of channel 0 are
+ * the slot's. */
+static sample_ingest_stats g_ingest[10][MAX_SLOT_CHANNELS];
+
+void ingest_reset(void) {
+    memset(g_ingest, 0, sizeof(g_ingest));
+}
+
+/* Not a number, or an overflow the parser let through */
+static int sample_valid(float value) {
+    return value == value && value <= 1e30 && value >= -1e30;
+}
+
+/* Running mean and variance (Welford) - no pass over the buffer */
+static void ingest_stats_add(sample_ingest_stats *st, float value, unsigned long time_ms) {
+    double delta;
+    
+    st->accepted++;
+    st->last_time_ms = time_ms;
+    if (st->accepted == 1) {
+        st->min = value;
+        st->max = value;
+    } else {
+        if (value < st->min) st->min = value;
+        if (value > st->max) st->max = value;
+    }
+    delta = value - st->mean;
+    st->mean += delta / (double)st->accepted;
+    st->m2 += delta * (value - st->mean);
+}
+
+int ingest_sample(int slot, float value, unsigned long time_ms) {
+    sample_ingest_stats *st;
+    float extra[MAX_SLOT_CHANNELS];
+    int complete = 1;
+    int c;
+    
+    if (slot < 0 || slot >= 10) return INGEST_DROPPED;
+    st = &g_ingest[slot][0];
+    
+    /* The store clears the channels - keep this sample's for the stats */
+    for (c = 1; c < g_channel_count[slot]; c++) {
+        if (!g_channels[slot][c].valid) complete = 0;
+        extra[c] = g_channels[slot][c].next;
+    }
+    
+    /* A channel without a good value drops the whole row */
+    if (!sample_valid(value) || !complete) {
+        clear_channel_next(slot);
+        st->dropped++;
+        return INGEST_DROPPED;
+    }
+    
+    /* A reading no newer than the last one is the same reading again */
+    if (st->accepted > 0 && (long)(time_ms - st->last_time_ms) <= 0) {
+        clear_channel_next(slot);
+        st->duplicated++;
+        return INGEST_DUPLICATE;
+    }
+    
+    if (!store_module_sample(slot, value, time_ms)) {
+        clear_channel_next(slot);
+        st->dropped++;
+        return INGEST_DROPPED;
+    }
+    ingest_stats_add(st, value, time_ms);
+    for (c = 1; c < g_channel_count[slot]; c++) {
+        ingest_stats_add(&g_ingest[slot][c], extra[c], time_ms);
+    }
+    
+    /* Driver min/max shown in the module menus */
+    switch (g_system->modules[slot].module_type) {
+        case MOD_DM5120:
+            if (g_dm5120_config[slot].min_max_enabled && value != 0.0) {
+                if (value < g_dm5120_config[slot].min_value) g_dm5120_config[slot].min_value = value;
+                if (value > g_dm5120_config[slot].max_value) g_dm5120_config[slot].max_value = value;
+                g_dm5120_config[slot].sample_count++;
+            }
+            break;
+        case MOD_DM5010:
+            if (g_dm5010_config[slot].statistics_enabled) {
+                if (value < g_dm5010_config[slot].min_value) g_dm5010_config[slot].min_value = value;
+                if (value > g_dm5010_config[slot].max_value) g_dm5010_config[slot].max_value = value;
+            }
+            break;
+    }
+    
+    update_realtime_export(slot, 0, value, time_ms);
+    for (c = 1; c < g_channel_count[slot]; c++) {
+        update_realtime_export(slot, c, extra[c], time_ms);
+    }
+    return INGEST_ACCEPTED;
+}
+
+/* A reading the driver could not get - counted as dropped, nothing
+ * stored, and the channels staged for it go with it */
+int ingest_failed(int slot) {
+    if (slot < 0 || slot >= 10) return INGEST_DROPPED;
+    clear_channel_next(slot);
+    g_ingest[slot][0].dropped++;
+    return INGEST_DROPPED;
+}
+
+sample_ingest_stats *ingest_get(int slot) {
+    return ingest_channel_get(slot, 0);
+}
+
+float ingest_std_dev(int slot) {
+    return ingest_channel_std_dev(slot, 0);
+}
+
+sample_ingest_stats *ingest_channel_get(int slot, int channel) {
+    if (slot < 0 || slot >= 10 || channel < 0 || channel >= MAX_SLOT_CHANNELS) return NULL;
+    return &g_ingest[slot][channel];
+}
+
+float ingest_channel_std_dev(int slot, int channel) {
+    sample_ingest_stats *st = ingest_channel_get(slot, channel);
+    
+    if (!st || st->accepted < 2) return 0.0;
+    return (float)sqrt(st->m2 / (double)(st->accepted - 1));
+}
+
+/* Give slot the channels in defs, module_data being the first.  A slot
+ * already laid out that way keeps its columns; otherwise the extra
+ * columns are allocated afresh and samples already stored read 0 in
+ * them.  count 1 or defs NULL puts the slot back to module_data alone.
+ * Returns 0 if there was no memory - the slot is then single-channel. */
+int define_slot_channels(int slot, const channel_def *defs, int count) {
+    tm5000_module *m;
+    slot_channel *ch;
+    int c;
+    
+    if (slot < 0 || slot >= 10) return 0;
+    if (!defs || count < 1) count = 1;
+    if (count > MAX_SLOT_CHANNELS) count = MAX_SLOT_CHANNELS;
+    
+    if (defs && g_channel_count[slot] == count) {
+        for (c = 0; c < count; c++) {
+            ch = &g_channels[slot][c];
+            if (strncmp(ch->name, defs[c].name, CHANNEL_NAME_LEN - 1) != 0 ||
+                ch->unit_type != defs[c].unit_type) {
+                break;
+            }
+        }
+        if (c == count) return 1;
+    }
+    
+    free_slot_channels(slot);
+    if (!defs) return 1;
+    m = &g_system->modules[slot];
+    if (count > 1 && !m->module_data) return 0;
+    
+    for (c = 0; c < count; c++) {
+        ch = &g_channels[slot][c];
+        strncpy(ch->name, defs[c].name, CHANNEL_NAME_LEN - 1);
+        ch->unit_type = defs[c].unit_type;
+        if (c == 0) continue;
+        
+        ch->data = (float far *)_fmalloc(m->module_data_size * sizeof(float));
+        if (!ch->data) {
+            free_slot_channels(slot);
+            return 0;
+        }
+        _fmemset(ch->data, 0, m->module_data_size * sizeof(float));
+    }
+    g_channel_count[slot] = (unsigned char)count;
+    return 1;
+}
+
+int slot_channel_count(int slot) {
+    if (slot < 0 || slot >= 10 || g_channel_count[slot] < 1) return 1;
+    return g_channel_count[slot];
+}
+
+/* Descriptor of a channel, NULL for a slot without named channels */
+slot_channel *slot_channel_get(int slot, int channel) {
+    if (slot < 0 || slot >= 10 || channel < 0 || channel >= g_channel_count[slot]) return NULL;
+    return &g_channels[slot][channel];
+}
+
+/* Value of channel (1 up) for the sample the next store writes.  A
+ * reading that failed marks the channel invalid, and the ingest then
+ * drops the whole sample rather than store a value from before. */
+void channel_put(int slot, int channel, float value) {
+    if (slot < 0 || slot >= 10 || channel < 1 || channel >= g_channel_count[slot]) return;
+    if (!sample_valid(value)) {
+        g_ingest[slot][channel].dropped++;
+        g_channels[slot][channel].next = 0.0;
+        g_channels[slot][channel].valid = 0;
+        return;
+    }
+    g_channels[slot][channel].next = value;
+    g_channels[slot][channel].valid = 1;
+}
+
+/* Column of channel - module_data for channel 0 */
+float far *slot_channel_data(int slot, int channel) {
+    if (slot < 0 || slot >= 10) return NULL;
+    if (channel == 0) return g_system->modules[slot].module_data;
+    if (channel < 0 || channel >= g_channel_count[slot]) return NULL;
+    return g_channels[slot][channel].data;
+}
+
+const char *unit_type_name(int unit_type) {
+    switch (unit_type) {
+        case UNIT_FREQUENCY:  return "Hz";
+        case UNIT_DB:         return "dB";
+        case UNIT_DERIVATIVE: return "V/s";
+        case UNIT_CURRENT:    return "A";
+        case UNIT_RESISTANCE: return "Ohm";
+        case UNIT_POWER:      return "V2/Hz";
+        case UNIT_STATE:      return "State";
+        case UNIT_COUNT:      return "Count";
+        default:              return "V";
+    }
+}
+
+/* Sample index in time order, 0 = oldest */
+float module_data_at(int slot, unsigned int index) {
+    tm5000_module *m = &g_system->modules[slot];
+    
+    return m->module_data[module_data_pos(m, index)];
+}
+
+/* Channel sample in time order */
+float channel_data_at(int slot, int channel, unsigned int index) {
+    tm5000_module *m = &g_system->modules[slot];
+    
+    if (channel == 0) return module_data_at(slot, index);
+    return g_channels[slot][channel].data[module_data_pos(m, index)];
+}
+
+/* Fill in channel (1 up) of a sample already stored - paging from disk */
+void channel_store_at(int slot, int channel, unsigned int index, float value) {
+    tm5000_module *m;
+    
+    if (slot < 0 || slot >= 10 || channel < 1 || channel >= g_channel_count[slot]) return;
+    m = &g_system->modules[slot];
+    if (index >= m->module_data_count) return;
+    g_channels[slot][channel].data[module_data_pos(m, index)] = value;
+}
+
+/* Trace sample in time order - traces backed by a ring slot are rotated */
+float trace_data_at(int trace, unsigned int index) {
+    int slot = g_traces[trace].slot;
+    int channel = g_traces[trace].channel;
+    
+    if (slot >= 0 && slot < 10 && channel < slot_channel_count(slot) &&
+        g_traces[trace].data == (float *)slot_channel_data(slot, channel)) {
+        return channel_data_at(slot, channel, index);
+    }
+    return g_traces[trace].data[index];
+}
+
+static void reverse_module_data(int slot, unsigned int a, unsigned int b) {
+    tm5000_module *m = &g_system->modules[slot];
+    float f;
+    unsigned int t16;
+    unsigned long t32;
+    int timed = m->module_time && m->module_time_count == m->module_data_count;
+    int c;
+    
+    while (a < b) {
+        f = m->module_data[a];
+        m->module_data[a] = m->module_data[b];
+        m->module_data[b] = f;
+        for (c = 1; c < g_channel_count[slot]; c++) {
+            f = g_channels[slot][c].data[a];
+            g_channels[slot][c].data[a] = g_channels[slot][c].data[b];
+            g_channels[slot][c].data[b] = f;
+        }
+        if (timed && m->time_wide) {
+            t32 = ((unsigned long far *)m->module_time)[a];
+            ((unsigned long far *)m->module_time)[a] = ((unsigned long far *)m->module_time)[b];
+            ((unsigned long far *)m->module_time)[b] = t32;
+        } else if (timed) {
+            t16 = ((unsigned int far *)m->module_time)[a];
+            ((unsigned int far *)m->module_time)[a] = ((unsigned int far *)m->module_time)[b];
+            ((unsigned int far *)m->module_time)[b] = t16;
+        }
+        a++;
+        b--;
+    }
+}
+
+/* Rotate a wrapped ring in place so index 0 is the oldest sample again -
+ * for the math routines that walk module_data directly.  Three reversals,
+ * no second buffer. */
+void module_data_linearize(int slot) {
+    tm5000_module *m;
+    unsigned int head;
+    
+    if (slot < 0 || slot >= 10) return;
+    m = &g_system->modules[slot];
+    head = m->module_data_head;
+    if (!m->module_data || head == 0) return;
+    
+    reverse_module_data(slot, 0, head - 1);
+    reverse_module_data(slot, head, m->module_data_size - 1);
+    reverse_module_data(slot, 0, m->module_data_size - 1);
+    m->module_data_head = 0;
+    g_time_cursor_index[slot] = 0;
+}
+
+/* Ring mode keeps the newest module_data_size samples instead of the first */
+void set_module_ring(int slot, int enabled) {
+    if (slot < 0 || slot >= 10) return;
+    if (!enabled) module_data_linearize(slot);
+    g_system->modules[slot].ring = enabled ? 1 : 0;
+    if (!enabled) g_system->modules[slot].spill = 0;
+}
+
+/* Spill mode logs the whole run to disk - the buffer becomes a ring
+ * holding the most recent window */
+void set_module_spill(int slot, int enabled) {
+    if (slot < 0 || slot >= 10) return;
+    if (enabled) set_module_ring(slot, 1);
+    g_system->modules[slot].spill = enabled ? 1 : 0;
 }
 
 /* Clear all data in a module's buffer */
 void clear_module_data(int slot) {
     if (slot < 0 || slot >= 10) return;
     g_system->modules[slot].module_data_count = 0;
+    g_system->modules[slot].module_data_head = 0;
+    g_system->modules[slot].module_time_count = 0;
+    g_system->modules[slot].time_base_ms = 0;
+    g_time_cursor_index[slot] = 0;
+}
+
+/* Start a new acquisition session - timestamps count from here */
+void reset_session_time(void) {
+    g_session_start_ms = tb_now_ms();
+    g_session_start_time = time(NULL);
+    ingest_reset();
+}
+
+/* Wall-clock time of the session start, 0 if no session has run */
+time_t session_start_time(void) {
+    return g_session_start_time;
+}
+
+unsigned long session_time_ms(void) {
+    return tb_now_ms() - g_session_start_ms;
+}
+
+/* Every stored sample has a timestamp */
+int module_has_times(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return g_system->modules[slot].module_time &&
+           g_system->modules[slot].module_data_count > 0 &&
+           g_system->modules[slot].module_time_count == g_system->modules[slot].module_data_count;
+}
+
+/* Timestamp of sample index, ms from session start.  Falls back to
+ * index x sample rate for slots without a time column. */
+unsigned long module_time_ms(int slot, unsigned int index) {
+    tm5000_module *m;
+    unsigned int i;
+    unsigned long t;
+    
+    if (!module_has_times(slot) || index >= g_system->modules[slot].module_time_count) {
+        return (unsigned long)index * (unsigned long)g_control_panel.sample_rate_ms;
+    }
+    m = &g_system->modules[slot];
+    
+    /* Walk from the cursor when it is closer than sample 0 */
+    i = g_time_cursor_index[slot];
+    t = g_time_cursor_ms[slot];
+    if (i == 0 || (index < i && i - index > index)) {
+        i = 0;
+        t = m->time_base_ms;
+    }
+    while (i < index) {
+        i++;
+        t += module_time_delta(slot, i);
+    }
+    while (i > index) {
+        t -= module_time_delta(slot, i);
+        i--;
+    }
+    
+    g_time_cursor_index[slot] = i;
+    g_time_cursor_ms[slot] = t;
+    return t;
+}
+
+/* Mean rate over the stored samples, or the configured rate */
+float module_sample_rate_hz(int slot) {
+    unsigned int count;
+    unsigned long span;
+    
+    if (module_has_times(slot)) {
+        count = g_system->modules[slot].module_data_count;
+        span = g_system->modules[slot].time_last_ms - g_system->modules[slot].time_base_ms;
+        if (count > 1 && span > 0) {
+            return (float)(count - 1) * 1000.0 / (float)span;
+        }
+    }
+    return 1000.0 / g_control_panel.sample_rate_ms;
+}
+
+/* Give a math result slot the time column of its source */
+void copy_module_times(int target_slot, int source_slot) {
+    tm5000_module *t = &g_system->modules[target_slot];
+    tm5000_module *s = &g_system->modules[source_slot];
+    unsigned int i;
+    unsigned int count;
+    
+    if (target_slot == source_slot) return;
+    if (!module_has_times(source_slot) || !t->module_data) {
+        t->module_time_count = 0;
+        return;
+    }
+    
+    count = s->module_time_count;
+    if (count > t->module_data_size) count = t->module_data_size;
+    
+    t->module_time_count = 0;
+    if (!t->module_time) return;
+    if (s->time_wide && !t->time_wide && !widen_module_times(target_slot)) return;
+    
+    /* Results are written in time order from index 0 */
+    t->module_data_head = 0;
+    for (i = 0; i < count; i++) {
+        set_time_delta(t, i, module_time_delta(source_slot, i));
+    }
+    
+    t->time_base_ms = s->time_base_ms;
+    t->time_last_ms = module_time_ms(source_slot, count - 1);
+    t->module_time_count = count;
+    g_time_cursor_index[target_slot] = 0;
 }
 
 /* Save measurement data to file */
@@ -69,6 +670,7 @@ void save_data(void) {
     FILE *fp;
     char filename[80];
     int i, j;
+    int c, channels;
     int total_module_samples = 0;
     
     clrscr();
@@ -163,15 +765,34 @@ void save_data(void) {
             }
             
             printf("Writing slot %d data section: %u samples\n", i, data_count);
-            fprintf(fp, "Slot%d:%u\n", i, data_count);
             
-            /* Only write actual data if it exists */
+            /* ":T" - each sample line carries its time in ms from session start.
+             * ":C<n>" - n named channels, one "Channel" line each, and the
+             * values of channels 1 up at the end of every sample line */
+            channels = slot_channel_count(i);
             if (data_count > 0) {
+                fprintf(fp, "Slot%d:%u%s", i, data_count, module_has_times(i) ? ":T" : "");
+                if (channels > 1) {
+                    fprintf(fp, ":C%d\n", channels);
+                    for (c = 0; c < channels; c++) {
+                        fprintf(fp, "Channel%d=%s,%d\n", c, slot_channel_get(i, c)->name,
+                                slot_channel_get(i, c)->unit_type);
+                    }
+                } else {
+                    fprintf(fp, "\n");
+                }
                 for (j = 0; j < data_count; j++) {
-                    fprintf(fp, "%.6e\n", g_system->modules[i].module_data[j]);
+                    fprintf(fp, "%.6e", module_data_at(i, j));
+                    if (module_has_times(i)) fprintf(fp, " %lu", module_time_ms(i, j));
+                    for (c = 1; c < channels; c++) {
+                        fprintf(fp, " %.6e", channel_data_at(i, c, j));
+                    }
+                    fprintf(fp, "\n");
                 }
-                printf("Wrote %u data values for slot %d\n", data_count, i);
+                printf("Wrote %u %s for slot %d\n", data_count,
+                       module_has_times(i) ? "timestamped values" : "data values", i);
             } else {
+                fprintf(fp, "Slot%d:%u\n", i, data_count);
                 printf("No measurement data for slot %d (configured but not measured)\n", i);
             }
         }
@@ -200,6 +821,12 @@ void load_data(void) {
     int i, j;
     unsigned int module_count;
     float value;
+    unsigned long time_ms;
+    int timed;
+    int c, channels, unit;
+    float extra;
+    char channel_names[MAX_SLOT_CHANNELS][CHANNEL_NAME_LEN];
+    channel_def channel_defs[MAX_SLOT_CHANNELS];
     int total_loaded = 0;
     int active_modules = 0;
     
@@ -356,6 +983,9 @@ void load_data(void) {
         }
     }
     
+    /* Module types, addresses and termination are final - rebuild descriptors */
+    gpib_build_device_table();
+    
     /* Read global data with enhanced validation */
     if (g_system->data_buffer == NULL) {
         printf("Error: Global data buffer not allocated\n");
@@ -381,6 +1011,24 @@ void load_data(void) {
         if (strncmp(line, "EndOfFile", 9) == 0) break;
         
         if (sscanf(line, "Slot%d:%u", &slot, &module_count) == 2) {
+            timed = strstr(line, ":T") != NULL;
+            
+            /* Channel lines follow the header of a multi-channel slot */
+            channels = 1;
+            if (strstr(line, ":C") && sscanf(strstr(line, ":C"), ":C%d", &channels) == 1) {
+                if (channels > MAX_SLOT_CHANNELS) channels = MAX_SLOT_CHANNELS;
+                for (c = 0; c < channels; c++) {
+                    channel_defs[c].name = channel_names[c];
+                    channel_defs[c].unit_type = UNIT_VOLTAGE;
+                    strcpy(channel_names[c], "?");
+                    if (fgets(line, sizeof(line), fp) &&
+                        sscanf(line, "Channel%*d=%5[^,],%d", channel_names[c], &unit) == 2) {
+                        channel_defs[c].unit_type = (unsigned char)unit;
+                    }
+                }
+            }
+            if (channels < 1) channels = 1;
+            
             if (slot >= 0 && slot < 10 && g_system->modules[slot].enabled) {
                 printf("Processing slot %d with %u samples...\n", slot, module_count);
                 
@@ -408,14 +1056,24 @@ void load_data(void) {
                 
                 printf("Loading %u samples for slot %d...\n", module_count, slot);
                 
+                if (!define_slot_channels(slot, channels > 1 ? channel_defs : NULL, channels)) {
+                    printf("Warning: No memory for the %d channels of slot %d, loading channel 0 only\n",
+                           channels, slot);
+                }
+                
                 for (j = 0; j < module_count; j++) {
-                    if (fscanf(fp, "%f", &value) == 1) {
+                    time_ms = (unsigned long)j * (unsigned long)g_control_panel.sample_rate_ms;
+                    if (timed ? fscanf(fp, "%f %lu", &value, &time_ms) == 2 :
+                                fscanf(fp, "%f", &value) == 1) {
                         /* Safety check for invalid values */
                         if (value != value || value == HUGE_VAL || value == -HUGE_VAL) {
                             printf("Warning: Invalid data value detected in slot %d sample %d, setting to 0.0\n", slot, j);
                             value = 0.0;  /* Use safe default instead of skipping */
                         }
-                        store_module_data(slot, value);
+                        for (c = 1; c < channels; c++) {
+                            if (fscanf(fp, "%f", &extra) == 1) channel_put(slot, c, extra);
+                        }
+                        store_module_sample(slot, value, time_ms);
                         total_loaded++;
                     } else {
                         printf("Warning: Failed to read sample %d for slot %d\n", j, slot);
@@ -426,8 +1084,7 @@ void load_data(void) {
                 /* Update last reading */
                 if (g_system->modules[slot].module_data_count > 0) {
                     g_system->modules[slot].last_reading = 
-                        g_system->modules[slot].module_data[
-                            g_system->modules[slot].module_data_count - 1];
+                        module_data_at(slot, g_system->modules[slot].module_data_count - 1);
                 }
             }
         }
@@ -557,6 +1214,15 @@ void save_settings(void) {
     fprintf(fp, "AutoScale=%d\n", g_graph_scale.auto_scale);
     fprintf(fp, "ZoomFactor=%f\n", g_graph_scale.zoom_factor);
     
+    /* Learned DM5120 READ cycles - function,digits,filter,range,learned,cycles,max */
+    fprintf(fp, "\n[DM5120Timing]\n");
+    for (i = 0; i < dm5120_timing_count(); i++) {
+        dm5120_timing_entry *e = dm5120_timing_at(i);
+        if (e->samples == 0) continue;
+        fprintf(fp, "Entry%d=%s,%d,%d,%d,%u,%u,%u\n", i, e->function,
+                e->digits, e->filter, e->range, e->learned_ms, e->samples, e->max_ms);
+    }
+    
     fclose(fp);
     
     printf("\nSettings saved to %s\n", filename);
@@ -572,6 +1238,8 @@ void load_settings(void) {
     char key[50], value[200];
     int slot, type, addr;
     char desc[50];
+    dm5120_timing_entry timing;
+    int digits, filter, range;
     
     clrscr();
     printf("Load Configuration Settings\n");
@@ -726,6 +1394,8 @@ void load_settings(void) {
             while (fgets(line, sizeof(line), fp)) {
                 if (line[0] == '[') {
                     /* End of section - don't use unreliable fseek */
+                    /* Strip the newline so the next section matches below */
+                    line[strcspn(line, "\r\n")] = 0;
                     break;
                 }
                 if (sscanf(line, "%[^=]=%s", key, value) == 2) {
@@ -754,7 +1424,10 @@ void load_settings(void) {
         if (strcmp(line, "[GraphScale]") == 0) {
             /* Read graph scale settings */
             while (fgets(line, sizeof(line), fp)) {
-                if (line[0] == '[') break;
+                if (line[0] == '[') {
+                    line[strcspn(line, "\r\n")] = 0;
+                    break;
+                }
                 if (sscanf(line, "%[^=]=%s", key, value) == 2) {
                     if (strcmp(key, "MinValue") == 0) {
                         g_graph_scale.min_value = (float)atof(value);
@@ -768,10 +1441,32 @@ void load_settings(void) {
                 }
             }
         }
+        
+        if (strcmp(line, "[DM5120Timing]") == 0) {
+            /* Learned READ cycles replace the calibration run */
+            dm5120_timing_reset();
+            while (fgets(line, sizeof(line), fp)) {
+                if (line[0] == '[') {
+                    line[strcspn(line, "\r\n")] = 0;
+                    break;
+                }
+                memset(&timing, 0, sizeof(timing));
+                if (sscanf(line, "Entry%d=%9[^,],%d,%d,%d,%u,%u,%u", &slot, timing.function,
+                           &digits, &filter, &range, &timing.learned_ms,
+                           &timing.samples, &timing.max_ms) == 8) {
+                    timing.digits = (unsigned char)digits;
+                    timing.filter = (unsigned char)filter;
+                    timing.range = (unsigned char)range;
+                    dm5120_timing_restore(&timing);
+                }
+            }
+        }
     }
     
     fclose(fp);
     
+    gpib_build_device_table();
+    
     /* Display summary */
     printf("\nSettings loaded successfully!\n");
     printf("Sample rate: %d ms\n", g_control_panel.sample_rate_ms);
@@ -818,8 +1513,8 @@ void save_dm5120_config(FILE *fp, int slot) {
             cfg->nullval, cfg->null_enabled, cfg->data_format, cfg->buffer_enabled, cfg->buffer_size);
     fprintf(fp, "min_max_enabled=%d|min_value=%.6f|max_value=%.6f|sample_count=%d|\n",
             cfg->min_max_enabled, cfg->min_value, cfg->max_value, cfg->sample_count);
-    fprintf(fp, "burst_mode=%d|sample_rate=%.6f|lf_termination=%d\n",
-            cfg->burst_mode, cfg->sample_rate, cfg->lf_termination);
+    fprintf(fp, "burst_mode=%d|sample_rate=%.6f|lf_termination=%d|stream_mode=%d\n",
+            cfg->burst_mode, cfg->sample_rate, cfg->lf_termination, cfg->stream_mode);
 }
 
 /* Save DM5010 configuration to file */
@@ -848,8 +1543,8 @@ void save_ps5004_config(FILE *fp, int slot) {
             cfg->voltage, cfg->current_limit, cfg->output_enabled, cfg->display_mode);
     fprintf(fp, "vri_enabled=%d|cri_enabled=%d|uri_enabled=%d|dt_enabled=%d|\n",
             cfg->vri_enabled, cfg->cri_enabled, cfg->uri_enabled, cfg->dt_enabled);
-    fprintf(fp, "user_enabled=%d|rqs_enabled=%d|lf_termination=%d\n",
-            cfg->user_enabled, cfg->rqs_enabled, cfg->lf_termination);
+    fprintf(fp, "user_enabled=%d|rqs_enabled=%d|lf_termination=%d|log_both=%d\n",
+            cfg->user_enabled, cfg->rqs_enabled, cfg->lf_termination, cfg->log_both);
 }
 
 /* Save PS5010 configuration to file */
@@ -905,8 +1600,8 @@ void save_dc5010_config(FILE *fp, int slot) {
             cfg->level_a, cfg->level_b, cfg->filter_enabled, cfg->auto_trigger);
     fprintf(fp, "overflow_enabled=%d|preset_enabled=%d|srq_enabled=%d|\n",
             cfg->overflow_enabled, cfg->preset_enabled, cfg->srq_enabled);
-    fprintf(fp, "rise_fall_enabled=%d|burst_mode=%d|lf_termination=%d\n",
-            cfg->rise_fall_enabled, cfg->burst_mode, cfg->lf_termination);
+    fprintf(fp, "rise_fall_enabled=%d|burst_mode=%d|lf_termination=%d|log_both=%d\n",
+            cfg->rise_fall_enabled, cfg->burst_mode, cfg->lf_termination, cfg->log_both);
 }
 
 /* Save FG5010 configuration to file */
@@ -967,6 +1662,7 @@ void load_dm5120_config(FILE *fp, int slot) {
                 else if (strcmp(key, "burst_mode") == 0) cfg->burst_mode = atoi(value);
                 else if (strcmp(key, "sample_rate") == 0) cfg->sample_rate = (float)atof(value);
                 else if (strcmp(key, "lf_termination") == 0) cfg->lf_termination = atoi(value);
+                else if (strcmp(key, "stream_mode") == 0) cfg->stream_mode = atoi(value);
             }
             token = strtok(NULL, "|");
         }
@@ -1043,6 +1739,7 @@ void load_ps5004_config(FILE *fp, int slot) {
                 else if (strcmp(key, "user_enabled") == 0) cfg->user_enabled = atoi(value);
                 else if (strcmp(key, "rqs_enabled") == 0) cfg->rqs_enabled = atoi(value);
                 else if (strcmp(key, "lf_termination") == 0) cfg->lf_termination = atoi(value);
+                else if (strcmp(key, "log_both") == 0) cfg->log_both = atoi(value);
             }
             token = strtok(NULL, "|");
         }
@@ -1174,6 +1871,7 @@ void load_dc5010_config(FILE *fp, int slot) {
                 else if (strcmp(key, "rise_fall_enabled") == 0) cfg->rise_fall_enabled = atoi(value);
                 else if (strcmp(key, "burst_mode") == 0) cfg->burst_mode = atoi(value);
                 else if (strcmp(key, "lf_termination") == 0) cfg->lf_termination = atoi(value);
+                else if (strcmp(key, "log_both") == 0) cfg->log_both = atoi(value);
             }
             token = strtok(NULL, "|");
         }
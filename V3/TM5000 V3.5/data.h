@@ -102,7 +102,7 @@ int export_measurement_summary(char *filename, export_config *config);
 
 /* Real-time Export Functions */
 int start_realtime_export(char *filename_template, export_config *config);
-int update_realtime_export(int slot, float value, time_t timestamp);
+int update_realtime_export(int slot, int channel, float value, unsigned long time_ms);
 int stop_realtime_export(void);
 int pause_realtime_export(void);
 int resume_realtime_export(void);
@@ -117,6 +117,8 @@ int export_calibration_info(FILE *file, export_config *config);
 /* Data Format Functions */
 int format_data_value(char *buffer, int buffer_size, float value, export_config *config);
 int format_timestamp(char *buffer, int buffer_size, time_t timestamp, export_config *config);
+int format_timestamp_ms(char *buffer, int buffer_size, time_t base,
+                        unsigned long offset_ms, export_config *config);
 int format_scientific_notation(char *buffer, int buffer_size, float value, int precision);
 int generate_filename_from_template(char *output, int output_size, char *template, time_t timestamp);
 
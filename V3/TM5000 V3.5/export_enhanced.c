@@ -12,26 +12,32 @@
  * 
  * Version History:
  * 3.5 - Initial implementation for enhanced data export
+ * 3.5 - Millisecond timestamps from the PIT timebase
+ * 3.5 - Row timestamps from the stored per-sample times
+ * 3.5 - One column per slot channel, channel index in the real-time rows
  */
 
 #include "data.h"
 #include "modules.h"
+#include "timebase.h"
 
 /* Global variables for enhanced export system */
 realtime_export_state g_realtime_export = {{0}, "", NULL, 0, 0, 0, 0};
+static unsigned long g_realtime_start_ms = 0;   /* tb_now_ms() at session_start */
 export_statistics g_export_stats = {0, 0, 0, 0, 0, 0.0};
 
 /* Enhanced data export with metadata and configuration options */
 int export_data_enhanced(char *filename, export_config *config) {
     FILE *file;
     time_t start_time, end_time;
-    int i, j;
+    int i, j, c;
     char timestamp_str[32];
     char value_str[32];
     unsigned long total_samples = 0;
     unsigned long file_size = 0;
     int enabled_modules[10];
     int enabled_count = 0;
+    time_t time_base;
     
     /* Validate configuration */
     if (validate_export_config(config) != EXPORT_SUCCESS) {
@@ -52,6 +58,17 @@ int export_data_enhanced(char *filename, export_config *config) {
         return EXPORT_ERROR_NO_DATA;
     }
     
+    /* Each slot's time column comes from its own recorded sample times,
+     * counted from the acquisition session start - slots run at their own
+     * periods, so one column for the row would mislabel the others */
+    time_base = config->export_start_time;
+    for (i = 0; i < enabled_count; i++) {
+        if (module_has_times(enabled_modules[i]) && session_start_time()) {
+            time_base = session_start_time();
+            break;
+        }
+    }
+    
     start_time = time(NULL);
     
     /* Create output file */
@@ -92,21 +109,31 @@ int export_data_enhanced(char *filename, export_config *config) {
         }
         
         /* Column headers */
-        if (config->flags & EXPORT_FLAG_TIMESTAMPS) {
-            fprintf(file, "Timestamp%c", config->delimiter);
-        }
         fprintf(file, "Sample");
         
         for (i = 0; i < enabled_count; i++) {
             int slot = enabled_modules[i];
-            fprintf(file, "%cSlot_%d_%s", config->delimiter, slot, 
-                   g_system->modules[slot].description);
             
-            /* Add units if available */
-            if (strlen(config->units_override) > 0) {
-                fprintf(file, "_%s", config->units_override);
-            } else {
-                fprintf(file, "_V"); /* Default to volts */
+            if (config->flags & EXPORT_FLAG_TIMESTAMPS) {
+                fprintf(file, "%cSlot_%d_Time", config->delimiter, slot);
+            }
+            for (c = 0; c < slot_channel_count(slot); c++) {
+                fprintf(file, "%cSlot_%d_%s", config->delimiter, slot, 
+                       g_system->modules[slot].description);
+                
+                /* Named channels carry their own units */
+                if (slot_channel_count(slot) > 1) {
+                    fprintf(file, "_%s", slot_channel_get(slot, c)->name);
+                }
+                
+                /* Add units if available */
+                if (strlen(config->units_override) > 0) {
+                    fprintf(file, "_%s", config->units_override);
+                } else if (slot_channel_count(slot) > 1) {
+                    fprintf(file, "_%s", unit_type_name(slot_channel_get(slot, c)->unit_type));
+                } else {
+                    fprintf(file, "_V"); /* Default to volts */
+                }
             }
         }
         
@@ -120,30 +147,40 @@ int export_data_enhanced(char *filename, export_config *config) {
     
     /* Export data rows */
     for (i = 0; i < total_samples; i++) {
-        /* Timestamp column */
-        if (config->flags & EXPORT_FLAG_TIMESTAMPS) {
-            time_t sample_time = config->export_start_time + 
-                               (i * (g_control_panel.sample_rate_ms / 1000.0));
-            format_timestamp(timestamp_str, sizeof(timestamp_str), sample_time, config);
-            fprintf(file, "%s%c", timestamp_str, config->delimiter);
-        }
-        
         /* Sample number */
         fprintf(file, "%d", i);
         
-        /* Data values for each enabled module */
+        /* Time and data values for each enabled module; a slot with fewer
+         * samples leaves its fields empty */
         for (j = 0; j < enabled_count; j++) {
             int slot = enabled_modules[j];
-            float value = 0.0;
+            int have = i < g_system->modules[slot].module_data_count;
             
-            /* Get data value if available */
-            if (i < g_system->modules[slot].module_data_count) {
-                value = g_system->modules[slot].module_data[i];
+            if (config->flags & EXPORT_FLAG_TIMESTAMPS) {
+                unsigned long offset_ms;
+                
+                timestamp_str[0] = '\0';
+                if (have) {
+                    if (module_has_times(slot)) {
+                        offset_ms = module_time_ms(slot, i);
+                    } else {
+                        offset_ms = (unsigned long)i * (unsigned long)g_control_panel.sample_rate_ms;
+                    }
+                    format_timestamp_ms(timestamp_str, sizeof(timestamp_str), time_base,
+                                        offset_ms, config);
+                }
+                fprintf(file, "%c%s", config->delimiter, timestamp_str);
             }
             
-            /* Format value according to configuration */
-            format_data_value(value_str, sizeof(value_str), value, config);
-            fprintf(file, "%c%s", config->delimiter, value_str);
+            for (c = 0; c < slot_channel_count(slot); c++) {
+                /* Format value according to configuration */
+                value_str[0] = '\0';
+                if (have) {
+                    format_data_value(value_str, sizeof(value_str),
+                                      channel_data_at(slot, c, i), config);
+                }
+                fprintf(file, "%c%s", config->delimiter, value_str);
+            }
         }
         
         /* Environmental data (simulated for now) */
@@ -205,6 +242,7 @@ int start_realtime_export(char *filename_template, export_config *config) {
     memcpy(&g_realtime_export.config, config, sizeof(export_config));
     g_realtime_export.samples_exported = 0;
     g_realtime_export.session_start = current_time;
+    g_realtime_start_ms = tb_now_ms();
     g_realtime_export.active = 1;
     g_realtime_export.error_count = 0;
     strncpy(g_realtime_export.current_filename, actual_filename, 
@@ -218,8 +256,8 @@ int start_realtime_export(char *filename_template, export_config *config) {
         if (config->flags & EXPORT_FLAG_TIMESTAMPS) {
             fprintf(g_realtime_export.file, "Timestamp%c", config->delimiter);
         }
-        fprintf(g_realtime_export.file, "Sample%cSlot%cValue", 
-                config->delimiter, config->delimiter);
+        fprintf(g_realtime_export.file, "Sample%cSlot%cChannel%cValue", 
+                config->delimiter, config->delimiter, config->delimiter);
         
         if (strlen(config->units_override) > 0) {
             fprintf(g_realtime_export.file, "_%s", config->units_override);
@@ -232,10 +270,13 @@ int start_realtime_export(char *filename_template, export_config *config) {
     return EXPORT_SUCCESS;
 }
 
-/* Update real-time export with new data point */
-int update_realtime_export(int slot, float value, time_t timestamp) {
+/* Update real-time export with new data point taken at time_ms (ms from
+ * the acquisition session start) - one row per channel of the sample */
+int update_realtime_export(int slot, int channel, float value, unsigned long time_ms) {
     char timestamp_str[32];
     char value_str[32];
+    unsigned long age_ms;
+    unsigned long elapsed_ms;
     
     /* Check if real-time export is active */
     if (!g_realtime_export.active || !g_realtime_export.file) {
@@ -244,17 +285,23 @@ int update_realtime_export(int slot, float value, time_t timestamp) {
     
     /* Format timestamp if requested */
     if (g_realtime_export.config.flags & EXPORT_FLAG_TIMESTAMPS) {
-        format_timestamp(timestamp_str, sizeof(timestamp_str), timestamp, 
-                        &g_realtime_export.config);
+        /* Readings drained in a batch keep their own sample times */
+        age_ms = session_time_ms() - time_ms;
+        elapsed_ms = tb_elapsed_ms(g_realtime_start_ms);
+        elapsed_ms = elapsed_ms > age_ms ? elapsed_ms - age_ms : 0;
+        format_timestamp_ms(timestamp_str, sizeof(timestamp_str),
+                            g_realtime_export.session_start, elapsed_ms,
+                            &g_realtime_export.config);
         fprintf(g_realtime_export.file, "%s%c", timestamp_str, 
                 g_realtime_export.config.delimiter);
     }
     
-    /* Write sample number, slot, and value */
+    /* Write sample number, slot, channel and value */
     format_data_value(value_str, sizeof(value_str), value, &g_realtime_export.config);
-    fprintf(g_realtime_export.file, "%lu%c%d%c%s\n", 
+    fprintf(g_realtime_export.file, "%lu%c%d%c%d%c%s\n", 
             g_realtime_export.samples_exported, 
             g_realtime_export.config.delimiter, slot,
+            g_realtime_export.config.delimiter, channel,
             g_realtime_export.config.delimiter, value_str);
     
     /* Flush to ensure data is written immediately */
@@ -412,6 +459,22 @@ int format_timestamp(char *buffer, int buffer_size, time_t timestamp, export_con
     return EXPORT_SUCCESS;
 }
 
+/* Timestamp base + offset_ms with milliseconds - sub-second rates would
+ * otherwise print the same second for several rows */
+int format_timestamp_ms(char *buffer, int buffer_size, time_t base,
+                        unsigned long offset_ms, export_config *config) {
+    int result;
+    
+    result = format_timestamp(buffer, buffer_size, base + (time_t)(offset_ms / 1000L), config);
+    if (result != EXPORT_SUCCESS) {
+        return result;
+    }
+    
+    sprintf(buffer + strlen(buffer), ".%03lu", offset_ms % 1000L);
+    
+    return EXPORT_SUCCESS;
+}
+
 /* Format value in scientific notation */
 int format_scientific_notation(char *buffer, int buffer_size, float value, int precision) {
     int exponent = 0;
@@ -6,11 +6,103 @@
  * Version History:
  * 3.0 - Initial extraction from TM5000L.c
  * 3.1 - Version update
+ * 3.5 - Status-driven completion layer replaces fixed delay() padding
+ * 3.5 - Per-address device descriptors replace the DM5120/DM5010 families
+ * 3.5 - Command batching for instrument setup
+ * 3.5 - Streaming multi-value reader for long responses (READ ALLSTORE)
+ * 3.5 - Readings go through the single-pass parser in gpib_parse.c
+ * 3.5 - Transaction trace ring and per-address latency histograms
+ * 3.5 - Rack-wide service scan replaces per-read serial polls
+ * 3.5 - Armed addresses dispatch service requests to their owner
+ * 3.5 - Per-address health with quarantine and exponential backoff
+ * 3.5 - Transaction timing from the PIT timebase instead of clock()
+ * 3.5 - Completion wait measured from an earlier trigger for pipelined reads
+ * 3.5 - Group Execute Trigger to a list of addresses
  */
 
 #include "gpib.h"
+#include "timebase.h"
 
+/* Driver488 handles need raw mode and an IOCTL BREAK; the host build
+ * (make test) talks to sim5000 over plain FIFOs and skips both */
+#ifdef __WATCOMC__
 extern void rawmode(int handle);
+#elif !defined(O_BINARY)
+#define O_BINARY 0
+#endif
+
+/* Per-address completion state, indexed by GPIB address */
+static gpib_completion g_completion[GPIB_MAX_ADDRESS];
+
+/* Per-address device descriptors, indexed by GPIB address */
+static gpib_device g_devices[GPIB_MAX_ADDRESS];
+
+static const unsigned int g_timeout_class_ms[3] = { 500, GPIB_DEFAULT_TIMEOUT_MS, 5000 };
+
+/* Open command batch - one address at a time, -1 when closed */
+static int g_batch_address = -1;
+static char g_batch_buffer[GPIB_BUFFER_SIZE];
+static int g_batch_length = 0;
+static int g_batch_transactions = 0;
+static int g_batch_failed = 0;
+
+/* Per-address health, indexed by GPIB address */
+static gpib_health g_health[GPIB_MAX_ADDRESS];
+
+/* Owners of armed addresses, NULL when not armed */
+static gpib_service_handler g_service_handlers[GPIB_MAX_ADDRESS];
+
+/* Requests of armed addresses seen outside a scan, 0 when none pending */
+static unsigned char g_service_pending[GPIB_MAX_ADDRESS];
+
+static void gpib_failed(int address, int on_bus);
+
+/* Transaction trace - every record is behind a g_trace_enabled test so
+ * the disabled cost is one compare per transaction */
+static int g_trace_enabled = 0;
+static gpib_trace_entry g_trace[GPIB_TRACE_SIZE];
+static unsigned int g_trace_next = 0;
+static unsigned long g_trace_count = 0;
+static gpib_latency_hist g_latency_hist[GPIB_MAX_ADDRESS];
+
+static void gpib_trace_record(int address, char kind, const char *text,
+                              int bytes, unsigned long start) {
+    gpib_trace_entry *e = &g_trace[g_trace_next];
+    gpib_latency_hist *h;
+    unsigned long latency = tb_elapsed_ms(start);
+    int bucket = 0;
+    int i;
+    
+    if (latency > 0xFFFFUL) latency = 0xFFFFUL;
+    
+    e->time_ms = tb_now_ms() - latency;
+    e->latency_ms = (unsigned int)latency;
+    e->bytes = bytes;
+    e->address = (signed char)address;
+    e->kind = kind;
+    e->error = (unsigned char)(bytes < 0 ? errno : 0);
+    for (i = 0; i < GPIB_TRACE_TEXT - 1 && text[i] && text[i] != '\r' && text[i] != '\n'; i++) {
+        e->text[i] = text[i];
+    }
+    e->text[i] = '\0';
+    
+    g_trace_next = (g_trace_next + 1) % GPIB_TRACE_SIZE;
+    g_trace_count++;
+    
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return;
+    h = &g_latency_hist[address];
+    
+    /* log2 bucket: 0ms, 1ms, 2-3ms, 4-7ms ... 1024ms+ */
+    while (latency > 0 && bucket < GPIB_HIST_BUCKETS - 1) {
+        bucket++;
+        latency >>= 1;
+    }
+    if (h->bucket[bucket] < 0xFFFF) h->bucket[bucket]++;
+    h->transactions++;
+    h->total_ms += e->latency_ms;
+    if (bytes > 0) h->bytes += bytes;
+    if (e->latency_ms > h->max_ms) h->max_ms = e->latency_ms;
+}
 
 int ieee_write(const char *str) {
     if (ieee_out < 0) return -1;
@@ -51,13 +143,19 @@ int gpib_check_srq(int address) {
     char cmd[80];
     char response[10];
     int status;
+    int bytes;
+    unsigned long start = g_trace_enabled ? tb_now_ms() : 0;
     
     sprintf(cmd, "spoll %2d\r\n", address);
     ieee_write(cmd);
-    delay(50);
     
-    if (ieee_read(response, sizeof(response)) > 0) {
+    bytes = ieee_read(response, sizeof(response));
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_SPOLL, bytes > 0 ? response : "", bytes, start);
+    }
+    if (bytes > 0) {
         status = atoi(response);
+        gpib_service_note(address, (unsigned char)status);
         return status;
     }
     return 0;
@@ -67,350 +165,889 @@ int ieee_spoll(int address, unsigned char *status) {
     char cmd[80];
     char response[10];
     int result;
+    int bytes;
+    unsigned long start = g_trace_enabled ? tb_now_ms() : 0;
     
     sprintf(cmd, "spoll %2d\r\n", address);
     ieee_write(cmd);
-    delay(50);
     
-    if (ieee_read(response, sizeof(response)) > 0) {
+    bytes = ieee_read(response, sizeof(response));
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_SPOLL, bytes > 0 ? response : "", bytes, start);
+    }
+    if (bytes > 0) {
         result = atoi(response);
         *status = (unsigned char)(result & 0xFF);
+        gpib_service_note(address, *status);
         return 0;  /* Success */
     }
     *status = 0;
     return -1;  /* Error */
 }
 
-void gpib_write(int address, char *command) {
-    char cmd_buffer[GPIB_BUFFER_SIZE];
-    
-    if (g_system && address >= 10 && address < 18) {
-        int slot = address - 10;
-        if (slot >= 0 && slot < 10 && 
-            g_system->modules[slot].module_type == MOD_DM5120) {
-            gpib_check_srq(address);
-            delay(50);
-        }
-    }
-    
-    sprintf(cmd_buffer, "output %2d;%s\r\n", address, command);
-    ieee_write(cmd_buffer);
+/* SRQ line state - Driver488 "spoll" without an address.
+ * Returns 1 when asserted, 0 when not, -1 when the driver did not answer. */
+int gpib_srq_line(void) {
+    char response[10];
+    int bytes;
+    unsigned long start = g_trace_enabled ? tb_now_ms() : 0;
     
-    if (g_system && address >= 10 && address < 18) {
-        int slot = address - 10;
-        if (slot >= 0 && slot < 10 && 
-            g_system->modules[slot].module_type == MOD_DM5120) {
-            delay(100);
-        } else {
-            delay(50);
-        }
-    } else {
-        delay(50);
+    ieee_write("spoll\r\n");
+    bytes = ieee_read(response, sizeof(response));
+    if (g_trace_enabled) {
+        gpib_trace_record(-1, GPIB_TRACE_SPOLL, bytes > 0 ? response : "", bytes, start);
     }
+    if (bytes <= 0) return -1;
+    return atoi(response) != 0;
 }
 
-int gpib_read(int address, char *buffer, int maxlen) {
-    char cmd_buffer[80];
-    int bytes_read;
+/* Serial poll a list of addresses in one Driver488 command
+ * ("spoll 16,17,20"); the driver answers with the status bytes in the
+ * same order.  Returns the number of status bytes read, -1 on error. */
+int gpib_spoll_list(const int *addresses, int count, unsigned char *status) {
+    char cmd[GPIB_BUFFER_SIZE];
+    char response[GPIB_BUFFER_SIZE];
+    char *p;
+    int len, bytes, i, n = 0;
+    unsigned long start = g_trace_enabled ? tb_now_ms() : 0;
     
-    sprintf(cmd_buffer, "enter %2d\r\n", address);
-    ieee_write(cmd_buffer);
+    if (count <= 0) return 0;
     
-    delay(50);
+    len = sprintf(cmd, "spoll ");
+    for (i = 0; i < count && len < (int)sizeof(cmd) - 8; i++) {
+        len += sprintf(cmd + len, i ? ",%d" : "%d", addresses[i]);
+    }
+    count = i;
+    strcpy(cmd + len, "\r\n");
+    ieee_write(cmd);
     
-    bytes_read = ieee_read(buffer, maxlen);
-    return bytes_read;
+    bytes = ieee_read(response, sizeof(response));
+    if (g_trace_enabled) {
+        gpib_trace_record(-1, GPIB_TRACE_SPOLL, bytes > 0 ? response : "", bytes, start);
+    }
+    if (bytes <= 0) return -1;
+    
+    p = response;
+    while (n < count) {
+        while (*p && (*p < '0' || *p > '9')) p++;
+        if (!*p) break;
+        status[n++] = (unsigned char)(atoi(p) & 0xFF);
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    return n;
 }
 
-int gpib_read_float(int address, float *value) {
-    char buffer[GPIB_BUFFER_SIZE];
-    char cmd_buffer[80];
+/* Poll a group of addresses and hand out their requests */
+static int gpib_service_poll(const int *addresses, int count) {
+    unsigned char status[GPIB_MAX_ADDRESS];
+    int requesting = 0;
+    int i, n;
     
-    sprintf(cmd_buffer, "enter %2d\r\n", address);
-    ieee_write(cmd_buffer);
+    if (count == 0) return 0;
     
-    if (ieee_read(buffer, sizeof(buffer)) > 0) {
-        if (sscanf(buffer, "%*[^+-]%f", value) == 1) {
-            return 1;
-        }
-        if (sscanf(buffer, "%f", value) == 1) {
-            return 1;
+    n = gpib_spoll_list(addresses, count, status);
+    for (i = 0; i < n; i++) {
+        int address = addresses[i];
+        
+        g_completion[address].last_status = status[i];
+        if (!(status[i] & GPIB_STB_RQS)) continue;
+        
+        requesting++;
+        if (g_service_handlers[address]) {
+            g_service_handlers[address](address, status[i]);
         }
-        if (sscanf(buffer, "%e", value) == 1) {
-            return 1;
+    }
+    return requesting;
+}
+
+/* Find which configured addresses need attention - call once per
+ * acquisition cycle, or in a wait loop for an armed event.  Costs one
+ * bus operation when nobody is asking.  Armed addresses are polled
+ * first; the rest only if none of them was the requester.
+ * Returns the number of addresses requesting service. */
+int gpib_service_scan(void) {
+    int armed[GPIB_MAX_ADDRESS];
+    int others[GPIB_MAX_ADDRESS];
+    int num_armed = 0;
+    int num_others = 0;
+    int requesting = 0;
+    unsigned char status;
+    int i, n;
+    
+    for (i = 1; i < GPIB_MAX_ADDRESS; i++) {
+        if (g_service_handlers[i]) {
+            armed[num_armed++] = i;
+        } else if (g_devices[i].module_type != MOD_NONE) {
+            others[num_others++] = i;
         }
     }
+    if (num_armed + num_others == 0) return 0;
+    
+    /* A completion poll already cleared these from the SRQ line */
+    for (i = 0; i < num_armed; i++) {
+        status = g_service_pending[armed[i]];
+        if (!status) continue;
+        g_service_pending[armed[i]] = 0;
+        requesting++;
+        g_service_handlers[armed[i]](armed[i], status);
+    }
     
-    return 0;
+    if (gpib_srq_line() == 0) return requesting;
+    
+    n = gpib_service_poll(armed, num_armed);
+    if (n == 0) {
+        n = gpib_service_poll(others, num_others);
+    }
+    return requesting + n;
 }
 
-void gpib_remote(int address) {
-    char cmd_buffer[80];
-    
-    sprintf(cmd_buffer, "remote %2d\r\n", address);
-    ieee_write(cmd_buffer);
-    delay(100);  /* Increased delay for DM5120 */
+/* A status byte read outside a scan.  Serial polling cleared the
+ * instrument's request, so an armed address keeps it for the handler
+ * at the next scan - not run here, in the middle of the transaction
+ * that polled. */
+void gpib_service_note(int address, unsigned char status) {
+    if (address < 1 || address >= GPIB_MAX_ADDRESS) return;
+    if ((status & GPIB_STB_RQS) && g_service_handlers[address]) {
+        g_service_pending[address] = status;
+    }
 }
 
-void gpib_local(int address) {
-    char cmd_buffer[80];
-    
-    sprintf(cmd_buffer, "local %2d\r\n", address);
-    ieee_write(cmd_buffer);
-    delay(50);
+/* Route service requests from an address to handler */
+void gpib_service_arm(int address, gpib_service_handler handler) {
+    if (address < 1 || address >= GPIB_MAX_ADDRESS) return;
+    g_service_handlers[address] = handler;
+    g_service_pending[address] = 0;
 }
 
-void gpib_clear(int address) {
-    char cmd_buffer[80];
-    
-    sprintf(cmd_buffer, "clear %2d\r\n", address);
-    ieee_write(cmd_buffer);
-    delay(100);
+void gpib_service_disarm(int address) {
+    if (address < 1 || address >= GPIB_MAX_ADDRESS) return;
+    g_service_handlers[address] = NULL;
+    g_service_pending[address] = 0;
 }
 
-void gpib_write_dm5120(int address, char *command) {
-    char cmd_buffer[GPIB_BUFFER_SIZE];
-    int slot;
-    char *termination;
+/* Wait for an instrument to finish the last command.
+ * Sleeps through the part of the address's learned latency that is
+ * certain to read busy, then serial polls until the busy bit clears or
+ * the per-address timeout expires.  Returns 0 when ready, -1 on timeout
+ * or when the instrument does not answer serial polls. */
+int gpib_wait_ready(int address) {
+    return gpib_wait_ready_since(address, tb_now_ms());
+}
+
+/* As gpib_wait_ready for a command sent at start_ms - time already spent
+ * since then (reading back other meters) counts toward the wait */
+int gpib_wait_ready_since(int address, unsigned long start_ms) {
+    gpib_completion *c;
+    gpib_device *dev;
+    unsigned char status;
+    unsigned long elapsed;
+    unsigned int timeout;
+    unsigned long start = start_ms;
+    unsigned int lead;
+    
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return -1;
+    if (!gpib_health_ok(address)) {
+        gpib_failed(address, 0);
+        return -1;
+    }
+    c = &g_completion[address];
+    dev = &g_devices[address];
+    
+    /* Addresses without a configured module get the old fixed settle */
+    if (!dev->poll_busy) {
+        elapsed = tb_elapsed_ms(start);
+        if (elapsed < dev->settle_ms) delay((unsigned int)(dev->settle_ms - elapsed));
+        return 0;
+    }
     
-    slot = -1;
-    {
-        int i;
-        for (i = 0; i < 10; i++) {
-            if (g_system->modules[i].gpib_address == address && g_system->modules[i].module_type == MOD_DM5120) {
-                slot = i;
-                break;
-            }
+    timeout = gpib_timeout_ms(address);
+    
+    /* Fast path - skip polls that would only report busy */
+    if (c->samples > 0 && c->learned_ms > GPIB_POLL_INTERVAL_MS) {
+        lead = c->learned_ms - (c->learned_ms >> 2);
+        elapsed = tb_elapsed_ms(start);
+        if (elapsed < lead) delay((unsigned int)(lead - elapsed));
+    }
+    
+    for (;;) {
+        if (ieee_spoll(address, &status) != 0) {
+            c->poll_failed = 1;
+            gpib_failed(address, 1);
+            delay(dev->settle_ms);
+            return -1;
+        }
+        c->poll_failed = 0;
+        c->last_status = status;
+        
+        elapsed = tb_elapsed_ms(start);
+        if (!(status & GPIB_STB_BUSY)) break;
+        
+        if (elapsed >= timeout) {
+            c->timeouts++;
+            gpib_failed(address, 1);
+            return -1;
         }
+        delay(GPIB_POLL_INTERVAL_MS);
     }
     
-    if (slot != -1 && g_dm5120_config[slot].lf_termination) {
-        termination = "\n";  /* LF only for instruments showing "LF" */
+    /* 3/4 old + 1/4 new keeps one slow reading from skewing the average */
+    if (elapsed > 0xFFFFUL) elapsed = 0xFFFFUL;
+    if (c->samples == 0) {
+        c->learned_ms = (unsigned int)elapsed;
     } else {
-        termination = "\r\n";  /* Standard CRLF */
+        c->learned_ms = (unsigned int)(((unsigned long)c->learned_ms * 3 + elapsed) >> 2);
     }
+    if (c->samples < 0xFFFF) c->samples++;
     
-    gpib_check_srq(address);
-    delay(50);
+    return 0;
+}
+
+/* May the address be accessed now?  An expired quarantine lets one
+ * probe through, one failure short of the limit. */
+int gpib_health_ok(int address) {
+    gpib_health *h;
     
-    sprintf(cmd_buffer, "output %2d; %s%s", address, command, termination);
-    ieee_write(cmd_buffer);
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return 0;
+    h = &g_health[address];
+    if (h->state != GPIB_HEALTH_QUARANTINED) return 1;
     
-    delay(200);
+    if ((long)(tb_now_ms() - h->until_ms) < 0) return 0;
+    
+    h->state = GPIB_HEALTH_FAILING;
+    h->failures = GPIB_HEALTH_FAIL_LIMIT - 1;
+    return 1;
 }
 
-int gpib_read_dm5120(int address, char *buffer, int maxlen) {
-    char cmd_buffer[80];
-    int bytes_read;
-    int slot;
-    char *termination;
+void gpib_health_report(int address, int success) {
+    gpib_health *h;
     
-    slot = -1;
-    {
-        int i;
-        for (i = 0; i < 10; i++) {
-            if (g_system->modules[i].gpib_address == address && g_system->modules[i].module_type == MOD_DM5120) {
-                slot = i;
-                break;
-            }
-        }
-    }
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return;
+    h = &g_health[address];
     
-    if (slot != -1 && g_dm5120_config[slot].lf_termination) {
-        termination = "\n";  /* LF only for instruments showing "LF" */
-    } else {
-        termination = "\r\n";  /* Standard CRLF */
+    if (success) {
+        h->state = GPIB_HEALTH_OK;
+        h->failures = 0;
+        h->backoff_ms = GPIB_HEALTH_BACKOFF_MS;
+        return;
     }
     
-    sprintf(cmd_buffer, "enter %2d%s", address, termination);
-    ieee_write(cmd_buffer);
+    if (h->failures < 0xFFFF) h->failures++;
+    if (h->failures < GPIB_HEALTH_FAIL_LIMIT) {
+        h->state = GPIB_HEALTH_FAILING;
+        return;
+    }
     
-    delay(100);
+    if (h->backoff_ms == 0) h->backoff_ms = GPIB_HEALTH_BACKOFF_MS;
+    h->state = GPIB_HEALTH_QUARANTINED;
+    h->until_ms = tb_now_ms() + h->backoff_ms;
+    if (h->quarantines < 0xFFFF) h->quarantines++;
     
-    bytes_read = ieee_read(buffer, maxlen-1);
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-    } else {
-        buffer[0] = '\0';
+    h->backoff_ms <<= 1;
+    if (h->backoff_ms > GPIB_HEALTH_BACKOFF_MAX_MS) {
+        h->backoff_ms = GPIB_HEALTH_BACKOFF_MAX_MS;
     }
-    
-    return bytes_read;
 }
 
-int gpib_read_float_dm5120(int address, float *value) {
-    char buffer[GPIB_BUFFER_SIZE];
-    char cmd_buffer[80];
-    int slot;
-    char *termination;
-    
-    slot = -1;
-    {
-        int i;
-        for (i = 0; i < 10; i++) {
-            if (g_system->modules[i].gpib_address == address && g_system->modules[i].module_type == MOD_DM5120) {
-                slot = i;
-                break;
-            }
+/* A transaction that did not complete.  on_bus is 0 for one skipped
+ * because the address is quarantined - counted, but no further strike
+ * against its health. */
+static void gpib_failed(int address, int on_bus) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return;
+    g_completion[address].failed++;
+    if (on_bus) gpib_health_report(address, 0);
+}
+
+/* Failed transactions on an address so far.  Two readings that differ
+ * mean something in between failed - a write, a read, a completion
+ * poll or a busy timeout. */
+unsigned int gpib_failures(int address) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return 0;
+    return g_completion[address].failed;
+}
+
+gpib_health *gpib_get_health(int address) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return NULL;
+    return &g_health[address];
+}
+
+/* Time left in quarantine, 0 when the address may be accessed */
+unsigned long gpib_health_remaining_ms(int address) {
+    gpib_health *h = gpib_get_health(address);
+    long remaining;
+    
+    if (!h || h->state != GPIB_HEALTH_QUARANTINED) return 0;
+    remaining = (long)(h->until_ms - tb_now_ms());
+    return remaining > 0 ? (unsigned long)remaining : 0;
+}
+
+void gpib_reset_health(void) {
+    memset(g_health, 0, sizeof(g_health));
+}
+
+void gpib_print_health(void) {
+    int i;
+    int shown = 0;
+    
+    printf("Addr  State        Failures  Quarantines  Next backoff\n");
+    for (i = 0; i < GPIB_MAX_ADDRESS; i++) {
+        gpib_health *h = &g_health[i];
+        if (h->failures == 0 && h->quarantines == 0) continue;
+        printf("%4d  %-11s  %8u  %11u  %9ums",
+               i,
+               h->state == GPIB_HEALTH_QUARANTINED ? "QUARANTINED" :
+               h->state == GPIB_HEALTH_FAILING ? "FAILING" : "OK",
+               h->failures, h->quarantines,
+               h->backoff_ms ? h->backoff_ms : GPIB_HEALTH_BACKOFF_MS);
+        if (h->state == GPIB_HEALTH_QUARANTINED) {
+            printf("  (%lus left)", (gpib_health_remaining_ms(i) + 999) / 1000);
         }
+        printf("\n");
+        shown++;
     }
-    
-    if (slot != -1 && g_dm5120_config[slot].lf_termination) {
-        termination = "\n";  /* LF only for instruments showing "LF" */
-    } else {
-        termination = "\r\n";  /* Standard CRLF */
+    if (!shown) {
+        printf("  All addresses healthy\n");
     }
+}
+
+/* Completion timeout - the address's own, else its device class's */
+unsigned int gpib_timeout_ms(int address) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return GPIB_DEFAULT_TIMEOUT_MS;
+    if (g_completion[address].timeout_ms) return g_completion[address].timeout_ms;
+    return g_timeout_class_ms[g_devices[address].timeout_class];
+}
+
+void gpib_set_timeout(int address, unsigned int timeout_ms) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return;
+    g_completion[address].timeout_ms = timeout_ms;
+}
+
+gpib_completion *gpib_get_completion(int address) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return NULL;
+    return &g_completion[address];
+}
+
+void gpib_reset_completion(void) {
+    memset(g_completion, 0, sizeof(g_completion));
+    memset(g_service_pending, 0, sizeof(g_service_pending));
+}
+
+static void set_device_defaults(gpib_device *dev) {
+    strcpy(dev->termination, "\r\n");
+    dev->settle_ms = 50;
+    dev->max_message = 72;  /* Fits "output NN;" in an 80 byte command */
+    dev->module_type = MOD_NONE;
+    dev->slot = -1;
+    dev->timeout_class = GPIB_TIMEOUT_NORMAL;
+    dev->separator = ';';
+    dev->poll_busy = 0;
+    dev->clear_abort = 0;
+}
+
+/* Rebuild the per-address descriptors from the configured modules.
+ * Call after any change to module type, address or termination. */
+void gpib_build_device_table(void) {
+    int i;
+    int lf;
     
-    sprintf(cmd_buffer, "enter %2d%s", address, termination);
-    ieee_write(cmd_buffer);
+    for (i = 0; i < GPIB_MAX_ADDRESS; i++) {
+        set_device_defaults(&g_devices[i]);
+    }
+    gpib_reset_health();  /* Reconfigured meters get a fresh start */
     
-    delay(100);
+    if (!g_system) return;
     
-    if (ieee_read(buffer, sizeof(buffer)) > 0) {
-        if (sscanf(buffer, "NDCV%e", value) == 1) return 1;
-        if (sscanf(buffer, "DCV%e", value) == 1) return 1;
-        if (sscanf(buffer, "NACV%e", value) == 1) return 1;
-        if (sscanf(buffer, "ACV%e", value) == 1) return 1;
-        if (sscanf(buffer, "%e", value) == 1) return 1;
-        if (sscanf(buffer, "%f", value) == 1) return 1;
+    for (i = 0; i < 10; i++) {
+        tm5000_module *mod = &g_system->modules[i];
+        gpib_device *dev;
+        
+        if (!mod->enabled || mod->module_type == MOD_NONE) continue;
+        if (mod->gpib_address < 1 || mod->gpib_address >= GPIB_MAX_ADDRESS) continue;
+        
+        dev = &g_devices[mod->gpib_address];
+        dev->module_type = mod->module_type;
+        dev->slot = (signed char)i;
+        dev->poll_busy = 1;
+        lf = 0;
+        
+        switch (mod->module_type) {
+            case MOD_DM5120:
+                dev->settle_ms = 200;
+                dev->timeout_class = GPIB_TIMEOUT_SLOW;
+                dev->clear_abort = 1;
+                lf = g_dm5120_config[i].lf_termination;
+                break;
+            case MOD_DM5010:
+                dev->settle_ms = 100;
+                lf = g_dm5010_config[i].lf_termination;
+                break;
+            case MOD_PS5004:
+                dev->timeout_class = GPIB_TIMEOUT_FAST;
+                lf = g_ps5004_config[i].lf_termination;
+                break;
+            case MOD_PS5010:
+                dev->timeout_class = GPIB_TIMEOUT_FAST;
+                lf = g_ps5010_config[i].lf_termination;
+                break;
+            case MOD_DC5009:
+                lf = g_dc5009_config[i].lf_termination;
+                break;
+            case MOD_DC5010:
+                lf = g_dc5010_config[i].lf_termination;
+                break;
+            case MOD_FG5010:
+                dev->timeout_class = GPIB_TIMEOUT_FAST;
+                lf = g_fg5010_config[i].lf_termination;
+                break;
+        }
+        
+        if (lf) {
+            strcpy(dev->termination, "\n");  /* LF only for instruments showing "LF" */
+        }
     }
-    
-    return 0;
 }
 
-void gpib_remote_dm5120(int address) {
-    char cmd_buffer[80];
-    int slot;
-    char *termination;
-    
-    slot = -1;
-    {
-        int i;
-        for (i = 0; i < 10; i++) {
-            if (g_system->modules[i].gpib_address == address && g_system->modules[i].module_type == MOD_DM5120) {
-                slot = i;
-                break;
-            }
+gpib_device *gpib_get_device(int address) {
+    if (address < 0 || address >= GPIB_MAX_ADDRESS) return NULL;
+    return &g_devices[address];
+}
+
+void gpib_print_latency(void) {
+    int i;
+    int shown = 0;
+    
+    printf("Addr  Learned  Timeout  Samples  Timeouts  Status\n");
+    for (i = 0; i < GPIB_MAX_ADDRESS; i++) {
+        gpib_completion *c = &g_completion[i];
+        if (c->samples == 0 && c->timeouts == 0 && !c->poll_failed) continue;
+        printf("%4d  %5ums  %5ums  %7u  %8u  0x%02X%s\n",
+               i, c->learned_ms,
+               gpib_timeout_ms(i),
+               c->samples, c->timeouts, c->last_status,
+               c->poll_failed ? " (no spoll)" : "");
+        shown++;
+    }
+    if (!shown) {
+        printf("  No completions recorded yet\n");
+    }
+}
+
+void gpib_trace_enable(int enabled) {
+    g_trace_enabled = enabled ? 1 : 0;
+}
+
+int gpib_trace_enabled(void) {
+    return g_trace_enabled;
+}
+
+void gpib_trace_clear(void) {
+    memset(g_trace, 0, sizeof(g_trace));
+    memset(g_latency_hist, 0, sizeof(g_latency_hist));
+    g_trace_next = 0;
+    g_trace_count = 0;
+}
+
+/* Entry n back from the newest, n = 0 is the newest */
+static gpib_trace_entry *gpib_trace_entry_at(unsigned int n) {
+    return &g_trace[(g_trace_next + GPIB_TRACE_SIZE - 1 - n) % GPIB_TRACE_SIZE];
+}
+
+static unsigned int gpib_trace_available(void) {
+    return g_trace_count < GPIB_TRACE_SIZE ? (unsigned int)g_trace_count : GPIB_TRACE_SIZE;
+}
+
+/* Show the last count transactions, oldest first */
+void gpib_trace_print(int count) {
+    unsigned int n = gpib_trace_available();
+    
+    printf("Trace %s, %lu transactions recorded\n",
+           g_trace_enabled ? "ON" : "OFF", g_trace_count);
+    if (count > 0 && (unsigned int)count < n) n = (unsigned int)count;
+    if (n == 0) return;
+    
+    printf("    Time ms Addr Kind Bytes Latency Err Text\n");
+    while (n-- > 0) {
+        gpib_trace_entry *e = gpib_trace_entry_at(n);
+        printf("%11lu %4d  %c  %5d %5ums %3u %s\n",
+               e->time_ms, e->address, e->kind, e->bytes,
+               e->latency_ms, e->error, e->text);
+    }
+}
+
+static const char * __far hist_labels[GPIB_HIST_BUCKETS] = {
+    "0", "1", "2", "4", "8", "16", "32", "64", "128", "256", "512", "1K+"
+};
+
+void gpib_trace_print_histograms(void) {
+    int i, b;
+    int shown = 0;
+    
+    printf("Latency histograms (ms, bucket = lower bound)\n");
+    printf("Addr  Trans  Avg  Max");
+    for (b = 0; b < GPIB_HIST_BUCKETS; b++) {
+        printf("%5s", hist_labels[b]);
+    }
+    printf("\n");
+    
+    for (i = 0; i < GPIB_MAX_ADDRESS; i++) {
+        gpib_latency_hist *h = &g_latency_hist[i];
+        if (h->transactions == 0) continue;
+        printf("%4d %6lu %4lu %4u", i, h->transactions,
+               h->total_ms / h->transactions, h->max_ms);
+        for (b = 0; b < GPIB_HIST_BUCKETS; b++) {
+            printf("%5u", h->bucket[b]);
         }
+        printf("\n");
+        shown++;
     }
-    
-    if (slot != -1 && g_dm5120_config[slot].lf_termination) {
-        termination = "\n";  /* LF only for instruments showing "LF" */
-    } else {
-        termination = "\r\n";  /* Standard CRLF */
+    if (!shown) {
+        printf("  No transactions recorded%s\n", g_trace_enabled ? "" : " - trace is OFF");
     }
-    
-    sprintf(cmd_buffer, "remote %2d%s", address, termination);
-    ieee_write(cmd_buffer);
-    delay(200);  /* Extended delay for DM5120 */
 }
 
-void gpib_local_dm5120(int address) {
-    char cmd_buffer[80];
-    int slot;
-    char *termination;
+/* Write the ring (oldest first) and the histograms as CSV */
+int gpib_trace_dump(const char *filename) {
+    FILE *fp;
+    unsigned int n = gpib_trace_available();
+    int i, b;
+    
+    fp = fopen(filename, "w");
+    if (!fp) return -1;
+    
+    fprintf(fp, "time_ms,address,kind,bytes,latency_ms,errno,text\n");
+    while (n-- > 0) {
+        gpib_trace_entry *e = gpib_trace_entry_at(n);
+        fprintf(fp, "%lu,%d,%c,%d,%u,%u,\"%s\"\n",
+                e->time_ms, e->address, e->kind, e->bytes,
+                e->latency_ms, e->error, e->text);
+    }
     
-    slot = -1;
-    {
-        int i;
-        for (i = 0; i < 10; i++) {
-            if (g_system->modules[i].gpib_address == address && g_system->modules[i].module_type == MOD_DM5120) {
-                slot = i;
-                break;
-            }
+    fprintf(fp, "\naddress,transactions,bytes,avg_ms,max_ms");
+    for (b = 0; b < GPIB_HIST_BUCKETS; b++) {
+        fprintf(fp, ",%s", hist_labels[b]);
+    }
+    fprintf(fp, "\n");
+    for (i = 0; i < GPIB_MAX_ADDRESS; i++) {
+        gpib_latency_hist *h = &g_latency_hist[i];
+        if (h->transactions == 0) continue;
+        fprintf(fp, "%d,%lu,%lu,%lu,%u", i, h->transactions, h->bytes,
+                h->total_ms / h->transactions, h->max_ms);
+        for (b = 0; b < GPIB_HIST_BUCKETS; b++) {
+            fprintf(fp, ",%u", h->bucket[b]);
         }
+        fprintf(fp, "\n");
     }
     
-    if (slot != -1 && g_dm5120_config[slot].lf_termination) {
-        termination = "\n";  /* LF only for instruments showing "LF" */
-    } else {
-        termination = "\r\n";  /* Standard CRLF */
+    fclose(fp);
+    return 0;
+}
+
+/* Returns 0 when the message went out, -1 when it did not */
+static int gpib_send_output_nowait(int address, char *message) {
+    char cmd_buffer[GPIB_BUFFER_SIZE + 16];
+    gpib_device *dev = gpib_get_device(address);
+    unsigned long start = g_trace_enabled ? tb_now_ms() : 0;
+    int bytes;
+    int len;
+    
+    if (!gpib_health_ok(address)) {  /* Quarantined - no bus time */
+        gpib_failed(address, 0);
+        return -1;
     }
     
-    sprintf(cmd_buffer, "local %2d%s", address, termination);
-    ieee_write(cmd_buffer);
-    delay(100);
+    len = sprintf(cmd_buffer, "output %2d;%s%s", address, message, dev->termination);
+    bytes = ieee_write(cmd_buffer);
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_OUTPUT, message, bytes, start);
+    }
+    if (bytes != len) {
+        gpib_failed(address, 1);
+        return -1;
+    }
+    return 0;
 }
 
-void gpib_clear_dm5120(int address) {
-    char cmd_buffer[80];
-    int slot;
-    char *termination;
+/* Returns 0 once the instrument has finished with the message, -1 if
+ * it did not go out or completion timed out */
+static int gpib_send_output(int address, char *message) {
+    if (gpib_send_output_nowait(address, message) != 0) return -1;
+    return gpib_wait_ready(address);
+}
+
+static void gpib_batch_flush(void) {
+    if (g_batch_address < 0 || g_batch_length == 0) return;
     
-    slot = -1;
-    {
-        int i;
-        for (i = 0; i < 10; i++) {
-            if (g_system->modules[i].gpib_address == address && g_system->modules[i].module_type == MOD_DM5120) {
-                slot = i;
-                break;
-            }
-        }
+    if (gpib_send_output(g_batch_address, g_batch_buffer) != 0) {
+        g_batch_failed = 1;
     }
-    
-    if (slot != -1 && g_dm5120_config[slot].lf_termination) {
-        termination = "\n";  /* LF only for instruments showing "LF" */
-    } else {
-        termination = "\r\n";  /* Standard CRLF */
+    g_batch_buffer[0] = '\0';
+    g_batch_length = 0;
+    g_batch_transactions++;
+}
+
+void gpib_batch_begin(int address) {
+    if (g_batch_address >= 0) {
+        gpib_batch_commit();
     }
+    if (!gpib_get_device(address)) return;
     
-    sprintf(cmd_buffer, "abort%s", termination);
-    ieee_write(cmd_buffer);
-    delay(100);
-    
-    sprintf(cmd_buffer, "clear %2d%s", address, termination);
-    ieee_write(cmd_buffer);
-    delay(200);
+    g_batch_address = address;
+    g_batch_buffer[0] = '\0';
+    g_batch_length = 0;
+    g_batch_transactions = 0;
+    g_batch_failed = 0;
 }
 
-void gpib_write_dm5010(int address, char *command) {
-    char cmd_buffer[GPIB_BUFFER_SIZE];
+/* Send whatever is queued and close the batch.
+ * Returns the number of bus transactions the batch took, -1 if any of
+ * them failed to go out or to complete. */
+int gpib_batch_commit(void) {
+    int transactions;
+    
+    gpib_batch_flush();
+    transactions = g_batch_failed ? -1 : g_batch_transactions;
+    g_batch_address = -1;
+    g_batch_transactions = 0;
+    g_batch_failed = 0;
+    return transactions;
+}
+
+void gpib_write(int address, char *command) {
+    gpib_device *dev = gpib_get_device(address);
+    int len;
     
-    gpib_check_srq(address);
-    delay(50);
+    if (!dev) return;
     
-    sprintf(cmd_buffer, "output %2d; %s\r\n", address, command);
-    ieee_write(cmd_buffer);
+    if (g_batch_address == address) {
+        len = strlen(command);
+        if (g_batch_length > 0 && g_batch_length + 1 + len > (int)dev->max_message) {
+            gpib_batch_flush();
+        }
+        if (len <= (int)dev->max_message) {
+            if (g_batch_length > 0) {
+                g_batch_buffer[g_batch_length++] = dev->separator;
+            }
+            strcpy(g_batch_buffer + g_batch_length, command);
+            g_batch_length += len;
+            return;
+        }
+        /* Too long to batch - fall through and send on its own */
+    } else if (g_batch_address >= 0) {
+        gpib_batch_flush();  /* Keep bus order across addresses */
+    }
     
-    delay(100);
+    if (gpib_send_output(address, command) != 0 && g_batch_address == address) {
+        g_batch_failed = 1;
+    }
+    if (g_batch_address == address) {
+        g_batch_transactions++;
+    }
+}
+
+/* Send a command and return at once - for triggers whose conversion
+ * overlaps other bus work; gpib_wait_ready_since() collects it later */
+void gpib_write_nowait(int address, char *command) {
+    if (!gpib_get_device(address)) return;
+    if (g_batch_address >= 0) {
+        gpib_batch_flush();
+    }
+    gpib_send_output_nowait(address, command);
 }
 
-int gpib_read_dm5010(int address, char *buffer, int maxlen) {
+int gpib_read(int address, char *buffer, int maxlen) {
     char cmd_buffer[80];
     int bytes_read;
+    unsigned long start;
+    gpib_device *dev = gpib_get_device(address);
     
-    sprintf(cmd_buffer, "enter %2d\r\n", address);
+    if (!dev) return -1;
+    if (g_batch_address >= 0) {
+        gpib_batch_flush();  /* Queued commands must reach the instrument first */
+    }
+    if (!gpib_health_ok(address)) {
+        gpib_failed(address, 0);
+        buffer[0] = '\0';
+        return -1;
+    }
+    start = g_trace_enabled ? tb_now_ms() : 0;
+    sprintf(cmd_buffer, "enter %2d%s", address, dev->termination);
     ieee_write(cmd_buffer);
     
-    delay(100);
-    
-    bytes_read = ieee_read(buffer, maxlen-1);
+    bytes_read = ieee_read(buffer, maxlen);
     if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
+        gpib_health_report(address, 1);
     } else {
         buffer[0] = '\0';
+        gpib_failed(address, 1);
+    }
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_ENTER, buffer, bytes_read, start);
     }
-    
     return bytes_read;
 }
 
-int gpib_read_float_dm5010(int address, float *value) {
+int gpib_read_float(int address, float *value) {
     char buffer[GPIB_BUFFER_SIZE];
+    
+    if (gpib_read(address, buffer, sizeof(buffer)) <= 0) return 0;
+    return parse_reading_value(buffer, value);
+}
+
+/* Read a comma/semicolon separated list of values of any length.
+ * Calls ieee_read until the response terminator, carrying a partial
+ * number across chunk boundaries and writing straight into dest.
+ * Returns the number of values stored (at most max_values); anything
+ * beyond max_values is read and discarded so the bus is left clean. */
+int gpib_read_floats(int address, float far *dest, int max_values) {
     char cmd_buffer[80];
+    char chunk[64];
+    char token[32];
+    int token_len = 0;
+    int count = 0;
+    int bytes_read;
+    int done = 0;
+    int total = 0;
+    int i;
+    float value;
+    unsigned long start;
+    gpib_device *dev = gpib_get_device(address);
     
-    sprintf(cmd_buffer, "enter %2d\r\n", address);
+    if (!dev || !dest || max_values <= 0) return 0;
+    if (g_batch_address >= 0) {
+        gpib_batch_flush();
+    }
+    if (!gpib_health_ok(address)) {
+        gpib_failed(address, 0);
+        return 0;
+    }
+    start = g_trace_enabled ? tb_now_ms() : 0;
+    sprintf(cmd_buffer, "enter %2d%s", address, dev->termination);
     ieee_write(cmd_buffer);
+    chunk[0] = '\0';
     
-    delay(100);
+    while (!done) {
+        bytes_read = ieee_read(chunk, sizeof(chunk));
+        if (bytes_read <= 0) {
+            if (total == 0) total = bytes_read;
+            break;
+        }
+        total += bytes_read;
+        
+        for (i = 0; i < bytes_read; i++) {
+            char c = chunk[i];
+            
+            if (c == ',' || c == ';' || c == '\r' || c == '\n' || c == ' ') {
+                if (token_len > 0) {
+                    token[token_len] = '\0';
+                    if (count < max_values && parse_reading_value(token, &value)) {
+                        dest[count++] = value;
+                    }
+                    token_len = 0;
+                }
+                if (c == '\n') {
+                    done = 1;  /* End of message */
+                    break;
+                }
+            } else if (token_len < (int)sizeof(token) - 1) {
+                token[token_len++] = c;
+            }
+        }
+    }
     
-    if (ieee_read(buffer, sizeof(buffer)) > 0) {
-        if (sscanf(buffer, "%e", value) == 1) return 1;
-        if (sscanf(buffer, "%f", value) == 1) return 1;
-        if (sscanf(buffer, "%eV", value) == 1) return 1;
-        if (sscanf(buffer, "%eA", value) == 1) return 1;
-        if (sscanf(buffer, "%eR", value) == 1) return 1;
+    /* Response ended without a terminator */
+    if (token_len > 0) {
+        token[token_len] = '\0';
+        if (count < max_values && parse_reading_value(token, &value)) {
+            dest[count++] = value;
+        }
     }
     
-    return 0;
+    if (total > 0) {
+        gpib_health_report(address, 1);
+    } else {
+        gpib_failed(address, 1);
+    }
+    if (g_trace_enabled) {
+        sprintf(cmd_buffer, "%d values", count);
+        gpib_trace_record(address, GPIB_TRACE_ENTER, cmd_buffer, total, start);
+    }
+    return count;
+}
+
+void gpib_remote(int address) {
+    char cmd_buffer[80];
+    unsigned long start;
+    int bytes;
+    gpib_device *dev = gpib_get_device(address);
+    
+    if (!dev) return;
+    gpib_batch_flush();
+    start = g_trace_enabled ? tb_now_ms() : 0;
+    sprintf(cmd_buffer, "remote %2d%s", address, dev->termination);
+    bytes = ieee_write(cmd_buffer);
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_BUS, "remote", bytes, start);
+    }
+}
+
+void gpib_local(int address) {
+    char cmd_buffer[80];
+    unsigned long start;
+    int bytes;
+    gpib_device *dev = gpib_get_device(address);
+    
+    if (!dev) return;
+    gpib_batch_flush();
+    start = g_trace_enabled ? tb_now_ms() : 0;
+    sprintf(cmd_buffer, "local %2d%s", address, dev->termination);
+    bytes = ieee_write(cmd_buffer);
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_BUS, "local", bytes, start);
+    }
+}
+
+void gpib_clear(int address) {
+    char cmd_buffer[80];
+    unsigned long start;
+    int bytes;
+    gpib_device *dev = gpib_get_device(address);
+    
+    if (!dev) return;
+    gpib_batch_flush();
+    start = g_trace_enabled ? tb_now_ms() : 0;
+    if (dev->clear_abort) {
+        sprintf(cmd_buffer, "abort%s", dev->termination);
+        ieee_write(cmd_buffer);
+    }
+    
+    sprintf(cmd_buffer, "clear %2d%s", address, dev->termination);
+    bytes = ieee_write(cmd_buffer);
+    if (g_trace_enabled) {
+        gpib_trace_record(address, GPIB_TRACE_BUS, "clear", bytes, start);
+    }
+    gpib_wait_ready(address);
+}
+
+/* Group Execute Trigger to several addresses in one bus message - every
+ * listed instrument in bus-triggered mode starts converting at once.
+ * Returns the number of addresses sent. */
+int gpib_trigger_list(const int *addresses, int count) {
+    char cmd[GPIB_BUFFER_SIZE];
+    unsigned long start = g_trace_enabled ? tb_now_ms() : 0;
+    int len, bytes, i;
+    
+    if (count <= 0) return 0;
+    gpib_batch_flush();
+    
+    len = sprintf(cmd, "trigger ");
+    for (i = 0; i < count && len < (int)sizeof(cmd) - 8; i++) {
+        len += sprintf(cmd + len, i ? ",%d" : "%d", addresses[i]);
+    }
+    strcpy(cmd + len, "\r\n");
+    bytes = ieee_write(cmd);
+    if (g_trace_enabled) {
+        gpib_trace_record(-1, GPIB_TRACE_BUS, "trigger", bytes, start);
+    }
+    return bytes > 0 ? i : 0;
 }
 
 int command_has_response(const char *cmd) {
@@ -436,35 +1073,59 @@ void drain_input_buffer(void) {
     char buffer[GPIB_BUFFER_SIZE];
     int bytes_read;
     int total_drained = 0;
+#ifndef __WATCOMC__
+    /* Driver488 returns nothing when it has nothing; a FIFO read waits
+     * for the simulator, so the host build drains without blocking */
+    int flags = fcntl(ieee_in, F_GETFL);
+    
+    fcntl(ieee_in, F_SETFL, flags | O_NONBLOCK);
+#endif
     
     while ((bytes_read = read(ieee_in, buffer, sizeof(buffer))) > 0) {
         total_drained += bytes_read;
         if (total_drained > 1024) break;  /* Safety limit */
     }
+#ifndef __WATCOMC__
+    fcntl(ieee_in, F_SETFL, flags);
+#endif
 }
 
 int init_gpib_system(void) {
     int i, bytes_read;
     char response[GPIB_BUFFER_SIZE];
+    char *out_path;
+    char *in_path;
+    
+    /* TM5000_IEEEOUT/TM5000_IEEEIN point the driver handles at another
+     * endpoint, e.g. a fake ieee device with scripted latencies */
+    out_path = getenv("TM5000_IEEEOUT");
+    if (out_path == NULL) out_path = "\\dev\\ieeeout";
+    in_path = getenv("TM5000_IEEEIN");
+    if (in_path == NULL) in_path = "\\dev\\ieeein";
+    
+    gpib_reset_completion();
+    gpib_reset_health();
+    gpib_build_device_table();
     
     printf("Opening IEEE device handles...\n");
     
-    ieee_out = open("\\dev\\ieeeout", O_WRONLY | O_BINARY);
+    ieee_out = open(out_path, O_WRONLY | O_BINARY);
     if (ieee_out < 0) {
-        printf("Cannot open \\DEV\\IEEEOUT\n");
+        printf("Cannot open %s\n", out_path);
         return -1;
     }
     
     printf("Waiting before opening input device...\n");
     delay(400);  /* 400ms delay to let driver settle */
     
-    ieee_in = open("\\dev\\ieeein", O_RDONLY | O_BINARY);
+    ieee_in = open(in_path, O_RDONLY | O_BINARY);
     if (ieee_in < 0) {
-        printf("Cannot open \\DEV\\IEEEIN\n");
+        printf("Cannot open %s\n", in_path);
         close(ieee_out);
         return -1;
     }
     
+#ifdef __WATCOMC__
     printf("Setting raw mode...\n");
     rawmode(ieee_out);
     rawmode(ieee_in);  /* May fail on Personal488, that's OK */
@@ -490,6 +1151,7 @@ int init_gpib_system(void) {
         }
     }
     delay(200);
+#endif
     
     printf("Initializing IEEE subsystem...\n");
     
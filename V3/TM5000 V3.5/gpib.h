@@ -8,32 +8,164 @@
 #define GPIB_H
 
 #include "tm5000.h"
+#include "gpib_parse.h"
+
+/* Completion layer - v3.5 status-driven transaction timing */
+#define GPIB_MAX_ADDRESS        31
+#define GPIB_STB_BUSY           0x10  /* TM5000 status byte busy bit */
+#define GPIB_STB_RQS            0x40  /* Service request bit */
+#define GPIB_POLL_INTERVAL_MS   5     /* Serial poll interval while busy */
+#define GPIB_DEFAULT_TIMEOUT_MS 2000  /* Per-address completion timeout */
+
+/* Timeout classes for the device descriptor */
+#define GPIB_TIMEOUT_FAST       0     /* Supplies, generators - 500ms */
+#define GPIB_TIMEOUT_NORMAL     1     /* Counters, DM5010 - 2s */
+#define GPIB_TIMEOUT_SLOW       2     /* DM5120 high-resolution/filtered - 5s */
+
+/* Per-address health - a meter that stops answering is quarantined
+ * after a few consecutive failures so it cannot stall the other slots */
+#define GPIB_HEALTH_OK          0
+#define GPIB_HEALTH_FAILING     1     /* Recent failures, still accessed */
+#define GPIB_HEALTH_QUARANTINED 2     /* Skipped until the backoff expires */
+#define GPIB_HEALTH_FAIL_LIMIT  3     /* Consecutive failures before quarantine */
+#define GPIB_HEALTH_BACKOFF_MS  1000  /* First quarantine period, doubles each time */
+#define GPIB_HEALTH_BACKOFF_MAX_MS 32000
+
+/* Transaction trace - ring of recent bus transactions plus per-address
+ * latency histograms, off by default */
+#define GPIB_TRACE_SIZE         64    /* Transactions kept in the ring */
+#define GPIB_TRACE_TEXT         14    /* Command or response characters kept */
+#define GPIB_HIST_BUCKETS       12    /* log2 ms buckets: 0, 1, 2-3, 4-7 ... 1024+ */
+
+/* Transaction kinds */
+#define GPIB_TRACE_OUTPUT       'O'
+#define GPIB_TRACE_ENTER        'E'
+#define GPIB_TRACE_SPOLL        'S'
+#define GPIB_TRACE_BUS          'B'   /* remote, local, clear */
+
+/* Per-address device descriptor - built once by gpib_build_device_table()
+ * whenever modules are configured or loaded */
+typedef struct {
+    char termination[3];          /* "\r\n" or "\n" */
+    unsigned int settle_ms;       /* Fixed settle when busy polling is unavailable */
+    unsigned int max_message;     /* Longest program message the instrument accepts */
+    unsigned char module_type;    /* MOD_* or MOD_NONE if no module at this address */
+    signed char slot;             /* Owning slot, -1 if none */
+    unsigned char timeout_class;  /* GPIB_TIMEOUT_* */
+    char separator;               /* Message unit separator */
+    unsigned char poll_busy:1;    /* Completion by serial poll busy bit */
+    unsigned char clear_abort:1;  /* Send abort before device clear */
+    unsigned char reserved:6;
+} gpib_device;
+
+typedef struct {
+    unsigned int learned_ms;    /* Running average of observed completion time */
+    unsigned int timeout_ms;    /* Give up waiting after this long */
+    unsigned int samples;       /* Completions observed */
+    unsigned int timeouts;      /* Completions that timed out */
+    unsigned int failed;        /* Failed or skipped transactions, wraps */
+    unsigned char last_status;  /* Last serial poll status byte */
+    unsigned char poll_failed:1;  /* Last serial poll got no answer */
+    unsigned char reserved:7;
+} gpib_completion;
+
+typedef struct {
+    unsigned long until_ms;     /* End of quarantine, program ms */
+    unsigned int backoff_ms;    /* Length of the next quarantine */
+    unsigned int failures;      /* Consecutive failed transactions */
+    unsigned int quarantines;   /* Times quarantined since reset */
+    unsigned char state;        /* GPIB_HEALTH_* */
+} gpib_health;
+
+typedef struct {
+    unsigned long time_ms;        /* Start of the transaction, ms since program start */
+    unsigned int latency_ms;      /* Write through last byte read */
+    int bytes;                    /* Bytes moved, negative on error */
+    signed char address;
+    char kind;                    /* GPIB_TRACE_* */
+    unsigned char error;          /* errno when bytes < 0 */
+    char text[GPIB_TRACE_TEXT];   /* Command sent or response received */
+} gpib_trace_entry;
+
+typedef struct {
+    unsigned int bucket[GPIB_HIST_BUCKETS];  /* Saturating counts */
+    unsigned long transactions;
+    unsigned long total_ms;
+    unsigned long bytes;
+    unsigned int max_ms;
+} gpib_latency_hist;
 
 /* GPIB communication functions */
 int init_gpib_system(void);
 int ieee_write(const char *str);
 int ieee_read(char *buffer, int maxlen);
 void gpib_write(int address, char *command);
+void gpib_write_nowait(int address, char *command);
 int gpib_read(int address, char *buffer, int maxlen);
 int gpib_read_float(int address, float *value);
+int gpib_read_floats(int address, float far *dest, int max_values);
 void gpib_remote(int address);
 void gpib_local(int address);
 void gpib_clear(int address);
+int gpib_trigger_list(const int *addresses, int count);
 int gpib_check_srq(int address);
 int ieee_spoll(int address, unsigned char *status);
 
-/* DM5120-specific GPIB functions */
-void gpib_write_dm5120(int address, char *command);
-int gpib_read_dm5120(int address, char *buffer, int maxlen);
-int gpib_read_float_dm5120(int address, float *value);
-void gpib_remote_dm5120(int address);
-void gpib_local_dm5120(int address);
-void gpib_clear_dm5120(int address);
-
-/* DM5010-specific GPIB functions */
-void gpib_write_dm5010(int address, char *command);
-int gpib_read_dm5010(int address, char *buffer, int maxlen);
-int gpib_read_float_dm5010(int address, float *value);
+/* Device descriptor functions */
+void gpib_build_device_table(void);
+gpib_device *gpib_get_device(int address);
+
+/* Command batching - writes to one address between begin and commit
+ * are joined with the instrument's separator into as few "output"
+ * transactions as its message limit allows, with one settle at the end */
+void gpib_batch_begin(int address);
+int gpib_batch_commit(void);
+
+/* Completion layer functions */
+int gpib_wait_ready(int address);
+int gpib_wait_ready_since(int address, unsigned long start_ms);
+unsigned int gpib_failures(int address);
+void gpib_set_timeout(int address, unsigned int timeout_ms);
+unsigned int gpib_timeout_ms(int address);
+gpib_completion *gpib_get_completion(int address);
+void gpib_reset_completion(void);
+void gpib_print_latency(void);
+
+/* Service request handler - called from gpib_service_scan() with the
+ * status byte of an armed address that requested service */
+typedef void (*gpib_service_handler)(int address, unsigned char status);
+
+/* Rack-wide service detection - one SRQ line check per acquisition cycle,
+ * and one multi-address serial poll only when the line is asserted.
+ * Armed addresses are polled first and their requests go straight to
+ * the handler, as do requests a completion poll found since the last
+ * scan; other requests are only counted, their status byte left
+ * in the address's last_status. */
+int gpib_srq_line(void);
+int gpib_spoll_list(const int *addresses, int count, unsigned char *status);
+int gpib_service_scan(void);
+void gpib_service_note(int address, unsigned char status);
+void gpib_service_arm(int address, gpib_service_handler handler);
+void gpib_service_disarm(int address);
+
+/* Health functions - gpib_read and gpib_wait_ready report on their own;
+ * quarantined addresses get no bus traffic until the backoff expires,
+ * then one probe transaction decides between recovery and a longer
+ * quarantine */
+int gpib_health_ok(int address);
+void gpib_health_report(int address, int success);
+gpib_health *gpib_get_health(int address);
+unsigned long gpib_health_remaining_ms(int address);
+void gpib_reset_health(void);
+void gpib_print_health(void);
+
+/* Transaction trace functions */
+void gpib_trace_enable(int enabled);
+int gpib_trace_enabled(void);
+void gpib_trace_clear(void);
+void gpib_trace_print(int count);
+void gpib_trace_print_histograms(void);
+int gpib_trace_dump(const char *filename);
 
 /* Utility functions */
 int command_has_response(const char *cmd);
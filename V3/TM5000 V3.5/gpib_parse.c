@@ -0,0 +1,237 @@
+/*
+ * TM5000 GPIB Control System - Instrument Response Parser
+ * Version 3.5
+ * Single-pass, allocation-free parser for TM5000 family readings
+ *
+ * Responses come in a handful of shapes across the rack:
+ *   DM5120   "NDCV+1.23456E-03", "ACV+1.0000E+00", "OHMS+9.9E+37"
+ *   DM5010   "+4.99876E+00", "-0.0123V"
+ *   DC5009   "FREQ+1.000000E+06", "+1.0E+06"
+ * The old code tried up to six sscanf formats per reading; this walks
+ * the buffer once, keeps the header as a function tag and flags the
+ * over-range and error markers.
+ *
+ * Version History:
+ * 3.5 - Initial implementation replacing the sscanf format cascades
+ */
+
+#include "gpib_parse.h"
+#include "timebase.h"
+
+/* 10^(2^i) for binary exponent scaling */
+static const double __far pow10_table[6] = { 1e1, 1e2, 1e4, 1e8, 1e16, 1e32 };
+
+static double scale_pow10(double mantissa, int exponent) {
+    int neg = 0;
+    int i;
+
+    if (exponent < 0) {
+        neg = 1;
+        exponent = -exponent;
+    }
+    if (exponent > 63) exponent = 63;
+
+    for (i = 0; i < 6 && exponent; i++, exponent >>= 1) {
+        if (exponent & 1) {
+            mantissa = neg ? mantissa / pow10_table[i] : mantissa * pow10_table[i];
+        }
+    }
+    return mantissa;
+}
+
+int parse_reading(const char *text, tm5000_reading *reading) {
+    const char *p = text;
+    unsigned long mantissa = 0;
+    int digits = 0;          /* Significant digits kept in mantissa */
+    int seen_digit = 0;
+    int exponent = 0;        /* Decimal exponent applied to mantissa */
+    int exp_value = 0;
+    int exp_neg = 0;
+    int negative = 0;
+    int tag_len = 0;
+    double value;
+
+    reading->value = 0.0;
+    reading->tag[0] = '\0';
+    reading->status = READING_NONE;
+
+    if (!p) return 0;
+
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+
+    /* Function header - letters before the number */
+    while ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) {
+        if (tag_len < READING_TAG_SIZE - 1) {
+            reading->tag[tag_len++] = (char)toupper((unsigned char)*p);
+        }
+        p++;
+    }
+    reading->tag[tag_len] = '\0';
+
+    if (reading->tag[0] == 'O' && reading->tag[1] == 'V') {
+        reading->status = READING_OVERFLOW;  /* OVER, OVF, OVERFLOW */
+        reading->value = (float)9.9e37;
+        return 1;
+    }
+    if (reading->tag[0] == 'E' && reading->tag[1] == 'R' && reading->tag[2] == 'R') {
+        reading->status = READING_ERROR;
+        return 0;
+    }
+
+    while (*p == ' ' || *p == ':') p++;
+
+    /* Mantissa */
+    if (*p == '+' || *p == '-') {
+        negative = (*p == '-');
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        seen_digit = 1;
+        if (digits < 9) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;  /* Dropped integer digit */
+        }
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            seen_digit = 1;
+            if (digits < 9) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (!seen_digit) return 0;
+
+    /* Exponent - "E" not followed by digits is a unit suffix, not an exponent */
+    if ((*p == 'E' || *p == 'e') &&
+        ((p[1] >= '0' && p[1] <= '9') ||
+         ((p[1] == '+' || p[1] == '-') && p[2] >= '0' && p[2] <= '9'))) {
+        p++;
+        if (*p == '+' || *p == '-') {
+            exp_neg = (*p == '-');
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            if (exp_value < 1000) exp_value = exp_value * 10 + (*p - '0');
+            p++;
+        }
+        exponent += exp_neg ? -exp_value : exp_value;
+    }
+
+    value = scale_pow10((double)mantissa, exponent);
+    if (negative) value = -value;
+
+    reading->value = (float)value;
+    if (value >= READING_OVERFLOW_LEVEL || value <= -READING_OVERFLOW_LEVEL) {
+        reading->status = READING_OVERFLOW;
+    } else {
+        reading->status = READING_OK;
+    }
+    return 1;
+}
+
+int parse_reading_value(const char *text, float *value) {
+    tm5000_reading reading;
+
+    if (parse_reading(text, &reading)) {
+        *value = reading.value;
+        return 1;
+    }
+    return 0;
+}
+
+/* Old per-reading path kept here only as the benchmark baseline */
+static int parse_sscanf_cascade(const char *buffer, float *value) {
+    if (sscanf(buffer, "%*[^+-]%f", value) == 1) return 1;
+    if (sscanf(buffer, "%f", value) == 1) return 1;
+    if (sscanf(buffer, "%e", value) == 1) return 1;
+    if (sscanf(buffer, "NDCV%e", value) == 1) return 1;
+    if (sscanf(buffer, "DCV%e", value) == 1) return 1;
+    if (sscanf(buffer, "NACV%e", value) == 1) return 1;
+    if (sscanf(buffer, "ACV%e", value) == 1) return 1;
+    return 0;
+}
+
+/* Responses recorded from the rack */
+static const char * __far bench_responses[] = {
+    "NDCV+1.23456E-03\r\n",
+    "DCV-0.012345\r\n",
+    "NACV+2.5000E-01\r\n",
+    "ACV+1.0000E+00\r\n",
+    "OHMS+9.9E+37\r\n",
+    "+4.99876E+00\r\n",
+    "-0.0123V\r\n",
+    "FREQ+1.000000E+06\r\n",
+    "1.2345E-3\r\n",
+    " 12.5\r\n"
+};
+#define NUM_BENCH_RESPONSES (sizeof(bench_responses) / sizeof(bench_responses[0]))
+#define BENCH_ITERATIONS 200
+
+void parse_benchmark(void) {
+    tm5000_reading reading;
+    float old_value, new_value;
+    unsigned long start;
+    unsigned long old_us, new_us;
+    int i, n;
+    int mismatches = 0;
+
+    printf("Response parser benchmark (%d responses x %d passes)\n",
+           (int)NUM_BENCH_RESPONSES, BENCH_ITERATIONS);
+    printf("====================================================\n\n");
+
+    printf("%-20s %-14s %-14s %s\n", "Response", "sscanf", "parse_reading", "Tag");
+    for (i = 0; i < (int)NUM_BENCH_RESPONSES; i++) {
+        int old_ok = parse_sscanf_cascade(bench_responses[i], &old_value);
+        int new_ok = parse_reading(bench_responses[i], &reading);
+        char shown[20];
+
+        strncpy(shown, bench_responses[i], sizeof(shown) - 1);
+        shown[sizeof(shown) - 1] = '\0';
+        shown[strcspn(shown, "\r\n")] = '\0';
+
+        printf("%-20s ", shown);
+        if (old_ok) printf("%-14.6e ", old_value); else printf("%-14s ", "FAIL");
+        if (new_ok) printf("%-14.6e ", reading.value); else printf("%-14s ", "FAIL");
+        printf("%s%s\n", reading.tag,
+               reading.status == READING_OVERFLOW ? " (overflow)" : "");
+
+        if (old_ok && new_ok && fabs(old_value - reading.value) > fabs(old_value) * 1e-6) {
+            mismatches++;
+        }
+    }
+
+    /* PIT timebase - clock() only ticks every 55 ms, longer than a pass */
+    start = tb_now_us();
+    for (n = 0; n < BENCH_ITERATIONS; n++) {
+        for (i = 0; i < (int)NUM_BENCH_RESPONSES; i++) {
+            parse_sscanf_cascade(bench_responses[i], &old_value);
+        }
+    }
+    old_us = tb_now_us() - start;
+
+    start = tb_now_us();
+    for (n = 0; n < BENCH_ITERATIONS; n++) {
+        for (i = 0; i < (int)NUM_BENCH_RESPONSES; i++) {
+            parse_reading_value(bench_responses[i], &new_value);
+        }
+    }
+    new_us = tb_now_us() - start;
+
+    n = BENCH_ITERATIONS * (int)NUM_BENCH_RESPONSES;
+    printf("\nsscanf cascade: %lu.%03lu ms (%lu us per response)\n",
+           old_us / 1000L, old_us % 1000L, old_us / n);
+    printf("parse_reading:  %lu.%03lu ms (%lu us per response)\n",
+           new_us / 1000L, new_us % 1000L, new_us / n);
+    if (new_us > 0) {
+        printf("Speedup:        %.1fx\n", (float)old_us / (float)new_us);
+    }
+    printf("Value mismatches where both parsed: %d\n", mismatches);
+}
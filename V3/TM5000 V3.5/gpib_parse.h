@@ -0,0 +1,40 @@
+/*
+ * TM5000 GPIB Control System - Instrument Response Parser
+ * Version 3.5
+ * Header file for the single-pass reading parser
+ *
+ * Version History:
+ * 3.5 - Initial implementation replacing the sscanf format cascades
+ */
+
+#ifndef GPIB_PARSE_H
+#define GPIB_PARSE_H
+
+#include "tm5000.h"
+
+/* Reading status */
+#define READING_OK        0
+#define READING_OVERFLOW  1     /* Over-range marker or 9.9E37 value */
+#define READING_ERROR     2     /* Instrument reported an error */
+#define READING_NONE      3     /* No number found */
+
+#define READING_TAG_SIZE  6
+#define READING_OVERFLOW_LEVEL 9.0e37
+
+typedef struct {
+    float value;                   /* Parsed value, 0.0 if none */
+    char tag[READING_TAG_SIZE];    /* Function header (NDCV, DCV, OHMS, FREQ...), "" if none */
+    unsigned char status;          /* READING_* */
+} tm5000_reading;
+
+/* Parse one TM5000 response such as "NDCV+1.2345E-03", "-0.0123V" or
+ * "OVER".  Returns 1 when a value was found (status OK or OVERFLOW). */
+int parse_reading(const char *text, tm5000_reading *reading);
+
+/* Convenience wrapper - value only */
+int parse_reading_value(const char *text, float *value);
+
+/* Compare parse_reading against the old sscanf cascade on recorded responses */
+void parse_benchmark(void);
+
+#endif /* GPIB_PARSE_H */
@@ -10,6 +10,8 @@
  * 3.3 - Version update
  * 3.4 - Added get_power_units() and UNIT_POWER support for FFT power spectrum display
  * 3.5 - Added CGA assembly optimizations for 286/287 systems
+ * 3.5 - Shadowed text-mode writes straight to video memory for the monitor
+ * 3.5 - Legend names the channel shown for multi-channel slots
  */
 
 #include "graphics.h"
@@ -99,6 +101,44 @@ void clreol(void) {
     int86(0x10, &regs, &regs);
 }
 
+/* Copy of what text_put_diff last wrote to the 80x25 text screen */
+static char __far text_shadow[25][80];
+
+/* Forget the shadow so the next text_put_diff rewrites every field -
+ * after clrscr or anything else that wrote to the screen */
+void text_shadow_reset(void) {
+    _fmemset(text_shadow, 0, sizeof(text_shadow));
+}
+
+/* Write text at column x, row y (1-based) padded with spaces to width,
+ * straight into text video memory.  Only characters that differ from the
+ * shadow are stored, so an unchanged field costs a compare per character
+ * and no BIOS calls.  Returns the number of characters written. */
+int text_put_diff(int x, int y, const char *text, int width) {
+    unsigned char far *cell;
+    char far *shadow;
+    int written = 0;
+    char c;
+    
+    if (y < 1 || y > 25 || x < 1 || x > 80) return 0;
+    if (width > 81 - x) width = 81 - x;
+    
+    cell = video_mem + ((y - 1) * 80 + (x - 1)) * 2;
+    shadow = &text_shadow[y - 1][x - 1];
+    
+    while (width-- > 0) {
+        c = *text ? *text++ : ' ';
+        if (*shadow != c) {
+            *shadow = c;
+            *cell = (unsigned char)c;    /* Attribute byte is left alone */
+            written++;
+        }
+        shadow++;
+        cell += 2;
+    }
+    return written;
+}
+
 /* Plot a pixel in CGA graphics mode */
 void plot_pixel(int x, int y, unsigned char color) {
     unsigned int offset;
@@ -621,7 +661,9 @@ void draw_frequency_grid(int fft_samples, int selected_trace) {
     int grid_divisions = 5;  /* Default major divisions */
     int show_minor_grid = 0;
     
-    sample_rate = 1000.0 / g_control_panel.sample_rate_ms;  /* Hz */
+    /* Rate the FFT was computed with - measured from timestamps when available */
+    sample_rate = g_fft_sample_rate > 0.0 ? g_fft_sample_rate :
+                  1000.0 / g_control_panel.sample_rate_ms;  /* Hz */
     max_freq = sample_rate / 2.0;  /* Nyquist frequency */
     
     if (max_freq >= 1000000.0) {
@@ -1063,6 +1105,8 @@ void draw_legend_enhanced(int *is_fft_trace, int selected_trace) {
             /* Get module name based on trace type first, then module type */
             if (is_fft_trace[i]) {
                 module_name = "FFT";
+            } else if (slot_channel_count(i) > 1) {
+                module_name = slot_channel_get(i, g_traces[i].channel)->name;
             } else if ((g_traces[i].enabled && g_traces[i].unit_type == UNIT_DERIVATIVE) ||
                        (g_system->modules[i].enabled && strcmp(g_system->modules[i].description, "Derivative") == 0)) {
                 module_name = "DERIV";
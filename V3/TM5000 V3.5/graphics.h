@@ -26,6 +26,8 @@ void clrscr(void);
 void gotoxy(int x, int y);
 void textattr(unsigned char attr);
 void clreol(void);
+void text_shadow_reset(void);
+int text_put_diff(int x, int y, const char *text, int width);
 void draw_text(int x, int y, char *text, unsigned char color);
 void draw_text_scaled(int x, int y, char *text, unsigned char color, int scale_x, int scale_y);
 void draw_readout(int x, int y, char *text);
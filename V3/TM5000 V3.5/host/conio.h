@@ -0,0 +1,8 @@
+/* Host build shim - see dos.h.  Console I/O is not used by the tests. */
+#ifndef HOST_CONIO_H
+#define HOST_CONIO_H
+
+int getch(void);
+int kbhit(void);
+
+#endif /* HOST_CONIO_H */
@@ -0,0 +1,31 @@
+/*
+ * TM5000 GPIB Control System - Host Build Shim
+ * Version 3.5
+ * Stand-in for the OpenWatcom <dos.h> so the GPIB layer compiles with
+ * the host compiler for "make test".  Not used by the DOS build.
+ *
+ * Version History:
+ * 3.5 - Initial implementation
+ */
+
+#ifndef HOST_DOS_H
+#define HOST_DOS_H
+
+/* One flat address space - the memory model keywords go away */
+#define far
+#define _far
+#define __far
+#define near
+#define huge
+#define interrupt
+#define __interrupt
+
+struct WORDREGS { unsigned short ax, bx, cx, dx, si, di, cflag; };
+struct BYTEREGS { unsigned char al, ah, bl, bh, cl, ch, dl, dh; };
+union REGS { struct WORDREGS x; struct WORDREGS w; struct BYTEREGS h; };
+struct SREGS { unsigned short es, cs, ss, ds; };
+
+/* From timebase.c (host build) */
+void delay(unsigned int milliseconds);
+
+#endif /* HOST_DOS_H */
@@ -0,0 +1,2 @@
+/* Host build shim - see dos.h */
+#include <dos.h>
@@ -0,0 +1,14 @@
+/* Host build shim - see dos.h.  Far heap calls map to the one heap. */
+#ifndef HOST_MALLOC_H
+#define HOST_MALLOC_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define _fmalloc  malloc
+#define _ffree    free
+#define _fmemset  memset
+#define _fmemcpy  memcpy
+#define _fmemmove memmove
+
+#endif /* HOST_MALLOC_H */
@@ -0,0 +1,220 @@
+/*
+ * TM5000 GPIB Control System - Completion Layer Test
+ * Version 3.5
+ * Host-side (Linux) test of gpib.c against the rack simulator
+ *
+ * Starts sim5000 on a pair of FIFOs, opens them through
+ * init_gpib_system() as the DOS program opens Driver488, and checks the
+ * completion layer end to end: busy polling and learned completion time,
+ * command batching, failure reporting on a completion timeout, and
+ * service request dispatch to an armed handler.
+ *
+ * Not part of the DOS build - run with the host compiler:
+ *     make test           (builds sim5000 and test_gpib, then runs it)
+ *
+ * Usage:
+ *     test_gpib [path-to-sim5000]      (default ./sim5000)
+ * Exit status is the number of failed checks.
+ *
+ * Version History:
+ * 3.5 - Initial implementation
+ */
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "tm5000.h"
+#include "gpib.h"
+#include "timebase.h"
+
+/* Globals main.c provides in the DOS program */
+int ieee_out = -1;
+int ieee_in = -1;
+int gpib_error = 0;
+char g_error_msg[64] = "";
+measurement_system *g_system = NULL;
+dm5120_config g_dm5120_config[10];
+dm5010_config g_dm5010_config[10];
+ps5004_config g_ps5004_config[10];
+ps5010_config g_ps5010_config[10];
+dc5009_config g_dc5009_config[10];
+dc5010_config g_dc5010_config[10];
+fg5010_config g_fg5010_config[10];
+
+#define TEST_DM5120   16
+#define TEST_DM5010   18
+
+/* DM5120 converts in 80 ms; the DM5010 stays busy 2 s after a setting,
+ * longer than the 500 ms FAST timeout the test gives it */
+static const char *g_rack =
+    "16 DM5120 conv=80 value=1.25\n"
+    "18 DM5010 conv=40 setup=2000 value=5.0\n";
+
+static int g_failed = 0;
+static int g_service_calls = 0;
+static unsigned char g_service_status = 0;
+
+static void check(int ok, const char *what) {
+    printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) g_failed++;
+}
+
+static void test_service(int address, unsigned char status) {
+    if (address == TEST_DM5120) {
+        g_service_calls++;
+        g_service_status = status;
+    }
+}
+
+static void add_module(int slot, int type, int address) {
+    tm5000_module *mod = &g_system->modules[slot];
+
+    mod->enabled = 1;
+    mod->module_type = type;
+    mod->gpib_address = address;
+}
+
+static pid_t start_sim(const char *sim, const char *cfg, const char *out, const char *in) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execl(sim, sim, "-c", cfg, "-o", out, "-i", in, "-1", (char *)NULL);
+        perror(sim);
+        _exit(127);
+    }
+    return pid;
+}
+
+static void test_completion(void) {
+    gpib_completion *c = gpib_get_completion(TEST_DM5120);
+    unsigned int failures = gpib_failures(TEST_DM5120);
+    float value = 0.0;
+
+    /* gpib_write returns once the busy bit has cleared */
+    gpib_write(TEST_DM5120, "READ ADC");
+    check(c->samples == 1, "READ ADC completion timed by busy polling");
+    check(c->learned_ms >= 70 && c->learned_ms < 300, "learned time follows the 80 ms conversion");
+    check(gpib_read_float(TEST_DM5120, &value) && value > 1.2 && value < 1.3,
+          "reading parsed after completion");
+    check(gpib_failures(TEST_DM5120) == failures, "no failures counted on a good read");
+}
+
+static void test_batch(void) {
+    int transactions;
+
+    gpib_batch_begin(TEST_DM5120);
+    gpib_write(TEST_DM5120, "FUNCT DCV");
+    gpib_write(TEST_DM5120, "DIGITS 5");
+    gpib_write(TEST_DM5120, "FILTER OFF");
+    transactions = gpib_batch_commit();
+    check(transactions == 1, "three settings go out as one transaction");
+}
+
+static void test_timeout(void) {
+    gpib_device *dev = gpib_get_device(TEST_DM5010);
+    gpib_completion *c = gpib_get_completion(TEST_DM5010);
+    unsigned int failures = gpib_failures(TEST_DM5010);
+    unsigned int timeouts = c->timeouts;
+    int transactions;
+
+    dev->timeout_class = GPIB_TIMEOUT_FAST;
+    gpib_batch_begin(TEST_DM5010);
+    gpib_write(TEST_DM5010, "FUNCT DCV");
+    transactions = gpib_batch_commit();
+    check(transactions == -1, "batch commit reports a completion timeout");
+    check(c->timeouts == timeouts + 1, "timeout counted on the address");
+    check(gpib_failures(TEST_DM5010) > failures, "failure counter moved for the shadow");
+
+    /* Let the setting finish so the simulator is idle at exit */
+    dev->timeout_class = GPIB_TIMEOUT_SLOW;
+    gpib_wait_ready(TEST_DM5010);
+}
+
+static void test_service_request(void) {
+    unsigned long start;
+    float value;
+
+    gpib_service_arm(TEST_DM5120, test_service);
+    gpib_write(TEST_DM5120, "RQS ON");
+    gpib_write(TEST_DM5120, "RDY ON");
+    gpib_write_nowait(TEST_DM5120, "READ ADC");
+
+    start = tb_now_ms();
+    while (g_service_calls == 0 && tb_elapsed_ms(start) < 1000) {
+        gpib_service_scan();
+        delay(10);
+    }
+    check(g_service_calls == 1, "RDY request dispatched to the armed handler");
+    check((g_service_status & GPIB_STB_RQS) && (g_service_status & 0x04),
+          "handler given the RQS status byte with the RDY event");
+
+    gpib_service_disarm(TEST_DM5120);
+    gpib_write(TEST_DM5120, "RQS OFF");
+    gpib_read_float(TEST_DM5120, &value);   /* Collect the reading */
+}
+
+int main(int argc, char *argv[]) {
+    static measurement_system sys;
+    char dir[] = "/tmp/tm5000XXXXXX";
+    char cfg[64], out[64], in[64];
+    const char *sim = argc > 1 ? argv[1] : "./sim5000";
+    FILE *fp;
+    pid_t pid;
+    int status;
+
+    tb_init();
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    sprintf(cfg, "%s/rack.cfg", dir);
+    sprintf(out, "%s/ieeeout", dir);
+    sprintf(in, "%s/ieeein", dir);
+
+    fp = fopen(cfg, "w");
+    if (!fp) {
+        perror(cfg);
+        return 1;
+    }
+    fputs(g_rack, fp);
+    fclose(fp);
+    if (mkfifo(out, 0600) < 0 || mkfifo(in, 0600) < 0) {
+        perror("mkfifo");
+        return 1;
+    }
+
+    pid = start_sim(sim, cfg, out, in);
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    g_system = &sys;
+    add_module(0, MOD_DM5120, TEST_DM5120);
+    add_module(1, MOD_DM5010, TEST_DM5010);
+    setenv("TM5000_IEEEOUT", out, 1);
+    setenv("TM5000_IEEEIN", in, 1);
+
+    if (init_gpib_system() != 0) {
+        check(0, "init_gpib_system opens the simulator");
+        kill(pid, SIGTERM);
+    } else {
+        test_completion();
+        test_batch();
+        test_timeout();
+        test_service_request();
+        close(ieee_out);
+        close(ieee_in);
+    }
+    waitpid(pid, &status, 0);
+
+    unlink(out);
+    unlink(in);
+    unlink(cfg);
+    rmdir(dir);
+
+    printf("%d check(s) failed\n", g_failed);
+    return g_failed;
+}
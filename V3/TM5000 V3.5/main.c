@@ -55,6 +55,7 @@
 #include "graphics.h"
 #include "ui.h"
 #include "data.h"
+#include "timebase.h"
 
 /* Global variable definitions */
 int ieee_out = -1;  /* Handle for writing to GPIB */
@@ -76,6 +77,7 @@ graph_scale g_graph_scale = {-1000.0, 1000.0, 1.0, 0.0, 1.0, 10, 0, 0, 1, 0}; /*
 trace_info __far g_traces[10];
 control_panel_state g_control_panel = {"500", 500, 2, 0xFF, 0, 0, 1, 0}; /* Reordered: string, ints, bit fields */
 fft_config g_fft_config = {0.0, 256, 128, 1, 0, 1, 1, 1, 0};  /* Reordered: float, ints, bit fields */
+float g_fft_sample_rate = 0.0;  /* Rate used by the last FFT, 0 = none yet */
 int g_has_287 = 0;  /* Math coprocessor flag */
 
 /* Sample rate presets - moved to far memory */
@@ -118,14 +120,9 @@ measurement_system* init_measurement_system(unsigned int points) {
     return sys;
 }
 
-/* Delay function */
+/* Delay function - millisecond resolution from the PIT timebase */
 void delay(unsigned int milliseconds) {
-    clock_t start_time = clock();
-    clock_t delay_ticks = (clock_t)milliseconds * CLOCKS_PER_SEC / 1000;
-    
-    while ((clock() - start_time) < delay_ticks) {
-        /* Busy wait */
-    }
+    tb_delay_ms(milliseconds);
 }
 
 /* Cleanup function */
@@ -159,6 +156,9 @@ void cleanup(void) {
             _ffree(g_system->data_buffer);
         free(g_system);
     }
+    
+    /* Give channel 0 back to the BIOS in its original mode */
+    tb_shutdown();
 }
 
 /* Main program entry point */
@@ -168,6 +168,7 @@ int main(void) {
     unsigned int status_word;
     
     srand((unsigned)time(NULL));
+    tb_init();
     
     clrscr();
     printf("TM5000 GPIB Control System v" TM5000_VERSION "\n");
@@ -69,6 +69,9 @@ int perform_dual_trace_operation(int trace1, int trace2, int operation, int resu
         return MATH_ERROR_NO_DATA;
     }
     
+    module_data_linearize(trace1);
+    module_data_linearize(trace2);
+    
     /* Determine operation count (minimum of both traces) */
     count = (g_system->modules[trace1].module_data_count < g_system->modules[trace2].module_data_count) ?
             g_system->modules[trace1].module_data_count : g_system->modules[trace2].module_data_count;
@@ -125,6 +128,7 @@ int perform_dual_trace_operation(int trace1, int trace2, int operation, int resu
     
     /* Update result slot metadata */
     g_system->modules[result_slot].module_data_count = count;
+    copy_module_times(result_slot, trace1);
     g_system->modules[result_slot].enabled = 1;
     g_system->modules[result_slot].module_type = MOD_NONE;
     
@@ -169,6 +173,7 @@ int calculate_realtime_statistics(int trace_slot, statistics_config *config, sta
         return MATH_ERROR_INVALID_PARAMS;
     }
     
+    module_data_linearize(trace_slot);  /* Ring slots back in time order */
     data = g_system->modules[trace_slot].module_data;
     count = g_system->modules[trace_slot].module_data_count;
     
@@ -256,6 +261,7 @@ int apply_digital_filter(int trace_slot, filter_config *config) {
         return MATH_ERROR_INVALID_CONFIG;
     }
     
+    module_data_linearize(trace_slot);  /* Ring slots back in time order */
     data = g_system->modules[trace_slot].module_data;
     count = g_system->modules[trace_slot].module_data_count;
     
@@ -807,6 +813,8 @@ int calculate_correlation(int trace1, int trace2, correlation_result *result) {
     /* Initialize result */
     memset(result, 0, sizeof(correlation_result));
     
+    module_data_linearize(trace1);
+    module_data_linearize(trace2);
     data1 = g_system->modules[trace1].module_data;
     data2 = g_system->modules[trace2].module_data;
     count1 = g_system->modules[trace1].module_data_count;
@@ -970,6 +978,7 @@ int calculate_rolling_statistics(int trace_slot, int window_size) {
     }
     
     /* Get trace data */
+    module_data_linearize(trace_slot);  /* Ring slots back in time order */
     data = g_system->modules[trace_slot].module_data;
     count = g_system->modules[trace_slot].module_data_count;
     
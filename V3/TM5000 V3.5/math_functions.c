@@ -10,6 +10,7 @@
  * 3.3 - Version update  
  * 3.4 - Removed FFT buffer size constraints for 1024-sample optimization
  * 3.5 - Added 286/287 assembly optimizations for performance
+ * 3.5 - Differentiation, integration and FFT use per-sample timestamps
  */
 
 #include "tm5000.h"
@@ -344,6 +345,7 @@ void execute_fft_with_config(void) {
     }
     
     /* Use configured input size, limited by available data */
+    module_data_linearize(slot);  /* Ring slots back in time order */
     actual_input_size = g_system->modules[slot].module_data_count;
     if (actual_input_size > g_fft_config.input_points) {
         actual_input_size = g_fft_config.input_points;
@@ -379,11 +381,13 @@ void execute_fft_with_config(void) {
         sample_rate = g_fft_config.custom_sample_rate;
         printf("Sample rate: %.2f Hz (custom)\n", sample_rate);
     } else {
-        sample_rate = 1000.0 / g_control_panel.sample_rate_ms;
-        printf("Sample rate: %.2f Hz (auto-detect)\n", sample_rate);
+        sample_rate = module_sample_rate_hz(slot);
+        printf("Sample rate: %.2f Hz (auto-detect%s)\n", sample_rate,
+               module_has_times(slot) ? ", timestamps" : "");
     }
     
     freq_resolution = sample_rate / N;
+    g_fft_sample_rate = sample_rate;
     printf("Frequency resolution: %.3f Hz\n", freq_resolution);
     
     /* Allocate memory for FFT */
@@ -647,6 +651,8 @@ void execute_fft_with_config(void) {
         }
     }
     g_system->modules[target_slot].module_data_count = g_fft_config.output_points;
+    g_system->modules[target_slot].module_data_head = 0;
+    g_system->modules[target_slot].module_time_count = 0;  /* Frequency axis */
     
     /* Set up trace for display */
     if (target_slot >= 0 && target_slot < 10) {
@@ -706,6 +712,18 @@ void execute_fft_with_config(void) {
     getch();
 }
 
+/* Seconds between samples a < b of slot - from the timestamps when the
+ * slot has them, otherwise the nominal step */
+static float sample_span_s(int slot, int a, int b, float dt) {
+    unsigned long ta, tb;
+    
+    if (!module_has_times(slot)) return (b - a) * dt;
+    ta = module_time_ms(slot, a);
+    tb = module_time_ms(slot, b);
+    if (tb <= ta) return (b - a) * dt;
+    return (float)(tb - ta) / 1000.0;
+}
+
 /* Differentiation - Calculate dV/dt */
 void perform_differentiation(void) {
     int slot, i;
@@ -732,13 +750,15 @@ void perform_differentiation(void) {
         return;
     }
     
+    module_data_linearize(slot);  /* Ring slots back in time order */
     source_data = g_system->modules[slot].module_data;
     count = g_system->modules[slot].module_data_count;
     
-    dt = g_control_panel.sample_rate_ms / 1000.0;  /* Convert to seconds */
+    dt = 1.0 / module_sample_rate_hz(slot);  /* Mean step in seconds */
     
     printf("\nDifferentiating %d samples...\n", count);
-    printf("Time step: %.3f seconds\n", dt);
+    printf("Time step: %.3f seconds%s\n", dt,
+           module_has_times(slot) ? " (mean, per-sample timestamps)" : "");
     
     /* Find available slot for results */
     for (i = 0; i < 10; i++) {
@@ -766,27 +786,32 @@ void perform_differentiation(void) {
     
     if (g_has_287) {
         /* Use central difference method for better accuracy */
-        scale_factor = 1.0 / dt;
+        scale_factor = 1.0 / sample_span_s(slot, 0, 1, dt);
         
         /* Forward difference for first point */
         result_data[0] = (source_data[1] - source_data[0]) * scale_factor;
         
         /* Central difference for interior points */
         for (i = 1; i < count - 1; i++) {
-            result_data[i] = (source_data[i+1] - source_data[i-1]) * 0.5 * scale_factor;
+            result_data[i] = (source_data[i+1] - source_data[i-1]) /
+                             sample_span_s(slot, i - 1, i + 1, dt);
         }
         
         /* Backward difference for last point */
+        scale_factor = 1.0 / sample_span_s(slot, count - 2, count - 1, dt);
         result_data[count-1] = (source_data[count-1] - source_data[count-2]) * scale_factor;
     } else {
         /* Simple forward difference for software mode */
         for (i = 0; i < count - 1; i++) {
-            result_data[i] = (source_data[i+1] - source_data[i]) / dt;
+            result_data[i] = (source_data[i+1] - source_data[i]) /
+                             sample_span_s(slot, i, i + 1, dt);
         }
         result_data[count-1] = result_data[count-2];  /* Duplicate last */
     }
     
     g_system->modules[target_slot].module_data_count = count;
+    g_system->modules[target_slot].module_data_head = 0;
+    copy_module_times(target_slot, slot);
     
     /* Set up trace for display with proper derivative units */
     if (target_slot >= 0 && target_slot < 10) {
@@ -837,13 +862,15 @@ void perform_integration(void) {
         return;
     }
     
+    module_data_linearize(slot);  /* Ring slots back in time order */
     source_data = g_system->modules[slot].module_data;
     count = g_system->modules[slot].module_data_count;
     
-    dt = g_control_panel.sample_rate_ms / 1000.0;  /* Convert to seconds */
+    dt = 1.0 / module_sample_rate_hz(slot);  /* Mean step in seconds */
     
     printf("\nIntegrating %d samples...\n", count);
-    printf("Time step: %.3f seconds\n", dt);
+    printf("Time step: %.3f seconds%s\n", dt,
+           module_has_times(slot) ? " (mean, per-sample timestamps)" : "");
     
     /* Find available slot for results */
     for (i = 0; i < 10; i++) {
@@ -879,20 +906,23 @@ void perform_integration(void) {
     if (g_has_287) {
         /* High-precision trapezoidal rule with compensated summation */
         for (i = 1; i < count; i++) {
-            double trapezoid_area = (double)(source_data[i] + source_data[i-1]) * 0.5 * dt;
+            double trapezoid_area = (double)(source_data[i] + source_data[i-1]) * 0.5 *
+                                    sample_span_s(slot, i - 1, i, dt);
             kahan_add(&acc, trapezoid_area);
             result_data[i] = (float)acc.sum;
         }
     } else {
         /* Software mode with Kahan summation */
         for (i = 1; i < count; i++) {
-            double rectangle_area = (double)source_data[i] * dt;
+            double rectangle_area = (double)source_data[i] * sample_span_s(slot, i - 1, i, dt);
             kahan_add(&acc, rectangle_area);
             result_data[i] = (float)acc.sum;
         }
     }
     
     g_system->modules[target_slot].module_data_count = count;
+    g_system->modules[target_slot].module_data_head = 0;
+    copy_module_times(target_slot, slot);
     
     printf("\nIntegration complete!\n");
     printf("Units changed from V to V*s\n");
@@ -940,6 +970,7 @@ void perform_smoothing(void) {
         return;
     }
     
+    module_data_linearize(slot);  /* Ring slots back in time order */
     source_data = g_system->modules[slot].module_data;
     count = g_system->modules[slot].module_data_count;
     half_window = window_size / 2;
@@ -992,6 +1023,8 @@ void perform_smoothing(void) {
     }
     
     g_system->modules[target_slot].module_data_count = count;
+    g_system->modules[target_slot].module_data_head = 0;
+    copy_module_times(target_slot, slot);
     
     printf("\nSmoothing complete!\n");
     printf("Noise reduction applied with %d-point moving average\n", window_size);
@@ -7,6 +7,7 @@
 #include "modules.h"
 #include "module_funcs.h"
 #include "gpib.h"
+#include "shadow.h"
 
 /* Send custom GPIB command to selected module */
 void send_custom_command(void) {
@@ -98,6 +99,11 @@ void send_custom_command(void) {
         
         gpib_write(g_system->modules[slot].gpib_address, command);
         
+        /* Anything but a query may have changed a setting */
+        if (strchr(command, '?') == NULL) {
+            shadow_invalidate(slot);
+        }
+        
         if (strchr(command, '?') != NULL || 
             strcasecmp(command, "X") == 0 ||
             strcasecmp(command, "SEND") == 0 ||
@@ -177,7 +183,8 @@ void configure_dm5120_advanced(int slot) {
                cfg->lf_termination ? "ON (LF only)" : "OFF (CRLF)");
         
         printf("\nC. Query Current Status\n");
-        printf("D. Apply Settings to DM5120\n");
+        printf("D. Apply Settings to DM5120 (%d changed)\n",
+               shadow_count_fields(shadow_stale_fields(slot)));
         printf("E. Test Measurement\n");
         printf("F. Run Communication Test\n");
         printf("G. Clear Min/Max Statistics\n");
@@ -186,6 +193,12 @@ void configure_dm5120_advanced(int slot) {
         printf("J. SRQ Event Configuration\n");
         printf("K. Timing Diagnostics\n");
         printf("L. Configuration Validation\n");
+        printf("M. Monitor Streaming: %s", cfg->stream_mode ? "ON" : "OFF");
+        if (cfg->stream_mode) {
+            printf(" (circular buffer, STOINT %d ms)", dm5120_stream_interval_ms(slot));
+        }
+        printf("\n");
+        printf("N. Verify Settings on Instrument\n");
         printf("0. Return to Module Config\n");
         
         printf("\nSelect option: ");
@@ -313,6 +326,7 @@ void configure_dm5120_advanced(int slot) {
                 
             case 'B':  /* LF termination */
                 cfg->lf_termination = !cfg->lf_termination;
+                gpib_build_device_table();
                 printf("\n\nLF termination %s.\n", 
                        cfg->lf_termination ? "enabled (LF only)" : "disabled (CRLF)");
                 printf("Press any key to continue...");
@@ -358,23 +372,7 @@ void configure_dm5120_advanced(int slot) {
                 
             case 'D':  /* Apply settings */
                 printf("\n\nApplying settings to DM5120...\n");
-                
-                gpib_remote(address);
-                delay(200);
-                
-                dm5120_set_function(address, cfg->function);
-                dm5120_set_range(address, cfg->range_mode);
-                dm5120_set_filter(address, cfg->filter_enabled, cfg->filter_value);
-                dm5120_set_trigger(address, cfg->trigger_source ? "EXT" : "TALK", cfg->trigger_mode ? "ONE" : "CONT");
-                dm5120_set_digits(address, cfg->digits);
-                dm5120_set_null(address, cfg->null_enabled, cfg->nullval);
-                dm5120_set_data_format(address, cfg->data_format);
-                
-                if (cfg->buffer_enabled) {
-                    dm5120_enable_buffering(address, slot, cfg->buffer_size);
-                }
-                
-                printf("Settings applied!\n");
+                printf("Settings applied - %d changed fields sent.\n", dm5120_apply_config(slot));
                 printf("Press any key to continue...");
                 getch();
                 break;
@@ -439,6 +437,23 @@ void configure_dm5120_advanced(int slot) {
                 getch();
                 break;
                 
+            case 'M':  /* Monitor streaming */
+                cfg->stream_mode = !cfg->stream_mode;
+                if (cfg->stream_mode) {
+                    printf("\n\nStreaming enabled. The monitor runs the buffer circularly at\n");
+                    printf("STOINT %d ms and stores every reading, drained on each HALF event.\n",
+                           dm5120_stream_interval_ms(slot));
+                } else {
+                    printf("\n\nStreaming disabled.\n");
+                }
+                printf("Press any key to continue...");
+                getch();
+                break;
+                
+            case 'N':  /* Verify against the instrument */
+                shadow_verify_dialog(slot);
+                break;
+                
             case '0':
                 done = 1;
                 break;
@@ -489,6 +504,9 @@ void configure_ps5004_advanced(int slot) {
         printf("E. Test Measurement\n");
         printf("F. Run Communication Test\n");
         printf("G. Initialize PS5004 (INIT command)\n");
+        printf("H. Verify Settings on Instrument\n");
+        printf("I. Monitor Logs: %s\n",
+               cfg->log_both ? "VOLTAGE + CURRENT" : "Display quantity only");
         printf("0. Return to Module Config\n");
         
         printf("\nSelect option: ");
@@ -553,6 +571,7 @@ void configure_ps5004_advanced(int slot) {
                 
             case 'B':  /* LF termination */
                 cfg->lf_termination = !cfg->lf_termination;
+                gpib_build_device_table();
                 printf("\n\nLF termination %s.\n", 
                        cfg->lf_termination ? "enabled (LF only)" : "disabled (CRLF)");
                 printf("Press any key to continue...");
@@ -592,36 +611,7 @@ void configure_ps5004_advanced(int slot) {
                 
             case 'D':  /* Apply settings */
                 printf("\n\nApplying settings to PS5004...\n");
-                
-                gpib_remote(address);
-                delay(200);
-                
-                ps5004_set_voltage(address, cfg->voltage);
-                ps5004_set_current(address, cfg->current_limit);
-                
-                switch(cfg->display_mode) {
-                    case 0: ps5004_set_display(address, "VOLTAGE"); break;
-                    case 1: ps5004_set_display(address, "CURRENT"); break;
-                    case 2: ps5004_set_display(address, "CLIMIT"); break;
-                }
-                
-                gpib_write(address, cfg->vri_enabled ? "VRI ON" : "VRI OFF");
-                delay(50);
-                gpib_write(address, cfg->cri_enabled ? "CRI ON" : "CRI OFF");
-                delay(50);
-                gpib_write(address, cfg->uri_enabled ? "URI ON" : "URI OFF");
-                delay(50);
-                
-                gpib_write(address, cfg->dt_enabled ? "DT ON" : "DT OFF");
-                delay(50);
-                gpib_write(address, cfg->user_enabled ? "USER ON" : "USER OFF");
-                delay(50);
-                gpib_write(address, cfg->rqs_enabled ? "RQS ON" : "RQS OFF");
-                delay(50);
-                
-                ps5004_set_output(address, cfg->output_enabled);
-                
-                printf("Settings applied!\n");
+                printf("Settings applied - %d changed fields sent.\n", ps5004_apply_config(slot));
                 printf("Press any key to continue...");
                 getch();
                 break;
@@ -660,6 +650,14 @@ void configure_ps5004_advanced(int slot) {
                 getch();
                 break;
                 
+            case 'H':  /* Verify against the instrument */
+                shadow_verify_dialog(slot);
+                break;
+                
+            case 'I':  /* Voltage and current every monitor sample */
+                cfg->log_both = !cfg->log_both;
+                break;
+                
             case '0':
                 done = 1;
                 break;
@@ -717,6 +715,7 @@ void configure_ps5010_advanced(int slot) {
         printf("8. Read Regulation Status\n");
         printf("9. Test VTRA Command\n");
         printf("A. Run Communication Test\n");
+        printf("B. Verify Settings on Instrument\n");
         printf("0. Return to Module Config\n");
         
         printf("\nSelect option: ");
@@ -829,6 +828,7 @@ void configure_ps5010_advanced(int slot) {
                 
             case '6':  /* LF termination */
                 cfg->lf_termination = !cfg->lf_termination;
+                gpib_build_device_table();
                 printf("\n\nLF termination %s.\n", 
                        cfg->lf_termination ? "enabled (LF only)" : "disabled (CRLF)");
                 printf("Press any key to continue...");
@@ -837,23 +837,7 @@ void configure_ps5010_advanced(int slot) {
                 
             case '7':  /* Apply all settings */
                 printf("\n\nApplying settings to PS5010...\n");
-                
-                gpib_remote(address);
-                delay(200);
-                
-                ps5010_set_voltage(address, 1, cfg->voltage1);
-                ps5010_set_voltage(address, 2, cfg->voltage2);
-                ps5010_set_voltage(address, 3, cfg->logic_voltage);
-                
-                ps5010_set_current(address, 1, cfg->current_limit1);
-                ps5010_set_current(address, 2, cfg->current_limit2);
-                ps5010_set_current(address, 3, cfg->logic_current_limit);
-                
-                ps5010_set_output(address, 1, cfg->output1_enabled);
-                ps5010_set_output(address, 2, cfg->output2_enabled);
-                ps5010_set_output(address, 3, cfg->logic_enabled);
-                
-                printf("Settings applied!\n");
+                printf("Settings applied - %d changed fields sent.\n", ps5010_apply_config(slot));
                 printf("Press any key to continue...");
                 getch();
                 break;
@@ -917,6 +901,10 @@ void configure_ps5010_advanced(int slot) {
                 test_ps5010_comm(address);
                 break;
                 
+            case 'B':  /* Verify against the instrument */
+                shadow_verify_dialog(slot);
+                break;
+                
             case '0':
                 done = 1;
                 break;
@@ -941,7 +929,11 @@ void gpib_terminal_mode(void) {
     printf("  OUTPUT 16; voltage?\n");
     printf("  ENTER 16\n");
     printf("  STATUS\n");
-    printf("Type 'EXIT' to return\n\n");
+    printf("Type 'EXIT' to return, 'LATENCY' for completion times,\n");
+    printf("'HEALTH' for quarantined/failing addresses,\n");
+    printf("'PARSEBENCH' to time the response parser\n");
+    printf("'TRACE ON|OFF|CLEAR', 'TRACE' to show, 'HIST' for latency\n");
+    printf("histograms, 'TRACE DUMP file' to save as CSV\n\n");
     printf("Note: BREAK is sent via IOCTL, not as a command\n\n");
     
     ieee_write("status\r\n");
@@ -972,6 +964,55 @@ void gpib_terminal_mode(void) {
             continue;
         }
         
+        if (strcasecmp(command, "LATENCY") == 0) {
+            gpib_print_latency();
+            continue;
+        }
+        
+        if (strcasecmp(command, "HEALTH") == 0) {
+            gpib_print_health();
+            continue;
+        }
+        
+        if (strcasecmp(command, "PARSEBENCH") == 0) {
+            parse_benchmark();
+            continue;
+        }
+        
+        if (strncasecmp(command, "TRACE", 5) == 0 &&
+            (command[5] == '\0' || command[5] == ' ')) {
+            char *arg = command + 5;
+            while (*arg == ' ') arg++;
+            
+            if (strcasecmp(arg, "ON") == 0) {
+                gpib_trace_enable(1);
+                printf("Trace ON\n");
+            } else if (strcasecmp(arg, "OFF") == 0) {
+                gpib_trace_enable(0);
+                printf("Trace OFF\n");
+            } else if (strcasecmp(arg, "CLEAR") == 0) {
+                gpib_trace_clear();
+                printf("Trace cleared\n");
+            } else if (strncasecmp(arg, "DUMP", 4) == 0) {
+                arg += 4;
+                while (*arg == ' ') arg++;
+                if (*arg == '\0') arg = "GPIBTRC.CSV";
+                if (gpib_trace_dump(arg) == 0) {
+                    printf("Trace written to %s\n", arg);
+                } else {
+                    printf("Cannot write %s\n", arg);
+                }
+            } else {
+                gpib_trace_print(20);
+            }
+            continue;
+        }
+        
+        if (strcasecmp(command, "HIST") == 0) {
+            gpib_trace_print_histograms();
+            continue;
+        }
+        
         printf("Sending: '%s'\n", command);
         strcat(command, "\r\n");
         ieee_write(command);
@@ -1008,6 +1049,7 @@ static const char* __far buffer_opts[] = {
 void dm5120_buffer_query_menu(int address) {
     char choice;
     static char __far response[128];  /* Shared buffer */
+    static float __far all_values[DM5120_MAX_BUFFER_SIZE];
     float value;
     int count, i, buffer_size;
     int done = 0;
@@ -1052,20 +1094,21 @@ void dm5120_buffer_query_menu(int address) {
                 printf("\nSize: %s\n", buffer_size == 0 ? "CIRCULAR" : "LINEAR");
                 break;
             case '6':
-                gpib_write_dm5120(address, "READ ONESTORE");
+                gpib_write(address, "READ ONESTORE");
                 delay(100);
-                if (gpib_read_dm5120(address, response, 128) > 0) {
+                if (gpib_read(address, response, 128) > 0) {
                     printf("\nValue: %s\n", response);
                 }
                 break;
             case '7':
                 count = dm5120_get_buffer_count(address);
                 printf("\nReading %d values...\n", count);
-                gpib_write_dm5120(address, "READ ALLSTORE");
-                delay(200);
-                if (gpib_read_dm5120(address, response, 128) > 0) {
-                    printf("Data: %s\n", response);
+                count = dm5120_read_all_stored(address, all_values, DM5120_MAX_BUFFER_SIZE);
+                printf("Received %d values:\n", count);
+                for (i = 0; i < count; i++) {
+                    printf("%12.6e%s", all_values[i], (i % 5 == 4) ? "\n" : " ");
                 }
+                printf("\n");
                 break;
             case '8':
                 printf("\nEnter size (0=CIRCULAR, 10-500): ");
@@ -1128,7 +1171,7 @@ void dm5120_stoint_menu(int address, int slot) {
         
         switch(choice) {
             case '1':
-                gpib_write_dm5120(address, "STOINT ONE");
+                gpib_write(address, "STOINT ONE");
                 delay(100);
                 printf("\nSTOINT set to ONE\n");
                 break;
@@ -1228,15 +1271,15 @@ void dm5120_srq_menu(int address, int slot) {
                 {
                     int rqs;
                     scanf("%d", &rqs);
-                    gpib_write_dm5120(address, rqs ? "RQS ON" : "RQS OFF");
+                    gpib_write(address, rqs ? "RQS ON" : "RQS OFF");
                     delay(100);
                     printf("RQS: %s\n", rqs ? "ON" : "OFF");
                 }
                 break;
             case '6':
-                gpib_write_dm5120(address, "EVENT?");
+                gpib_write(address, "EVENT?");
                 delay(100);
-                if (gpib_read_dm5120(address, response, 64) > 0) {
+                if (gpib_read(address, response, 64) > 0) {
                     printf("\nEVENT: %s\n", response);
                 }
                 break;
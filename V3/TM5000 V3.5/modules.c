@@ -11,6 +11,12 @@
 #include "modules.h"
 #include "gpib.h"
 #include "graphics.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "spill.h"
+#include "acquire.h"
+#include "shadow.h"
+#include "reduce.h"
 
 /* Shared GPIB buffer pool to reduce memory usage */
 static char __far gpib_cmd_buffer[80];
@@ -78,6 +84,7 @@ void init_dc5010_config(int slot) {
 
 /* DC5009 GPIB Functions */
 void dc5009_set_function(int address, char *function, char *channel) {
+    shadow_forget(address, SH_DC_FUNCTION);
     
     /* Handle special command formats */
     if (strcmp(function, "TIME") == 0 && channel && strlen(channel) == 2) {
@@ -102,66 +109,65 @@ void dc5009_set_function(int address, char *function, char *channel) {
     }
     
     gpib_write(address, gpib_cmd_buffer);
-    delay(100);
 }
 
 void dc5009_set_coupling(int address, char channel, char *coupling) {
+    shadow_forget(address, channel == 'B' ? SH_DC_COUPLING_A << 1 : SH_DC_COUPLING_A);
     
     sprintf(gpib_cmd_buffer, "COU CHA %c %s", channel, coupling);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_set_impedance(int address, char channel, char *impedance) {
+    shadow_forget(address, channel == 'B' ? SH_DC_IMPEDANCE_A << 1 : SH_DC_IMPEDANCE_A);
     
     sprintf(gpib_cmd_buffer, "TER CHA %c %s", channel, impedance);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_set_attenuation(int address, char channel, char *attenuation) {
+    shadow_forget(address, channel == 'B' ? SH_DC_ATTENUATION_A << 1 : SH_DC_ATTENUATION_A);
     
     sprintf(gpib_cmd_buffer, "ATT CHA %c %s", channel, attenuation);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_set_slope(int address, char channel, char *slope) {
+    shadow_forget(address, channel == 'B' ? SH_DC_SLOPE_A << 1 : SH_DC_SLOPE_A);
     
     sprintf(gpib_cmd_buffer, "SLO CHA %c %s", channel, slope);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_set_level(int address, char channel, float level) {
+    shadow_forget(address, channel == 'B' ? SH_DC_LEVEL_A << 1 : SH_DC_LEVEL_A);
     
     sprintf(gpib_cmd_buffer, "LEV CHA %c %.3f", channel, level);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_set_filter(int address, int enabled) {
+    shadow_forget(address, SH_DC_FILTER);
     gpib_write(address, enabled ? "FIL ON" : "FIL OFF");
-    delay(50);
 }
 
 void dc5009_set_gate_time(int address, float gate_time) {
+    shadow_forget(address, SH_DC_GATE);
     
     sprintf(gpib_cmd_buffer, "GATE %.3f", gate_time);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_set_averaging(int address, int count) {
+    shadow_forget(address, SH_DC_AVERAGING);
     
     sprintf(gpib_cmd_buffer, "AVG %d", count);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5009_auto_trigger(int address) {
+    shadow_forget(address, SH_DC_LEVEL_A | SH_DC_LEVEL_A << 1);
     gpib_write(address, "AUTO");
-    delay(100);
 }
 
 void dc5009_start_measurement(int address) {
@@ -230,7 +236,6 @@ int dc5009_query_error(int address) {
 /* DC5009 Advanced Functions */
 void dc5009_set_preset(int address, int enabled) {
     gpib_write(address, enabled ? "PRE ON" : "PRE OFF");
-    delay(50);
 }
 
 void dc5009_manual_timing(int address) {
@@ -240,7 +245,6 @@ void dc5009_manual_timing(int address) {
 
 void dc5009_set_srq(int address, int enabled) {
     gpib_write(address, enabled ? "RQS ON" : "RQS OFF");
-    delay(50);
 }
 
 unsigned char dc5009_get_status_byte(int address) {
@@ -281,6 +285,7 @@ double dc5009_read_extended_range(int address) {
 
 /* DC5010 GPIB Functions (similar to DC5009 but with additional capabilities) */
 void dc5010_set_function(int address, char *function, char *channel) {
+    shadow_forget(address, SH_DC_FUNCTION);
     
     
     /* Handle special command formats including DC5010-specific modes */
@@ -318,66 +323,113 @@ void dc5010_set_function(int address, char *function, char *channel) {
     }
     
     gpib_write(address, gpib_cmd_buffer);
-    delay(100);
+}
+
+/* Slot's function measured on one input and logged from both - only
+ * for a function set to channel A or B */
+int dc5010_logs_both(int slot) {
+    dc5010_config *cfg;
+    
+    if (slot < 0 || slot >= 10 || g_system->modules[slot].module_type != MOD_DC5010) return 0;
+    cfg = &g_dc5010_config[slot];
+    return cfg->log_both && (strcmp(cfg->channel, "A") == 0 || strcmp(cfg->channel, "B") == 0);
+}
+
+/* Input the counter is known to measure the slot's function on, NULL if
+ * unknown */
+char *dc5010_selected(int slot) {
+    module_shadow *sh = shadow_for(slot);
+    
+    if (!(sh->known & SH_DC_FUNCTION) ||
+        strcmp(sh->cfg.dc5010.function, g_dc5010_config[slot].function) != 0) {
+        return NULL;
+    }
+    return sh->cfg.dc5010.channel;
+}
+
+/* Measure the slot's function on channel ("A" or "B").  Nothing is sent
+ * when the shadow says the counter is there already.  Returns 1 if the
+ * input changed, -1 if the switch failed and the input is unknown. */
+int dc5010_select(int slot, char *channel) {
+    module_shadow *sh;
+    char *shown = dc5010_selected(slot);
+    int address = g_system->modules[slot].gpib_address;
+    unsigned int failures;
+    
+    if (shown && strcmp(shown, channel) == 0) return 0;
+    
+    failures = gpib_failures(address);
+    dc5010_set_function(address, g_dc5010_config[slot].function, channel);
+    
+    /* Left unknown on failure, so the next select sends it again */
+    if (gpib_failures(address) != failures) return -1;
+    
+    /* As with the PS5004 display, the next apply puts the configured
+     * input back if it differs */
+    sh = shadow_for(slot);
+    strcpy(sh->cfg.dc5010.function, g_dc5010_config[slot].function);
+    strcpy(sh->cfg.dc5010.channel, channel);
+    sh->known |= SH_DC_FUNCTION;
+    return 1;
 }
 
 void dc5010_set_coupling(int address, char channel, char *coupling) {
+    shadow_forget(address, channel == 'B' ? SH_DC_COUPLING_A << 1 : SH_DC_COUPLING_A);
     
     sprintf(gpib_cmd_buffer, "COU CHA %c %s", channel, coupling);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_set_impedance(int address, char channel, char *impedance) {
+    shadow_forget(address, channel == 'B' ? SH_DC_IMPEDANCE_A << 1 : SH_DC_IMPEDANCE_A);
     
     sprintf(gpib_cmd_buffer, "TER CHA %c %s", channel, impedance);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_set_attenuation(int address, char channel, char *attenuation) {
+    shadow_forget(address, channel == 'B' ? SH_DC_ATTENUATION_A << 1 : SH_DC_ATTENUATION_A);
     
     sprintf(gpib_cmd_buffer, "ATT CHA %c %s", channel, attenuation);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_set_slope(int address, char channel, char *slope) {
+    shadow_forget(address, channel == 'B' ? SH_DC_SLOPE_A << 1 : SH_DC_SLOPE_A);
     
     sprintf(gpib_cmd_buffer, "SLO CHA %c %s", channel, slope);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_set_level(int address, char channel, float level) {
+    shadow_forget(address, channel == 'B' ? SH_DC_LEVEL_A << 1 : SH_DC_LEVEL_A);
     
     sprintf(gpib_cmd_buffer, "LEV CHA %c %.3f", channel, level);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_set_filter(int address, int enabled) {
+    shadow_forget(address, SH_DC_FILTER);
     gpib_write(address, enabled ? "FIL ON" : "FIL OFF");
-    delay(50);
 }
 
 void dc5010_set_gate_time(int address, float gate_time) {
+    shadow_forget(address, SH_DC_GATE);
     
     sprintf(gpib_cmd_buffer, "GATE %.3f", gate_time);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_set_averaging(int address, int count) {
+    shadow_forget(address, SH_DC_AVERAGING);
     
     sprintf(gpib_cmd_buffer, "AVG %d", count);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_auto_trigger(int address) {
+    shadow_forget(address, SH_DC_LEVEL_A | SH_DC_LEVEL_A << 1);
     gpib_write(address, "AUTO");
-    delay(100);
 }
 
 void dc5010_start_measurement(int address) {
@@ -424,11 +476,11 @@ void dc5010_clear_overflow(int address) {
 
 /* DC5010 specific functions */
 void dc5010_set_burst_mode(int address, int enabled) {
+    shadow_forget(address, SH_DC_BURST);
     /* DC5010 specific burst mode implementation */
     
     sprintf(gpib_cmd_buffer, "BURST %s", enabled ? "ON" : "OFF");
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void dc5010_measure_rise_time(int address) {
@@ -465,7 +517,6 @@ int dc5010_query_error(int address) {
 /* DC5010 Advanced Functions */
 void dc5010_set_preset(int address, int enabled) {
     gpib_write(address, enabled ? "PRE ON" : "PRE OFF");
-    delay(50);
 }
 
 void dc5010_manual_timing(int address) {
@@ -490,7 +541,6 @@ void dc5010_propagation_delay(int address) {
 
 void dc5010_set_srq(int address, int enabled) {
     gpib_write(address, enabled ? "RQS ON" : "RQS OFF");
-    delay(50);
 }
 
 unsigned char dc5010_get_status_byte(int address) {
@@ -552,6 +602,7 @@ void test_dc5009_comm(int address) {
     
     printf("2. Testing initialization...\n");
     gpib_write(address, "INIT");
+    shadow_forget(address, SH_ALL);
     delay(500);
     printf("   Initialization command sent\n");
     success_count++;
@@ -633,6 +684,7 @@ void test_dc5010_comm(int address) {
     
     printf("2. Testing initialization...\n");
     gpib_write(address, "INIT");
+    shadow_forget(address, SH_ALL);
     delay(500);
     printf("   Initialization command sent\n");
     success_count++;
@@ -828,27 +880,7 @@ void configure_dc5009_advanced(int slot) {
                 
             case 'A':
                 printf("\n\nApplying settings to DC5009...\n");
-                gpib_remote(address);
-                delay(200);
-                
-                dc5009_set_function(address, cfg->function, cfg->channel);
-                dc5009_set_gate_time(address, cfg->gate_time);
-                dc5009_set_averaging(address, cfg->averaging);
-                dc5009_set_coupling(address, 'A', cfg->coupling_a);
-                dc5009_set_coupling(address, 'B', cfg->coupling_b);
-                dc5009_set_impedance(address, 'A', cfg->impedance_a);
-                dc5009_set_impedance(address, 'B', cfg->impedance_b);
-                dc5009_set_attenuation(address, 'A', cfg->attenuation_a);
-                dc5009_set_attenuation(address, 'B', cfg->attenuation_b);
-                dc5009_set_slope(address, 'A', cfg->slope_a);
-                dc5009_set_slope(address, 'B', cfg->slope_b);
-                dc5009_set_level(address, 'A', cfg->level_a);
-                dc5009_set_level(address, 'B', cfg->level_b);
-                dc5009_set_filter(address, cfg->filter_enabled);
-                
-                if (cfg->auto_trigger) {
-                    dc5009_auto_trigger(address);
-                }
+                dc5009_apply_config(slot);
                 
                 printf("Settings applied!\n");
                 printf("Press any key to continue...");
@@ -979,6 +1011,8 @@ void configure_dc5010_advanced(int slot) {
         printf("F. Advanced Features (Query, SRQ, Preset)\n");
         printf("G. DC5010 Specific Functions\n");
         printf("H. Extended Range Test\n");
+        printf("I. Monitor Logs: %s\n",
+               cfg->log_both ? "Channel A + B" : "Configured channel only");
         printf("0. Exit\n\n");
         
         printf("Choice: ");
@@ -1079,28 +1113,7 @@ void configure_dc5010_advanced(int slot) {
                 
             case 'C':
                 printf("\n\nApplying settings to DC5010...\n");
-                gpib_remote(address);
-                delay(200);
-                
-                dc5010_set_function(address, cfg->function, cfg->channel);
-                dc5010_set_gate_time(address, cfg->gate_time);
-                dc5010_set_averaging(address, cfg->averaging);
-                dc5010_set_coupling(address, 'A', cfg->coupling_a);
-                dc5010_set_coupling(address, 'B', cfg->coupling_b);
-                dc5010_set_impedance(address, 'A', cfg->impedance_a);
-                dc5010_set_impedance(address, 'B', cfg->impedance_b);
-                dc5010_set_attenuation(address, 'A', cfg->attenuation_a);
-                dc5010_set_attenuation(address, 'B', cfg->attenuation_b);
-                dc5010_set_slope(address, 'A', cfg->slope_a);
-                dc5010_set_slope(address, 'B', cfg->slope_b);
-                dc5010_set_level(address, 'A', cfg->level_a);
-                dc5010_set_level(address, 'B', cfg->level_b);
-                dc5010_set_filter(address, cfg->filter_enabled);
-                dc5010_set_burst_mode(address, cfg->burst_mode);
-                
-                if (cfg->auto_trigger) {
-                    dc5010_auto_trigger(address);
-                }
+                dc5010_apply_config(slot);
                 
                 printf("Settings applied!\n");
                 printf("Press any key to continue...");
@@ -1204,6 +1217,17 @@ void configure_dc5010_advanced(int slot) {
                 getch();
                 break;
                 
+            case 'I':
+                cfg->log_both = !cfg->log_both;
+                printf("\n\nMonitor logs %s\n", cfg->log_both ?
+                       "the function on channel A and B each sample" : "the configured channel only");
+                if (cfg->log_both && !dc5010_logs_both(slot)) {
+                    printf("Takes effect once the function is set to channel A or B\n");
+                }
+                printf("Press any key to continue...");
+                getch();
+                break;
+                
             case '0':
                 done = 1;
                 break;
@@ -1360,6 +1384,7 @@ void configure_fg5010(int slot) {
                 
             case 7:
                 cfg->lf_termination = !cfg->lf_termination;
+                gpib_build_device_table();
                 printf("Line termination set to %s\n", cfg->lf_termination ? "LF" : "CRLF");
                 delay(1000);
                 break;
@@ -1580,46 +1605,47 @@ void configure_fg5010_advanced(int slot) {
 /* FG5010 GPIB Control Functions */
 void fg5010_set_frequency(int address, float freq) {
     char cmd[50];
+    shadow_forget(address, SH_FG5010_FREQUENCY);
     sprintf(gpib_cmd_buffer, "FREQ %.3f", freq);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_amplitude(int address, float amp) {
     char cmd[50];
+    shadow_forget(address, SH_FG5010_AMPLITUDE);
     sprintf(gpib_cmd_buffer, "AMPL %.3f", amp);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_offset(int address, float offset) {
     char cmd[50];
+    shadow_forget(address, SH_FG5010_OFFSET);
     sprintf(gpib_cmd_buffer, "OFFS %.3f", offset);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_waveform(int address, char *waveform) {
     char cmd[50];
+    shadow_forget(address, SH_FG5010_WAVEFORM);
     sprintf(gpib_cmd_buffer, "FUNC %s", waveform);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_duty_cycle(int address, float duty) {
     char cmd[50];
+    shadow_forget(address, SH_FG5010_DUTY);
     sprintf(gpib_cmd_buffer, "DCYC %.1f", duty);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_enable_output(int address, int enable) {
+    shadow_forget(address, SH_FG5010_OUTPUT);
     gpib_write(address, enable ? "OUTP ON" : "OUTP OFF");
-    delay(50);
 }
 
 void fg5010_set_sweep(int address, int enable, float start_freq, float stop_freq, float time) {
     char cmd[100];
+    shadow_forget(address, SH_FG5010_SWEEP);
     if (enable) {
         sprintf(gpib_cmd_buffer, "SWE:STAT ON;SWE:STAR %.3f;SWE:STOP %.3f;SWE:TIME %.3f", 
                 start_freq, stop_freq, time);
@@ -1627,35 +1653,35 @@ void fg5010_set_sweep(int address, int enable, float start_freq, float stop_freq
         strcpy(gpib_cmd_buffer, "SWE:STAT OFF");
     }
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_trigger(int address, char *source, char *slope, float level) {
     char cmd[100];
+    shadow_forget(address, SH_FG5010_TRIGGER);
     sprintf(gpib_cmd_buffer, "TRIG:SOUR %s;TRIG:SLOP %s;TRIG:LEV %.2f", source, slope, level);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_sync(int address, int enable) {
+    shadow_forget(address, SH_FG5010_SYNC);
     gpib_write(address, enable ? "SYNC ON" : "SYNC OFF");
-    delay(50);
 }
 
 void fg5010_set_invert(int address, int enable) {
+    shadow_forget(address, SH_FG5010_INVERT);
     gpib_write(address, enable ? "INV ON" : "INV OFF");
-    delay(50);
 }
 
 void fg5010_set_phase(int address, float phase) {
     char cmd[50];
+    shadow_forget(address, SH_FG5010_PHASE);
     sprintf(gpib_cmd_buffer, "PHAS %.1f", phase);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_modulation(int address, int enable, char *type, float freq, float depth) {
     char cmd[100];
+    shadow_forget(address, SH_FG5010_MODULATION);
     if (enable) {
         sprintf(gpib_cmd_buffer, "MOD:STAT ON;MOD:TYP %s;MOD:FREQ %.2f;MOD:DEPT %.1f", 
                 type, freq, depth);
@@ -1663,18 +1689,17 @@ void fg5010_set_modulation(int address, int enable, char *type, float freq, floa
         strcpy(gpib_cmd_buffer, "MOD:STAT OFF");
     }
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 void fg5010_set_burst(int address, int enable, int count, float period) {
     char cmd[100];
+    shadow_forget(address, SH_FG5010_BURST);
     if (enable) {
         sprintf(gpib_cmd_buffer, "BURS:STAT ON;BURS:NCYC %d;BURS:INT:PER %.3f", count, period);
     } else {
         strcpy(gpib_cmd_buffer, "BURS:STAT OFF");
     }
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 
 /* Test FG5010 communication */
@@ -1807,6 +1832,259 @@ int fg5010_read_output_status(int address) {
     return 0;
 }
 
+/* Apply stored configuration to instruments - each setter is queued in a
+ * GPIB batch so a module's whole setup goes out in one or two transactions.
+ * Only fields the shadow cannot vouch for are sent; each apply returns the
+ * number of fields it sent. */
+int dm5120_apply_config(int slot) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_DM5120_FUNCTION) dm5120_set_function(address, cfg->function);
+    if (stale & SH_DM5120_RANGE) dm5120_set_range(address, cfg->range_mode);
+    if (stale & SH_DM5120_FILTER) dm5120_set_filter(address, cfg->filter_enabled, cfg->filter_value);
+    if (stale & SH_DM5120_TRIGGER) {
+        dm5120_set_trigger(address, cfg->trigger_source ? "EXT" : "TALK", cfg->trigger_mode ? "ONE" : "CONT");
+    }
+    if (stale & SH_DM5120_DIGITS) dm5120_set_digits(address, cfg->digits);
+    if (stale & SH_DM5120_NULL) dm5120_set_null(address, cfg->null_enabled, cfg->nullval);
+    if (stale & SH_DM5120_DATFOR) dm5120_set_data_format(address, cfg->data_format);
+    gpib_batch_commit();
+    
+    if (stale & SH_DM5120_BUFFER) {
+        dm5120_enable_buffering(address, slot, cfg->buffer_size);
+    }
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+int dm5010_apply_config(int slot) {
+    dm5010_config *cfg = &g_dm5010_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_DM5010_FUNCTION) dm5010_set_function(address, cfg->function);
+    if (stale & SH_DM5010_FILTER) dm5010_set_filter(address, cfg->filter_enabled, cfg->filter_count);
+    if (stale & SH_DM5010_TRIGGER) {
+        dm5010_set_trigger(address, cfg->trigger_mode == 0 ? "IMM" : (cfg->trigger_mode == 1 ? "EXT" : "BUS"));
+    }
+    if (stale & SH_DM5010_AUTOZERO) dm5010_set_autozero(address, cfg->auto_zero);
+    if (stale & SH_DM5010_NULL) dm5010_set_null(address, cfg->null_enabled, cfg->nullval);
+    if (stale & SH_DM5010_CALC) {
+        dm5010_set_calculation(address, cfg->calculation_mode, 
+                             cfg->calculation_mode == 2 ? cfg->scale_factor : 
+                             (cfg->calculation_mode == 3 ? cfg->dbm_reference : cfg->dbr_reference),
+                             cfg->scale_offset);
+    }
+    if (stale & SH_DM5010_BEEPER) dm5010_beeper(address, cfg->beeper_enabled);
+    if (stale & SH_DM5010_LOCK) dm5010_lock_front_panel(address, cfg->front_panel_lock);
+    gpib_batch_commit();
+    
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+int ps5004_apply_config(int slot) {
+    ps5004_config *cfg = &g_ps5004_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_PS5004_VOLTAGE) ps5004_set_voltage(address, cfg->voltage);
+    if (stale & SH_PS5004_CURRENT) ps5004_set_current(address, cfg->current_limit);
+    
+    if (stale & SH_PS5004_DISPLAY) {
+        switch(cfg->display_mode) {
+            case 0: ps5004_set_display(address, "VOLTAGE"); break;
+            case 1: ps5004_set_display(address, "CURRENT"); break;
+            case 2: ps5004_set_display(address, "CLIMIT"); break;
+        }
+    }
+    
+    if (stale & SH_PS5004_VRI) gpib_write(address, cfg->vri_enabled ? "VRI ON" : "VRI OFF");
+    if (stale & SH_PS5004_CRI) gpib_write(address, cfg->cri_enabled ? "CRI ON" : "CRI OFF");
+    if (stale & SH_PS5004_URI) gpib_write(address, cfg->uri_enabled ? "URI ON" : "URI OFF");
+    if (stale & SH_PS5004_DT) gpib_write(address, cfg->dt_enabled ? "DT ON" : "DT OFF");
+    if (stale & SH_PS5004_USER) gpib_write(address, cfg->user_enabled ? "USER ON" : "USER OFF");
+    if (stale & SH_PS5004_RQS) gpib_write(address, cfg->rqs_enabled ? "RQS ON" : "RQS OFF");
+    
+    if (stale & SH_PS5004_OUTPUT) ps5004_set_output(address, cfg->output_enabled);
+    gpib_batch_commit();
+    
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+int ps5010_apply_config(int slot) {
+    ps5010_config *cfg = &g_ps5010_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_PS5010_VOLTAGE1) ps5010_set_voltage(address, 1, cfg->voltage1);
+    if (stale & (SH_PS5010_VOLTAGE1 << 1)) ps5010_set_voltage(address, 2, cfg->voltage2);
+    if (stale & (SH_PS5010_VOLTAGE1 << 2)) ps5010_set_voltage(address, 3, cfg->logic_voltage);
+    
+    if (stale & SH_PS5010_CURRENT1) ps5010_set_current(address, 1, cfg->current_limit1);
+    if (stale & (SH_PS5010_CURRENT1 << 1)) ps5010_set_current(address, 2, cfg->current_limit2);
+    if (stale & (SH_PS5010_CURRENT1 << 2)) ps5010_set_current(address, 3, cfg->logic_current_limit);
+    
+    if (stale & SH_PS5010_OUTPUT1) ps5010_set_output(address, 1, cfg->output1_enabled);
+    if (stale & (SH_PS5010_OUTPUT1 << 1)) ps5010_set_output(address, 2, cfg->output2_enabled);
+    if (stale & (SH_PS5010_OUTPUT1 << 2)) ps5010_set_output(address, 3, cfg->logic_enabled);
+    gpib_batch_commit();
+    
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+/* AUTO picks the trigger levels itself, so with auto trigger on it goes
+ * out after any change and the levels are never taken as known */
+int dc5009_apply_config(int slot) {
+    dc5009_config *cfg = &g_dc5009_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_DC_FUNCTION) dc5009_set_function(address, cfg->function, cfg->channel);
+    if (stale & SH_DC_GATE) dc5009_set_gate_time(address, cfg->gate_time);
+    if (stale & SH_DC_AVERAGING) dc5009_set_averaging(address, cfg->averaging);
+    if (stale & SH_DC_COUPLING_A) dc5009_set_coupling(address, 'A', cfg->coupling_a);
+    if (stale & (SH_DC_COUPLING_A << 1)) dc5009_set_coupling(address, 'B', cfg->coupling_b);
+    if (stale & SH_DC_IMPEDANCE_A) dc5009_set_impedance(address, 'A', cfg->impedance_a);
+    if (stale & (SH_DC_IMPEDANCE_A << 1)) dc5009_set_impedance(address, 'B', cfg->impedance_b);
+    if (stale & SH_DC_ATTENUATION_A) dc5009_set_attenuation(address, 'A', cfg->attenuation_a);
+    if (stale & (SH_DC_ATTENUATION_A << 1)) dc5009_set_attenuation(address, 'B', cfg->attenuation_b);
+    if (stale & SH_DC_SLOPE_A) dc5009_set_slope(address, 'A', cfg->slope_a);
+    if (stale & (SH_DC_SLOPE_A << 1)) dc5009_set_slope(address, 'B', cfg->slope_b);
+    if (stale & SH_DC_LEVEL_A) dc5009_set_level(address, 'A', cfg->level_a);
+    if (stale & (SH_DC_LEVEL_A << 1)) dc5009_set_level(address, 'B', cfg->level_b);
+    if (stale & SH_DC_FILTER) dc5009_set_filter(address, cfg->filter_enabled);
+    
+    if (cfg->auto_trigger) {
+        dc5009_auto_trigger(address);
+        stale &= ~(SH_DC_LEVEL_A | (SH_DC_LEVEL_A << 1));
+    }
+    gpib_batch_commit();
+    
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+int dc5010_apply_config(int slot) {
+    dc5010_config *cfg = &g_dc5010_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_DC_FUNCTION) dc5010_set_function(address, cfg->function, cfg->channel);
+    if (stale & SH_DC_GATE) dc5010_set_gate_time(address, cfg->gate_time);
+    if (stale & SH_DC_AVERAGING) dc5010_set_averaging(address, cfg->averaging);
+    if (stale & SH_DC_COUPLING_A) dc5010_set_coupling(address, 'A', cfg->coupling_a);
+    if (stale & (SH_DC_COUPLING_A << 1)) dc5010_set_coupling(address, 'B', cfg->coupling_b);
+    if (stale & SH_DC_IMPEDANCE_A) dc5010_set_impedance(address, 'A', cfg->impedance_a);
+    if (stale & (SH_DC_IMPEDANCE_A << 1)) dc5010_set_impedance(address, 'B', cfg->impedance_b);
+    if (stale & SH_DC_ATTENUATION_A) dc5010_set_attenuation(address, 'A', cfg->attenuation_a);
+    if (stale & (SH_DC_ATTENUATION_A << 1)) dc5010_set_attenuation(address, 'B', cfg->attenuation_b);
+    if (stale & SH_DC_SLOPE_A) dc5010_set_slope(address, 'A', cfg->slope_a);
+    if (stale & (SH_DC_SLOPE_A << 1)) dc5010_set_slope(address, 'B', cfg->slope_b);
+    if (stale & SH_DC_LEVEL_A) dc5010_set_level(address, 'A', cfg->level_a);
+    if (stale & (SH_DC_LEVEL_A << 1)) dc5010_set_level(address, 'B', cfg->level_b);
+    if (stale & SH_DC_FILTER) dc5010_set_filter(address, cfg->filter_enabled);
+    if (stale & SH_DC_BURST) dc5010_set_burst_mode(address, cfg->burst_mode);
+    
+    if (cfg->auto_trigger) {
+        dc5010_auto_trigger(address);
+        stale &= ~(SH_DC_LEVEL_A | (SH_DC_LEVEL_A << 1));
+    }
+    gpib_batch_commit();
+    
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+/* The output goes on last, once the waveform it puts out is set up */
+int fg5010_apply_config(int slot) {
+    fg5010_config *cfg = &g_fg5010_config[slot];
+    int address = g_system->modules[slot].gpib_address;
+    unsigned long stale = shadow_stale_fields(slot);
+    unsigned int failures = gpib_failures(address);
+    
+    if (!stale) return 0;
+    gpib_remote(address);
+    
+    gpib_batch_begin(address);
+    if (stale & SH_FG5010_WAVEFORM) fg5010_set_waveform(address, cfg->waveform);
+    if (stale & SH_FG5010_FREQUENCY) fg5010_set_frequency(address, cfg->frequency);
+    if (stale & SH_FG5010_AMPLITUDE) fg5010_set_amplitude(address, cfg->amplitude);
+    if (stale & SH_FG5010_OFFSET) fg5010_set_offset(address, cfg->offset);
+    if (stale & SH_FG5010_DUTY) fg5010_set_duty_cycle(address, cfg->duty_cycle);
+    if (stale & SH_FG5010_PHASE) fg5010_set_phase(address, cfg->phase);
+    if (stale & SH_FG5010_SWEEP) {
+        fg5010_set_sweep(address, cfg->sweep_enabled, cfg->start_freq, cfg->stop_freq, cfg->sweep_time);
+    }
+    if (stale & SH_FG5010_TRIGGER) {
+        fg5010_set_trigger(address, cfg->trigger_source, cfg->trigger_slope, cfg->trigger_level);
+    }
+    if (stale & SH_FG5010_MODULATION) {
+        fg5010_set_modulation(address, cfg->modulation_enabled, cfg->mod_type, cfg->mod_freq, cfg->mod_depth);
+    }
+    if (stale & SH_FG5010_BURST) {
+        fg5010_set_burst(address, cfg->burst_enabled, cfg->burst_count, cfg->burst_period);
+    }
+    if (stale & SH_FG5010_SYNC) fg5010_set_sync(address, cfg->sync_enabled);
+    if (stale & SH_FG5010_INVERT) fg5010_set_invert(address, cfg->invert_enabled);
+    if (stale & SH_FG5010_OUTPUT) fg5010_enable_output(address, cfg->output_enabled);
+    gpib_batch_commit();
+    
+    shadow_commit(slot, cfg, sizeof(*cfg), stale, failures);
+    return shadow_count_fields(stale);
+}
+
+/* Apply the stored configuration of one slot to its instrument.  Returns
+ * the number of fields sent. */
+int apply_module_config(int slot) {
+    if (slot < 0 || slot >= 10 || !g_system->modules[slot].enabled) return 0;
+    
+    switch (g_system->modules[slot].module_type) {
+        case MOD_DM5120: return dm5120_apply_config(slot);
+        case MOD_DM5010: return dm5010_apply_config(slot);
+        case MOD_PS5004: return ps5004_apply_config(slot);
+        case MOD_PS5010: return ps5010_apply_config(slot);
+        case MOD_DC5009: return dc5009_apply_config(slot);
+        case MOD_DC5010: return dc5010_apply_config(slot);
+        case MOD_FG5010: return fg5010_apply_config(slot);
+    }
+    return 0;
+}
+
 /* Validate and cleanup phantom enabled modules */
 void validate_enabled_modules(void) {
     int i;
@@ -1827,6 +2105,8 @@ void validate_enabled_modules(void) {
             }
         }
     }
+    
+    gpib_build_device_table();
 }
 
 /* Stub implementations for other module functions - to be filled in from TM5000L.c */
@@ -1887,6 +2167,7 @@ void configure_modules(void) {
                 g_system->modules[slot].gpib_address = 0;
                 strcpy(g_system->modules[slot].description, "");
                 free_module_buffer(slot);
+                gpib_build_device_table();
             } else if (module_type >= 1 && module_type <= 7) {
                 printf("Enter GPIB address (1-30): ");
                 scanf("%d", &address);
@@ -1942,6 +2223,8 @@ void configure_modules(void) {
                                 break;
                         }
                         
+                        gpib_build_device_table();
+                        
                         /* Initialize device and handle LF termination like v2.9 */
                         printf("Initializing device at GPIB address %d...\n", 
                                g_system->modules[slot].gpib_address);
@@ -1966,6 +2249,7 @@ void configure_modules(void) {
                                     printf("Standard CRLF termination enabled.\n");
                                 }
                             }
+                            gpib_build_device_table();
                         }
                         
                         /* Allocate data buffer */
@@ -2079,10 +2363,15 @@ void display_trace_selection_menu(void) {
         active_traces = 0;
         for (i = 0; i < 10; i++) {
             if (g_system->modules[i].enabled && g_traces[i].data_count > 0) {
-                printf("%d: %s (%d points) - %s\n", i, 
+                printf("%d: %s (%d points) - %s", i, 
                        g_traces[i].label,
                        g_traces[i].data_count,
                        g_traces[i].enabled ? "ACTIVE" : "inactive");
+                if (slot_channel_count(i) > 1) {
+                    printf(" - channel %s (%d of %d)", slot_channel_get(i, g_traces[i].channel)->name,
+                           g_traces[i].channel + 1, slot_channel_count(i));
+                }
+                printf("\n");
                 if (g_traces[i].enabled) active_traces++;
             }
         }
@@ -2093,6 +2382,7 @@ void display_trace_selection_menu(void) {
         printf("0-9: Toggle trace display\n");
         printf("A: Show All traces\n");
         printf("N: Show No traces\n");
+        printf("C: Next channel of a slot\n");
         printf("ESC: Exit\n\n");
         printf("Choice: ");
         
@@ -2100,6 +2390,10 @@ void display_trace_selection_menu(void) {
         
         if (choice == 27) {  /* ESC */
             done = 1;
+        } else if (choice == 'C') {
+            printf("\nSlot (0-9): ");
+            choice = getch();
+            if (choice >= '0' && choice <= '9') trace_next_channel(choice - '0');
         } else if (choice >= '0' && choice <= '9') {
             i = choice - '0';
             if (g_system->modules[i].enabled && g_traces[i].data_count > 0) {
@@ -2119,6 +2413,15 @@ void display_trace_selection_menu(void) {
     }
 }
 
+/* Show the next channel of a multi-channel slot's trace.  Returns 0 if
+ * the slot has only module_data. */
+int trace_next_channel(int slot) {
+    if (slot < 0 || slot >= 10 || slot_channel_count(slot) < 2) return 0;
+    g_traces[slot].channel = (unsigned char)((g_traces[slot].channel + 1) % slot_channel_count(slot));
+    sync_traces_with_modules();
+    return 1;
+}
+
 void sync_traces_with_modules(void) {
     int i;
     int user_enabled[10];  /* Save user trace visibility preferences */
@@ -2152,14 +2455,24 @@ void sync_traces_with_modules(void) {
             g_traces[i].color = get_module_color(g_system->modules[i].module_type);
             strcpy(g_traces[i].label, g_system->modules[i].description);
             
+            /* Each slot trace shows one of the slot's channels */
+            if (g_traces[i].channel >= slot_channel_count(i)) {
+                g_traces[i].channel = 0;
+            }
+            
             if (g_system->modules[i].module_data && 
                 g_system->modules[i].module_data_count > 0) {
-                g_traces[i].data = g_system->modules[i].module_data;
+                g_traces[i].data = (float *)slot_channel_data(i, g_traces[i].channel);
                 g_traces[i].data_count = g_system->modules[i].module_data_count;
                 
                 /* Set unit type based on module type */
                 /* Check if this is FFT data - preserve dB units */
-                if (strcmp(g_system->modules[i].description, "FFT Result") == 0) {
+                if (slot_channel_count(i) > 1) {
+                    /* Named channels carry their own units */
+                    g_traces[i].unit_type = slot_channel_get(i, g_traces[i].channel)->unit_type;
+                    g_traces[i].x_scale = 1.0;
+                    g_traces[i].x_offset = 0.0;
+                } else if (strcmp(g_system->modules[i].description, "FFT Result") == 0) {
                     /* FFT data - preserve existing unit_type (should be UNIT_DB) */
                     /* Don't override unit_type, x_scale, or x_offset for FFT */
                 } else {
@@ -2216,6 +2529,8 @@ void init_dm5120_config(int slot) {
     g_dm5120_config[slot].burst_mode = 0;
     g_dm5120_config[slot].sample_rate = 1.0;
     g_dm5120_config[slot].lf_termination = 0;  /* Default to CRLF */
+    g_dm5120_config[slot].stream_mode = 0;
+    g_dm5120_config[slot].streaming = 0;
 }
 void init_dm5120_config_enhanced(int slot) {
     init_dm5120_config(slot);
@@ -2409,13 +2724,14 @@ void configure_dm5120_advanced(int slot) {
                 
             case 'A':
                 cfg->lf_termination = !cfg->lf_termination;
+                gpib_build_device_table();
                 printf("\n\nTermination: %s\n", cfg->lf_termination ? "LF only (for instruments showing LF)" : "Standard CRLF");
                 getch();
                 break;
                 
             case 'B':
                 printf("\n\nApplying settings to DM5120...\n");
-                gpib_remote_dm5120(address);
+                gpib_remote(address);
                 delay(200);
                 
                 dm5120_set_function(address, cfg->function);
@@ -2459,37 +2775,37 @@ void configure_dm5120_advanced(int slot) {
 #endif
 void dm5120_set_function(int address, char *function) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_FUNCTION);
     sprintf(gpib_cmd_buffer, "FUNCT %s", function);
-    gpib_write_dm5120(address, gpib_cmd_buffer);
-    delay(100);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5120_set_range(int address, int range) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_RANGE);
     if (range == 0) {
-        gpib_write_dm5120(address, "RANGE AUTO");
+        gpib_write(address, "RANGE AUTO");
     } else {
         sprintf(gpib_cmd_buffer, "RANGE %d", range);
-        gpib_write_dm5120(address, gpib_cmd_buffer);
+        gpib_write(address, gpib_cmd_buffer);
     }
-    delay(50);
 }
 void dm5120_set_filter(int address, int enabled, int value) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_FILTER);
     
     if (enabled) {
-        gpib_write_dm5120(address, "FILTER ON");
-        delay(50);
+        gpib_write(address, "FILTER ON");
         if (value > 0 && value <= 99) {
             sprintf(gpib_cmd_buffer, "FILTER %d", value);  /* Correct DM5120 syntax */
-            gpib_write_dm5120(address, gpib_cmd_buffer);
-            delay(50);
+            gpib_write(address, gpib_cmd_buffer);
         }
     } else {
-        gpib_write_dm5120(address, "FILTER OFF");
+        gpib_write(address, "FILTER OFF");
     }
 }
 void dm5120_set_trigger(int address, char *source, char *mode) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_TRIGGER);
     
     /* Validate parameters */
     if (!source || !mode) {
@@ -2510,32 +2826,30 @@ void dm5120_set_trigger(int address, char *source, char *mode) {
     }
     
     sprintf(gpib_cmd_buffer, "TRIGGER %s,%s", source, mode);  /* DM5120 manual syntax: TRIGGER <source>,<mode> */
-    gpib_write_dm5120(address, gpib_cmd_buffer);
-    delay(50);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5120_set_digits(int address, int digits) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_DIGITS);
     if (digits >= 3 && digits <= 6) {
         sprintf(gpib_cmd_buffer, "DIGITS %d", digits);  /* Correct DM5120 syntax */
-        gpib_write_dm5120(address, gpib_cmd_buffer);
-        delay(50);
+        gpib_write(address, gpib_cmd_buffer);
     }
 }
 void dm5120_set_null(int address, int enabled, float value) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_NULL);
     if (enabled) {
         sprintf(gpib_cmd_buffer, "NULL %.6e", value);
-        gpib_write_dm5120(address, gpib_cmd_buffer);
-        delay(50);
-        gpib_write_dm5120(address, "NULL ON");
+        gpib_write(address, gpib_cmd_buffer);
+        gpib_write(address, "NULL ON");
     } else {
-        gpib_write_dm5120(address, "NULL OFF");
+        gpib_write(address, "NULL OFF");
     }
-    delay(50);
 }
 void dm5120_set_data_format(int address, int on) {
-    gpib_write_dm5120(address, on ? "DATFOR ON" : "DATFOR OFF");
-    delay(50);
+    shadow_forget(address, SH_DM5120_DATFOR);
+    gpib_write(address, on ? "DATFOR ON" : "DATFOR OFF");
 }
 /* DM5120 Measurement Rate Tables (readings/second) based on manual specifications */
 
@@ -2572,13 +2886,11 @@ static const float __far dm5120_bus_ohms_rates[4][2] = {
     {0.0, 0.3}         /* 6.5 digit */
 };
 
-/* Get measurement rate in readings/second for current DM5120 configuration */
-float dm5120_get_measurement_rate(int slot, int trigger_mode) {
-    dm5120_config *cfg = &g_dm5120_config[slot];
+/* Rate table lookup for the configured function and digits */
+static float dm5120_table_rate(dm5120_config *cfg, int use_bus_rates) {
     int digit_index, autocal_index;
     float rate;
     int is_ohms_function;
-    int use_bus_rates;
     
     /* Convert digits to array index */
     switch (cfg->digits) {
@@ -2595,17 +2907,6 @@ float dm5120_get_measurement_rate(int slot, int trigger_mode) {
     /* Check if this is an OHMS function */
     is_ohms_function = (strstr(cfg->function, "OHMS") != NULL);
     
-    /* Determine if we should use bus-triggered rates
-     * Per DM5120 manual:
-     * - EXT,CONT with buffer enabled requires external trigger (bus rates)
-     * - EXT,ONE always requires external trigger (bus rates)  
-     * - TALK mode always uses bus rates (triggered by GPIB addressing)
-     * - EXT,CONT with buffer disabled uses continuous rates (auto-trigger)
-     */
-    use_bus_rates = (trigger_mode == 2) || /* Explicit bus-triggered mode */
-                    (cfg->trigger_source == 1 && (cfg->trigger_mode == 1 || cfg->buffer_enabled)) || /* EXT,ONE or EXT,CONT with buffer */
-                    (cfg->trigger_source == 0); /* TALK mode always uses bus rates */
-    
     /* Select appropriate rate table */
     if (use_bus_rates) { /* IEEE-488 bus triggered */
         if (is_ohms_function) {
@@ -2632,12 +2933,37 @@ float dm5120_get_measurement_rate(int slot, int trigger_mode) {
     return rate;
 }
 
+/* Get measurement rate in readings/second for current DM5120 configuration */
+float dm5120_get_measurement_rate(int slot, int trigger_mode) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    int use_bus_rates;
+    
+    /* Determine if we should use bus-triggered rates
+     * Per DM5120 manual:
+     * - EXT,CONT with buffer enabled requires external trigger (bus rates)
+     * - EXT,ONE always requires external trigger (bus rates)  
+     * - TALK mode always uses bus rates (triggered by GPIB addressing)
+     * - EXT,CONT with buffer disabled uses continuous rates (auto-trigger)
+     */
+    use_bus_rates = (trigger_mode == 2) || /* Explicit bus-triggered mode */
+                    (cfg->trigger_source == 1 && (cfg->trigger_mode == 1 || cfg->buffer_enabled)) || /* EXT,ONE or EXT,CONT with buffer */
+                    (cfg->trigger_source == 0); /* TALK mode always uses bus rates */
+    
+    return dm5120_table_rate(cfg, use_bus_rates);
+}
+
 /* Calculate precise timing delay based on DM5120 measurement rates */
 int dm5120_calculate_measurement_time(int slot, int operation_type, int sample_count) {
     dm5120_config *cfg = &g_dm5120_config[slot];
     float measurement_rate;
     int base_time_ms;
     int trigger_mode = cfg->trigger_mode;
+    unsigned int learned;
+    
+    /* A single reading waits what this configuration has been seen to take */
+    if (operation_type == 0 && (learned = dm5120_learned_ms(slot)) > 0) {
+        return (int)(learned + (learned >> 3) + DM5120_TIMING_MARGIN_MS);
+    }
     
     /* Get actual measurement rate for current configuration */
     measurement_rate = dm5120_get_measurement_rate(slot, trigger_mode);
@@ -2676,8 +3002,144 @@ int dm5120_calculate_delay(int slot, int operation_type, int sample_count) {
     return dm5120_calculate_measurement_time(slot, operation_type, sample_count);
 }
 
+/* Learned READ cycle table - shared by all DM5120 slots, since meters
+ * in the same configuration take the same time */
+static dm5120_timing_entry __far g_dm5120_timing[DM5120_TIMING_ENTRIES];
+static int g_dm5120_timing_count = 0;
+static unsigned int g_dm5120_timing_cycles[10];   /* Untimed cycles since the last timed one */
+
+static int dm5120_timing_matches(dm5120_timing_entry *e, dm5120_config *cfg) {
+    return strcmp(e->function, cfg->function) == 0 &&
+           e->digits == (unsigned char)cfg->digits &&
+           e->filter == (unsigned char)(cfg->filter_enabled ? cfg->filter_value : 0) &&
+           e->range == (unsigned char)cfg->range_mode;
+}
+
+/* Entry for the slot's configuration, NULL if there is none and create
+ * is 0.  A full table gives up its least used entry. */
+static dm5120_timing_entry *dm5120_timing_find(int slot, int create) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    dm5120_timing_entry *e;
+    int i, victim = 0;
+    
+    for (i = 0; i < g_dm5120_timing_count; i++) {
+        if (dm5120_timing_matches(&g_dm5120_timing[i], cfg)) return &g_dm5120_timing[i];
+        if (g_dm5120_timing[i].samples < g_dm5120_timing[victim].samples) victim = i;
+    }
+    if (!create) return NULL;
+    
+    if (g_dm5120_timing_count < DM5120_TIMING_ENTRIES) victim = g_dm5120_timing_count++;
+    e = &g_dm5120_timing[victim];
+    memset(e, 0, sizeof(dm5120_timing_entry));
+    strncpy(e->function, cfg->function, sizeof(e->function) - 1);
+    e->digits = (unsigned char)cfg->digits;
+    e->filter = (unsigned char)(cfg->filter_enabled ? cfg->filter_value : 0);
+    e->range = (unsigned char)cfg->range_mode;
+    return e;
+}
+
+void dm5120_timing_learn(int slot, unsigned long cycle_ms) {
+    dm5120_timing_entry *e = dm5120_timing_find(slot, 1);
+    
+    if (cycle_ms > 0xFFFFUL) cycle_ms = 0xFFFFUL;
+    
+    /* Same 3/4 old + 1/4 new average as the completion layer */
+    if (e->samples == 0) {
+        e->learned_ms = (unsigned int)cycle_ms;
+    } else {
+        e->learned_ms = (unsigned int)(((unsigned long)e->learned_ms * 3 + cycle_ms) >> 2);
+    }
+    if ((unsigned int)cycle_ms > e->max_ms) e->max_ms = (unsigned int)cycle_ms;
+    if (e->samples < 0xFFFF) e->samples++;
+    g_dm5120_timing_cycles[slot] = 0;
+}
+
+unsigned int dm5120_learned_ms(int slot) {
+    dm5120_timing_entry *e = dm5120_timing_find(slot, 0);
+    
+    if (!e || e->samples < DM5120_TIMING_CALIBRATE) return 0;
+    return e->learned_ms;
+}
+
+/* The fixed-table wait for a single reading, for comparison */
+int dm5120_nominal_ms(int slot) {
+    float rate = dm5120_get_measurement_rate(slot, g_dm5120_config[slot].trigger_mode);
+    
+    return ((int)(1000.0 / rate) * 150) / 100;
+}
+
+/* Time this cycle?  Until calibrated always, then every RECHECK-th */
+static int dm5120_timing_due(int slot) {
+    if (dm5120_learned_ms(slot) == 0) return 1;
+    return ++g_dm5120_timing_cycles[slot] >= DM5120_TIMING_RECHECK;
+}
+
+/* A read that came back empty after a blind wait - time it again */
+static void dm5120_timing_miss(int slot) {
+    dm5120_timing_entry *e = dm5120_timing_find(slot, 0);
+    
+    if (e) e->samples = 0;
+}
+
+/* Wait for the reading whose READ went out unwaited at start_ms.  Cycles
+ * due for timing busy poll and learn what they saw; the rest sleep the
+ * learned time plus margin instead of polling.  An address that cannot
+ * be busy polled has nothing to time and always sleeps the rate table.
+ * Returns 1 if this cycle was timed. */
+static int dm5120_wait_reading(int address, int slot, unsigned long start_ms) {
+    gpib_device *dev = gpib_get_device(address);
+    unsigned long elapsed;
+    int wait;
+    
+    if (dev && dev->poll_busy && dm5120_timing_due(slot)) {
+        if (gpib_wait_ready_since(address, start_ms) == 0) {
+            dm5120_timing_learn(slot, tb_elapsed_ms(start_ms));
+        }
+        return 1;
+    }
+    
+    wait = dm5120_calculate_delay(slot, 0, 1);
+    elapsed = tb_elapsed_ms(start_ms);
+    if (elapsed < (unsigned long)wait) delay((unsigned int)(wait - elapsed));
+    return 0;
+}
+
+int dm5120_timing_count(void) {
+    return g_dm5120_timing_count;
+}
+
+dm5120_timing_entry *dm5120_timing_at(int index) {
+    if (index < 0 || index >= g_dm5120_timing_count) return NULL;
+    return &g_dm5120_timing[index];
+}
+
+/* Add an entry read back from the settings file */
+void dm5120_timing_restore(dm5120_timing_entry *entry) {
+    int i;
+    
+    for (i = 0; i < g_dm5120_timing_count; i++) {
+        if (strcmp(g_dm5120_timing[i].function, entry->function) == 0 &&
+            g_dm5120_timing[i].digits == entry->digits &&
+            g_dm5120_timing[i].filter == entry->filter &&
+            g_dm5120_timing[i].range == entry->range) {
+            break;
+        }
+    }
+    if (i == g_dm5120_timing_count) {
+        if (g_dm5120_timing_count >= DM5120_TIMING_ENTRIES) return;
+        g_dm5120_timing_count++;
+    }
+    g_dm5120_timing[i] = *entry;
+}
+
+void dm5120_timing_reset(void) {
+    g_dm5120_timing_count = 0;
+    memset(g_dm5120_timing_cycles, 0, sizeof(g_dm5120_timing_cycles));
+}
+
 void dm5120_enable_buffering(int address, int slot, int buffer_size) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_BUFFER);
     
     /* Enforce 500 sample limit for DM5120 internal buffer */
     if (buffer_size > 500) {
@@ -2686,10 +3148,10 @@ void dm5120_enable_buffering(int address, int slot, int buffer_size) {
     
     if (buffer_size == 0) {
         /* Use circular buffer mode */
-        gpib_write_dm5120(address, "BUFSZ CIRCULAR");
+        gpib_write(address, "BUFSZ CIRCULAR");
     } else {
         sprintf(gpib_cmd_buffer, "BUFSZ %d", buffer_size);
-        gpib_write_dm5120(address, gpib_cmd_buffer);
+        gpib_write(address, gpib_cmd_buffer);
     }
     
     /* Use digit-aware timing for buffer setup */
@@ -2750,11 +3212,11 @@ void dm5120_set_storage_interval(int address, int slot, int interval_ms) {
     
     if (interval_ms == 0) {
         /* One shot mode - store one reading per trigger */
-        gpib_write_dm5120(address, "STOINT ONE");
+        gpib_write(address, "STOINT ONE");
     } else {
         /* Continuous mode with interval timing */
         sprintf(gpib_cmd_buffer, "STOINT %d", interval_ms);
-        gpib_write_dm5120(address, gpib_cmd_buffer);
+        gpib_write(address, gpib_cmd_buffer);
     }
     
     /* Use appropriate delay based on operation type */
@@ -2765,10 +3227,10 @@ int dm5120_query_storage_interval(int address) {
     
     int interval = 0;
     
-    gpib_write_dm5120(address, "STOINT?");
+    gpib_write(address, "STOINT?");
     delay(50);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (strstr(gpib_response_buffer, "ONE")) {
             return 0; /* One shot mode */
         }
@@ -2784,37 +3246,63 @@ int dm5120_query_storage_interval(int address) {
 
 /* Enable/disable specific SRQ events */
 void dm5120_configure_srq_events(int address, int enable_full, int enable_half, int enable_rdy, int enable_opc) {
-    char cmd[50];
+    gpib_batch_begin(address);
     
     /* Configure FULL buffer event */
     sprintf(gpib_cmd_buffer, "FULL %s", enable_full ? "ON" : "OFF");
-    gpib_write_dm5120(address, gpib_cmd_buffer);
-    delay(50);
+    gpib_write(address, gpib_cmd_buffer);
     
     /* Configure HALF buffer event */
     sprintf(gpib_cmd_buffer, "HALF %s", enable_half ? "ON" : "OFF");
-    gpib_write_dm5120(address, gpib_cmd_buffer);
-    delay(50);
+    gpib_write(address, gpib_cmd_buffer);
     
     /* Configure RDY (ready) event */
     sprintf(gpib_cmd_buffer, "RDY %s", enable_rdy ? "ON" : "OFF");
-    gpib_write_dm5120(address, gpib_cmd_buffer);
-    delay(50);
+    gpib_write(address, gpib_cmd_buffer);
     
     /* Configure OPC (operation complete) event */
     sprintf(gpib_cmd_buffer, "OPC %s", enable_opc ? "ON" : "OFF");
-    gpib_write_dm5120(address, gpib_cmd_buffer);
-    delay(50);
+    gpib_write(address, gpib_cmd_buffer);
     
     /* Enable RQS (Service Request) */
-    gpib_write_dm5120(address, "RQS ON");
-    delay(50);
+    gpib_write(address, "RQS ON");
+    gpib_batch_commit();
+    
+    /* Service requests from this meter go to its slot's buffer state */
+    gpib_service_arm(address, dm5120_service_event);
 }
 
-/* Intelligent SRQ event configuration based on buffer characteristics */
-void dm5120_configure_srq_events_smart(int address, int buffer_size, int is_circular, int expected_time_ms) {
-    int enable_full, enable_half;
-    
+/* Service request from an armed DM5120 - read the event once and
+ * advance the owning slot's buffer state machine */
+void dm5120_service_event(int address, unsigned char status) {
+    gpib_device *dev = gpib_get_device(address);
+    dm5120_config *cfg;
+    int event;
+    
+    if (!dev || dev->slot < 0 || dev->module_type != MOD_DM5120) return;
+    cfg = &g_dm5120_config[dev->slot];
+    
+    event = dm5120_check_buffer_status(address);
+    
+    if (event & 0x01) {             /* FULL */
+        cfg->buffer_state = 3;
+        cfg->samples_ready = cfg->buffer_size;
+    } else if (event & 0x02) {      /* HALF */
+        if (cfg->buffer_state < 2) {
+            cfg->buffer_state = 2;
+            cfg->samples_ready = cfg->buffer_size / 2;
+        }
+    } else if (event & 0x04) {      /* RDY - one more reading stored */
+        if (cfg->buffer_state == 1 || cfg->buffer_state == 2) {
+            cfg->samples_ready++;
+        }
+    }
+}
+
+/* Intelligent SRQ event configuration based on buffer characteristics */
+void dm5120_configure_srq_events_smart(int address, int buffer_size, int is_circular, int expected_time_ms) {
+    int enable_full, enable_half;
+    
     if (is_circular) {
         /* CIRCULAR buffers never report FULL events */
         enable_full = 0;
@@ -2834,8 +3322,8 @@ void dm5120_configure_srq_events_smart(int address, int buffer_size, int is_circ
         }
     }
     
-    /* Configure events with intelligent strategy */
-    dm5120_configure_srq_events(address, enable_full, enable_half, 1, 1);
+    /* RDY/OPC would raise a service request for every stored reading */
+    dm5120_configure_srq_events(address, enable_full, enable_half, 0, 0);
 }
 
 /* Check DM5120 buffer status using SRQ events */
@@ -2844,10 +3332,9 @@ int dm5120_check_buffer_status(int address) {
     int status = 0;
     
     /* Check for any pending events */
-    gpib_write_dm5120(address, "EVENT?");
-    delay(50);
+    gpib_write(address, "EVENT?");
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         int event_code;
         if (sscanf(gpib_response_buffer, "EVENT %d", &event_code) == 1) {
             switch (event_code) {
@@ -2859,6 +3346,10 @@ int dm5120_check_buffer_status(int address) {
                 case 16: status = 0x10; break;     /* OVER overrange */
                 default: status = 0x80; break;     /* Unknown event */
             }
+        } else if (strstr(gpib_response_buffer, "FULL")) {
+            status = 0x01;
+        } else if (strstr(gpib_response_buffer, "HALF")) {
+            status = 0x02;
         }
     }
     
@@ -2873,7 +3364,7 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
     float value;
     int count = 0;
     int timeout_ms, elapsed_ms = 0;
-    int status;
+    int half_reported = 0;
     unsigned long start_time, current_time;
     int is_circular;
     float measurement_rate;
@@ -2895,11 +3386,12 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
     
     /* Configure buffer size (this clears any existing buffer data) */
     if (is_circular) {
-        gpib_write_dm5120(address, "BUFSZ CIRCULAR");
+        gpib_write(address, "BUFSZ CIRCULAR");
     } else {
         sprintf(gpib_cmd_buffer, "BUFSZ %d", max_samples);
-        gpib_write_dm5120(address, gpib_cmd_buffer);
+        gpib_write(address, gpib_cmd_buffer);
     }
+    shadow_forget(address, SH_DM5120_BUFFER);
     delay(100);
     
     if (use_cont_mode) {
@@ -2915,42 +3407,44 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
                measurement_interval_ms, measurement_rate);
     }
     
-    start_time = *((unsigned long far *)0x0040006CL);
+    start_time = tb_now_ms();
     
     if (use_cont_mode) {
-        /* CONT mode: Buffer fills automatically, monitor SRQ events */
+        /* CONT mode: Buffer fills automatically; FULL/HALF arrive as
+         * service requests and dm5120_service_event moves the state */
         printf("Monitoring automatic buffer fill...\n");
+        cfg->buffer_state = 1;
+        cfg->samples_ready = 0;
         
-        while (count < max_samples && elapsed_ms < timeout_ms) {
-            current_time = *((unsigned long far *)0x0040006CL);
-            elapsed_ms = (int)((current_time - start_time) * 55);
+        while (elapsed_ms < timeout_ms) {
+            gpib_service_scan();
             
-            /* Check SRQ events */
-            status = dm5120_check_buffer_status(address);
-            
-            if (status & 0x01) { /* FULL buffer event */
+            if (cfg->buffer_state == 3) {
                 printf("FULL event received - buffer complete\n");
                 break;
             }
-            
-            if (status & 0x02) { /* HALF buffer event */
+            if (cfg->buffer_state == 2 && !half_reported) {
                 printf("Buffer 50%% full...\n");
+                half_reported = 1;
             }
             
-            delay(200); /* Check events every 200ms */
+            delay(GPIB_POLL_INTERVAL_MS);
+            current_time = tb_now_ms();
+            elapsed_ms = (int)(current_time - start_time);
         }
+        dm5120_reset_buffer_async(slot);
         
     } else {
         /* SEND mode: Manual trigger for each measurement */
         printf("Manual triggering for %d samples...\n", max_samples);
         
         for (i = 0; i < max_samples && elapsed_ms < timeout_ms; i++) {
-            gpib_write_dm5120(address, "SEND");
+            gpib_write(address, "SEND");
             delay(measurement_interval_ms);
             
             /* Update elapsed time */
-            current_time = *((unsigned long far *)0x0040006CL);
-            elapsed_ms = (int)((current_time - start_time) * 55);
+            current_time = tb_now_ms();
+            elapsed_ms = (int)(current_time - start_time);
             
             /* Progress feedback every 10 measurements */
             if ((i + 1) % 10 == 0 || i == max_samples - 1) {
@@ -2964,10 +3458,10 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
     
     /* Verify buffer has data before reading */
     printf("Checking buffer status before read...\n");
-    gpib_write_dm5120(address, "BUFCNT?");
+    gpib_write(address, "BUFCNT?");
     delay(50);
     
-    if (gpib_read_dm5120(address, response, sizeof(response)) > 0) {
+    if (gpib_read(address, response, sizeof(response)) > 0) {
         int buffer_count;
         if (sscanf(response, "%d", &buffer_count) == 1) {
             printf("Buffer contains %d samples\n", buffer_count);
@@ -2980,7 +3474,7 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
     
     /* Read all stored data with extended timeout and error handling */
     printf("Reading buffer data...\n");
-    gpib_write_dm5120(address, "READ ALLSTORE");
+    gpib_write(address, "READ ALLSTORE");
     delay(dm5120_calculate_measurement_time(slot, 4, 1) * 2); /* Double the timeout */
     
     /* Check for GPIB errors before attempting read */
@@ -3003,19 +3497,10 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
         }
     }
     
-    /* Parse response and fill buffer with improved error handling */
+    /* Stream the whole response straight into the sample buffer */
     printf("Attempting to read buffer data...\n");
-    if (gpib_read_dm5120(address, response, sizeof(response)) > 0) {
-        char *token = strtok(response, ",;");
-        
-        while (token != NULL && count < max_samples) {
-            if (sscanf(token, "%f", &value) == 1) {
-                buffer[count] = value;
-                count++;
-            }
-            token = strtok(NULL, ",;");
-        }
-        
+    count = gpib_read_floats(address, buffer, max_samples);
+    if (count > 0) {
         printf("Buffer read complete: %d samples retrieved\n", count);
     } else {
         printf("ERROR: Failed to read buffer data - READFAULT detected\n");
@@ -3023,10 +3508,10 @@ int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, in
         
         /* Try reading one sample at a time as fallback */
         for (i = 0; i < max_samples && count < max_samples; i++) {
-            gpib_write_dm5120(address, "READ ONESTORE");
+            gpib_write(address, "READ ONESTORE");
             delay(200);
             
-            if (gpib_read_dm5120(address, response, sizeof(response)) > 0) {
+            if (gpib_read(address, response, sizeof(response)) > 0) {
                 if (sscanf(response, "%f", &value) == 1) {
                     buffer[count] = value;
                     count++;
@@ -3153,6 +3638,17 @@ void dm5120_timing_diagnostics(int slot) {
     printf("IEEE-488 Bus Mode: %.1f readings/sec\n", rate_bus);
     printf("\n");
     
+    /* Learned against nominal for the current configuration */
+    printf("READ Cycle:\n");
+    printf("Nominal (rate table + 50%%): %d ms\n", dm5120_nominal_ms(slot));
+    if (dm5120_learned_ms(slot) > 0) {
+        printf("Learned: %u ms, wait with margin %d ms\n",
+               dm5120_learned_ms(slot), dm5120_calculate_measurement_time(slot, 0, 1));
+    } else {
+        printf("Learned: not calibrated yet (%d timed cycles needed)\n", DM5120_TIMING_CALIBRATE);
+    }
+    printf("\n");
+    
     /* Show timing for different operations */
     printf("Operation Timings:\n");
     printf("Single Reading: %d ms\n", dm5120_calculate_measurement_time(slot, 0, 1));
@@ -3181,30 +3677,33 @@ void dm5120_timing_diagnostics(int slot) {
     printf("DCV/ACV: ~8-35 r/s\n");
     printf("OHMS: ~9-16 r/s\n");
     printf("OHMSCOMP: ~4-8 r/s (50%% of normal OHMS)\n");
-}
-
-int dm5120_get_buffer_data(int address, int slot, float far *buffer, int max_samples) {
-    char response[GPIB_BUFFER_SIZE];
-    int count = 0;
-    int i;
-    char *token;
-    
-    gpib_write_dm5120(address, "READ ALLSTORE");
     
-    /* Use digit-aware timing scaled by sample count */
-    delay(dm5120_calculate_delay(slot, 2, max_samples));
-    
-    if (gpib_read_dm5120(address, response, sizeof(response)) > 0) {
-        token = strtok(response, ",");
-        while (token && count < max_samples) {
-            if (sscanf(token, "%e", &buffer[count]) == 1) {
-                count++;
+    /* Every configuration timed so far */
+    if (dm5120_timing_count() > 0) {
+        dm5120_timing_entry *e;
+        char range_text[8];
+        
+        printf("\nLearned READ Cycles:\n");
+        printf("Function  Digits Filter Range  Learned    Max  Cycles\n");
+        for (i = 0; i < dm5120_timing_count(); i++) {
+            e = dm5120_timing_at(i);
+            if (e->range == 0) {
+                strcpy(range_text, "AUTO");
+            } else {
+                sprintf(range_text, "R%d", e->range);
             }
-            token = strtok(NULL, ",");
+            printf("%-9s %6d %6d %5s %6u ms %4u ms %6u%s\n",
+                   e->function, e->digits, e->filter,
+                   range_text, e->learned_ms, e->max_ms, e->samples,
+                   e->samples < DM5120_TIMING_CALIBRATE ? " (calibrating)" : "");
         }
     }
-    
-    return count;
+}
+
+int dm5120_get_buffer_data(int address, int slot, float far *buffer, int max_samples) {
+    /* One transaction for the whole buffer - the reader streams the reply */
+    gpib_write(address, "READ ALLSTORE");
+    return gpib_read_floats(address, buffer, max_samples);
 }
 /* Complete buffer fill and retrieve multiple samples */
 int dm5120_fill_buffer_complete(int address, int slot, float far *buffer, int buffer_size) {
@@ -3222,11 +3721,11 @@ int dm5120_fill_buffer_complete(int address, int slot, float far *buffer, int bu
         dm5120_set_trigger(address, "EXT", "CONT");
         
         /* Enable SRQ events for buffer monitoring */
-        gpib_write_dm5120(address, "HALF ON");
+        gpib_write(address, "HALF ON");
         delay(50);
-        gpib_write_dm5120(address, "FULL ON");
+        gpib_write(address, "FULL ON");
         delay(50);
-        gpib_write_dm5120(address, "RQS ON");
+        gpib_write(address, "RQS ON");
         delay(50);
     } else {
         /* For single measurements use TALK,CONT */
@@ -3265,67 +3764,42 @@ void dm5120_start_buffer_async(int address, int slot) {
     
     /* Configure for async buffer fill */
     dm5120_set_trigger(address, "EXT", "CONT");
-    delay(50);
     
     /* Set storage interval for automatic triggering */
     dm5120_set_storage_interval(address, slot, 100); /* 100ms intervals */
-    delay(50);
     
-    /* Enable SRQ events for buffer monitoring */
-    gpib_write_dm5120(address, "HALF ON");
-    delay(50);
-    gpib_write_dm5120(address, "FULL ON");
-    delay(50);
-    gpib_write_dm5120(address, "RQS ON");
-    delay(50);
+    /* FULL/HALF come back as service requests to dm5120_service_event */
+    dm5120_configure_srq_events(address, 1, 1, 0, 0);
     
     /* Clear buffer and prepare for new data */
-    gpib_write_dm5120(address, "BUFCLR");
-    delay(50);
+    gpib_write(address, "BUFCLR");
     
     /* Configure buffer size if needed */
     if (cfg->buffer_size > 0 && cfg->buffer_size <= DM5120_MAX_BUFFER_SIZE) {
         dm5120_set_buffer_size(address, cfg->buffer_size);
-        delay(50);
     }
     
     /* Mark state as filling */
     cfg->buffer_state = 1; /* filling */
-    cfg->buffer_start_time = *((unsigned long far *)0x0040006CL); /* Get tick count */
+    cfg->buffer_start_time = tb_now_ms();
     cfg->samples_ready = 0;
 }
 
+/* Buffer state is moved by dm5120_service_event when the monitor's
+ * service scan sees FULL/HALF; this only covers a lost request */
 int dm5120_check_buffer_async(int address, int slot) {
     dm5120_config *cfg = &g_dm5120_config[slot];
-    char response[128];
-    int event_found = 0;
+    unsigned long expected_ms;
     
     /* Only check if buffer is filling */
     if (cfg->buffer_state == 0) {
         return 0;  /* Not active */
     }
     
-    /* Check for SRQ events */
-    gpib_write_dm5120(address, "EVENT?");
-    delay(50);
-    
-    if (gpib_read_dm5120(address, response, sizeof(response)) > 0) {
-        /* Check for HALF event */
-        if (strstr(response, "HALF")) {
-            cfg->buffer_state = 2; /* half full */
-            cfg->samples_ready = cfg->buffer_size / 2;
-            event_found = 1;
-        }
-        /* Check for FULL event */
-        else if (strstr(response, "FULL")) {
-            cfg->buffer_state = 3; /* full */
-            cfg->samples_ready = cfg->buffer_size;
-            event_found = 1;
-        }
-    }
-    
-    /* If no event, check buffer count directly */
-    if (!event_found && cfg->buffer_state == 1) {
+    /* Overdue by a second past the 100ms STOINT fill time - ask directly */
+    expected_ms = (unsigned long)cfg->buffer_size * 100L + 1000L;
+    if (cfg->buffer_state < 3 &&
+        tb_elapsed_ms(cfg->buffer_start_time) > expected_ms) {
         int count = dm5120_get_buffer_count(address);
         if (count > 0) {
             cfg->samples_ready = count;
@@ -3341,9 +3815,7 @@ int dm5120_check_buffer_async(int address, int slot) {
     
     /* Check for timeout (30 seconds) */
     if (cfg->buffer_state == 1) {
-        unsigned long current_ticks = *((unsigned long far *)0x0040006CL);
-        unsigned long elapsed_ticks = current_ticks - cfg->buffer_start_time;
-        if (elapsed_ticks > (30L * 182L / 10L)) { /* 30 seconds in ticks */
+        if (tb_elapsed_ms(cfg->buffer_start_time) > 30000L) { /* 30 seconds */
             /* Timeout - read whatever is available */
             cfg->buffer_state = 3; /* Force full state to trigger read */
         }
@@ -3361,15 +3833,145 @@ void dm5120_reset_buffer_async(int slot) {
     cfg->samples_ready = 0;
 }
 
+/* DM5120 Gapless Streaming
+ *
+ * The meter stores into its circular buffer at the STOINT rate while
+ * the monitor drains it.  Each HALF service request - or the overdue
+ * check, if one was lost - reads everything stored so far with READ
+ * ALLSTORE; the meter carries on storing into the emptied buffer, so no
+ * reading falls between two drains.  Every reading goes into the slot's
+ * module_data stamped with the session time it was stored at. */
+
+static float __far g_stream_stage[DM5120_MAX_BUFFER_SIZE];
+
+/* STOINT period for the fastest continuous rate of this configuration */
+int dm5120_stream_interval_ms(int slot) {
+    float rate = dm5120_table_rate(&g_dm5120_config[slot], 0);
+    int interval = (int)(1000.0 / rate);
+    
+    if ((float)interval * rate < 1000.0) interval++;
+    if (interval < DM5120_STREAM_MIN_STOINT) interval = DM5120_STREAM_MIN_STOINT;
+    return interval;
+}
+
+void dm5120_stream_start(int address, int slot) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    
+    cfg->stream_interval_ms = dm5120_stream_interval_ms(slot);
+    
+    /* HALF only - a circular buffer never reports FULL */
+    dm5120_configure_srq_events(address, 0, 1, 0, 0);
+    
+    gpib_batch_begin(address);
+    gpib_write(address, "BUFSZ CIRCULAR");
+    shadow_forget(address, SH_DM5120_BUFFER);
+    dm5120_set_trigger(address, "TALK", "CONT");
+    sprintf(gpib_cmd_buffer, "STOINT %u", cfg->stream_interval_ms);
+    gpib_write(address, gpib_cmd_buffer);
+    gpib_write(address, "BUFCLR");
+    gpib_batch_commit();
+    
+    /* First reading is stored one interval after the clear */
+    cfg->stream_next_ms = session_time_ms() + cfg->stream_interval_ms;
+    cfg->stream_drain_time = tb_now_ms();
+    cfg->stream_samples = 0;
+    cfg->stream_overruns = 0;
+    cfg->buffer_state = 1;
+    cfg->samples_ready = 0;
+    cfg->streaming = 1;
+}
+
+/* Drain when HALF has been seen, or when the buffer should be three
+ * quarters full and the request never came.  Returns the readings
+ * stored, 0 if nothing was due. */
+int dm5120_stream_service(int address, int slot) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    unsigned long half_ms;
+    
+    if (!cfg->streaming) {
+        dm5120_stream_start(address, slot);
+        return 0;
+    }
+    
+    half_ms = (unsigned long)(DM5120_MAX_BUFFER_SIZE / 2) * cfg->stream_interval_ms;
+    if (cfg->buffer_state >= 2 ||
+        tb_elapsed_ms(cfg->stream_drain_time) > half_ms + half_ms / 2) {
+        return dm5120_stream_drain(address, slot);
+    }
+    return 0;
+}
+
+int dm5120_stream_drain(int address, int slot) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    unsigned long interval = cfg->stream_interval_ms;
+    unsigned long now_ms;
+    unsigned long span;
+    unsigned long anchored;
+    unsigned long time_ms;
+    int count, i;
+    
+    count = dm5120_read_all_stored(address, g_stream_stage, DM5120_MAX_BUFFER_SIZE);
+    now_ms = session_time_ms();
+    cfg->stream_drain_time = tb_now_ms();
+    cfg->buffer_state = 1;
+    cfg->samples_ready = count > 0 ? count : 0;
+    if (count <= 0) return 0;
+    
+    /* A full buffer has wrapped and lost its oldest readings */
+    if (count >= DM5120_MAX_BUFFER_SIZE) cfg->stream_overruns++;
+    
+    /* Readings follow on from the last drain unless that grid has fallen
+     * more than two intervals behind the newest reading being stored now.
+     * The grid never moves back - earlier times are already taken. */
+    span = (unsigned long)(count - 1) * interval;
+    anchored = now_ms > span ? now_ms - span : 0;
+    time_ms = cfg->stream_next_ms;
+    if ((long)(anchored - time_ms) > (long)(2 * interval)) {
+        time_ms = anchored;
+    }
+    
+    for (i = 0; i < count; i++) {
+        ingest_sample(slot, g_stream_stage[i], time_ms);
+        time_ms += interval;
+    }
+    cfg->stream_next_ms = time_ms;
+    cfg->stream_samples += count;
+    
+    g_system->modules[slot].last_reading = g_stream_stage[count - 1];
+    return count;
+}
+
+/* Stop storing and put the buffer and trigger back to the configuration */
+void dm5120_stream_stop(int address, int slot) {
+    dm5120_config *cfg = &g_dm5120_config[slot];
+    
+    if (!cfg->streaming) return;
+    
+    dm5120_configure_srq_events(address, 0, 0, 0, 0);
+    
+    gpib_batch_begin(address);
+    gpib_write(address, "STOINT ONE");
+    if (cfg->buffer_size > 0 && cfg->buffer_size <= DM5120_MAX_BUFFER_SIZE) {
+        sprintf(gpib_cmd_buffer, "BUFSZ %d", cfg->buffer_size);
+        gpib_write(address, gpib_cmd_buffer);
+    }
+    dm5120_set_trigger(address, cfg->trigger_source ? "EXT" : "TALK",
+                       cfg->trigger_mode ? "ONE" : "CONT");
+    gpib_batch_commit();
+    
+    dm5120_reset_buffer_async(slot);
+    cfg->streaming = 0;
+}
+
 /* DM5120 Buffer Query Functions */
 float dm5120_get_buffer_average(int address) {
     
     float value = 0.0;
     
-    gpib_write_dm5120(address, "BUFAVE?");
+    gpib_write(address, "BUFAVE?");
     delay(100);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
             return value;
         }
@@ -3385,10 +3987,10 @@ int dm5120_get_buffer_count(int address) {
     
     int count = 0;
     
-    gpib_write_dm5120(address, "BUFCNT?");
+    gpib_write(address, "BUFCNT?");
     delay(50);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (sscanf(gpib_response_buffer, "%d", &count) == 1) {
             return count;
         }
@@ -3401,10 +4003,10 @@ float dm5120_get_buffer_min(int address) {
     
     float value = 0.0;
     
-    gpib_write_dm5120(address, "BUFMIN?");
+    gpib_write(address, "BUFMIN?");
     delay(100);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
             return value;
         }
@@ -3420,10 +4022,10 @@ float dm5120_get_buffer_max(int address) {
     
     float value = 0.0;
     
-    gpib_write_dm5120(address, "BUFMAX?");
+    gpib_write(address, "BUFMAX?");
     delay(100);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
             return value;
         }
@@ -3437,12 +4039,13 @@ float dm5120_get_buffer_max(int address) {
 
 void dm5120_set_buffer_size(int address, int size) {
     char cmd[50];
+    shadow_forget(address, SH_DM5120_BUFFER);
     
     if (size == 0) {
-        gpib_write_dm5120(address, "BUFSZ CIRCULAR");
+        gpib_write(address, "BUFSZ CIRCULAR");
     } else {
         sprintf(gpib_cmd_buffer, "BUFSZ %d", size);
-        gpib_write_dm5120(address, gpib_cmd_buffer);
+        gpib_write(address, gpib_cmd_buffer);
     }
     delay(100);
 }
@@ -3451,10 +4054,10 @@ int dm5120_query_buffer_size(int address) {
     
     int size = 0;
     
-    gpib_write_dm5120(address, "BUFSZ?");
+    gpib_write(address, "BUFSZ?");
     delay(50);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (strstr(gpib_response_buffer, "CIRCULAR")) {
             return 500;  /* Full circular buffer size */
         }
@@ -3471,10 +4074,10 @@ float dm5120_read_one_stored(int address) {
     
     float value = 0.0;
     
-    gpib_write_dm5120(address, "READ ONESTORE");
+    gpib_write(address, "READ ONESTORE");
     delay(100);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
             return value;
         }
@@ -3487,25 +4090,8 @@ float dm5120_read_one_stored(int address) {
 }
 
 int dm5120_read_all_stored(int address, float far *buffer, int max_samples) {
-    char response[GPIB_BUFFER_SIZE];
-    int count = 0;
-    char *token;
-    
-    gpib_write_dm5120(address, "READ ALLSTORE");
-    delay(200);  /* Allow time for all data to be formatted */
-    
-    if (gpib_read_dm5120(address, response, sizeof(response)) > 0) {
-        /* Parse comma-separated values */
-        token = strtok(response, ",");
-        while (token && count < max_samples) {
-            if (sscanf(token, "%e", &buffer[count]) == 1) {
-                count++;
-            }
-            token = strtok(NULL, ",");
-        }
-    }
-    
-    return count;
+    gpib_write(address, "READ ALLSTORE");
+    return gpib_read_floats(address, buffer, max_samples);
 }
 
 float read_dm5120_buffered(int address, int slot) {
@@ -3618,98 +4204,64 @@ void dm5120_buffer_example(int address, int slot) {
     
     printf("\nBuffer example complete.\n");
 }
-float read_dm5120_enhanced(int address, int slot) {
-    float value = 0.0;
+/* One reading from a DM5120 slot, with the X/SEND retries.  Returns 1
+ * with the reading in *value, 0 if none came back. */
+int dm5120_get_reading(int address, int slot, float *value) {
     int retry;
+    int timed;
+    unsigned long start_ms;
     dm5120_config *cfg = &g_dm5120_config[slot];
     
-    int srq_status;
+    if (!gpib_health_ok(address)) return 0;  /* Quarantined */
     
-    srq_status = gpib_check_srq(address);
-    if (srq_status & 0x40) {  /* Device requesting service */
-        delay(100);
-    }
-    
-    gpib_write_dm5120(address, "READ ADC");
+    /* Unwaited - the wait below is the only one this reading gets */
+    start_ms = tb_now_ms();
+    gpib_write_nowait(address, "READ ADC");
     
-    /* Use digit-aware timing for voltage measurement */
-    delay(dm5120_calculate_delay(slot, 0, 1));
+    /* Learned cycle time for this configuration, or the rate table */
+    timed = dm5120_wait_reading(address, slot, start_ms);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
-        if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
-            if (cfg->min_max_enabled) {
-                if (value < cfg->min_value) cfg->min_value = value;
-                if (value > cfg->max_value) cfg->max_value = value;
-            }
-            store_module_data(slot, value);
-            return value;
-        }
-        if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
-            if (cfg->min_max_enabled) {
-                if (value < cfg->min_value) cfg->min_value = value;
-                if (value > cfg->max_value) cfg->max_value = value;
-            }
-            store_module_data(slot, value);
-            return value;
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+        if (parse_reading_value(gpib_response_buffer, value)) {
+            return 1;
         }
     }
+    if (!timed) dm5120_timing_miss(slot);
     
     if (cfg->trigger_mode == 0) {  /* CONT mode */
-        gpib_write_dm5120(address, "X");
+        gpib_write(address, "X");
         /* Use digit-aware timing for X command */
         delay(dm5120_calculate_delay(slot, 0, 1));
     } else {
-        gpib_write_dm5120(address, "SEND");
+        gpib_write(address, "SEND");
         /* Use digit-aware timing for SEND command with slight overhead */
         delay(dm5120_calculate_delay(slot, 0, 1) + 50);
     }
     
-    if (gpib_read_float_dm5120(address, &value)) {
-        if (cfg->min_max_enabled) {
-            if (value < cfg->min_value) cfg->min_value = value;
-            if (value > cfg->max_value) cfg->max_value = value;
-        }
-        store_module_data(slot, value);
-        return value;
+    if (gpib_read_float(address, value)) {
+        return 1;
     }
     
-    for (retry = 0; retry < 3; retry++) {
-        
-        
-        gpib_write_dm5120(address, "X");
+    /* Stops as soon as the failures above quarantine the meter */
+    for (retry = 0; retry < 3 && gpib_health_ok(address); retry++) {
+        gpib_write(address, "X");
         delay(300);
         
-        if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
-            if (sscanf(gpib_response_buffer, "NDCV%e", &value) == 1) {
-                store_module_data(slot, value);
-                return value;
-            }
-            if (sscanf(gpib_response_buffer, "DCV%e", &value) == 1) {
-                store_module_data(slot, value);
-                return value;
-            }
-            if (sscanf(gpib_response_buffer, "NACV%e", &value) == 1) {
-                store_module_data(slot, value);
-                return value;
-            }
-            if (sscanf(gpib_response_buffer, "ACV%e", &value) == 1) {
-                store_module_data(slot, value);
-                return value;
-            }
-            if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
-                store_module_data(slot, value);
-                return value;
-            }
-            if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
-                store_module_data(slot, value);
-                return value;
+        if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+            if (parse_reading_value(gpib_response_buffer, value)) {
+                return 1;
             }
         }
         
         delay(100);
     }
     
-    return 0.0;
+    return 0;
+}
+float read_dm5120_enhanced(int address, int slot) {
+    float value;
+    
+    return dm5120_get_reading(address, slot, &value) ? value : 0.0;
 }
 float read_dm5120(int address) {
     int i;
@@ -3722,23 +4274,24 @@ float read_dm5120(int address) {
     }
     return read_dm5120_enhanced(address, 0);
 }
-float read_dm5120_voltage(int address) {
-    
-    float value = 0.0;
-    
-    gpib_check_srq(address);
-    delay(50);
-    
-    gpib_write_dm5120(address, "READ ADC");
+/* Plain READ ADC with a fixed wait - the fallback when the enhanced
+ * read got nothing.  Returns 0 if no reading came back. */
+int dm5120_get_voltage(int address, float *value) {
+    gpib_write(address, "READ ADC");
     delay(300);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
-        if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
-            return value;
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+        if (parse_reading_value(gpib_response_buffer, value)) {
+            return 1;
         }
     }
     
-    return 0.0;
+    return 0;
+}
+float read_dm5120_voltage(int address) {
+    float value;
+    
+    return dm5120_get_voltage(address, &value) ? value : 0.0;
 }
 void dm5120_clear_statistics(int slot) {
     if (slot >= 0 && slot < 10) {
@@ -3762,7 +4315,7 @@ void test_dm5120_comm(int address) {
     printf("Driver status: %s\n", status);
     
     printf("Setting REMOTE mode...\n");
-    gpib_remote_dm5120(address);
+    gpib_remote(address);
     delay(200);
     
     printf("Checking SRQ status...\n");
@@ -3774,28 +4327,29 @@ void test_dm5120_comm(int address) {
     delay(200);
     
     printf("\nSending INIT command...\n");
-    gpib_write_dm5120(address, "INIT");
+    gpib_write(address, "INIT");
+    shadow_forget(address, SH_ALL);
     delay(300);
     
     printf("Setting DCV function...\n");
-    gpib_write_dm5120(address, "FUNCT DCV");
+    gpib_write(address, "FUNCT DCV");
     delay(100);
     
     printf("Setting AUTO range...\n");
-    gpib_write_dm5120(address, "RANGE AUTO");
+    gpib_write(address, "RANGE AUTO");
     delay(100);
     
     printf("Setting data format ON (scientific)...\n");
-    gpib_write_dm5120(address, "DATFOR ON");
+    gpib_write(address, "DATFOR ON");
     delay(100);
     
     printf("\nAttempting measurement reads:\n");
     
     printf("\n1. Using voltage? command:\n");
-    gpib_write_dm5120(address, "READ ADC");
+    gpib_write(address, "READ ADC");
     delay(300);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
         if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
             printf("   Parsed value: %g V\n", value);
@@ -3805,10 +4359,10 @@ void test_dm5120_comm(int address) {
     }
     
     printf("\n2. Simple execute (X command):\n");
-    gpib_write_dm5120(address, "X");
+    gpib_write(address, "X");
     delay(300);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
         if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
             printf("   Parsed value: %g V\n", value);
@@ -3818,10 +4372,10 @@ void test_dm5120_comm(int address) {
     }
     
     printf("\n3. READ? query:\n");
-    gpib_write_dm5120(address, "READ?");
+    gpib_write(address, "READ?");
     delay(300);
     
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     } else {
         printf("   No response\n");
@@ -3829,53 +4383,53 @@ void test_dm5120_comm(int address) {
     
     printf("\nQuerying current settings:\n");
     
-    gpib_write_dm5120(address, "FUNCT?");
+    gpib_write(address, "FUNCT?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
-    gpib_write_dm5120(address, "RANGE?");
+    gpib_write(address, "RANGE?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
     printf("\nTesting enhanced buffer commands:\n");
     
     printf("4. BUFSZ? (Buffer Size Query):\n");
-    gpib_write_dm5120(address, "BUFSZ?");
+    gpib_write(address, "BUFSZ?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
     printf("5. BUFCNT? (Buffer Count Query):\n");
-    gpib_write_dm5120(address, "BUFCNT?");
+    gpib_write(address, "BUFCNT?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
     printf("6. Testing BUFSZ 50 (Set Buffer Size):\n");
-    gpib_write_dm5120(address, "BUFSZ 50");
+    gpib_write(address, "BUFSZ 50");
     delay(100);
-    gpib_write_dm5120(address, "BUFSZ?");
+    gpib_write(address, "BUFSZ?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
     printf("7. STOINT? (Storage Interval Query):\n");
-    gpib_write_dm5120(address, "STOINT?");
+    gpib_write(address, "STOINT?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
-    gpib_write_dm5120(address, "ERROR?");
+    gpib_write(address, "ERROR?");
     delay(50);
-    if (gpib_read_dm5120(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
     }
     
@@ -4014,9 +4568,11 @@ void configure_dm5010_advanced(int slot) {
         printf("9. Beeper Control\n");
         printf("A. Front Panel Lock\n");
         printf("B. Statistics Control\n");
-        printf("C. Apply Settings to DM5010\n");
+        printf("C. Apply Settings to DM5010 (%d changed)\n",
+               shadow_count_fields(shadow_stale_fields(slot)));
         printf("D. Test Communication\n");
         printf("E. Reset to Defaults\n");
+        printf("F. Verify Settings on Instrument\n");
         printf("0. Exit\n\n");
         
         printf("Choice: ");
@@ -4145,22 +4701,7 @@ void configure_dm5010_advanced(int slot) {
                 
             case 'C':
                 printf("\n\nApplying settings to DM5010...\n");
-                gpib_remote(address);
-                delay(200);
-                
-                dm5010_set_function(address, cfg->function);
-                dm5010_set_filter(address, cfg->filter_enabled, cfg->filter_count);
-                dm5010_set_trigger(address, cfg->trigger_mode == 0 ? "IMM" : (cfg->trigger_mode == 1 ? "EXT" : "BUS"));
-                dm5010_set_autozero(address, cfg->auto_zero);
-                dm5010_set_null(address, cfg->null_enabled, cfg->nullval);
-                dm5010_set_calculation(address, cfg->calculation_mode, 
-                                     cfg->calculation_mode == 2 ? cfg->scale_factor : 
-                                     (cfg->calculation_mode == 3 ? cfg->dbm_reference : cfg->dbr_reference),
-                                     cfg->scale_offset);
-                dm5010_beeper(address, cfg->beeper_enabled);
-                dm5010_lock_front_panel(address, cfg->front_panel_lock);
-                
-                printf("Settings applied!\n");
+                printf("Settings applied - %d changed fields sent.\n", dm5010_apply_config(slot));
                 printf("Press any key to continue...");
                 getch();
                 break;
@@ -4176,6 +4717,10 @@ void configure_dm5010_advanced(int slot) {
                 getch();
                 break;
                 
+            case 'F':
+                shadow_verify_dialog(slot);
+                break;
+                
             case '0':
                 done = 1;
                 break;
@@ -4183,145 +4728,129 @@ void configure_dm5010_advanced(int slot) {
     }
 }
 void dm5010_set_function(int address, char *function) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_FUNCTION);
     sprintf(gpib_cmd_buffer, "CONF:%s", function);
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5010_set_range(int address, char *function, float range) {
-    char cmd[100];
+    shadow_forget(address, SH_DM5010_FUNCTION);
     if (range == 0.0) {
         sprintf(gpib_cmd_buffer, "CONF:%s AUTO", function);
     } else {
         sprintf(gpib_cmd_buffer, "CONF:%s %e", function, range);
     }
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5010_set_filter(int address, int enabled, int count) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_FILTER);
     if (enabled) {
         sprintf(gpib_cmd_buffer, "AVER:STAT ON");
-        gpib_write_dm5010(address, cmd);
+        gpib_write(address, gpib_cmd_buffer);
         sprintf(gpib_cmd_buffer, "AVER:COUN %d", count);
-        gpib_write_dm5010(address, cmd);
+        gpib_write(address, gpib_cmd_buffer);
     } else {
         sprintf(gpib_cmd_buffer, "AVER:STAT OFF");
-        gpib_write_dm5010(address, cmd);
+        gpib_write(address, gpib_cmd_buffer);
     }
 }
 void dm5010_set_trigger(int address, char *mode) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_TRIGGER);
     sprintf(gpib_cmd_buffer, "TRIG:SOUR %s", mode);
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5010_set_autozero(int address, int enabled) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_AUTOZERO);
     sprintf(gpib_cmd_buffer, "ZERO:AUTO %s", enabled ? "ON" : "OFF");
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5010_set_null(int address, int enabled, float value) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_NULL);
     if (enabled) {
         sprintf(gpib_cmd_buffer, "CALC:NULL:OFFS %e", value);
-        gpib_write_dm5010(address, cmd);
+        gpib_write(address, gpib_cmd_buffer);
         sprintf(gpib_cmd_buffer, "CALC:NULL:STAT ON");
-        gpib_write_dm5010(address, cmd);
+        gpib_write(address, gpib_cmd_buffer);
     } else {
         sprintf(gpib_cmd_buffer, "CALC:NULL:STAT OFF");
-        gpib_write_dm5010(address, cmd);
+        gpib_write(address, gpib_cmd_buffer);
     }
 }
 void dm5010_set_calculation(int address, int mode, float factor, float offset) {
-    char cmd[100];
+    shadow_forget(address, SH_DM5010_CALC);
     switch(mode) {
         case 1: /* Average */
             sprintf(gpib_cmd_buffer, "CALC:AVER:STAT ON");
             break;
         case 2: /* Scale */
             sprintf(gpib_cmd_buffer, "CALC:SCAL:GAIN %e", factor);
-            gpib_write_dm5010(address, cmd);
+            gpib_write(address, gpib_cmd_buffer);
             sprintf(gpib_cmd_buffer, "CALC:SCAL:OFFS %e", offset);
-            gpib_write_dm5010(address, cmd);
+            gpib_write(address, gpib_cmd_buffer);
             sprintf(gpib_cmd_buffer, "CALC:SCAL:STAT ON");
             break;
         case 3: /* dBm */
             sprintf(gpib_cmd_buffer, "CALC:DBM:REF %e", factor);
-            gpib_write_dm5010(address, cmd);
+            gpib_write(address, gpib_cmd_buffer);
             sprintf(gpib_cmd_buffer, "CALC:DBM:STAT ON");
             break;
         case 4: /* dBr */
             sprintf(gpib_cmd_buffer, "CALC:DB:REF %e", factor);
-            gpib_write_dm5010(address, cmd);
+            gpib_write(address, gpib_cmd_buffer);
             sprintf(gpib_cmd_buffer, "CALC:DB:STAT ON");
             break;
         default:
             sprintf(gpib_cmd_buffer, "CALC:STAT OFF");
             break;
     }
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5010_beeper(int address, int enabled) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_BEEPER);
     sprintf(gpib_cmd_buffer, "SYST:BEEP:STAT %s", enabled ? "ON" : "OFF");
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
 void dm5010_lock_front_panel(int address, int locked) {
-    char cmd[50];
+    shadow_forget(address, SH_DM5010_LOCK);
     sprintf(gpib_cmd_buffer, "SYST:LOCK %s", locked ? "ON" : "OFF");
-    gpib_write_dm5010(address, cmd);
+    gpib_write(address, gpib_cmd_buffer);
 }
-float read_dm5010_enhanced(int address, int slot) {
-    
-    float value = 0.0;
+/* One DM5010 reading, VAL? then READ? up to three times.  Returns 1
+ * with the reading in *value, 0 if none came back. */
+int dm5010_get_reading(int address, int slot, float *value) {
     int attempts = 0;
-    int success = 0;
     
-    gpib_check_srq(address);
-    delay(50);
-    
-    while (attempts < 3 && !success) {
+    while (attempts < 3 && gpib_health_ok(address)) {
         attempts++;
         
-        gpib_write_dm5010(address, "VAL?");
+        gpib_write(address, "VAL?");
         delay(100);
         
-        if (gpib_read_dm5010(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
-            if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
-                success = 1;
-                break;
+        if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+            if (parse_reading_value(gpib_response_buffer, value)) {
+                return 1;
             }
         }
         
-        if (!success) {
-            gpib_write_dm5010(address, "READ?");
-            delay(150);
-            
-            if (gpib_read_dm5010(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
-                if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
-                    success = 1;
-                    break;
-                }
+        gpib_write(address, "READ?");
+        delay(150);
+        
+        if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+            if (parse_reading_value(gpib_response_buffer, value)) {
+                return 1;
             }
         }
         
-        if (!success) {
+        if (gpib_health_ok(address)) {
             delay(200);
         }
     }
     
-    if (success && slot >= 0 && slot < 10) {
-        store_module_data(slot, value);
-        
-        if (g_dm5010_config[slot].statistics_enabled) {
-            if (value < g_dm5010_config[slot].min_value) {
-                g_dm5010_config[slot].min_value = value;
-            }
-            if (value > g_dm5010_config[slot].max_value) {
-                g_dm5010_config[slot].max_value = value;
-            }
-        }
-    }
+    return 0;
+}
+float read_dm5010_enhanced(int address, int slot) {
+    float value;
     
-    return value;
+    return dm5010_get_reading(address, slot, &value) ? value : 0.0;
 }
 void test_dm5010_comm(int address) {
     
@@ -4333,9 +4862,9 @@ void test_dm5010_comm(int address) {
     printf("Testing DM5010 at GPIB address %d\n\n", address);
     
     printf("1. Testing identification...\n");
-    gpib_write_dm5010(address, "*IDN?");
+    gpib_write(address, "*IDN?");
     delay(100);
-    if (gpib_read_dm5010(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
         success_count++;
     } else {
@@ -4344,20 +4873,21 @@ void test_dm5010_comm(int address) {
     test_count++;
     
     printf("2. Testing reset...\n");
-    gpib_write_dm5010(address, "*RST");
+    gpib_write(address, "*RST");
+    shadow_forget(address, SH_ALL);
     delay(500);
-    gpib_write_dm5010(address, "CONF:VOLT:DC");
+    gpib_write(address, "CONF:VOLT:DC");
     delay(100);
     printf("   Reset and configured for DC voltage\n");
     success_count++;
     test_count++;
     
     printf("3. Testing function configuration...\n");
-    gpib_write_dm5010(address, "CONF:VOLT:DC AUTO,MAX");
+    gpib_write(address, "CONF:VOLT:DC AUTO,MAX");
     delay(100);
-    gpib_write_dm5010(address, "FUNC?");
+    gpib_write(address, "FUNC?");
     delay(100);
-    if (gpib_read_dm5010(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
         success_count++;
     } else {
@@ -4366,9 +4896,9 @@ void test_dm5010_comm(int address) {
     test_count++;
     
     printf("4. Testing measurement...\n");
-    gpib_write_dm5010(address, "READ?");
+    gpib_write(address, "READ?");
     delay(200);
-    if (gpib_read_dm5010(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
             printf("   Measurement: %.6e V\n", value);
             success_count++;
@@ -4381,9 +4911,9 @@ void test_dm5010_comm(int address) {
     test_count++;
     
     printf("5. Testing status...\n");
-    gpib_write_dm5010(address, "*STB?");
+    gpib_write(address, "*STB?");
     delay(100);
-    if (gpib_read_dm5010(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
+    if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
         printf("   %s\n", gpib_response_buffer);
         success_count++;
     } else {
@@ -4413,6 +4943,7 @@ void init_ps5004_config(int slot) {
     g_ps5004_config[slot].current_limit = 0.1;  /* 100mA default */
     g_ps5004_config[slot].output_enabled = 0;   /* OFF */
     g_ps5004_config[slot].display_mode = 0;     /* Voltage */
+    g_ps5004_config[slot].log_both = 0;
     g_ps5004_config[slot].vri_enabled = 0;      /* OFF */
     g_ps5004_config[slot].cri_enabled = 0;      /* OFF */
     g_ps5004_config[slot].uri_enabled = 0;      /* OFF */
@@ -4606,38 +5137,74 @@ void configure_ps5004_advanced(int slot) {
 #endif
 void ps5004_init(int address) {
     gpib_write(address, "INIT");
+    shadow_forget(address, SH_ALL);
     delay(100);
 }
 void ps5004_set_voltage(int address, float voltage) {
     char cmd[50];
+    shadow_forget(address, SH_PS5004_VOLTAGE);
     if (voltage < 0.0) voltage = 0.0;
     if (voltage > 20.0) voltage = 20.0;
     sprintf(gpib_cmd_buffer, "VOLTAGE %.4f", voltage);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 void ps5004_set_current(int address, float current) {
     char cmd[50];
+    shadow_forget(address, SH_PS5004_CURRENT);
     if (current < 0.01) current = 0.01;    /* 10mA minimum */
     if (current > 0.305) current = 0.305;  /* 305mA maximum */
     sprintf(gpib_cmd_buffer, "CURRENT %.3f", current);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 void ps5004_set_output(int address, int on) {
+    shadow_forget(address, SH_PS5004_OUTPUT);
     if (on) {
         gpib_write(address, "OUTPUT ON");
     } else {
         gpib_write(address, "OUTPUT OFF");
     }
-    delay(50);
 }
 void ps5004_set_display(int address, char *mode) {
     char cmd[50];
+    shadow_forget(address, SH_PS5004_DISPLAY);
     sprintf(gpib_cmd_buffer, "DISPLAY %s", mode);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
+/* Display mode the instrument is known to be in, -1 if unknown */
+int ps5004_shown(int slot) {
+    module_shadow *sh = shadow_for(slot);
+    
+    if (!(sh->known & SH_PS5004_DISPLAY)) return -1;
+    return sh->cfg.ps5004.display_mode;
+}
+
+/* Put the display - and with it what SEND reads back - on mode
+ * (0=voltage, 1=current, 2=current limit).  Nothing is sent when the
+ * shadow says it is there already.  Returns 1 if the display changed,
+ * -1 if DISPLAY failed and the display is unknown. */
+int ps5004_show(int slot, int mode) {
+    module_shadow *sh;
+    int address = g_system->modules[slot].gpib_address;
+    unsigned int failures;
+    
+    if (ps5004_shown(slot) == mode) return 0;
+    
+    failures = gpib_failures(address);
+    ps5004_set_display(address, mode == 1 ? "CURRENT" : (mode == 2 ? "CLIMIT" : "VOLTAGE"));
+    delay(50);      /* Readback follows the display after a settle */
+    
+    /* set_display forgot the display - it stays unknown, and the next
+     * show sends it again, unless DISPLAY went through */
+    if (gpib_failures(address) != failures) return -1;
+    
+    /* What the monitor switched to is now what the instrument shows;
+     * the next apply puts the configured mode back if they differ */
+    sh = shadow_for(slot);
+    sh->cfg.ps5004.display_mode = mode;
+    sh->known |= SH_PS5004_DISPLAY;
+    return 1;
+}
+
 int ps5004_get_regulation_status(int address) {
     
     int status = 0;
@@ -4654,23 +5221,27 @@ int ps5004_get_regulation_status(int address) {
     
     return status;
 }
-float ps5004_read_value(int address) {
-    
-    float value = 0.0;
-    
+/* What the display shows, read back with SEND.  Returns 0 if nothing
+ * readable came back. */
+int ps5004_get_value(int address, float *value) {
     gpib_write(address, "SEND");
     delay(100);
     
     if (gpib_read(address, gpib_response_buffer, sizeof(gpib_response_buffer)) > 0) {
-        if (sscanf(gpib_response_buffer, "%e", &value) == 1) {
-            return value;
+        if (sscanf(gpib_response_buffer, "%e", value) == 1) {
+            return 1;
         }
-        if (sscanf(gpib_response_buffer, "%f", &value) == 1) {
-            return value;
+        if (sscanf(gpib_response_buffer, "%f", value) == 1) {
+            return 1;
         }
     }
     
-    return 0.0;
+    return 0;
+}
+float ps5004_read_value(int address) {
+    float value;
+    
+    return ps5004_get_value(address, &value) ? value : 0.0;
 }
 void test_ps5004_comm(int address) {
     
@@ -4998,6 +5569,7 @@ void configure_ps5010_advanced(int slot) {
 #endif
 void ps5010_init(int address) {
     gpib_write(address, "INIT");
+    shadow_forget(address, SH_ALL);
     delay(500);  /* PS5010 needs time for reset */
 }
 void ps5010_set_voltage(int address, int channel, float voltage) {
@@ -5023,8 +5595,8 @@ void ps5010_set_voltage(int address, int channel, float voltage) {
             return;  /* Invalid channel */
     }
     
+    shadow_forget(address, SH_PS5010_VOLTAGE1 << (channel - 1));
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 void ps5010_set_current(int address, int channel, float current) {
     char cmd[50];
@@ -5049,8 +5621,8 @@ void ps5010_set_current(int address, int channel, float current) {
             return;
     }
     
+    shadow_forget(address, SH_PS5010_CURRENT1 << (channel - 1));
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 void ps5010_set_output(int address, int channel, int on) {
     char cmd[50];
@@ -5069,8 +5641,9 @@ void ps5010_set_output(int address, int channel, int on) {
             return;
     }
     
+    shadow_forget(address, channel ? SH_PS5010_OUTPUT1 << (channel - 1) :
+                  (SH_PS5010_OUTPUT1 | SH_PS5010_OUTPUT1 << 1 | SH_PS5010_OUTPUT1 << 2));
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 void ps5010_set_tracking_voltage(int address, float voltage) {
     char cmd[50];
@@ -5080,7 +5653,6 @@ void ps5010_set_tracking_voltage(int address, float voltage) {
     
     sprintf(gpib_cmd_buffer, "VTRA %.1f", voltage);
     gpib_write(address, gpib_cmd_buffer);
-    delay(50);
 }
 int ps5010_read_regulation(int address, int *neg_stat, int *pos_stat, int *log_stat) {
     
@@ -5120,15 +5692,11 @@ int ps5010_get_error(int address) {
 }
 void ps5010_set_interrupts(int address, int pri_on, int nri_on, int lri_on) {
     gpib_write(address, pri_on ? "PRI ON" : "PRI OFF");
-    delay(50);
     gpib_write(address, nri_on ? "NRI ON" : "NRI OFF");
-    delay(50);
     gpib_write(address, lri_on ? "LRI ON" : "LRI OFF");
-    delay(50);
 }
 void ps5010_set_srq(int address, int on) {
     gpib_write(address, on ? "RQS ON" : "RQS OFF");
-    delay(50);
 }
 float read_ps5010(int address, int slot) {
     ps5010_config *cfg = &g_ps5010_config[slot];
@@ -5274,11 +5842,13 @@ void single_measurement(void) {
             case MOD_DC5009:
             case MOD_DC5010:
                 gpib_write(addr, "INIT");
+                shadow_forget(addr, SH_ALL);
                 break;
                 
             case MOD_DM5010:
             case MOD_DM5120:
                 gpib_write(addr, "INIT");
+                shadow_forget(addr, SH_ALL);
                 break;
                 
             case MOD_PS5004:
@@ -5320,20 +5890,27 @@ void single_measurement(void) {
                 
             case MOD_DM5010:
                 /* Enhanced multimeter reading */
-                value = read_dm5010_enhanced(g_system->modules[slot].gpib_address, slot);
+                if (!dm5010_get_reading(g_system->modules[slot].gpib_address, slot, &value)) {
+                    printf("Read failed\n");
+                    ingest_failed(slot);
+                    break;
+                }
                 printf("%.6g V\n", value);
                 g_system->modules[slot].last_reading = value;
+                ingest_sample(slot, value, session_time_ms());
                 break;
                 
             case MOD_DM5120:
                 /* Enhanced multimeter with fallback */
-                value = read_dm5120_enhanced(g_system->modules[slot].gpib_address, slot);
-                if (value == 0.0) {
-                    /* Fallback method */
-                    value = read_dm5120_voltage(g_system->modules[slot].gpib_address);
+                if (!dm5120_get_reading(g_system->modules[slot].gpib_address, slot, &value) &&
+                    !dm5120_get_voltage(g_system->modules[slot].gpib_address, &value)) {
+                    printf("Read failed\n");
+                    ingest_failed(slot);
+                    break;
                 }
                 printf("%.6g V\n", value);
                 g_system->modules[slot].last_reading = value;
+                ingest_sample(slot, value, session_time_ms());
                 break;
                 
             case MOD_PS5010:
@@ -5389,24 +5966,709 @@ void single_measurement(void) {
     printf("\nPress any key to continue...");
     getch();
 }
-void continuous_monitor(void) {
-    int i, done = 0;
-    float value;
-    time_t start_time = time(NULL);
-    time_t current_time;
-    unsigned long last_tick_count = 0;
-    unsigned long current_tick_count;
-    unsigned long tick_start, tick_end;
-    unsigned long ticks_per_sample;
-    unsigned long measurement_ticks = 0;
-    ps5004_config *ps_cfg;
+/* Status screen refresh - acquisition never waits on the display */
+#define MONITOR_REFRESH_MS    250     /* 4 Hz */
+#define MONITOR_FULL_REDRAW   20      /* Rewrite every field each 5 s */
+#define MONITOR_STATUS_ROW    5
+#define MONITOR_FIRST_ROW     7
+
+/* What a slot's last sample showed - set by monitor_acquire, turned into
+ * text only when the screen is refreshed */
+#define MON_NONE        0     /* Nothing sampled yet - last reading */
+#define MON_FREQ        1     /* Counter, value in Hz */
+#define MON_VOLTS       2
+#define MON_DM5120      3     /* Voltage with reading rate */
+#define MON_BUF_START   4
+#define MON_BUF_FILL    5     /* aux = samples ready */
+#define MON_BUF_HALF    6     /* aux = samples ready */
+#define MON_BUF_AVG     7     /* aux = buffer size */
+#define MON_BUF_IDLE    8
+#define MON_MILLIAMPS   9
+#define MON_PS5010      10    /* aux = pos | neg << 2 | log << 4 */
+#define MON_NO_STATUS   11
+#define MON_NOT_IMPL    12
+#define MON_STREAM      13    /* Streaming DM5120, aux = buffer overruns */
+#define MON_REDUCED     14    /* Block reduced on the meter, aux = readings */
+#define MON_REDUCING    15    /* Block collecting, aux = readings so far */
+#define MON_VOLT_AMP    16    /* PS5004 voltage, second = current */
+#define MON_FREQ_AB     17    /* DC5010 channel A, second = channel B */
+#define MON_READ_FAILED 18    /* No reading - counted as dropped, not stored */
+
+typedef struct {
+    float value;
+    float rate;                   /* DM5120 readings per second */
+    float second;                 /* PS5004 current or DC5010 channel B */
+    int aux;
+    unsigned char kind;
+    unsigned char fast:1;         /* Requested period below conversion time */
+    unsigned char reserved:7;
+} monitor_field;
+
+static monitor_field g_monitor_field[10];
+
+/* Channels a slot fills per sample in its monitor mode - the first is
+ * module_data.  The reduced readings take their unit from the meter's
+ * function; the DM5010 averages on the meter and has no extremes. */
+static const channel_def reduce_channels[] = {
+    { "MEAN", UNIT_VOLTAGE }, { "MIN", UNIT_VOLTAGE }, { "MAX", UNIT_VOLTAGE },
+    { "COUNT", UNIT_COUNT }
+};
+static const channel_def average_channels[] = {
+    { "MEAN", UNIT_VOLTAGE }, { "COUNT", UNIT_COUNT }
+};
+static const channel_def ps5004_channels[] = {
+    { "V", UNIT_VOLTAGE }, { "I", UNIT_CURRENT }
+};
+static const channel_def ps5010_channels[] = {
+    { "POS", UNIT_STATE }, { "NEG", UNIT_STATE }, { "LOG", UNIT_STATE }
+};
+static const channel_def dc5010_channels[] = {
+    { "A", UNIT_FREQUENCY }, { "B", UNIT_FREQUENCY }
+};
+#define NUM_CHANNELS(defs) ((int)(sizeof(defs) / sizeof(defs[0])))
+
+/* Unit of a DM5120 or DM5010 reading in the slot's configured function */
+static unsigned char meter_unit(int i) {
+    char *function = g_system->modules[i].module_type == MOD_DM5120 ?
+                     g_dm5120_config[i].function : g_dm5010_config[i].function;
+    
+    if (strstr(function, "DB")) return UNIT_DB;
+    if (strstr(function, "OHMS")) return UNIT_RESISTANCE;
+    if (strcmp(function, "DCA") == 0 || strcmp(function, "ACA") == 0 ||
+        strcmp(function, "DCI") == 0 || strcmp(function, "ACI") == 0) {
+        return UNIT_CURRENT;
+    }
+    return UNIT_VOLTAGE;
+}
+
+/* Reduced readings in the meter's unit, the count as it is */
+static void monitor_define_reduce(int i) {
+    channel_def defs[NUM_CHANNELS(reduce_channels)];
+    const channel_def *layout = reduce_channels;
+    int count = NUM_CHANNELS(reduce_channels);
+    int c;
+    
+    if (g_system->modules[i].module_type == MOD_DM5010) {
+        layout = average_channels;
+        count = NUM_CHANNELS(average_channels);
+    }
+    for (c = 0; c < count; c++) {
+        defs[c] = layout[c];
+        if (defs[c].unit_type != UNIT_COUNT) defs[c].unit_type = meter_unit(i);
+    }
+    define_slot_channels(i, defs, count);
+}
+
+/* Lay out slot i's channels for this run - called on a cleared buffer */
+static void monitor_define_channels(int i) {
+    switch (g_system->modules[i].module_type) {
+        case MOD_DM5120:
+        case MOD_DM5010:
+            if (reduce_enabled(i)) {
+                monitor_define_reduce(i);
+                return;
+            }
+            break;
+        case MOD_PS5004:
+            if (g_ps5004_config[i].log_both) {
+                define_slot_channels(i, ps5004_channels, NUM_CHANNELS(ps5004_channels));
+                return;
+            }
+            break;
+        case MOD_PS5010:
+            define_slot_channels(i, ps5010_channels, NUM_CHANNELS(ps5010_channels));
+            return;
+        case MOD_DC5010:
+            if (dc5010_logs_both(i)) {
+                define_slot_channels(i, dc5010_channels, NUM_CHANNELS(dc5010_channels));
+                return;
+            }
+            break;
+    }
+    define_slot_channels(i, NULL, 1);
+}
+
+/* Reduction slot - nothing crosses the bus until the meter has the
+ * whole block */
+static float monitor_reduce(int i, monitor_field *f) {
+    reduce_block block;
+    
+    f->fast = 0;
+    if (reduce_service(i, &block)) {
+        f->kind = MON_REDUCED;
+        f->aux = block.count;
+        f->value = block.mean;
+        if (block.has_extremes) {
+            channel_put(i, 1, block.min);
+            channel_put(i, 2, block.max);
+            channel_put(i, 3, (float)block.count);
+        } else {
+            channel_put(i, 1, (float)block.count);
+        }
+    } else {
+        f->kind = MON_REDUCING;
+        f->aux = reduce_progress(i);
+        f->value = g_system->modules[i].last_reading;
+    }
+    return f->value;
+}
+
+/* PS5004 - the display selects what SEND reads back.  A slot logging
+ * both quantities reads the one already on the display first, so each
+ * sample costs one display change instead of two. */
+static float monitor_ps5004(int i, monitor_field *f) {
+    ps5004_config *cfg = &g_ps5004_config[i];
+    int address = g_system->modules[i].gpib_address;
+    float volts, amps;
+    int ok;
+    
+    if (!cfg->log_both) {
+        f->kind = cfg->display_mode == 1 ? MON_MILLIAMPS : MON_VOLTS;
+        if (ps5004_show(i, cfg->display_mode == 1 ? 1 : 0) < 0 ||
+            !ps5004_get_value(address, &volts)) {
+            f->kind = MON_READ_FAILED;
+            return 0.0;
+        }
+        return volts;
+    }
+    
+    /* A display that did not switch would read one quantity as the other */
+    if (ps5004_shown(i) == 1) {
+        ok = ps5004_get_value(address, &amps) &&
+             ps5004_show(i, 0) >= 0 && ps5004_get_value(address, &volts);
+    } else {
+        ok = ps5004_show(i, 0) >= 0 && ps5004_get_value(address, &volts) &&
+             ps5004_show(i, 1) >= 0 && ps5004_get_value(address, &amps);
+    }
+    if (!ok) {
+        f->kind = MON_READ_FAILED;
+        return 0.0;
+    }
+    f->kind = MON_VOLT_AMP;
+    f->second = amps;
+    channel_put(i, 1, amps);
+    return volts;
+}
+
+static int monitor_counter_send(int address, float *value) {
+    gpib_write(address, "SEND");
+    return gpib_read_float(address, value);
+}
+
+/* DC5010 logging both inputs - same order trick as the PS5004: the
+ * input already selected is read first, then the other one */
+static float monitor_dc5010(int i, monitor_field *f) {
+    int address = g_system->modules[i].gpib_address;
+    char *shown = dc5010_selected(i);
+    float a, b;
+    int ok;
+    
+    /* An input that did not switch would swap the A and B columns */
+    if (shown && strcmp(shown, "B") == 0) {
+        ok = monitor_counter_send(address, &b) &&
+             dc5010_select(i, "A") >= 0 && monitor_counter_send(address, &a);
+    } else {
+        ok = dc5010_select(i, "A") >= 0 && monitor_counter_send(address, &a) &&
+             dc5010_select(i, "B") >= 0 && monitor_counter_send(address, &b);
+    }
+    if (!ok) {
+        f->kind = MON_READ_FAILED;
+        return 0.0;
+    }
+    f->kind = MON_FREQ_AB;
+    f->second = b;
+    channel_put(i, 1, b);
+    return a;
+}
+
+/* Take one sample from slot i.  Only records what to show in *f. */
+static float monitor_acquire(int i, monitor_field *f) {
+    float value;
+    
+    if (reduce_enabled(i)) return monitor_reduce(i, f);
+    
+    f->fast = 0;
+    switch(g_system->modules[i].module_type) {
+        case MOD_DC5009:
+        case MOD_DC5010:
+            if (dc5010_logs_both(i)) {
+                value = monitor_dc5010(i, f);
+                break;
+            }
+            value = dc5009_read_measurement(g_system->modules[i].gpib_address);
+            f->kind = MON_FREQ;
+            break;
+            
+        case MOD_DM5010:
+            f->kind = MON_VOLTS;
+            if (!dm5010_get_reading(g_system->modules[i].gpib_address, i, &value)) {
+                f->kind = MON_READ_FAILED;
+                value = 0.0;
+            }
+            break;
+            
+        case MOD_DM5120:
+            /* Enhanced DM5120 measurement with async buffer support */
+            {
+                dm5120_config *cfg = &g_dm5120_config[i];
+                int address = g_system->modules[i].gpib_address;
+                int optimal_delay;
+                
+                if (cfg->buffer_enabled && cfg->buffer_size > 1) {
+                    /* Async buffer operation */
+                    int state = cfg->buffer_state;
+                    
+                    /* Start buffer if idle */
+                    if (state == 0) {
+                        dm5120_start_buffer_async(address, i);
+                        f->kind = MON_BUF_START;
+                        value = g_system->modules[i].last_reading; /* Show last value */
+                        break;
+                    }
+                    
+                    /* Check for events if filling */
+                    if (state == 1 || state == 2) {
+                        dm5120_check_buffer_async(address, i);
+                        state = cfg->buffer_state;
+                    }
+                    
+                    switch(state) {
+                        case 1: /* Filling */
+                            f->kind = MON_BUF_FILL;
+                            f->aux = cfg->samples_ready;
+                            value = g_system->modules[i].last_reading;
+                            break;
+                            
+                        case 2: /* Half full */
+                            f->kind = MON_BUF_HALF;
+                            f->aux = cfg->samples_ready;
+                            value = g_system->modules[i].last_reading;
+                            break;
+                            
+                        case 3: /* Full */
+                            /* Read buffer average and reset */
+                            value = dm5120_get_buffer_average(address);
+                            if (value == 0.0) {
+                                /* Fallback to reading buffer count and single value */
+                                int count = dm5120_get_buffer_count(address);
+                                if (count > 0) {
+                                    value = dm5120_read_one_stored(address);
+                                }
+                            }
+                            f->kind = MON_BUF_AVG;
+                            f->aux = cfg->buffer_size;
+                            
+                            /* Reset for next cycle */
+                            dm5120_reset_buffer_async(i);
+                            break;
+                            
+                        default:
+                            f->kind = MON_BUF_IDLE;
+                            value = g_system->modules[i].last_reading;
+                            break;
+                    }
+                    
+                } else {
+                    /* Single measurement mode (non-buffered) */
+                    if (!dm5120_get_reading(address, i, &value) &&
+                        (!gpib_health_ok(address) || !dm5120_get_voltage(address, &value))) {
+                        f->kind = MON_READ_FAILED;
+                        value = 0.0;
+                        break;
+                    }
+                    f->kind = MON_DM5120;
+                    f->rate = dm5120_get_measurement_rate(i, cfg->trigger_mode);
+                    
+                    /* Check for timing conflicts */
+                    optimal_delay = dm5120_calculate_measurement_time(i, 0, 1);
+                    if (sched_get(i)->requested_ms < (unsigned int)optimal_delay) {
+                        f->fast = 1;
+                    }
+                }
+            }
+            break;
+            
+        case MOD_PS5004:
+            value = monitor_ps5004(i, f);
+            break;
+            
+        case MOD_PS5010:  
+            /* One REG? gives all three outputs - positive is the sample,
+             * negative and logic its other channels */
+            {
+                int neg_stat, pos_stat, log_stat;
+                
+                if (ps5010_read_regulation(g_system->modules[i].gpib_address,
+                                          &neg_stat, &pos_stat, &log_stat)) {
+                    f->kind = MON_PS5010;
+                    f->aux = (pos_stat & 3) | ((neg_stat & 3) << 2) | ((log_stat & 3) << 4);
+                    value = (float)pos_stat;
+                    channel_put(i, 1, (float)neg_stat);
+                    channel_put(i, 2, (float)log_stat);
+                } else {
+                    f->kind = MON_NO_STATUS;
+                    value = 0.0;
+                }
+            }
+            break;
+            
+        default:
+            value = 0.0;
+            f->kind = MON_NOT_IMPL;
+    } 
+    
+    f->value = value;
+    return value;
+}
+
+/* Screen field and statistics for a reading collected by the pipeline */
+static void monitor_pipelined_field(int i, float value, monitor_field *f) {
+    dm5120_config *cfg;
+    
+    f->value = value;
+    f->fast = 0;
+    switch(g_system->modules[i].module_type) {
+        case MOD_DM5120:
+            cfg = &g_dm5120_config[i];
+            f->kind = MON_DM5120;
+            f->rate = dm5120_get_measurement_rate(i, cfg->trigger_mode);
+            if (sched_get(i)->requested_ms < (unsigned int)dm5120_calculate_measurement_time(i, 0, 1)) {
+                f->fast = 1;
+            }
+            break;
+            
+        case MOD_DM5010:
+            f->kind = MON_VOLTS;
+            break;
+            
+        default:
+            f->kind = MON_FREQ;
+            break;
+    }
+}
+
+/* Hand one sample of slot i taken at session time time_ms to the ingest */
+static void monitor_store(int i, float value, unsigned long time_ms, int primary_slot) {
+    g_system->modules[i].last_reading = value;
+    if (ingest_sample(i, value, time_ms) != INGEST_ACCEPTED) return;
+    
+    /* The first selected slot paces the shared data buffer */
+    if (i == primary_slot && g_system->data_count < g_system->buffer_size) {
+        g_system->data_buffer[g_system->data_count] = value;
+        g_system->data_count++;
+    }
+}
+
+/* Streaming DM5120 - runs beside the scheduler and stores every reading
+ * itself whenever its buffer is half full */
+static void monitor_stream(int i) {
+    dm5120_config *cfg = &g_dm5120_config[i];
+    monitor_field *f = &g_monitor_field[i];
+    
+    dm5120_stream_service(g_system->modules[i].gpib_address, i);
+    
+    f->kind = MON_STREAM;
+    f->value = g_system->modules[i].last_reading;
+    f->rate = cfg->stream_interval_ms ? 1000.0 / cfg->stream_interval_ms : 0.0;
+    f->aux = cfg->stream_overruns;
+    f->fast = 0;
+}
+
+/* Pause, clear and exit leave no meter storing on its own */
+static void monitor_stop_streams(void) {
+    int i;
+    
+    for (i = 0; i < 10; i++) {
+        if (g_system->modules[i].module_type == MOD_DM5120 && g_dm5120_config[i].streaming) {
+            dm5120_stream_stop(g_system->modules[i].gpib_address, i);
+        }
+        /* A PS5004 logging both goes back to the display it was set to,
+         * a DC5010 to its configured input */
+        if (g_system->modules[i].enabled && g_system->modules[i].module_type == MOD_PS5004 &&
+            g_ps5004_config[i].log_both && gpib_health_ok(g_system->modules[i].gpib_address)) {
+            ps5004_show(i, g_ps5004_config[i].display_mode);
+        }
+        if (g_system->modules[i].enabled && dc5010_logs_both(i) &&
+            gpib_health_ok(g_system->modules[i].gpib_address)) {
+            dc5010_select(i, g_dc5010_config[i].channel);
+        }
+    }
+    reduce_stop_all();
+}
+
+/* Serial path - write, wait and read one slot */
+static void monitor_sample_serial(int i, int primary_slot) {
+    unsigned long start_ms = tb_now_ms();
+    unsigned long time_ms = session_time_ms();
+    float value;
+    
+    value = monitor_acquire(i, &g_monitor_field[i]);
+    
+    /* A buffer still filling only shows its last value - nothing new to store */
+    switch (g_monitor_field[i].kind) {
+        case MON_BUF_START:
+        case MON_BUF_FILL:
+        case MON_BUF_HALF:
+        case MON_BUF_IDLE:
+        case MON_REDUCING:
+            break;
+        case MON_NO_STATUS:
+        case MON_READ_FAILED:
+            ingest_failed(i);
+            break;
+        case MON_REDUCED:
+            /* Stamped at the middle of the block it stands for */
+            monitor_store(i, value, reduce_last(i)->time_ms, primary_slot);
+            break;
+        default:
+            monitor_store(i, value, time_ms, primary_slot);
+            break;
+    }
+    sched_mark_sampled(i, start_ms, tb_now_ms());
+}
+
+static const char *regulation_name(int status) {
+    return status == 1 ? "CV" : (status == 2 ? "CC" : "UR");
+}
+
+/* Readout column for slot i */
+static void monitor_format_readout(int i, monitor_field *f, char *out) {
+    dm5120_config *cfg = &g_dm5120_config[i];
+    
+    /* A running DM5120 buffer shows its progress between samples */
+    if (g_system->modules[i].module_type == MOD_DM5120 && !cfg->stream_mode &&
+        cfg->buffer_enabled && cfg->buffer_state != 0 && f->kind != MON_BUF_AVG) {
+        switch(cfg->buffer_state) {
+            case 1: sprintf(out, "[Filling %3d]       ", cfg->samples_ready); return;
+            case 2: sprintf(out, "[50%% Full]         "); return;
+            case 3: sprintf(out, "[Ready to read]    "); return;
+        }
+    }
+    
+    switch(f->kind) {
+        case MON_FREQ:
+            sprintf(out, "%12.6f MHz   ", f->value / 1e6);
+            break;
+        case MON_VOLTS:
+            sprintf(out, "%12.4f V     ", f->value);
+            break;
+        case MON_DM5120:
+            sprintf(out, "%12.6f V (%4.1f r/s)%s", f->value, f->rate, f->fast ? " [FAST]" : "");
+            break;
+        case MON_STREAM:
+            sprintf(out, "%12.6f V [Stream %5.1f r/s]%s", f->value, f->rate,
+                    f->aux ? " [OVR]" : "");
+            break;
+        case MON_BUF_START:
+            sprintf(out, "[Starting buffer]     ");
+            break;
+        case MON_BUF_FILL:
+            sprintf(out, "[Filling %3d samples] ", f->aux);
+            break;
+        case MON_BUF_HALF:
+            sprintf(out, "[50%% Full - %3d smp] ", f->aux);
+            break;
+        case MON_BUF_AVG:
+            sprintf(out, "%12.6f V [Avg%3d]", f->value, f->aux);
+            break;
+        case MON_BUF_IDLE:
+            sprintf(out, "[Buffer idle]         ");
+            break;
+        case MON_REDUCED:
+            if (reduce_last(i)->has_extremes) {
+                sprintf(out, "%12.6f V [%.4g..%.4g]", f->value,
+                        reduce_last(i)->min, reduce_last(i)->max);
+            } else {
+                sprintf(out, "%12.6f V [Avg%3d]", f->value, f->aux);
+            }
+            break;
+        case MON_REDUCING:
+            if (reduce_last(i)) {
+                sprintf(out, "%12.6f V [%3d/%3u]", f->value, f->aux, g_reduce_count[i]);
+            } else {
+                sprintf(out, "[Reducing %3d/%3u]    ", f->aux, g_reduce_count[i]);
+            }
+            break;
+        case MON_MILLIAMPS:
+            sprintf(out, "%12.1f mA    ", f->value * 1000);
+            break;
+        case MON_VOLT_AMP:
+            sprintf(out, "%10.4f V %8.1f mA ", f->value, f->second * 1000);
+            break;
+        case MON_FREQ_AB:
+            sprintf(out, "A%11.6f B%11.6f MHz", f->value / 1e6, f->second / 1e6);
+            break;
+        case MON_PS5010:
+            sprintf(out, "P:%s N:%s L:%s     ", regulation_name(f->aux & 3),
+                    regulation_name((f->aux >> 2) & 3), regulation_name((f->aux >> 4) & 3));
+            break;
+        case MON_NO_STATUS:
+            sprintf(out, "No status         ");
+            break;
+        case MON_READ_FAILED:
+            sprintf(out, "Read failed       ");
+            break;
+        case MON_NOT_IMPL:
+            sprintf(out, "Not implemented       ");
+            break;
+        default:
+            sprintf(out, "%12.6f       ", g_system->modules[i].last_reading);
+            break;
+    }
+}
+
+/* Presentation step - status line and one row per slot, written to text
+ * video memory through the shadow so unchanged fields cost nothing */
+static void monitor_draw(time_t start_time) {
+    char line[96];
+    char readout[48];
     char type_str[20];
+    unsigned long now_ms = tb_now_ms();
+    int i, len;
+    int row = MONITOR_FIRST_ROW;
+    int should_monitor;
+    
+    len = sprintf(line, "Time: %ld s  Samples: %u  %-7s  %s",
+                  time(NULL) - start_time,
+                  g_system->data_count,
+                  g_control_panel.running ? "RUNNING" : "STOPPED",
+                  g_acquire_mode == ACQ_MODE_SYNC ? "SYNC" :
+                  (g_acquire_mode == ACQ_MODE_PIPELINED ? "PIPE" : "SER"));
+    if (g_acquire_mode != ACQ_MODE_SERIAL && acquire_get_stats()->cycles > 0) {
+        len += sprintf(line + len, " %ums/%d", acquire_get_stats()->last_ms,
+                       acquire_get_stats()->last_slots);
+        if (g_acquire_mode == ACQ_MODE_SYNC) {
+            len += sprintf(line + len, " skew %ums", acquire_get_stats()->last_skew_ms);
+        }
+    }
+    if (spill_active()) {
+        sprintf(line + len, "  %s %luK", spill_file_name(), spill_bytes_written() / 1024);
+    } else if (spill_errors()) {
+        sprintf(line + len, "  DISK WRITE FAILED");
+    }
+    text_put_diff(1, MONITOR_STATUS_ROW, line, 80);
+    
+    for (i = 0; i < 10; i++) {
+        /* Skip ghost/phantom modules - must have valid type, address, and description */
+        if (!g_system->modules[i].enabled ||
+            g_system->modules[i].module_type == MOD_NONE ||
+            g_system->modules[i].gpib_address < 1 ||
+            g_system->modules[i].gpib_address > 30 ||
+            strlen(g_system->modules[i].description) == 0) {
+            continue;
+        }
+        
+        should_monitor = g_control_panel.monitor_all || 
+                        (g_control_panel.monitor_mask & (1 << i));
+        if (!should_monitor && g_control_panel.running) {
+            continue;
+        }
+        
+        /* Module type display */
+        switch(g_system->modules[i].module_type) {
+            case MOD_DC5009: strcpy(type_str, "DC5009"); break;
+            case MOD_DM5010: strcpy(type_str, "DM5010"); break;
+            case MOD_DM5120: 
+                strcpy(type_str, "DM5120");
+                if (g_dm5120_config[i].buffer_enabled) {
+                    strcat(type_str, "*");
+                }
+                break;
+            case MOD_PS5004: strcpy(type_str, "PS5004"); break;
+            case MOD_PS5010: strcpy(type_str, "PS5010"); break;
+            case MOD_DC5010: strcpy(type_str, "DC5010"); break;
+            case MOD_FG5010: strcpy(type_str, "FG5010"); break;
+            default: strcpy(type_str, "Unknown"); break;
+        }
+        if (!should_monitor && !g_control_panel.monitor_all) {
+            strcat(type_str, "-");  /* - indicates not monitored */
+        }
+        
+        if (!g_control_panel.running) {
+            strcpy(readout, " [Press SPACE]        ");
+        } else if (!gpib_health_ok(g_system->modules[i].gpib_address)) {
+            /* Quarantined meters cost no bus time; the rest keep their rate */
+            sprintf(readout, " [QUARANTINED %3lus]  ",
+                    (gpib_health_remaining_ms(g_system->modules[i].gpib_address) + 999) / 1000);
+        } else {
+            monitor_format_readout(i, &g_monitor_field[i], readout);
+        }
+        
+        len = sprintf(line, "S%d %-6s[%2d]:%s", i, type_str,
+                      g_system->modules[i].gpib_address, readout);
+        if (g_control_panel.running && should_monitor && g_monitor_field[i].kind != MON_STREAM &&
+            gpib_health_ok(g_system->modules[i].gpib_address)) {
+            sprintf(line + len, " %5.2f/%5.2fHz", sched_achieved_hz(i, now_ms),
+                    sched_requested_hz(i));
+        }
+        text_put_diff(1, row++, line, 80);
+    }
+    
+    /* Blank rows left over when fewer slots are shown */
+    while (row < MONITOR_FIRST_ROW + 10) {
+        text_put_diff(1, row++, "", 80);
+    }
+}
+
+/* Slots the monitor would put in bus-triggered mode for synchronized
+ * sampling - enabled, selected and able to take a Group Execute Trigger */
+static unsigned int monitor_sync_candidates(void) {
+    unsigned int mask = 0;
+    int i;
+    
+    for (i = 0; i < 10; i++) {
+        if (g_system->modules[i].enabled &&
+            (g_control_panel.monitor_all || (g_control_panel.monitor_mask & (1 << i))) &&
+            acquire_can_sync(i)) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+/* Time to the next deadline.  The sync group waits for its last member,
+ * so members already due do not count until then. */
+static unsigned long monitor_ms_until_due(unsigned int eligible_mask) {
+    unsigned long now_ms = tb_now_ms();
+    unsigned long until;
+    unsigned long group_ms = 0;
+    unsigned int group_mask = 0;
+    int i;
+    
+    if (g_acquire_mode == ACQ_MODE_SYNC) {
+        group_mask = acquire_sync_mask() & eligible_mask;
+        for (i = 0; i < 10; i++) {
+            if (!(group_mask & (1 << i))) continue;
+            until = sched_ms_until_due(now_ms, 1 << i);
+            if (until > group_ms) group_ms = until;
+        }
+    }
+    if (!(eligible_mask & ~group_mask)) return group_ms;
+    
+    until = sched_ms_until_due(now_ms, eligible_mask & ~group_mask);
+    if (group_mask && group_ms < until) until = group_ms;
+    return until;
+}
+
+void continuous_monitor(void) {
+    int i, j, done = 0;
+    time_t start_time = time(NULL);
+    unsigned long last_draw_ms;
+    unsigned long now_ms;
+    unsigned long wait_ms;
+    unsigned long due_ms;
+    unsigned int eligible_mask;
+    unsigned int stream_mask;
+    unsigned int pipe_mask;
+    unsigned int group_mask;
+    unsigned int sync_mask;
+    unsigned int ok_mask;
+    acquire_result results[10];
+    int due_slot;
+    int primary_slot = -1;
+    int frames = 0;
     int key;
-    int need_sample = 0;
-    int samples_taken = 0;
     int active_modules = 0;
-    int should_monitor;
-    int display_update_counter = 0;
     
     /* Validate and cleanup phantom enabled modules first */
     validate_enabled_modules();
@@ -5421,292 +6683,123 @@ void continuous_monitor(void) {
                 }
             }
             clear_module_data(i);
+            monitor_define_channels(i);
         }
+        g_monitor_field[i].kind = MON_NONE;
     }
     
     g_system->data_count = 0;
-    
-    /* Calculate timing - KEY TIMING LOGIC */
-    ticks_per_sample = (g_control_panel.sample_rate_ms * 182L) / 10000L;
-    if (ticks_per_sample < 1) ticks_per_sample = 1;
+    reset_session_time();
+    reduce_reset();
+    spill_start();
     
     clrscr();
     printf("Continuous Monitor - Press SPACE to start/stop, ESC to exit\n");
-    printf("Sample rate: %d ms (%lu ticks), %d active modules\n", 
-           g_control_panel.sample_rate_ms, ticks_per_sample, active_modules);
-    printf("Commands: C=Clear data\n");
+    printf("Sample rate: %d ms default, per-slot periods, %d active modules\n", 
+           g_control_panel.sample_rate_ms, active_modules);
+    printf("Commands: C=Clear data  M=Serial/pipelined/sync  Rates: achieved/requested Hz\n");
     printf("============================================================\n\n");
+    text_shadow_reset();
     
-    last_tick_count = *((unsigned long far *)0x0040006CL);
+    if (g_acquire_mode == ACQ_MODE_SYNC) {
+        acquire_sync_setup(monitor_sync_candidates());
+    }
+    sched_start(tb_now_ms());
+    acquire_reset_stats();
+    monitor_draw(start_time);
+    last_draw_ms = tb_now_ms();
     
     /* MAIN MEASUREMENT LOOP */
     while (!done) {
-        current_time = time(NULL);
-        gotoxy(1, 5);
-        printf("Time: %ld sec  Samples: %u  Status: %-8s  ", 
-               current_time - start_time, 
-               g_system->data_count + (need_sample && samples_taken > 0 ? 1 : 0),
-               g_control_panel.running ? "RUNNING" : "STOPPED");
-        
-        /* Display update optimization */
-        if (++display_update_counter >= 10) {
-            display_update_counter = 0;
-            if (measurement_ticks > 0 && g_control_panel.running) {
-                printf("OH:%lu ", (measurement_ticks * 10000L) / 182L);
-            }
-        }
-        printf("\n\n");
-        
-        current_tick_count = *((unsigned long far *)0x0040006CL);
-        
-        /* CRITICAL TIMING LOGIC FOR SAMPLING */
-        if (g_control_panel.running) {
-            unsigned long adjusted_ticks = ticks_per_sample;
-            if (measurement_ticks > 0 && measurement_ticks < ticks_per_sample) {
-                adjusted_ticks = ticks_per_sample - measurement_ticks;
-            }
-            
-            if ((current_tick_count - last_tick_count) >= adjusted_ticks) {
-                need_sample = 1;
-                last_tick_count = current_tick_count;
-                tick_start = current_tick_count;
-            }
-        }
-        
-        /* MODULE MEASUREMENT LOOP */
-        samples_taken = 0;
+        /* SLOTS ELIGIBLE FOR SCHEDULING - valid, selected and not quarantined;
+         * streaming DM5120s pace themselves and stay off the schedule */
+        eligible_mask = 0;
+        stream_mask = 0;
+        primary_slot = -1;
         for (i = 0; i < 10; i++) {
-            /* Skip ghost/phantom modules - must have valid type, address, and description */
             if (g_system->modules[i].enabled &&
                 g_system->modules[i].module_type != MOD_NONE &&
                 g_system->modules[i].gpib_address >= 1 &&
                 g_system->modules[i].gpib_address <= 30 &&
-                strlen(g_system->modules[i].description) > 0) {
-                
-                should_monitor = g_control_panel.monitor_all || 
-                                (g_control_panel.monitor_mask & (1 << i));
-                
-                if (!should_monitor && g_control_panel.running) {
-                    continue;  /* Skip to next module */
-                }
-                
-                /* Module type display */
-                switch(g_system->modules[i].module_type) {
-                    case MOD_DC5009: strcpy(type_str, "DC5009"); break;
-                    case MOD_DM5010: strcpy(type_str, "DM5010"); break;
-                    case MOD_DM5120: 
-                        strcpy(type_str, "DM5120");
-                        if (g_dm5120_config[i].buffer_enabled) {
-                            strcat(type_str, "*");
-                        }
-                        break;
-                    case MOD_PS5004: strcpy(type_str, "PS5004"); break;
-                    case MOD_PS5010: strcpy(type_str, "PS5010"); break;
-                    case MOD_DC5010: strcpy(type_str, "DC5010"); break;
-                    case MOD_FG5010: strcpy(type_str, "FG5010"); break;
-                    default: strcpy(type_str, "Unknown"); break;
+                strlen(g_system->modules[i].description) > 0 &&
+                (g_control_panel.monitor_all || (g_control_panel.monitor_mask & (1 << i))) &&
+                gpib_health_ok(g_system->modules[i].gpib_address)) {
+                if (g_system->modules[i].module_type == MOD_DM5120 &&
+                    g_dm5120_config[i].stream_mode) {
+                    stream_mask |= 1 << i;
+                    continue;
                 }
-                
-                if (!should_monitor && !g_control_panel.monitor_all) {
-                    strcat(type_str, "-");  /* - indicates not monitored */
+                eligible_mask |= 1 << i;
+                if (primary_slot < 0) primary_slot = i;
+            }
+        }
+        
+        /* ACQUISITION */
+        if (g_control_panel.running) {
+            /* One rack-wide service check per cycle instead of per-read polls */
+            gpib_service_scan();
+            
+            /* Streams - drain any meter whose buffer reported HALF */
+            for (i = 0; i < 10; i++) {
+                if (stream_mask & (1 << i)) monitor_stream(i);
+            }
+            
+            /* Sync - the bus-triggered group fires once all of it is due,
+             * so every member shares the sample number and the instant */
+            group_mask = 0;
+            sync_mask = 0;
+            pipe_mask = 0;
+            ok_mask = 0;
+            if (g_acquire_mode != ACQ_MODE_SERIAL) {
+                ok_mask = sched_due_mask(tb_now_ms(), eligible_mask);
+                if (g_acquire_mode == ACQ_MODE_SYNC) {
+                    group_mask = acquire_sync_mask() & eligible_mask;
+                    if (group_mask && (ok_mask & group_mask) == group_mask) {
+                        sync_mask = group_mask;
+                    }
                 }
                 
-                printf("S%d %-6s[%2d]:", i, type_str, g_system->modules[i].gpib_address);
-                
-                /* ACTUAL MEASUREMENT COLLECTION */
-                if (g_control_panel.running && need_sample && should_monitor) {
-                    switch(g_system->modules[i].module_type) {
-                        case MOD_DC5009:
-                        case MOD_DC5010:
-                            value = dc5009_read_measurement(g_system->modules[i].gpib_address);
-                            printf("%12.6f MHz   ", value / 1e6);
-                            break;
-                            
-                        case MOD_DM5010:
-                            value = read_dm5010_enhanced(g_system->modules[i].gpib_address, i);
-                            printf("%12.4f V     ", value);
-                            break;
-                            
-                        case MOD_DM5120:
-                            /* Enhanced DM5120 measurement with async buffer support */
-                            {
-                                dm5120_config *cfg = &g_dm5120_config[i];
-                                int address = g_system->modules[i].gpib_address;
-                                float measurement_rate = dm5120_get_measurement_rate(i, cfg->trigger_mode);
-                                int optimal_delay;
-                                
-                                if (cfg->buffer_enabled && cfg->buffer_size > 1) {
-                                    /* Async buffer operation */
-                                    int state = cfg->buffer_state;
-                                    
-                                    /* Start buffer if idle and we need a sample */
-                                    if (state == 0 && need_sample) {
-                                        dm5120_start_buffer_async(address, i);
-                                        printf("[Starting buffer]     ");
-                                        value = g_system->modules[i].last_reading; /* Show last value */
-                                        break;
-                                    }
-                                    
-                                    /* Check for events if filling */
-                                    if (state == 1 || state == 2) {
-                                        dm5120_check_buffer_async(address, i);
-                                        state = cfg->buffer_state;
-                                    }
-                                    
-                                    /* Display status based on buffer state */
-                                    switch(state) {
-                                        case 1: /* Filling */
-                                            printf("[Filling %3d samples] ", cfg->samples_ready);
-                                            value = g_system->modules[i].last_reading;
-                                            break;
-                                            
-                                        case 2: /* Half full */
-                                            printf("[50%% Full - %3d smp] ", cfg->samples_ready);
-                                            value = g_system->modules[i].last_reading;
-                                            break;
-                                            
-                                        case 3: /* Full */
-                                            /* Read buffer average and reset */
-                                            value = dm5120_get_buffer_average(address);
-                                            if (value == 0.0) {
-                                                /* Fallback to reading buffer count and single value */
-                                                int count = dm5120_get_buffer_count(address);
-                                                if (count > 0) {
-                                                    value = dm5120_read_one_stored(address);
-                                                }
-                                            }
-                                            printf("%12.6f V [Avg%3d]", value, cfg->buffer_size);
-                                            
-                                            /* Update statistics */
-                                            if (cfg->min_max_enabled && value != 0.0) {
-                                                if (value < cfg->min_value) cfg->min_value = value;
-                                                if (value > cfg->max_value) cfg->max_value = value;
-                                                cfg->sample_count++;
-                                            }
-                                            
-                                            /* Reset for next cycle */
-                                            dm5120_reset_buffer_async(i);
-                                            break;
-                                            
-                                        default:
-                                            printf("[Buffer idle]         ");
-                                            value = g_system->modules[i].last_reading;
-                                            break;
-                                    }
-                                    
-                                } else {
-                                    /* Single measurement mode (non-buffered) */
-                                    value = read_dm5120_enhanced(address, i);
-                                    if (value == 0.0) {
-                                        value = read_dm5120_voltage(address);
-                                    }
-                                    
-                                    printf("%12.6f V (%4.1f r/s)", value, measurement_rate);
-                                    
-                                    /* Check for timing conflicts */
-                                    optimal_delay = dm5120_calculate_measurement_time(i, 0, 1);
-                                    if (g_control_panel.sample_rate_ms < optimal_delay) {
-                                        printf(" [FAST]");
-                                    }
-                                    
-                                    /* Update statistics */
-                                    if (cfg->min_max_enabled && value != 0.0) {
-                                        if (value < cfg->min_value) cfg->min_value = value;
-                                        if (value > cfg->max_value) cfg->max_value = value;
-                                        cfg->sample_count++;
-                                    }
-                                }
-                            }
-                            break;
-                            
-                        case MOD_PS5004:
-                            ps_cfg = &g_ps5004_config[i];
-                            if (ps_cfg->display_mode == 1) {
-                                ps5004_set_display(g_system->modules[i].gpib_address, "CURRENT");
-                                delay(50);
-                                value = ps5004_read_value(g_system->modules[i].gpib_address);
-                                printf("%12.1f mA    ", value * 1000);
-                            } else {
-                                ps5004_set_display(g_system->modules[i].gpib_address, "VOLTAGE");
-                                delay(50);
-                                value = ps5004_read_value(g_system->modules[i].gpib_address);
-                                printf("%12.4f V     ", value);
-                            }
-                            break;
-                            
-                        case MOD_PS5010:  
-                            {
-                                ps5010_config *ps_cfg = &g_ps5010_config[i];
-                                int neg_stat, pos_stat, log_stat;
-                                
-                                if (ps5010_read_regulation(g_system->modules[i].gpib_address,
-                                                          &neg_stat, &pos_stat, &log_stat)) {
-                                    printf("P:%s N:%s L:%s     ",
-                                           pos_stat == 1 ? "CV" : (pos_stat == 2 ? "CC" : "UR"),
-                                           neg_stat == 1 ? "CV" : (neg_stat == 2 ? "CC" : "UR"),
-                                           log_stat == 1 ? "CV" : (log_stat == 2 ? "CC" : "UR"));
-                                    value = 0.0;
-                                } else {
-                                    printf("No status         ");
-                                    value = 0.0;
-                                }
-                            }
-                            break;
-                            
-                        default:
-                            value = 0.0;
-                            printf("Not implemented       ");
-                    } 
-                    
-                    /* STORE THE MEASUREMENT */
-                    g_system->modules[i].last_reading = value;
-                    store_module_data(i, value);
-                    
-                    if (samples_taken == 0 && g_system->data_count < g_system->buffer_size) {
-                        g_system->data_buffer[g_system->data_count] = value;
-                    }
-                    
-                    samples_taken++;
-                } else {
-                    /* Display previous readings when not sampling */
-                    if (g_control_panel.running) {
-                        if (should_monitor) {
-                            /* Special handling for DM5120 in buffer mode */
-                            if (g_system->modules[i].module_type == MOD_DM5120 && 
-                                g_dm5120_config[i].buffer_enabled && g_dm5120_config[i].buffer_state != 0) {
-                                /* Show buffer status even when not actively sampling */
-                                dm5120_check_buffer_async(g_system->modules[i].gpib_address, i);
-                                switch(g_dm5120_config[i].buffer_state) {
-                                    case 1: printf("[Filling %3d]       ", g_dm5120_config[i].samples_ready); break;
-                                    case 2: printf("[50%% Full]         "); break;
-                                    case 3: printf("[Ready to read]    "); break;
-                                    default: printf("%12.6f       ", g_system->modules[i].last_reading); break;
-                                }
-                            } else {
-                                printf("%12.6f       ", g_system->modules[i].last_reading);
-                            }
-                        } else {
-                            printf(" [Not Selected]    ");
-                        }
-                    } else {
-                        printf(" [Press SPACE]        ");
+                /* Pipelined - every other due slot with a trigger converts at once */
+                for (i = 0; i < 10; i++) {
+                    if ((ok_mask & ~group_mask & (1 << i)) && acquire_can_pipeline(i)) {
+                        pipe_mask |= 1 << i;
                     }
                 }
-                
-                printf("\n");
-            } 
-        } 
-        
-        /* POST-MEASUREMENT PROCESSING */
-        if (need_sample && g_control_panel.running && samples_taken > 0) {
-            if (g_system->data_count < g_system->buffer_size) {
-                g_system->data_count++;
+                ok_mask = 0;
             }
             
-            tick_end = *((unsigned long far *)0x0040006CL);
-            measurement_ticks = tick_end - tick_start;
+            if (sync_mask) ok_mask |= acquire_synchronized(sync_mask, results);
+            if (pipe_mask) ok_mask |= acquire_pipelined(pipe_mask, results);
+            if (sync_mask | pipe_mask) {
+                for (i = 0; i < 10; i++) {
+                    if (!((sync_mask | pipe_mask) & (1 << i))) continue;
+                    if (ok_mask & (1 << i)) {
+                        monitor_pipelined_field(i, results[i].value, &g_monitor_field[i]);
+                        monitor_store(i, results[i].value, results[i].time_ms, primary_slot);
+                        sched_mark_sampled(i, results[i].trigger_ms, results[i].done_ms);
+                    } else if (gpib_health_ok(g_system->modules[i].gpib_address)) {
+                        /* No reading - the serial driver has the retries */
+                        monitor_sample_serial(i, primary_slot);
+                    }
+                }
+            }
             
-            need_sample = 0;
+            /* Serial - earliest deadline first, one due slot per pass */
+            due_slot = sched_next_due(tb_now_ms(), eligible_mask & ~(pipe_mask | group_mask));
+            if (due_slot >= 0) {
+                monitor_sample_serial(due_slot, primary_slot);
+            }
+        }
+        
+        /* PRESENTATION - capped refresh rate, changed characters only */
+        now_ms = tb_now_ms();
+        if (tb_elapsed_ms(last_draw_ms) >= MONITOR_REFRESH_MS) {
+            if (++frames >= MONITOR_FULL_REDRAW) {
+                text_shadow_reset();   /* Repair anything else printed */
+                frames = 0;
+            }
+            monitor_draw(start_time);
+            last_draw_ms = now_ms;
         }
         
         /* KEYBOARD INPUT HANDLING */
@@ -5720,16 +6813,36 @@ void continuous_monitor(void) {
                 case ' ':
                     g_control_panel.running = !g_control_panel.running;
                     if (g_control_panel.running) {
-                        last_tick_count = *((unsigned long far *)0x0040006CL);
-                        measurement_ticks = 0;
+                        sched_start(tb_now_ms());
+                    } else {
+                        monitor_stop_streams();
+                    }
+                    break;
+                    
+                case 'M':
+                    if (g_acquire_mode == ACQ_MODE_SYNC) {
+                        acquire_sync_restore();
+                    }
+                    g_acquire_mode = (g_acquire_mode + 1) % ACQ_NUM_MODES;
+                    if (g_acquire_mode == ACQ_MODE_SYNC) {
+                        acquire_sync_setup(monitor_sync_candidates());
                     }
+                    acquire_reset_stats();
+                    sched_start(tb_now_ms());
                     break;
                     
                 case 'C':
+                    monitor_stop_streams();   /* Restart on the new session clock */
+                    spill_stop();
                     for (i = 0; i < 10; i++) {
                         clear_module_data(i);
+                        g_monitor_field[i].kind = MON_NONE;
                     }
                     g_system->data_count = 0;
+                    reset_session_time();
+                    reduce_reset();
+                    spill_start();
+                    sched_start(tb_now_ms());
                     gotoxy(1, 22);
                     printf("*** All data cleared ***");
                     delay(500);
@@ -5737,18 +6850,88 @@ void continuous_monitor(void) {
                     printf("                        ");
                     break;
             } 
+            monitor_draw(start_time);   /* Show the key's effect at once */
+            last_draw_ms = tb_now_ms();
         }
         
-        /* ADAPTIVE DELAY SYSTEM */
-        if (g_control_panel.running && samples_taken > 0) {
-            delay(5);  /* Shorter delay when actively sampling */
-        } else {
-            delay(15);  /* Longer delay when idle to save CPU */
+        /* SLEEP UNTIL THE NEXT DEADLINE OR REFRESH - no wait while a slot is due */
+        wait_ms = MONITOR_REFRESH_MS - tb_elapsed_ms(last_draw_ms);
+        if ((long)wait_ms < 0) wait_ms = 0;
+        if (g_control_panel.running) {
+            due_ms = monitor_ms_until_due(eligible_mask);
+            if (due_ms < wait_ms) wait_ms = due_ms;
+        }
+        if (wait_ms > SCHED_IDLE_WAIT_MS) wait_ms = SCHED_IDLE_WAIT_MS;
+        if (wait_ms > 0) {
+            /* Disk writes go in the slack before the next deadline */
+            spill_service();
+            delay((unsigned int)wait_ms);
         }
     } 
     
     /* CLEANUP AND SUMMARY */
+    monitor_stop_streams();
+    acquire_sync_restore();
+    spill_stop();
+    gotoxy(1, MONITOR_FIRST_ROW + 10);
     printf("\n\nMonitoring complete.\n");
+    sched_print_report(tb_now_ms());
+    printf("Acquisition: %s\n", acquire_mode_name(g_acquire_mode));
+    if (acquire_get_stats()->cycles > 0) {
+        acquire_stats *st = acquire_get_stats();
+        printf("%s cycles: %lu, mean %lu ms for %.1f slots\n",
+               g_acquire_mode == ACQ_MODE_SYNC ? "Synchronized" : "Pipelined", st->cycles,
+               st->total_ms / st->cycles, (float)st->slot_reads / (float)st->cycles);
+        if (st->slot_failures > 0) {
+            printf("Failed slot reads: %lu\n", st->slot_failures);
+        }
+        if (st->skew_cycles > 0) {
+            printf("Inter-slot skew: mean %lu ms, max %u ms over %lu cycles\n",
+                   st->total_skew_ms / st->skew_cycles, st->max_skew_ms, st->skew_cycles);
+        }
+    }
+    for (i = 0; i < 10; i++) {
+        sample_ingest_stats *st = ingest_get(i);
+        
+        if (st->accepted + st->dropped + st->duplicated == 0) continue;
+        printf("Slot %d: %lu stored, %lu dropped, %lu duplicate", i,
+               st->accepted, st->dropped, st->duplicated);
+        if (st->accepted > 0) {
+            printf(" - mean %g, sd %g, min %g, max %g", st->mean, ingest_std_dev(i),
+                   st->min, st->max);
+        }
+        printf("\n");
+        for (j = 1; j < slot_channel_count(i) && st->accepted > 0; j++) {
+            sample_ingest_stats *cst = ingest_channel_get(i, j);
+            
+            printf("  %-4s mean %g, sd %g, min %g, max %g\n", slot_channel_get(i, j)->name,
+                   cst->mean, ingest_channel_std_dev(i, j), cst->min, cst->max);
+        }
+    }
+    for (i = 0; i < 10; i++) {
+        if (reduce_blocks(i) > 0) {
+            printf("Slot %d reduced: %lu blocks, %lu readings on the meter, range %g to %g\n",
+                   i, reduce_blocks(i), reduce_readings(i),
+                   reduce_envelope_min(i), reduce_envelope_max(i));
+        }
+        if (g_system->modules[i].module_type == MOD_DM5120 &&
+            g_dm5120_config[i].stream_mode && g_dm5120_config[i].stream_samples > 0) {
+            printf("Slot %d stream: %lu readings at STOINT %u ms, %u overruns\n", i,
+                   g_dm5120_config[i].stream_samples, g_dm5120_config[i].stream_interval_ms,
+                   g_dm5120_config[i].stream_overruns);
+        }
+    }
+    if (spill_file_name()[0]) {
+        printf("Session file: %s (%lu bytes)\n", spill_file_name(), spill_bytes_written());
+        for (i = 0; i < 10; i++) {
+            if (spill_total(i) > 0) {
+                printf("  Slot %d: %lu samples logged\n", i, spill_total(i));
+            }
+        }
+    }
+    if (spill_errors()) {
+        printf("WARNING: Session file write failed - disk full?\n");
+    }
     printf("Total samples: %u\n", g_system->data_count);
     if (g_system->data_count > 0) {
         printf("First value: %.6f\n", g_system->data_buffer[0]);
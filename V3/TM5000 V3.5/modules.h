@@ -15,6 +15,8 @@ void validate_enabled_modules(void);
 /* void module_selection_menu(void); - moved to ui.h */
 void display_trace_selection_menu(void);
 void sync_traces_with_modules(void);
+int trace_next_channel(int slot);
+int apply_module_config(int slot);
 
 /* DM5120 functions */
 void init_dm5120_config(int slot);
@@ -27,6 +29,7 @@ void dm5120_set_trigger(int address, char *source, char *mode);
 void dm5120_set_digits(int address, int digits);
 void dm5120_set_null(int address, int enabled, float value);
 void dm5120_set_data_format(int address, int on);
+int dm5120_apply_config(int slot);
 /* DM5120 timing calculation */
 int dm5120_calculate_delay(int slot, int operation_type, int sample_count);
 
@@ -43,12 +46,24 @@ int dm5120_query_buffer_size(int address);
 float dm5120_get_measurement_rate(int slot, int trigger_mode);
 int dm5120_calculate_measurement_time(int slot, int operation_type, int sample_count);
 int dm5120_validate_stoint_settings(int slot, int interval_ms);
+
+/* Learned READ cycle times.  dm5120_timing_learn takes one timed cycle of
+ * the slot's current configuration; dm5120_learned_ms is 0 until the
+ * configuration is calibrated.  The table is kept in the settings file. */
+void dm5120_timing_learn(int slot, unsigned long cycle_ms);
+unsigned int dm5120_learned_ms(int slot);
+int dm5120_nominal_ms(int slot);
+int dm5120_timing_count(void);
+dm5120_timing_entry *dm5120_timing_at(int index);
+void dm5120_timing_restore(dm5120_timing_entry *entry);
+void dm5120_timing_reset(void);
 void dm5120_set_storage_interval(int address, int slot, int interval_ms);
 
 /* SRQ Event Handling Functions */
 void dm5120_configure_srq_events(int address, int enable_full, int enable_half, int enable_rdy, int enable_opc);
 void dm5120_configure_srq_events_smart(int address, int buffer_size, int is_circular, int expected_time_ms);
 int dm5120_check_buffer_status(int address);
+void dm5120_service_event(int address, unsigned char status);
 int dm5120_get_buffer_data_enhanced(int address, int slot, float far *buffer, int max_samples);
 
 /* Timing Validation and Diagnostic Functions */
@@ -59,8 +74,10 @@ int dm5120_get_buffer_data(int address, int slot, float far *buffer, int max_sam
 int dm5120_fill_buffer_complete(int address, int slot, float far *buffer, int buffer_size);
 int dm5120_get_multiple_samples(int address, int slot, float far *buffer, int num_samples);
 float read_dm5120_buffered(int address, int slot);
+int dm5120_get_reading(int address, int slot, float *value);
 float read_dm5120_enhanced(int address, int slot);
 float read_dm5120(int address);
+int dm5120_get_voltage(int address, float *value);
 float read_dm5120_voltage(int address);
 void dm5120_clear_statistics(int slot);
 void test_dm5120_comm(int address);
@@ -71,6 +88,13 @@ void dm5120_start_buffer_async(int address, int slot);
 int dm5120_check_buffer_async(int address, int slot);
 void dm5120_reset_buffer_async(int slot);
 
+/* DM5120 Gapless Streaming - circular buffer drained into module_data */
+int dm5120_stream_interval_ms(int slot);
+void dm5120_stream_start(int address, int slot);
+int dm5120_stream_service(int address, int slot);
+int dm5120_stream_drain(int address, int slot);
+void dm5120_stream_stop(int address, int slot);
+
 /* DM5010 functions */
 void init_dm5010_config(int slot);
 void configure_dm5010_advanced(int slot);
@@ -83,6 +107,8 @@ void dm5010_set_null(int address, int enabled, float value);
 void dm5010_set_calculation(int address, int mode, float factor, float offset);
 void dm5010_beeper(int address, int enabled);
 void dm5010_lock_front_panel(int address, int locked);
+int dm5010_apply_config(int slot);
+int dm5010_get_reading(int address, int slot, float *value);
 float read_dm5010_enhanced(int address, int slot);
 void test_dm5010_comm(int address);
 
@@ -94,7 +120,11 @@ void ps5004_set_voltage(int address, float voltage);
 void ps5004_set_current(int address, float current);
 void ps5004_set_output(int address, int on);
 void ps5004_set_display(int address, char *mode);
+int ps5004_shown(int slot);
+int ps5004_show(int slot, int mode);
+int ps5004_apply_config(int slot);
 int ps5004_get_regulation_status(int address);
+int ps5004_get_value(int address, float *value);
 float ps5004_read_value(int address);
 void test_ps5004_comm(int address);
 
@@ -111,6 +141,7 @@ int ps5010_get_settings(int address, char *buffer, int maxlen);
 int ps5010_get_error(int address);
 void ps5010_set_interrupts(int address, int pri_on, int nri_on, int lri_on);
 void ps5010_set_srq(int address, int on);
+int ps5010_apply_config(int slot);
 float read_ps5010(int address, int slot);
 void test_ps5010_comm(int address);
 
@@ -127,6 +158,7 @@ void dc5009_set_level(int address, char channel, float level);
 void dc5009_set_filter(int address, int enabled);
 void dc5009_set_gate_time(int address, float gate_time);
 void dc5009_set_averaging(int address, int count);
+int dc5009_apply_config(int slot);
 void dc5009_auto_trigger(int address);
 void dc5009_start_measurement(int address);
 void dc5009_stop_measurement(int address);
@@ -147,6 +179,9 @@ void test_dc5009_comm(int address);
 void init_dc5010_config(int slot);
 void configure_dc5010_advanced(int slot);
 void dc5010_set_function(int address, char *function, char *channel);
+int dc5010_logs_both(int slot);
+char *dc5010_selected(int slot);
+int dc5010_select(int slot, char *channel);
 void dc5010_set_coupling(int address, char channel, char *coupling);
 void dc5010_set_impedance(int address, char channel, char *impedance);
 void dc5010_set_attenuation(int address, char channel, char *attenuation);
@@ -155,6 +190,7 @@ void dc5010_set_level(int address, char channel, float level);
 void dc5010_set_filter(int address, int enabled);
 void dc5010_set_gate_time(int address, float gate_time);
 void dc5010_set_averaging(int address, int count);
+int dc5010_apply_config(int slot);
 void dc5010_auto_trigger(int address);
 void dc5010_start_measurement(int address);
 void dc5010_stop_measurement(int address);
@@ -197,6 +233,7 @@ void fg5010_set_burst(int address, int enable, int count, float period);
 int test_fg5010_comm(int address);
 float fg5010_read_frequency(int address);
 int fg5010_read_output_status(int address);
+int fg5010_apply_config(int slot);
 
 /* FG5010 Enhanced Programs (v3.5) */
 void fg5010_pulse_program_menu(int slot);
@@ -465,7 +465,7 @@ void print_graph_text(void) {
                     j = (x * g_traces[i].data_count) / 65;
                     if (j >= g_traces[i].data_count) j = g_traces[i].data_count - 1;
                     
-                    value = g_traces[i].data[j];
+                    value = trace_data_at(i, j);
                     
                     y_pos = (int)((float)(graph_lines - 1) * (max_val - value) / y_range + 0.5);
                     
@@ -1135,14 +1135,14 @@ void print_graph_postscript(void) {
             x_scale = graph_width / (float)(g_traces[i].data_count - 1);
             y_scale = graph_height / y_range;
             
-            value = g_traces[i].data[0];
+            value = trace_data_at(i, 0);
             sprintf(label, "%.2f %.2f moveto\r\n",
                     graph_x,
                     graph_y + (value - min_val) * y_scale);
             print_string(label);
             
             for (j = 1; j < g_traces[i].data_count; j++) {
-                value = g_traces[i].data[j];
+                value = trace_data_at(i, j);
                 sprintf(label, "%.2f %.2f lineto\r\n",
                         graph_x + j * x_scale,
                         graph_y + (value - min_val) * y_scale);
@@ -0,0 +1,291 @@
+/*
+ * TM5000 GPIB Control System - Instrument-Side Reduction
+ * Version 3.5
+ * Slots that collect a block of N readings on the meter and fetch only
+ * its mean, minimum, maximum and count
+ *
+ * Reading a slow trend one value at a time costs a bus transaction per
+ * reading.  Here the meter takes the readings itself and the monitor
+ * asks only for the reduced block, so the bus carries a few queries per
+ * N readings.  The DM5120 stores the block in its buffer at STOINT
+ * spacing and reports FULL as a service request; BUFAVE?, BUFMIN?,
+ * BUFMAX? and BUFCNT? fetch the block and BUFCLR starts the next one.
+ * The DM5010 has no buffer - its averaging filter is set to N readings
+ * and one VAL? a block later returns their mean, without extremes.
+ *
+ * Version History:
+ * 3.5 - Initial implementation for slow-trend logging with less bus traffic
+ */
+
+#include "reduce.h"
+#include "gpib.h"
+#include "modules.h"
+#include "scheduler.h"
+#include "shadow.h"
+#include "timebase.h"
+
+unsigned int g_reduce_count[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+typedef struct {
+    reduce_block last;
+    unsigned long start_ms;        /* Timebase ms the running block started */
+    unsigned long start_time_ms;   /* Session ms of its first reading */
+    unsigned long blocks;
+    unsigned long readings;
+    float env_min;
+    float env_max;
+    unsigned int count;            /* Block size the meter was set up for */
+    unsigned int interval_ms;      /* Spacing of the readings in a block */
+    unsigned int running:1;        /* Meter is set up and collecting */
+    unsigned int have_last:1;
+    unsigned int reserved:14;
+} reduce_slot_state;
+
+static reduce_slot_state g_reduce_slot[10];
+static char g_reduce_response[GPIB_BUFFER_SIZE];
+
+int reduce_supported(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    switch (g_system->modules[slot].module_type) {
+        case MOD_DM5120:
+            /* A streaming meter's buffer already belongs to the stream */
+            return !g_dm5120_config[slot].stream_mode;
+        case MOD_DM5010:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int reduce_enabled(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return g_reduce_count[slot] >= REDUCE_MIN_COUNT && reduce_supported(slot);
+}
+
+/* Block size asked for, within what the DM5120 buffer holds */
+static unsigned int reduce_size(int slot) {
+    return g_reduce_count[slot] > REDUCE_MAX_COUNT ? REDUCE_MAX_COUNT : g_reduce_count[slot];
+}
+
+/* One query answered with a number */
+static int reduce_query(int address, char *query, float *value) {
+    gpib_write(address, query);
+    return gpib_read(address, g_reduce_response, sizeof(g_reduce_response)) > 0 &&
+           parse_reading_value(g_reduce_response, value);
+}
+
+/* Start the next block on a meter that is already set up */
+static void reduce_restart(int slot, reduce_slot_state *r) {
+    int address = g_system->modules[slot].gpib_address;
+
+    if (g_system->modules[slot].module_type == MOD_DM5120) {
+        gpib_write(address, "BUFCLR");
+        g_dm5120_config[slot].buffer_state = 1;
+        g_dm5120_config[slot].buffer_start_time = tb_now_ms();
+        g_dm5120_config[slot].samples_ready = 0;
+    }
+    r->start_ms = tb_now_ms();
+    r->start_time_ms = session_time_ms() + r->interval_ms;
+}
+
+/* Readings spread over the slot's period, never closer than the meter
+ * can convert */
+static unsigned int reduce_dm5120_interval(int slot, unsigned int count) {
+    unsigned int interval = (unsigned int)dm5120_stream_interval_ms(slot);
+    unsigned int spread = sched_get(slot)->requested_ms / count;
+
+    return spread > interval ? spread : interval;
+}
+
+static void reduce_start(int slot, reduce_slot_state *r) {
+    int address = g_system->modules[slot].gpib_address;
+    char cmd[24];
+
+    r->count = reduce_size(slot);
+
+    if (g_system->modules[slot].module_type == MOD_DM5120) {
+        r->interval_ms = reduce_dm5120_interval(slot, r->count);
+
+        /* FULL only - one service request per block */
+        dm5120_configure_srq_events(address, 1, 0, 0, 0);
+
+        gpib_batch_begin(address);
+        sprintf(cmd, "BUFSZ %u", r->count);
+        gpib_write(address, cmd);
+        shadow_forget(address, SH_DM5120_BUFFER);
+        dm5120_set_trigger(address, "TALK", "CONT");
+        sprintf(cmd, "STOINT %u", r->interval_ms);
+        gpib_write(address, cmd);
+        gpib_batch_commit();
+    } else {
+        /* Per-reading time taken before the filter stretches it */
+        r->interval_ms = sched_conversion_ms(slot);
+        dm5010_set_filter(address, 1, r->count);
+    }
+
+    r->running = 1;
+    reduce_restart(slot, r);
+}
+
+/* Meter has the whole block.  Nothing goes on the bus until the block
+ * should be complete; a lost FULL request is covered by BUFCNT? once a
+ * second after that. */
+static int reduce_block_done(int slot, reduce_slot_state *r) {
+    unsigned long span = (unsigned long)r->count * r->interval_ms;
+    int count;
+
+    if (g_system->modules[slot].module_type != MOD_DM5120) {
+        return tb_elapsed_ms(r->start_ms) >= span;
+    }
+
+    if (g_dm5120_config[slot].buffer_state >= 3) return 1;
+    if (tb_elapsed_ms(r->start_ms) <= span + 1000L) return 0;
+
+    count = dm5120_get_buffer_count(g_system->modules[slot].gpib_address);
+    if (count >= (int)r->count) return 1;
+    r->start_ms += 1000L;
+    return 0;
+}
+
+static int reduce_fetch(int slot, reduce_slot_state *r, reduce_block *block) {
+    int address = g_system->modules[slot].gpib_address;
+    float count;
+
+    memset(block, 0, sizeof(reduce_block));
+    if (g_system->modules[slot].module_type == MOD_DM5120) {
+        if (!reduce_query(address, "BUFAVE?", &block->mean) ||
+            !reduce_query(address, "BUFMIN?", &block->min) ||
+            !reduce_query(address, "BUFMAX?", &block->max)) {
+            return 0;
+        }
+        block->count = reduce_query(address, "BUFCNT?", &count) && count > 0.0 ?
+                       (unsigned int)count : r->count;
+        block->has_extremes = 1;
+        block->time_ms = r->start_time_ms +
+                         (unsigned long)(block->count - 1) * r->interval_ms / 2;
+    } else {
+        if (!reduce_query(address, "VAL?", &block->mean)) return 0;
+        block->min = block->mean;
+        block->max = block->mean;
+        block->count = r->count;
+        block->time_ms = session_time_ms() - (unsigned long)r->count * r->interval_ms / 2;
+    }
+    return 1;
+}
+
+int reduce_service(int slot, reduce_block *block) {
+    reduce_slot_state *r;
+    int ok;
+
+    if (!reduce_enabled(slot)) return 0;
+    r = &g_reduce_slot[slot];
+
+    /* Block size changed since the meter was set up */
+    if (r->running && r->count != reduce_size(slot)) reduce_stop(slot);
+    if (!r->running) {
+        reduce_start(slot, r);
+        return 0;
+    }
+    if (!reduce_block_done(slot, r)) return 0;
+
+    ok = reduce_fetch(slot, r, block);
+    reduce_restart(slot, r);
+    if (!ok) return 0;
+
+    if (r->blocks == 0 || block->min < r->env_min) r->env_min = block->min;
+    if (r->blocks == 0 || block->max > r->env_max) r->env_max = block->max;
+    r->blocks++;
+    r->readings += block->count;
+    r->last = *block;
+    r->have_last = 1;
+    return 1;
+}
+
+unsigned int reduce_progress(int slot) {
+    reduce_slot_state *r;
+    unsigned long done;
+
+    if (slot < 0 || slot >= 10) return 0;
+    r = &g_reduce_slot[slot];
+    if (!r->running || r->interval_ms == 0) return 0;
+
+    done = tb_elapsed_ms(r->start_ms) / r->interval_ms;
+    return done < r->count ? (unsigned int)done : r->count;
+}
+
+void reduce_stop(int slot) {
+    reduce_slot_state *r;
+    dm5120_config *dm_cfg;
+    dm5010_config *dmm_cfg;
+    int address;
+    char cmd[24];
+
+    if (slot < 0 || slot >= 10) return;
+    r = &g_reduce_slot[slot];
+    if (!r->running) return;
+    address = g_system->modules[slot].gpib_address;
+
+    if (g_system->modules[slot].module_type == MOD_DM5120) {
+        dm_cfg = &g_dm5120_config[slot];
+        dm5120_configure_srq_events(address, 0, 0, 0, 0);
+
+        gpib_batch_begin(address);
+        gpib_write(address, "STOINT ONE");
+        if (dm_cfg->buffer_size > 0 && dm_cfg->buffer_size <= DM5120_MAX_BUFFER_SIZE) {
+            sprintf(cmd, "BUFSZ %d", dm_cfg->buffer_size);
+            gpib_write(address, cmd);
+        }
+        dm5120_set_trigger(address, dm_cfg->trigger_source ? "EXT" : "TALK",
+                           dm_cfg->trigger_mode ? "ONE" : "CONT");
+        gpib_batch_commit();
+        dm5120_reset_buffer_async(slot);
+    } else if (g_system->modules[slot].module_type == MOD_DM5010) {
+        dmm_cfg = &g_dm5010_config[slot];
+        dm5010_set_filter(address, dmm_cfg->filter_enabled, dmm_cfg->filter_count);
+    }
+    r->running = 0;
+}
+
+void reduce_stop_all(void) {
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        reduce_stop(i);
+    }
+}
+
+reduce_block *reduce_last(int slot) {
+    if (slot < 0 || slot >= 10 || !g_reduce_slot[slot].have_last) return NULL;
+    return &g_reduce_slot[slot].last;
+}
+
+unsigned long reduce_blocks(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return g_reduce_slot[slot].blocks;
+}
+
+unsigned long reduce_readings(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return g_reduce_slot[slot].readings;
+}
+
+float reduce_envelope_min(int slot) {
+    if (slot < 0 || slot >= 10) return 0.0;
+    return g_reduce_slot[slot].env_min;
+}
+
+float reduce_envelope_max(int slot) {
+    if (slot < 0 || slot >= 10) return 0.0;
+    return g_reduce_slot[slot].env_max;
+}
+
+/* Forget the session totals - the meters must already be stopped */
+void reduce_reset(void) {
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (!g_reduce_slot[i].running) {
+            memset(&g_reduce_slot[i], 0, sizeof(reduce_slot_state));
+        }
+    }
+}
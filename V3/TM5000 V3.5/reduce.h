@@ -0,0 +1,62 @@
+/*
+ * TM5000 GPIB Control System - Instrument-Side Reduction
+ * Version 3.5
+ * Header file for slots that collect N readings on the meter and fetch
+ * only the reduced block
+ *
+ * Version History:
+ * 3.5 - Initial implementation for slow-trend logging with less bus traffic
+ */
+
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include "tm5000.h"
+
+#define REDUCE_MIN_COUNT   2
+#define REDUCE_MAX_COUNT   DM5120_MAX_BUFFER_SIZE
+
+/* One block of readings reduced by the meter */
+typedef struct {
+    float mean;
+    float min;                     /* Equal to mean without has_extremes */
+    float max;
+    unsigned int count;            /* Readings that went into the block */
+    unsigned long time_ms;         /* Session ms of the middle of the block */
+    unsigned char has_extremes;    /* min and max came from the meter */
+} reduce_block;
+
+/* Per-slot readings per block, 0 = read one at a time as before */
+extern unsigned int g_reduce_count[10];
+
+/* Module type can reduce on the instrument - DM5120 and DM5010 */
+int reduce_supported(int slot);
+
+/* Slot has a block size set and can reduce */
+int reduce_enabled(int slot);
+
+/* Start the slot's block if it is not collecting yet, otherwise check
+ * for completion.  Returns 1 and fills *block when a block was fetched -
+ * the next one is already collecting.  No bus traffic while the meter is
+ * still collecting. */
+int reduce_service(int slot, reduce_block *block);
+
+/* Readings collected so far in the running block, estimated from time */
+unsigned int reduce_progress(int slot);
+
+/* Put the meter back to the slot's configuration */
+void reduce_stop(int slot);
+void reduce_stop_all(void);
+
+/* Last block fetched, NULL before the first one */
+reduce_block *reduce_last(int slot);
+
+/* Session totals - blocks fetched, readings they held, and the lowest
+ * and highest value seen in any block */
+unsigned long reduce_blocks(int slot);
+unsigned long reduce_readings(int slot);
+float reduce_envelope_min(int slot);
+float reduce_envelope_max(int slot);
+void reduce_reset(void);
+
+#endif /* REDUCE_H */
@@ -0,0 +1,176 @@
+/*
+ * TM5000 GPIB Control System - Acquisition Scheduler
+ * Version 3.5
+ * Per-slot earliest-deadline scheduling for continuous_monitor
+ *
+ * Every slot has its own period and an expected conversion time.  A slot
+ * is never scheduled faster than its instrument can convert, and a slow
+ * one (a DC5009 on a 10 s gate) no longer holds the fast meters to its
+ * rate - whichever slot's deadline is earliest gets the bus next.
+ *
+ * Version History:
+ * 3.5 - Initial implementation replacing the single global sample tick
+ */
+
+#include "scheduler.h"
+#include "modules.h"
+#include "gpib.h"
+
+unsigned int g_slot_period_ms[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static slot_schedule g_schedule[10];
+
+static unsigned int sched_requested_ms(int slot) {
+    unsigned int ms = g_slot_period_ms[slot];
+
+    if (ms == 0) ms = (unsigned int)g_control_panel.sample_rate_ms;
+    if (ms < SCHED_MIN_PERIOD_MS) ms = SCHED_MIN_PERIOD_MS;
+    return ms;
+}
+
+/* Time the instrument needs for one reading, before bus overhead */
+unsigned int sched_conversion_ms(int slot) {
+    int address = g_system->modules[slot].gpib_address;
+    gpib_completion *comp = gpib_get_completion(address);
+    float gate;
+
+    switch (g_system->modules[slot].module_type) {
+        case MOD_DM5120:
+            return (unsigned int)dm5120_calculate_measurement_time(slot, 0, 1);
+
+        case MOD_DC5009:
+        case MOD_DC5010:
+            gate = g_system->modules[slot].module_type == MOD_DC5009 ?
+                   g_dc5009_config[slot].gate_time : g_dc5010_config[slot].gate_time;
+            if (gate <= 0.0) gate = 1.0;
+            return (unsigned int)(gate * 1000.0) + 50;
+
+        default:
+            break;
+    }
+
+    /* Everything else: what the completion layer has seen, if anything */
+    if (comp && comp->samples > 0) return comp->learned_ms;
+    return g_system->modules[slot].module_type == MOD_DM5010 ? 150 : 50;
+}
+
+static void sched_update_period(int slot) {
+    slot_schedule *s = &g_schedule[slot];
+    unsigned int floor_ms = s->conversion_ms;
+
+    if (s->cost_ms > floor_ms) floor_ms = s->cost_ms;
+    s->period_ms = s->requested_ms > floor_ms ? s->requested_ms : floor_ms;
+}
+
+void sched_start(unsigned long now_ms) {
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        slot_schedule *s = &g_schedule[i];
+
+        memset(s, 0, sizeof(slot_schedule));
+        if (!g_system->modules[i].enabled ||
+            g_system->modules[i].module_type == MOD_NONE) {
+            continue;
+        }
+        s->active = 1;
+        s->requested_ms = sched_requested_ms(i);
+        s->conversion_ms = sched_conversion_ms(i);
+        s->next_due_ms = now_ms;
+        s->start_ms = now_ms;
+        sched_update_period(i);
+    }
+}
+
+int sched_next_due(unsigned long now_ms, unsigned int eligible_mask) {
+    int i;
+    int best = -1;
+    long best_late = -1;
+
+    for (i = 0; i < 10; i++) {
+        long late;
+
+        if (!g_schedule[i].active || !(eligible_mask & (1 << i))) continue;
+        late = (long)(now_ms - g_schedule[i].next_due_ms);
+        if (late >= 0 && late > best_late) {
+            best = i;
+            best_late = late;
+        }
+    }
+    return best;
+}
+
+/* Every slot in eligible_mask whose deadline has passed */
+unsigned int sched_due_mask(unsigned long now_ms, unsigned int eligible_mask) {
+    unsigned int due = 0;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (!g_schedule[i].active || !(eligible_mask & (1 << i))) continue;
+        if ((long)(now_ms - g_schedule[i].next_due_ms) >= 0) due |= 1 << i;
+    }
+    return due;
+}
+
+unsigned long sched_ms_until_due(unsigned long now_ms, unsigned int eligible_mask) {
+    int i;
+    long wait = -1;
+
+    for (i = 0; i < 10; i++) {
+        long until;
+
+        if (!g_schedule[i].active || !(eligible_mask & (1 << i))) continue;
+        until = (long)(g_schedule[i].next_due_ms - now_ms);
+        if (until <= 0) return 0;
+        if (wait < 0 || until < wait) wait = until;
+    }
+    return wait < 0 ? SCHED_IDLE_WAIT_MS : (unsigned long)wait;
+}
+
+void sched_mark_sampled(int slot, unsigned long start_ms, unsigned long end_ms) {
+    slot_schedule *s = &g_schedule[slot];
+    unsigned int cost = (unsigned int)(end_ms - start_ms);
+
+    if (!s->active) return;
+
+    s->samples++;
+    s->cost_ms = s->samples == 1 ? cost : (unsigned int)((s->cost_ms * 3L + cost) / 4);
+    sched_update_period(slot);
+
+    /* Keep the grid, but never queue up a burst of missed deadlines */
+    s->next_due_ms += s->period_ms;
+    if ((long)(end_ms - s->next_due_ms) > 0) {
+        s->next_due_ms = end_ms;
+    }
+}
+
+float sched_requested_hz(int slot) {
+    if (!g_schedule[slot].requested_ms) return 0.0;
+    return 1000.0 / (float)g_schedule[slot].requested_ms;
+}
+
+float sched_achieved_hz(int slot, unsigned long now_ms) {
+    unsigned long span = now_ms - g_schedule[slot].start_ms;
+
+    if (span == 0 || g_schedule[slot].samples == 0) return 0.0;
+    return (float)g_schedule[slot].samples * 1000.0 / (float)span;
+}
+
+slot_schedule *sched_get(int slot) {
+    if (slot < 0 || slot >= 10) return NULL;
+    return &g_schedule[slot];
+}
+
+void sched_print_report(unsigned long now_ms) {
+    int i;
+
+    printf("Slot  Req ms  Sched ms  Conv ms  Cost ms  Samples  Req Hz  Got Hz\n");
+    for (i = 0; i < 10; i++) {
+        slot_schedule *s = &g_schedule[i];
+
+        if (!s->active || s->samples == 0) continue;
+        printf("S%d   %6u  %8u  %7u  %7u  %7lu  %6.2f  %6.2f\n",
+               i, s->requested_ms, s->period_ms, s->conversion_ms, s->cost_ms,
+               s->samples, sched_requested_hz(i), sched_achieved_hz(i, now_ms));
+    }
+}
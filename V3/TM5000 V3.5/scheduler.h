@@ -0,0 +1,58 @@
+/*
+ * TM5000 GPIB Control System - Acquisition Scheduler
+ * Version 3.5
+ * Header file for the per-slot earliest-deadline scheduler
+ *
+ * Version History:
+ * 3.5 - Initial implementation replacing the single global sample tick
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "tm5000.h"
+
+#define SCHED_MIN_PERIOD_MS   10
+#define SCHED_MAX_PERIOD_MS   60000
+#define SCHED_IDLE_WAIT_MS    15    /* Longest sleep while nothing is due */
+
+typedef struct {
+    unsigned long next_due_ms;    /* Deadline of the next sample */
+    unsigned long start_ms;       /* Start of the rate measurement */
+    unsigned long samples;        /* Samples taken since start_ms */
+    unsigned int requested_ms;    /* Period asked for by the user */
+    unsigned int period_ms;       /* Period actually scheduled */
+    unsigned int conversion_ms;   /* Expected instrument conversion time */
+    unsigned int cost_ms;         /* Running average of observed sample time */
+    unsigned int active:1;
+    unsigned int reserved:15;
+} slot_schedule;
+
+/* Per-slot requested period in ms, 0 = follow g_control_panel.sample_rate_ms */
+extern unsigned int g_slot_period_ms[10];
+
+/* Reset deadlines and rate counters; every slot is due at now_ms */
+void sched_start(unsigned long now_ms);
+
+/* Earliest-deadline slot in eligible_mask that is due, -1 if none */
+int sched_next_due(unsigned long now_ms, unsigned int eligible_mask);
+
+/* Mask of the slots in eligible_mask that are due */
+unsigned int sched_due_mask(unsigned long now_ms, unsigned int eligible_mask);
+
+/* ms until the next slot in eligible_mask is due, 0 if one already is */
+unsigned long sched_ms_until_due(unsigned long now_ms, unsigned int eligible_mask);
+
+/* Record a sample of slot taken between start_ms and end_ms and set its
+ * next deadline */
+void sched_mark_sampled(int slot, unsigned long start_ms, unsigned long end_ms);
+
+/* Requested and achieved rate in Hz */
+float sched_requested_hz(int slot);
+float sched_achieved_hz(int slot, unsigned long now_ms);
+
+slot_schedule *sched_get(int slot);
+unsigned int sched_conversion_ms(int slot);
+void sched_print_report(unsigned long now_ms);
+
+#endif /* SCHEDULER_H */
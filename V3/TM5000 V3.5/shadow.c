@@ -0,0 +1,572 @@
+/*
+ * TM5000 GPIB Control System - Instrument Shadow State
+ * Version 3.5
+ * Per-slot copy of the settings last confirmed on each instrument
+ *
+ * Every apply used to send a module's whole setup - sixteen commands for
+ * a counter - even when nothing had changed, and each command costs a
+ * bus transaction plus the instrument's settling time.  The shadow holds
+ * the configuration as it was last sent, with a bit per field group that
+ * says the instrument is still running it.  An apply sends only the
+ * fields that are unknown or differ.  Setters called from anywhere else
+ * clear their field's bit, since they may leave the instrument on a
+ * value the stored configuration does not have; a failed transaction
+ * or a raw command clears the slot.  verify_module_config reads fields
+ * back through the instrument's query commands where it has them.
+ *
+ * Version History:
+ * 3.5 - Initial implementation for diff-based configuration apply
+ */
+
+#include "shadow.h"
+#include "gpib.h"
+
+static module_shadow __far g_shadow[10];
+static char g_shadow_response[GPIB_BUFFER_SIZE];
+
+/* Every field group each module type tracks */
+static unsigned long shadow_fields(unsigned char module_type) {
+    switch (module_type) {
+        case MOD_DM5120: return 0x00FFL;
+        case MOD_DM5010: return 0x00FFL;
+        case MOD_PS5004: return 0x03FFL;
+        case MOD_PS5010: return 0x01FFL;
+        case MOD_DC5009: return 0x3FFFL;
+        case MOD_DC5010: return 0x7FFFL;
+        case MOD_FG5010: return 0x1FFFL;
+        default:         return 0;
+    }
+}
+
+int shadow_count_fields(unsigned long bits) {
+    int n = 0;
+
+    while (bits) {
+        n += (int)(bits & 1);
+        bits >>= 1;
+    }
+    return n;
+}
+
+/* Values read back from an instrument come through its print format */
+static int float_differs(float a, float b) {
+    return fabs(a - b) > 1e-6 + 1e-5 * fabs(b);
+}
+
+module_shadow *shadow_for(int slot) {
+    module_shadow *sh = &g_shadow[slot];
+    tm5000_module *m = &g_system->modules[slot];
+
+    if (sh->module_type != m->module_type || sh->gpib_address != m->gpib_address) {
+        memset(sh, 0, sizeof(module_shadow));
+        sh->module_type = m->module_type;
+        sh->gpib_address = m->gpib_address;
+    }
+    return sh;
+}
+
+static unsigned long dm5120_stale(dm5120_config *cfg, dm5120_config *old) {
+    unsigned long stale = 0;
+
+    if (strcmp(cfg->function, old->function) != 0) stale |= SH_DM5120_FUNCTION;
+    if (cfg->range_mode != old->range_mode) stale |= SH_DM5120_RANGE;
+    if (cfg->filter_enabled != old->filter_enabled ||
+        (cfg->filter_enabled && cfg->filter_value != old->filter_value)) {
+        stale |= SH_DM5120_FILTER;
+    }
+    if (cfg->trigger_source != old->trigger_source || cfg->trigger_mode != old->trigger_mode) {
+        stale |= SH_DM5120_TRIGGER;
+    }
+    if (cfg->digits != old->digits) stale |= SH_DM5120_DIGITS;
+    if (cfg->null_enabled != old->null_enabled ||
+        (cfg->null_enabled && float_differs(cfg->nullval, old->nullval))) {
+        stale |= SH_DM5120_NULL;
+    }
+    if (cfg->data_format != old->data_format) stale |= SH_DM5120_DATFOR;
+    if (cfg->buffer_enabled &&
+        (!old->buffer_enabled || cfg->buffer_size != old->buffer_size)) {
+        stale |= SH_DM5120_BUFFER;
+    }
+    return stale;
+}
+
+static unsigned long dm5010_stale(dm5010_config *cfg, dm5010_config *old) {
+    unsigned long stale = 0;
+
+    if (strcmp(cfg->function, old->function) != 0) stale |= SH_DM5010_FUNCTION;
+    if (cfg->filter_enabled != old->filter_enabled ||
+        (cfg->filter_enabled && cfg->filter_count != old->filter_count)) {
+        stale |= SH_DM5010_FILTER;
+    }
+    if (cfg->trigger_mode != old->trigger_mode) stale |= SH_DM5010_TRIGGER;
+    if (cfg->auto_zero != old->auto_zero) stale |= SH_DM5010_AUTOZERO;
+    if (cfg->null_enabled != old->null_enabled ||
+        (cfg->null_enabled && float_differs(cfg->nullval, old->nullval))) {
+        stale |= SH_DM5010_NULL;
+    }
+    if (cfg->calculation_mode != old->calculation_mode ||
+        float_differs(cfg->scale_factor, old->scale_factor) ||
+        float_differs(cfg->scale_offset, old->scale_offset) ||
+        float_differs(cfg->dbm_reference, old->dbm_reference) ||
+        float_differs(cfg->dbr_reference, old->dbr_reference)) {
+        stale |= SH_DM5010_CALC;
+    }
+    if (cfg->beeper_enabled != old->beeper_enabled) stale |= SH_DM5010_BEEPER;
+    if (cfg->front_panel_lock != old->front_panel_lock) stale |= SH_DM5010_LOCK;
+    return stale;
+}
+
+static unsigned long ps5004_stale(ps5004_config *cfg, ps5004_config *old) {
+    unsigned long stale = 0;
+
+    if (float_differs(cfg->voltage, old->voltage)) stale |= SH_PS5004_VOLTAGE;
+    if (float_differs(cfg->current_limit, old->current_limit)) stale |= SH_PS5004_CURRENT;
+    if (cfg->display_mode != old->display_mode) stale |= SH_PS5004_DISPLAY;
+    if (cfg->vri_enabled != old->vri_enabled) stale |= SH_PS5004_VRI;
+    if (cfg->cri_enabled != old->cri_enabled) stale |= SH_PS5004_CRI;
+    if (cfg->uri_enabled != old->uri_enabled) stale |= SH_PS5004_URI;
+    if (cfg->dt_enabled != old->dt_enabled) stale |= SH_PS5004_DT;
+    if (cfg->user_enabled != old->user_enabled) stale |= SH_PS5004_USER;
+    if (cfg->rqs_enabled != old->rqs_enabled) stale |= SH_PS5004_RQS;
+    if (cfg->output_enabled != old->output_enabled) stale |= SH_PS5004_OUTPUT;
+    return stale;
+}
+
+static unsigned long ps5010_stale(ps5010_config *cfg, ps5010_config *old) {
+    unsigned long stale = 0;
+
+    if (float_differs(cfg->voltage1, old->voltage1)) stale |= SH_PS5010_VOLTAGE1;
+    if (float_differs(cfg->voltage2, old->voltage2)) stale |= SH_PS5010_VOLTAGE1 << 1;
+    if (float_differs(cfg->logic_voltage, old->logic_voltage)) stale |= SH_PS5010_VOLTAGE1 << 2;
+    if (float_differs(cfg->current_limit1, old->current_limit1)) stale |= SH_PS5010_CURRENT1;
+    if (float_differs(cfg->current_limit2, old->current_limit2)) stale |= SH_PS5010_CURRENT1 << 1;
+    if (float_differs(cfg->logic_current_limit, old->logic_current_limit)) stale |= SH_PS5010_CURRENT1 << 2;
+    if (cfg->output1_enabled != old->output1_enabled) stale |= SH_PS5010_OUTPUT1;
+    if (cfg->output2_enabled != old->output2_enabled) stale |= SH_PS5010_OUTPUT1 << 1;
+    if (cfg->logic_enabled != old->logic_enabled) stale |= SH_PS5010_OUTPUT1 << 2;
+    return stale;
+}
+
+/* DC5009 and DC5010 share their setup fields up to the DC5010 extras, so
+ * one comparison serves both through the DC5009 layout */
+static unsigned long dc_stale(dc5009_config *cfg, dc5009_config *old) {
+    unsigned long stale = 0;
+
+    if (strcmp(cfg->function, old->function) != 0 || strcmp(cfg->channel, old->channel) != 0) {
+        stale |= SH_DC_FUNCTION;
+    }
+    if (float_differs(cfg->gate_time, old->gate_time)) stale |= SH_DC_GATE;
+    if (cfg->averaging != old->averaging) stale |= SH_DC_AVERAGING;
+    if (strcmp(cfg->coupling_a, old->coupling_a) != 0) stale |= SH_DC_COUPLING_A;
+    if (strcmp(cfg->coupling_b, old->coupling_b) != 0) stale |= SH_DC_COUPLING_A << 1;
+    if (strcmp(cfg->impedance_a, old->impedance_a) != 0) stale |= SH_DC_IMPEDANCE_A;
+    if (strcmp(cfg->impedance_b, old->impedance_b) != 0) stale |= SH_DC_IMPEDANCE_A << 1;
+    if (strcmp(cfg->attenuation_a, old->attenuation_a) != 0) stale |= SH_DC_ATTENUATION_A;
+    if (strcmp(cfg->attenuation_b, old->attenuation_b) != 0) stale |= SH_DC_ATTENUATION_A << 1;
+    if (strcmp(cfg->slope_a, old->slope_a) != 0) stale |= SH_DC_SLOPE_A;
+    if (strcmp(cfg->slope_b, old->slope_b) != 0) stale |= SH_DC_SLOPE_A << 1;
+    if (float_differs(cfg->level_a, old->level_a)) stale |= SH_DC_LEVEL_A;
+    if (float_differs(cfg->level_b, old->level_b)) stale |= SH_DC_LEVEL_A << 1;
+    if (cfg->filter_enabled != old->filter_enabled) stale |= SH_DC_FILTER;
+    return stale;
+}
+
+/* Sweep, modulation and burst parameters only go out while enabled */
+static unsigned long fg5010_stale(fg5010_config *cfg, fg5010_config *old) {
+    unsigned long stale = 0;
+
+    if (strcmp(cfg->waveform, old->waveform) != 0) stale |= SH_FG5010_WAVEFORM;
+    if (float_differs(cfg->frequency, old->frequency)) stale |= SH_FG5010_FREQUENCY;
+    if (float_differs(cfg->amplitude, old->amplitude)) stale |= SH_FG5010_AMPLITUDE;
+    if (float_differs(cfg->offset, old->offset)) stale |= SH_FG5010_OFFSET;
+    if (float_differs(cfg->duty_cycle, old->duty_cycle)) stale |= SH_FG5010_DUTY;
+    if (float_differs(cfg->phase, old->phase)) stale |= SH_FG5010_PHASE;
+    if (cfg->sweep_enabled != old->sweep_enabled ||
+        (cfg->sweep_enabled && (float_differs(cfg->start_freq, old->start_freq) ||
+                                float_differs(cfg->stop_freq, old->stop_freq) ||
+                                float_differs(cfg->sweep_time, old->sweep_time)))) {
+        stale |= SH_FG5010_SWEEP;
+    }
+    if (strcmp(cfg->trigger_source, old->trigger_source) != 0 ||
+        strcmp(cfg->trigger_slope, old->trigger_slope) != 0 ||
+        float_differs(cfg->trigger_level, old->trigger_level)) {
+        stale |= SH_FG5010_TRIGGER;
+    }
+    if (cfg->modulation_enabled != old->modulation_enabled ||
+        (cfg->modulation_enabled && (strcmp(cfg->mod_type, old->mod_type) != 0 ||
+                                     float_differs(cfg->mod_freq, old->mod_freq) ||
+                                     float_differs(cfg->mod_depth, old->mod_depth)))) {
+        stale |= SH_FG5010_MODULATION;
+    }
+    if (cfg->burst_enabled != old->burst_enabled ||
+        (cfg->burst_enabled && (cfg->burst_count != old->burst_count ||
+                                float_differs(cfg->burst_period, old->burst_period)))) {
+        stale |= SH_FG5010_BURST;
+    }
+    if (cfg->sync_enabled != old->sync_enabled) stale |= SH_FG5010_SYNC;
+    if (cfg->invert_enabled != old->invert_enabled) stale |= SH_FG5010_INVERT;
+    if (cfg->output_enabled != old->output_enabled) stale |= SH_FG5010_OUTPUT;
+    return stale;
+}
+
+unsigned long shadow_stale_fields(int slot) {
+    module_shadow *sh;
+    unsigned long stale = 0;
+
+    if (slot < 0 || slot >= 10) return 0;
+    sh = shadow_for(slot);
+
+    switch (sh->module_type) {
+        case MOD_DM5120:
+            stale = dm5120_stale(&g_dm5120_config[slot], &sh->cfg.dm5120);
+            break;
+        case MOD_DM5010:
+            stale = dm5010_stale(&g_dm5010_config[slot], &sh->cfg.dm5010);
+            break;
+        case MOD_PS5004:
+            stale = ps5004_stale(&g_ps5004_config[slot], &sh->cfg.ps5004);
+            break;
+        case MOD_PS5010:
+            stale = ps5010_stale(&g_ps5010_config[slot], &sh->cfg.ps5010);
+            break;
+        case MOD_DC5009:
+            stale = dc_stale(&g_dc5009_config[slot], &sh->cfg.dc5009);
+            break;
+        case MOD_DC5010:
+            stale = dc_stale((dc5009_config *)&g_dc5010_config[slot], (dc5009_config *)&sh->cfg.dc5010);
+            if (g_dc5010_config[slot].burst_mode != sh->cfg.dc5010.burst_mode) stale |= SH_DC_BURST;
+            break;
+        case MOD_FG5010:
+            stale = fg5010_stale(&g_fg5010_config[slot], &sh->cfg.fg5010);
+            break;
+    }
+    stale = (stale | ~sh->known) & shadow_fields(sh->module_type);
+
+    /* BUFSZ is only ever sent to turn buffering on */
+    if (sh->module_type == MOD_DM5120 && !g_dm5120_config[slot].buffer_enabled) {
+        stale &= ~SH_DM5120_BUFFER;
+    }
+    return stale;
+}
+
+void shadow_commit(int slot, const void *cfg, unsigned int size, unsigned long sent,
+                   unsigned int failures) {
+    module_shadow *sh;
+    unsigned long fields;
+
+    if (slot < 0 || slot >= 10) return;
+    sh = shadow_for(slot);
+    fields = shadow_fields(sh->module_type);
+
+    /* Any part of the apply may not have been taken */
+    if (gpib_failures(sh->gpib_address) != failures) {
+        sh->known = 0;
+        return;
+    }
+    if (size > sizeof(shadow_config)) size = sizeof(shadow_config);
+    memcpy(&sh->cfg, cfg, size);
+    sh->known |= sent & fields;
+    sh->sent += shadow_count_fields(sent & fields);
+    sh->skipped += shadow_count_fields(fields & ~sent);
+}
+
+void shadow_forget(int address, unsigned long bits) {
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (g_shadow[i].known && g_shadow[i].gpib_address == address) {
+            g_shadow[i].known &= ~bits;
+        }
+    }
+}
+
+void shadow_invalidate(int slot) {
+    if (slot < 0 || slot >= 10) return;
+    g_shadow[slot].known = 0;
+}
+
+void shadow_invalidate_all(void) {
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        g_shadow[i].known = 0;
+    }
+}
+
+/* Ask "header?" and leave the value part of the reply, upper case, in
+ * value.  The Tektronix instruments echo the header ("FUNCT DCV"); the
+ * SCPI DM5010 answers with the bare value. */
+static int shadow_query(int address, const char *header, char *value, int len) {
+    char cmd[24];
+    char *p;
+    int n = strlen(header);
+
+    sprintf(cmd, "%s?", header);
+    gpib_write(address, cmd);
+    if (gpib_read(address, g_shadow_response, sizeof(g_shadow_response)) <= 0) {
+        return 0;
+    }
+    for (p = g_shadow_response; *p; p++) *p = toupper(*p);
+
+    p = g_shadow_response;
+    while (*p == ' ') p++;
+    if (strncmp(p, header, n) == 0 && (p[n] == ' ' || p[n] == '\0')) p += n;
+    while (*p == ' ' || *p == '"') p++;
+
+    strncpy(value, p, len - 1);
+    value[len - 1] = '\0';
+    n = strlen(value);
+    while (n > 0 && (value[n - 1] == '\r' || value[n - 1] == '\n' || value[n - 1] == ' ' ||
+                     value[n - 1] == ';' || value[n - 1] == '"')) {
+        value[--n] = '\0';
+    }
+    return n > 0;
+}
+
+/* 1 for ON, 0 for OFF, -1 for anything else */
+static int parse_on_off(const char *value) {
+    if (strcmp(value, "ON") == 0 || strcmp(value, "1") == 0) return 1;
+    if (strcmp(value, "OFF") == 0 || strcmp(value, "0") == 0) return 0;
+    return -1;
+}
+
+static int query_on_off(int address, const char *header) {
+    char value[16];
+
+    if (!shadow_query(address, header, value, sizeof(value))) return -1;
+    return parse_on_off(value);
+}
+
+static unsigned long dm5120_verify(int address, dm5120_config *sh) {
+    unsigned long read = 0;
+    char value[24];
+    char *comma;
+    int n;
+
+    if (shadow_query(address, "FUNCT", value, sizeof(value))) {
+        strncpy(sh->function, value, sizeof(sh->function) - 1);
+        sh->function[sizeof(sh->function) - 1] = '\0';
+        read |= SH_DM5120_FUNCTION;
+    }
+    if (shadow_query(address, "RANGE", value, sizeof(value))) {
+        if (strcmp(value, "AUTO") == 0) {
+            sh->range_mode = 0;
+            read |= SH_DM5120_RANGE;
+        } else if (isdigit(value[0])) {
+            sh->range_mode = atoi(value);
+            read |= SH_DM5120_RANGE;
+        }
+    }
+    /* FILTER ON alone leaves the count unknown */
+    if (shadow_query(address, "FILTER", value, sizeof(value))) {
+        if (parse_on_off(value) == 0) {
+            sh->filter_enabled = 0;
+            read |= SH_DM5120_FILTER;
+        } else if (isdigit(value[0])) {
+            sh->filter_enabled = 1;
+            sh->filter_value = atoi(value);
+            read |= SH_DM5120_FILTER;
+        }
+    }
+    if (shadow_query(address, "TRIGGER", value, sizeof(value)) &&
+        (comma = strchr(value, ',')) != NULL) {
+        *comma = '\0';
+        /* GET is the synchronized monitor's, not a configurable source */
+        if (strcmp(value, "TALK") == 0 || strcmp(value, "EXT") == 0) {
+            sh->trigger_source = strcmp(value, "EXT") == 0;
+            sh->trigger_mode = strcmp(comma + 1, "ONE") == 0;
+            read |= SH_DM5120_TRIGGER;
+        }
+    }
+    if (shadow_query(address, "DIGITS", value, sizeof(value)) && isdigit(value[0])) {
+        sh->digits = atoi(value);
+        read |= SH_DM5120_DIGITS;
+    }
+    /* The null value itself cannot be read back, only that it is off */
+    if (query_on_off(address, "NULL") == 0) {
+        sh->null_enabled = 0;
+        read |= SH_DM5120_NULL;
+    }
+    if ((n = query_on_off(address, "DATFOR")) >= 0) {
+        sh->data_format = n;
+        read |= SH_DM5120_DATFOR;
+    }
+    if (shadow_query(address, "BUFSZ", value, sizeof(value))) {
+        if (strcmp(value, "CIRCULAR") == 0) {
+            sh->buffer_enabled = 1;
+            sh->buffer_size = 0;
+            read |= SH_DM5120_BUFFER;
+        } else if (isdigit(value[0])) {
+            sh->buffer_enabled = 1;
+            sh->buffer_size = atoi(value);
+            read |= SH_DM5120_BUFFER;
+        }
+    }
+    return read;
+}
+
+static unsigned long dm5010_verify(int address, dm5010_config *sh) {
+    unsigned long read = 0;
+    char value[24];
+    int n;
+
+    if ((n = query_on_off(address, "AVER:STAT")) == 0) {
+        sh->filter_enabled = 0;
+        read |= SH_DM5010_FILTER;
+    } else if (n == 1 && shadow_query(address, "AVER:COUN", value, sizeof(value)) &&
+               isdigit(value[0])) {
+        sh->filter_enabled = 1;
+        sh->filter_count = atoi(value);
+        read |= SH_DM5010_FILTER;
+    }
+    if (shadow_query(address, "TRIG:SOUR", value, sizeof(value))) {
+        n = strncmp(value, "IMM", 3) == 0 ? 0 :
+            (strncmp(value, "EXT", 3) == 0 ? 1 : (strncmp(value, "BUS", 3) == 0 ? 2 : -1));
+        if (n >= 0) {
+            sh->trigger_mode = n;
+            read |= SH_DM5010_TRIGGER;
+        }
+    }
+    if ((n = query_on_off(address, "ZERO:AUTO")) >= 0) {
+        sh->auto_zero = n;
+        read |= SH_DM5010_AUTOZERO;
+    }
+    if (query_on_off(address, "CALC:NULL:STAT") == 0) {
+        sh->null_enabled = 0;
+        read |= SH_DM5010_NULL;
+    }
+    if ((n = query_on_off(address, "SYST:BEEP:STAT")) >= 0) {
+        sh->beeper_enabled = n;
+        read |= SH_DM5010_BEEPER;
+    }
+    return read;
+}
+
+static unsigned long ps5004_verify(int address, ps5004_config *sh) {
+    static const char *flags[6] = { "VRI", "CRI", "URI", "DT", "USER", "RQS" };
+    unsigned long read = 0;
+    char value[24];
+    int i, n;
+
+    if (shadow_query(address, "VOLTAGE", value, sizeof(value))) {
+        sh->voltage = atof(value);
+        read |= SH_PS5004_VOLTAGE;
+    }
+    if (shadow_query(address, "CURRENT", value, sizeof(value))) {
+        sh->current_limit = atof(value);
+        read |= SH_PS5004_CURRENT;
+    }
+    if (shadow_query(address, "DISPLAY", value, sizeof(value))) {
+        n = strcmp(value, "VOLTAGE") == 0 ? 0 :
+            (strcmp(value, "CURRENT") == 0 ? 1 : (strcmp(value, "CLIMIT") == 0 ? 2 : -1));
+        if (n >= 0) {
+            sh->display_mode = n;
+            read |= SH_PS5004_DISPLAY;
+        }
+    }
+    for (i = 0; i < 6; i++) {
+        if ((n = query_on_off(address, flags[i])) < 0) continue;
+        switch (i) {
+            case 0: sh->vri_enabled = n; break;
+            case 1: sh->cri_enabled = n; break;
+            case 2: sh->uri_enabled = n; break;
+            case 3: sh->dt_enabled = n; break;
+            case 4: sh->user_enabled = n; break;
+            case 5: sh->rqs_enabled = n; break;
+        }
+        read |= SH_PS5004_VRI << i;
+    }
+    if ((n = query_on_off(address, "OUTPUT")) >= 0) {
+        sh->output_enabled = n;
+        read |= SH_PS5004_OUTPUT;
+    }
+    return read;
+}
+
+static unsigned long ps5010_verify(int address, ps5010_config *sh) {
+    static const char *volts[3] = { "VPOS", "VNEG", "VLOG" };
+    static const char *amps[3] = { "IPOS", "INEG", "ILOG" };
+    unsigned long read = 0;
+    char value[24];
+    float v;
+    int i, n;
+
+    for (i = 0; i < 3; i++) {
+        if (shadow_query(address, volts[i], value, sizeof(value))) {
+            v = atof(value);
+            if (i == 0) sh->voltage1 = v;
+            else if (i == 1) sh->voltage2 = v;
+            else sh->logic_voltage = v;
+            read |= SH_PS5010_VOLTAGE1 << i;
+        }
+        if (shadow_query(address, amps[i], value, sizeof(value))) {
+            v = atof(value);
+            if (i == 0) sh->current_limit1 = v;
+            else if (i == 1) sh->current_limit2 = v;
+            else sh->logic_current_limit = v;
+            read |= SH_PS5010_CURRENT1 << i;
+        }
+    }
+    /* The apply sends output 1 as FSOUT and output 2 as LSOUT */
+    if ((n = query_on_off(address, "FSOUT")) >= 0) {
+        sh->output1_enabled = n;
+        read |= SH_PS5010_OUTPUT1;
+    }
+    if ((n = query_on_off(address, "LSOUT")) >= 0) {
+        sh->output2_enabled = n;
+        read |= SH_PS5010_OUTPUT1 << 1;
+    }
+    return read;
+}
+
+int verify_module_config(int slot) {
+    module_shadow *sh;
+    unsigned long fields;
+    unsigned long read;
+    int address;
+
+    if (slot < 0 || slot >= 10 || !g_system->modules[slot].enabled) return -1;
+    sh = shadow_for(slot);
+    address = sh->gpib_address;
+    fields = shadow_fields(sh->module_type);
+
+    switch (sh->module_type) {
+        case MOD_DM5120: read = dm5120_verify(address, &sh->cfg.dm5120); break;
+        case MOD_DM5010: read = dm5010_verify(address, &sh->cfg.dm5010); break;
+        case MOD_PS5004: read = ps5004_verify(address, &sh->cfg.ps5004); break;
+        case MOD_PS5010: read = ps5010_verify(address, &sh->cfg.ps5010); break;
+        default:
+            /* The counters report their setup only as one SET? string;
+             * the FG5010 driver has no queries */
+            return -1;
+    }
+
+    /* Fields that could not be read are no longer vouched for */
+    sh->known = read & fields;
+    return shadow_count_fields(read & fields);
+}
+
+void shadow_verify_dialog(int slot) {
+    module_shadow *sh;
+    unsigned long stale;
+    int read;
+
+    printf("\n\nReading settings back from the instrument...\n");
+    read = verify_module_config(slot);
+    if (read < 0) {
+        printf("This module has no setting queries - the next apply sends every field.\n");
+        shadow_invalidate(slot);
+    } else {
+        sh = shadow_for(slot);
+        stale = shadow_stale_fields(slot);
+        printf("Fields read back:          %d of %d\n", read,
+               shadow_count_fields(shadow_fields(sh->module_type)));
+        printf("Differ from configuration: %d\n", shadow_count_fields(stale & sh->known));
+        printf("Unreadable, sent on apply: %d\n",
+               shadow_count_fields(shadow_fields(sh->module_type) & ~sh->known));
+        printf("Apply so far: %lu fields sent, %lu skipped as unchanged\n",
+               sh->sent, sh->skipped);
+    }
+    printf("Press any key to continue...");
+    getch();
+}
@@ -0,0 +1,128 @@
+/*
+ * TM5000 GPIB Control System - Instrument Shadow State
+ * Version 3.5
+ * Header file for the per-slot copy of settings known to be on the instrument
+ *
+ * Version History:
+ * 3.5 - Initial implementation for diff-based configuration apply
+ */
+
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include "tm5000.h"
+
+/* Field groups - one bit per setter an apply function sends.  Bits are
+ * numbered per module type; a set bit means the shadow copy of that
+ * field is what the instrument is running. */
+#define SH_DM5120_FUNCTION   0x0001L
+#define SH_DM5120_RANGE      0x0002L
+#define SH_DM5120_FILTER     0x0004L
+#define SH_DM5120_TRIGGER    0x0008L
+#define SH_DM5120_DIGITS     0x0010L
+#define SH_DM5120_NULL       0x0020L
+#define SH_DM5120_DATFOR     0x0040L
+#define SH_DM5120_BUFFER     0x0080L
+
+#define SH_DM5010_FUNCTION   0x0001L
+#define SH_DM5010_FILTER     0x0002L
+#define SH_DM5010_TRIGGER    0x0004L
+#define SH_DM5010_AUTOZERO   0x0008L
+#define SH_DM5010_NULL       0x0010L
+#define SH_DM5010_CALC       0x0020L
+#define SH_DM5010_BEEPER     0x0040L
+#define SH_DM5010_LOCK       0x0080L
+
+#define SH_PS5004_VOLTAGE    0x0001L
+#define SH_PS5004_CURRENT    0x0002L
+#define SH_PS5004_DISPLAY    0x0004L
+#define SH_PS5004_VRI        0x0008L
+#define SH_PS5004_CRI        0x0010L
+#define SH_PS5004_URI        0x0020L
+#define SH_PS5004_DT         0x0040L
+#define SH_PS5004_USER       0x0080L
+#define SH_PS5004_RQS        0x0100L
+#define SH_PS5004_OUTPUT     0x0200L
+
+/* PS5010 - channel n (1-3) is bit << (n - 1) */
+#define SH_PS5010_VOLTAGE1   0x0001L
+#define SH_PS5010_CURRENT1   0x0008L
+#define SH_PS5010_OUTPUT1    0x0040L
+
+/* DC5009 and DC5010 - channel B is the channel A bit << 1 */
+#define SH_DC_FUNCTION       0x0001L
+#define SH_DC_GATE           0x0002L
+#define SH_DC_AVERAGING      0x0004L
+#define SH_DC_COUPLING_A     0x0008L
+#define SH_DC_IMPEDANCE_A    0x0020L
+#define SH_DC_ATTENUATION_A  0x0080L
+#define SH_DC_SLOPE_A        0x0200L
+#define SH_DC_LEVEL_A        0x0800L
+#define SH_DC_FILTER         0x2000L
+#define SH_DC_BURST          0x4000L
+
+#define SH_FG5010_WAVEFORM   0x0001L
+#define SH_FG5010_FREQUENCY  0x0002L
+#define SH_FG5010_AMPLITUDE  0x0004L
+#define SH_FG5010_OFFSET     0x0008L
+#define SH_FG5010_DUTY       0x0010L
+#define SH_FG5010_PHASE      0x0020L
+#define SH_FG5010_SWEEP      0x0040L
+#define SH_FG5010_TRIGGER    0x0080L
+#define SH_FG5010_MODULATION 0x0100L
+#define SH_FG5010_BURST      0x0200L
+#define SH_FG5010_SYNC       0x0400L
+#define SH_FG5010_INVERT     0x0800L
+#define SH_FG5010_OUTPUT     0x1000L
+
+#define SH_ALL               0xFFFFFFFFL
+
+typedef union {
+    dm5120_config dm5120;
+    dm5010_config dm5010;
+    ps5004_config ps5004;
+    ps5010_config ps5010;
+    dc5009_config dc5009;
+    dc5010_config dc5010;
+    fg5010_config fg5010;
+} shadow_config;
+
+typedef struct {
+    shadow_config cfg;             /* Last state confirmed on the instrument */
+    unsigned long known;           /* SH_* bits of the fields in cfg that hold */
+    unsigned long sent;            /* Fields sent by applies */
+    unsigned long skipped;         /* Fields applies left alone as unchanged */
+    int gpib_address;              /* Owner when cfg was recorded */
+    unsigned char module_type;
+} module_shadow;
+
+/* Shadow of slot, emptied first if the slot now holds a different module
+ * or address.  Never NULL for slots 0-9. */
+module_shadow *shadow_for(int slot);
+
+/* Fields of the slot's stored configuration that an apply has to send -
+ * unknown on the instrument or different from the shadow */
+unsigned long shadow_stale_fields(int slot);
+
+/* After an apply: the fields in sent now match cfg on the instrument.
+ * failures is gpib_failures() of the address from before the apply - if
+ * any transaction failed since, nothing is left known. */
+void shadow_commit(int slot, const void *cfg, unsigned int size, unsigned long sent,
+                   unsigned int failures);
+
+/* Number of field groups in bits */
+int shadow_count_fields(unsigned long bits);
+
+/* A setter or raw command changed these fields behind the shadow's back */
+void shadow_forget(int address, unsigned long bits);
+void shadow_invalidate(int slot);
+void shadow_invalidate_all(void);
+
+/* Refresh the shadow from the instrument's query commands.  Returns the
+ * number of fields read back, -1 if the module answers no queries. */
+int verify_module_config(int slot);
+
+/* Menu action - verify and report what the next apply would send */
+void shadow_verify_dialog(int slot);
+
+#endif /* SHADOW_H */
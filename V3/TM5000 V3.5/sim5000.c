@@ -0,0 +1,1166 @@
+/*
+ * TM5000 GPIB Control System - Rack Simulator
+ * Version 3.5
+ * Host-side (Linux) stand-in for Driver488 and a TM5000 mainframe
+ *
+ * Speaks the Driver488 text protocol that gpib.c writes to \dev\ieeeout
+ * and reads back from \dev\ieeein, and models the instruments well enough
+ * for the command set modules.c sends: conversion times, reading noise,
+ * the BUSY/RQS status byte, talk or bus (GET) triggering by the
+ * configured trigger source, and the DM5120 BUFSZ/STOINT store buffer.
+ * Used to benchmark and regression-test throughput changes offline.
+ *
+ * Not part of the DOS build - compile with the host compiler:
+ *     make sim            (or: gcc -O2 -o sim5000 sim5000.c -lm)
+ *
+ * Usage:
+ *     sim5000 [-c rack.cfg] [-o ieeeout] [-i ieeein] [-p] [-l ms] [-v] [-1]
+ *       -c file   Rack description (default rack below when omitted)
+ *       -o path   FIFO the program writes commands to  (default ./ieeeout)
+ *       -i path   FIFO the program reads responses from (default ./ieeein)
+ *       -p        Use a pseudo-terminal instead of FIFOs; the slave name
+ *                 is printed and serves as both ieeeout and ieeein
+ *       -l ms     Driver overhead added to every bus command (default 1)
+ *       -v        Trace bus traffic to stderr
+ *       -1        Exit after the first session instead of waiting for the
+ *                 next one
+ *
+ * Point the program at the simulator with the environment overrides read
+ * by init_gpib_system():
+ *     TM5000_IEEEOUT=./ieeeout TM5000_IEEEIN=./ieeein
+ *
+ * Rack file - one instrument per line, '#' starts a comment:
+ *     <address> <type> [key=value ...]
+ *   type   DM5120 DM5010 PS5004 PS5010 DC5009 DC5010 FG5010
+ *   conv   Conversion time in ms (reading takes this long, BUSY meanwhile)
+ *   setup  Busy time in ms after a setting command
+ *   jitter Random extra conversion time, 0..jitter ms
+ *   value  Mean reading (volts, amps, Hz...)
+ *   noise  Gaussian reading noise, one sigma
+ *   load   PS5004 load resistance in ohms (current readings)
+ *   srq    0 = instrument never asserts SRQ even with RQS ON
+ *   Example:
+ *     16 DM5120 conv=120 noise=2e-5 value=1.00012
+ *     22 PS5004 value=5.0 load=100
+ *
+ * Status byte returned by spoll:
+ *   0x10 BUSY while a conversion or setting is in progress
+ *   0x20 Abnormal - a command error is latched (cleared by ERR?)
+ *   0x40 RQS with the event code in the low bits (cleared by the poll):
+ *        0x01 buffer FULL, 0x02 buffer HALF, 0x04 RDY, 0x08 OPC
+ *
+ * Version History:
+ * 3.5 - Initial implementation
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define SIM_MAX_ADDRESS   31
+#define SIM_MAX_SETTINGS  24
+#define SIM_MAX_BUFFER    500       /* DM5120 store memory, as DM5120_MAX_BUFFER_SIZE */
+#define SIM_LINE_SIZE     1024
+#define SIM_REPLY_SIZE    12000     /* Room for READ ALLSTORE of a full buffer */
+
+/* Status byte bits */
+#define SIM_STB_BUSY      0x10
+#define SIM_STB_ABNORMAL  0x20
+#define SIM_STB_RQS       0x40
+
+/* Event codes (EVENT? and low bits of the RQS status byte) */
+#define SIM_EVENT_NONE    0
+#define SIM_EVENT_FULL    1
+#define SIM_EVENT_HALF    2
+#define SIM_EVENT_RDY     4
+#define SIM_EVENT_OPC     8
+
+/* Instrument types */
+#define SIM_NONE    0
+#define SIM_DM5120  1
+#define SIM_DM5010  2
+#define SIM_PS5004  3
+#define SIM_PS5010  4
+#define SIM_DC5009  5
+#define SIM_DC5010  6
+#define SIM_FG5010  7
+#define SIM_NUM_TYPES 8
+
+typedef struct {
+    const char *name;
+    const char *id;
+    unsigned int conv_ms;
+    unsigned int setup_ms;
+    double value;
+    double noise;
+} sim_type_info;
+
+static const sim_type_info sim_types[SIM_NUM_TYPES] = {
+    { "NONE",   "",                                0,   0, 0.0,   0.0 },
+    { "DM5120", "ID TEK/DM5120,V81.1,F3.2",      100,  20, 1.0,   5e-6 },
+    { "DM5010", "ID TEK/DM5010,V79.1,F2.4",      150,  20, 5.0,   2e-5 },
+    { "PS5004", "ID TEK/PS5004,V79.1,F1.2",       30,  10, 5.0,   2e-4 },
+    { "PS5010", "ID TEK/PS5010,V79.1,F1.3",       20,  10, 5.0,   5e-3 },
+    { "DC5009", "ID TEK/DC5009,V79.1,F1.1",      100,   5, 1.0e6, 1.0 },
+    { "DC5010", "ID TEK/DC5010,V79.1,F1.1",      100,   5, 1.0e6, 0.1 },
+    { "FG5010", "ID TEK/FG5010,V81.1,F1.0",       10,   5, 1.0e3, 0.0 }
+};
+
+typedef struct {
+    char header[16];
+    char arg[40];
+} sim_setting;
+
+typedef struct {
+    int type;
+
+    /* Rack file parameters */
+    unsigned int conv_ms;
+    unsigned int setup_ms;
+    unsigned int jitter_ms;
+    double value;
+    double noise;
+    double load_ohms;
+    int srq_allowed;
+
+    /* Bus state */
+    int remote;
+    double busy_until;          /* Host ms when BUSY clears */
+    int reading_pending;        /* A triggered reading completes at busy_until */
+    char reply[SIM_REPLY_SIZE];
+    int reply_ready;
+
+    /* Status and events */
+    int rqs_on;
+    int rqs_pending;
+    int event;
+    int error_code;
+    int half_on, full_on, rdy_on, opc_on;
+
+    /* DM5120 */
+    char function[8];
+    int null_on;
+    int bufsz;                  /* 0 = no buffer configured */
+    int circular;
+    int stoint_ms;              /* 0 = STOINT ONE (store each triggered reading) */
+    int storing;                /* STOINT auto-store running */
+    double next_store;
+    float buffer[SIM_MAX_BUFFER];
+    int buf_head;               /* Oldest sample */
+    int buf_count;
+    int half_sent;
+
+    /* Sources */
+    double volts, amps;
+    int output_on;
+    int display_current;
+
+    sim_setting settings[SIM_MAX_SETTINGS];
+    int num_settings;
+
+    /* Statistics */
+    unsigned long commands, enters, spolls, readings, stored, errors;
+} sim_instrument;
+
+static sim_instrument g_rack[SIM_MAX_ADDRESS];
+static unsigned int g_driver_ms = 1;
+static int g_verbose = 0;
+static volatile sig_atomic_t g_quit = 0;
+static double g_start_ms;
+
+/* ----------------------------------------------------------------------- */
+/* Time                                                                     */
+/* ----------------------------------------------------------------------- */
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+}
+
+static void sleep_ms(double ms) {
+    struct timespec ts;
+    if (ms <= 0.0) return;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1.0e6);
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR && !g_quit);
+}
+
+static void sleep_until(double t) {
+    sleep_ms(t - now_ms());
+}
+
+static void trace(const char *fmt, ...) {
+    va_list args;
+    if (!g_verbose) return;
+    fprintf(stderr, "[%10.1f] ", now_ms() - g_start_ms);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+/* ----------------------------------------------------------------------- */
+/* Instrument model                                                         */
+/* ----------------------------------------------------------------------- */
+
+static double gaussian(void) {
+    double u1, u2;
+    do {
+        u1 = (double)rand() / RAND_MAX;
+    } while (u1 <= 1e-12);
+    u2 = (double)rand() / RAND_MAX;
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+static const char *find_setting(sim_instrument *inst, const char *header) {
+    int i;
+    for (i = 0; i < inst->num_settings; i++) {
+        if (strcmp(inst->settings[i].header, header) == 0) {
+            return inst->settings[i].arg;
+        }
+    }
+    return NULL;
+}
+
+static void store_setting(sim_instrument *inst, const char *header, const char *arg) {
+    int i;
+    for (i = 0; i < inst->num_settings; i++) {
+        if (strcmp(inst->settings[i].header, header) == 0) break;
+    }
+    if (i == inst->num_settings) {
+        if (inst->num_settings >= SIM_MAX_SETTINGS) return;
+        inst->num_settings++;
+        strncpy(inst->settings[i].header, header, sizeof(inst->settings[i].header) - 1);
+    }
+    strncpy(inst->settings[i].arg, arg, sizeof(inst->settings[i].arg) - 1);
+}
+
+/* Power-on state; rack parameters are kept */
+static void reset_instrument(sim_instrument *inst) {
+    inst->busy_until = 0.0;
+    inst->reading_pending = 0;
+    inst->reply_ready = 0;
+    inst->rqs_on = 0;
+    inst->rqs_pending = 0;
+    inst->event = SIM_EVENT_NONE;
+    inst->error_code = 0;
+    inst->half_on = inst->full_on = inst->rdy_on = inst->opc_on = 0;
+    strcpy(inst->function, inst->type == SIM_DM5120 ? "DCV" : "");
+    inst->null_on = 0;
+    inst->bufsz = 0;
+    inst->circular = 0;
+    inst->stoint_ms = 0;
+    inst->storing = 0;
+    inst->buf_head = 0;
+    inst->buf_count = 0;
+    inst->half_sent = 0;
+    inst->volts = inst->type == SIM_PS5004 || inst->type == SIM_PS5010 ? inst->value : 0.0;
+    inst->amps = 0.1;
+    inst->output_on = 0;
+    inst->display_current = 0;
+    inst->num_settings = 0;
+}
+
+static void set_reply(sim_instrument *inst, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(inst->reply, sizeof(inst->reply), fmt, args);
+    va_end(args);
+    inst->reply_ready = 1;
+}
+
+static void raise_event(sim_instrument *inst, int event) {
+    inst->event = event;
+    if (inst->rqs_on && inst->srq_allowed) {
+        inst->rqs_pending = 1;
+    }
+}
+
+static void command_error(sim_instrument *inst, int code, const char *unit) {
+    inst->error_code = code;
+    inst->errors++;
+    trace("  error %d on \"%s\"", code, unit);
+}
+
+static unsigned char status_byte(sim_instrument *inst, double t) {
+    unsigned char stb = 0;
+    if (t < inst->busy_until) stb |= SIM_STB_BUSY;
+    if (inst->error_code) stb |= SIM_STB_ABNORMAL;
+    if (inst->rqs_pending) stb |= SIM_STB_RQS | (unsigned char)(inst->event & 0x0F);
+    return stb;
+}
+
+/* One noisy sample of whatever the instrument is measuring */
+static double sample_value(sim_instrument *inst) {
+    double v;
+
+    switch (inst->type) {
+        case SIM_PS5004:
+            if (!inst->output_on) return 0.0;
+            if (inst->display_current) {
+                v = inst->load_ohms > 0.0 ? inst->volts / inst->load_ohms : 0.0;
+                if (v > inst->amps) v = inst->amps;   /* Current limit */
+                return v + inst->noise * 1e-3 * gaussian();
+            }
+            return inst->volts + inst->noise * gaussian();
+        case SIM_PS5010:
+            return inst->output_on ? inst->volts + inst->noise * gaussian() : 0.0;
+        default:
+            v = inst->value + inst->noise * gaussian();
+            if (inst->null_on) v -= inst->value;
+            return v;
+    }
+}
+
+static void format_reading(sim_instrument *inst, double v, char *out, size_t size) {
+    switch (inst->type) {
+        case SIM_DM5120:
+            snprintf(out, size, "%s%s%+.5E", inst->null_on ? "N" : "", inst->function, v);
+            break;
+        case SIM_DC5009:
+        case SIM_DC5010:
+            snprintf(out, size, "FREQ%+.6E", v);
+            break;
+        default:
+            snprintf(out, size, "%+.5E", v);
+            break;
+    }
+}
+
+static double conversion_ms(sim_instrument *inst) {
+    double ms = inst->conv_ms;
+    if (inst->jitter_ms) ms += (double)(rand() % (inst->jitter_ms + 1));
+    return ms;
+}
+
+static void buffer_store(sim_instrument *inst, double v) {
+    int size = inst->circular ? SIM_MAX_BUFFER : inst->bufsz;
+    int tail;
+
+    if (size <= 0) return;
+    if (inst->buf_count >= size) {
+        if (!inst->circular) return;
+        inst->buf_head = (inst->buf_head + 1) % SIM_MAX_BUFFER;
+        inst->buf_count--;
+    }
+    tail = (inst->buf_head + inst->buf_count) % SIM_MAX_BUFFER;
+    inst->buffer[tail] = (float)v;
+    inst->buf_count++;
+    inst->stored++;
+
+    if (inst->half_on && !inst->half_sent && inst->buf_count >= size / 2) {
+        inst->half_sent = 1;
+        raise_event(inst, SIM_EVENT_HALF);
+    }
+    if (!inst->circular && inst->buf_count >= size) {
+        inst->storing = 0;
+        if (inst->full_on) raise_event(inst, SIM_EVENT_FULL);
+    }
+}
+
+static void buffer_clear(sim_instrument *inst) {
+    inst->buf_head = 0;
+    inst->buf_count = 0;
+    inst->half_sent = 0;
+}
+
+/* STOINT period, never shorter than a conversion */
+static double store_interval(sim_instrument *inst) {
+    if (inst->stoint_ms > (int)inst->conv_ms) return (double)inst->stoint_ms;
+    return (double)inst->conv_ms;
+}
+
+static void start_storing(sim_instrument *inst, double t) {
+    double interval;
+
+    if (inst->stoint_ms <= 0 || (inst->bufsz <= 0 && !inst->circular)) {
+        inst->storing = 0;
+        return;
+    }
+    interval = store_interval(inst);
+    inst->storing = 1;
+    inst->next_store = t + interval;
+}
+
+/* Bring time-driven state up to t: completed conversions and STOINT stores */
+static void update_instrument(sim_instrument *inst, double t) {
+    double interval;
+
+    if (inst->reading_pending && t >= inst->busy_until) {
+        char text[40];
+        double v = sample_value(inst);
+
+        format_reading(inst, v, text, sizeof(text));
+        set_reply(inst, "%s", text);
+        inst->reading_pending = 0;
+        inst->readings++;
+        if (inst->type == SIM_DM5120 && inst->stoint_ms == 0) {
+            buffer_store(inst, v);
+        }
+        if (inst->rdy_on) raise_event(inst, SIM_EVENT_RDY);
+    }
+
+    if (inst->storing) {
+        interval = store_interval(inst);
+        while (inst->storing && inst->next_store <= t) {
+            buffer_store(inst, sample_value(inst));
+            inst->readings++;
+            inst->next_store += interval;
+        }
+    }
+}
+
+static void update_rack(double t) {
+    int a;
+    for (a = 0; a < SIM_MAX_ADDRESS; a++) {
+        if (g_rack[a].type != SIM_NONE) update_instrument(&g_rack[a], t);
+    }
+}
+
+static void start_conversion(sim_instrument *inst, double t) {
+    inst->busy_until = t + conversion_ms(inst);
+    inst->reading_pending = 1;
+    inst->reply_ready = 0;
+}
+
+static void buffer_reply(sim_instrument *inst, int all) {
+    char *p = inst->reply;
+    char *end = inst->reply + sizeof(inst->reply) - 32;
+    int n = all ? inst->buf_count : (inst->buf_count ? 1 : 0);
+    int i;
+
+    *p = '\0';
+    for (i = 0; i < n && p < end; i++) {
+        int idx = (inst->buf_head + i) % SIM_MAX_BUFFER;
+        if (i) *p++ = ',';
+        format_reading(inst, inst->buffer[idx], p, (size_t)(end - p));
+        p += strlen(p);
+    }
+    inst->buf_head = (inst->buf_head + n) % SIM_MAX_BUFFER;
+    inst->buf_count -= n;
+    if (inst->buf_count == 0) inst->half_sent = 0;
+    inst->reply_ready = 1;
+}
+
+static void buffer_statistic(sim_instrument *inst, int which) {
+    double sum = 0.0, min = 0.0, max = 0.0, v;
+    int i;
+
+    for (i = 0; i < inst->buf_count; i++) {
+        v = inst->buffer[(inst->buf_head + i) % SIM_MAX_BUFFER];
+        sum += v;
+        if (i == 0 || v < min) min = v;
+        if (i == 0 || v > max) max = v;
+    }
+    switch (which) {
+        case 0:  v = inst->buf_count ? sum / inst->buf_count : 0.0; break;
+        case 1:  v = min; break;
+        default: v = max; break;
+    }
+    set_reply(inst, "%+.5E", v);
+}
+
+static int is_on(const char *arg) {
+    return strncmp(arg, "ON", 2) == 0 || strcmp(arg, "1") == 0;
+}
+
+/* DM5120 commands that need more than the settings table */
+static int dm5120_command(sim_instrument *inst, const char *header, const char *arg, double t) {
+    if (strcmp(header, "X") == 0 ||
+        (strcmp(header, "READ") == 0 && (arg[0] == '\0' || strcmp(arg, "ADC") == 0))) {
+        start_conversion(inst, t);
+    } else if (strcmp(header, "READ") == 0 && strcmp(arg, "ONESTORE") == 0) {
+        buffer_reply(inst, 0);
+    } else if (strcmp(header, "READ") == 0 && strcmp(arg, "ALLSTORE") == 0) {
+        buffer_reply(inst, 1);
+    } else if (strcmp(header, "FUNCT") == 0) {
+        strncpy(inst->function, arg, sizeof(inst->function) - 1);
+        inst->function[sizeof(inst->function) - 1] = '\0';
+        return 0;       /* Also goes into the settings table for FUNCT? */
+    } else if (strcmp(header, "FUNCT?") == 0) {
+        set_reply(inst, "FUNCT %s", inst->function);
+    } else if (strcmp(header, "NULL") == 0) {
+        inst->null_on = is_on(arg);
+        return 0;
+    } else if (strcmp(header, "BUFSZ") == 0) {
+        inst->circular = strcmp(arg, "CIRCULAR") == 0;
+        inst->bufsz = inst->circular ? SIM_MAX_BUFFER : atoi(arg);
+        if (inst->bufsz > SIM_MAX_BUFFER) inst->bufsz = SIM_MAX_BUFFER;
+        buffer_clear(inst);
+        start_storing(inst, t);
+    } else if (strcmp(header, "BUFSZ?") == 0) {
+        if (inst->circular) set_reply(inst, "BUFSZ CIRCULAR");
+        else set_reply(inst, "BUFSZ %d", inst->bufsz);
+    } else if (strcmp(header, "BUFCNT?") == 0) {
+        set_reply(inst, "%d", inst->buf_count);
+    } else if (strcmp(header, "BUFCLR") == 0) {
+        buffer_clear(inst);
+        start_storing(inst, t);
+    } else if (strcmp(header, "BUFAVE?") == 0) {
+        buffer_statistic(inst, 0);
+    } else if (strcmp(header, "BUFMIN?") == 0) {
+        buffer_statistic(inst, 1);
+    } else if (strcmp(header, "BUFMAX?") == 0) {
+        buffer_statistic(inst, 2);
+    } else if (strcmp(header, "STOINT") == 0) {
+        inst->stoint_ms = strcmp(arg, "ONE") == 0 ? 0 : atoi(arg);
+        start_storing(inst, t);
+    } else if (strcmp(header, "STOINT?") == 0) {
+        if (inst->stoint_ms == 0) set_reply(inst, "STOINT ONE");
+        else set_reply(inst, "STOINT %d", inst->stoint_ms);
+    } else if (strcmp(header, "HALF") == 0) {
+        inst->half_on = is_on(arg);
+    } else if (strcmp(header, "FULL") == 0) {
+        inst->full_on = is_on(arg);
+    } else if (strcmp(header, "RDY") == 0) {
+        inst->rdy_on = is_on(arg);
+    } else if (strcmp(header, "OPC") == 0) {
+        inst->opc_on = is_on(arg);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int dm5010_command(sim_instrument *inst, const char *header, const char *arg, double t) {
+    (void)arg;
+    if (strcmp(header, "X") == 0 || strcmp(header, "READ?") == 0 ||
+        strcmp(header, "VAL?") == 0 || strcmp(header, "SEND") == 0) {
+        start_conversion(inst, t);
+        return 1;
+    }
+    return 0;
+}
+
+static int counter_command(sim_instrument *inst, const char *header, const char *arg, double t) {
+    if (strcmp(header, "SEND") == 0 || strcmp(header, "X") == 0) {
+        start_conversion(inst, t);
+        return 1;
+    }
+    if (strcmp(header, "GATE") == 0 && atof(arg) > 0.0) {
+        inst->conv_ms = (unsigned int)(atof(arg) * 1000.0 + 0.5);
+        return 0;
+    }
+    if (strcmp(header, "OVER?") == 0) {
+        set_reply(inst, "OVER OFF");
+        return 1;
+    }
+    return 0;
+}
+
+static int ps5004_command(sim_instrument *inst, const char *header, const char *arg, double t) {
+    if (strcmp(header, "VOLTAGE") == 0) {
+        inst->volts = atof(arg);
+    } else if (strcmp(header, "CURRENT") == 0) {
+        inst->amps = atof(arg);
+    } else if (strcmp(header, "OUTPUT") == 0) {
+        inst->output_on = is_on(arg);
+    } else if (strcmp(header, "DISPLAY") == 0) {
+        inst->display_current = arg[0] == 'C' || arg[0] == 'I';
+    } else if (strcmp(header, "VOLTAGE?") == 0) {
+        set_reply(inst, "VOLTAGE %.4f", inst->volts);
+        return 1;
+    } else if (strcmp(header, "CURRENT?") == 0) {
+        set_reply(inst, "CURRENT %.4f", inst->amps);
+        return 1;
+    } else if (strcmp(header, "REGULATION?") == 0) {
+        int limited = inst->output_on && inst->load_ohms > 0.0 &&
+                      inst->volts / inst->load_ohms > inst->amps;
+        set_reply(inst, "REGULATION %d", limited ? 2 : 1);
+        return 1;
+    } else if (strcmp(header, "SET?") == 0) {
+        set_reply(inst, "VOLTAGE %.4f;CURRENT %.4f;OUTPUT %s;DISPLAY %s",
+                  inst->volts, inst->amps, inst->output_on ? "ON" : "OFF",
+                  inst->display_current ? "CURRENT" : "VOLTAGE");
+        return 1;
+    } else if (strcmp(header, "SEND") == 0) {
+        start_conversion(inst, t);
+        return 1;
+    } else {
+        return 0;
+    }
+    return 0;   /* Settings also go into the table for their queries */
+}
+
+static int ps5010_command(sim_instrument *inst, const char *header, const char *arg, double t) {
+    (void)t;
+    if (strcmp(header, "VPOS") == 0) {
+        inst->volts = atof(arg);
+    } else if (strcmp(header, "OUT") == 0) {
+        inst->output_on = is_on(arg);
+    } else if (strcmp(header, "REG?") == 0) {
+        set_reply(inst, "REG 1,1,1");
+        return 1;
+    } else if (strcmp(header, "SET?") == 0) {
+        const char *vneg = find_setting(inst, "VNEG");
+        const char *vlog = find_setting(inst, "VLOG");
+        set_reply(inst, "VPOS %.2f;VNEG %s;VLOG %s;OUT %s", inst->volts,
+                  vneg ? vneg : "0.00", vlog ? vlog : "5.00",
+                  inst->output_on ? "ON" : "OFF");
+        return 1;
+    }
+    return 0;
+}
+
+/* Execute one message unit ("FUNCT DCV", "BUFCNT?") at an instrument */
+static void instrument_command(sim_instrument *inst, char *unit, double t) {
+    char header[16];
+    const char *arg;
+    const char *value;
+    int handled = 0;
+    int i = 0;
+
+    while (*unit == ' ') unit++;
+    if (*unit == '\0') return;
+    inst->commands++;
+
+    while (unit[i] && unit[i] != ' ' && i < (int)sizeof(header) - 1) {
+        header[i] = (char)toupper((unsigned char)unit[i]);
+        i++;
+    }
+    header[i] = '\0';
+    arg = unit + i;
+    while (*arg == ' ') arg++;
+
+    /* Common to the whole family */
+    if (strcmp(header, "ID?") == 0) {
+        set_reply(inst, "%s", sim_types[inst->type].id);
+        return;
+    }
+    if (strcmp(header, "*IDN?") == 0) {
+        set_reply(inst, "TEKTRONIX,%s,0,SIM3.5", sim_types[inst->type].name);
+        return;
+    }
+    if (strcmp(header, "INIT") == 0 || strcmp(header, "*RST") == 0) {
+        reset_instrument(inst);
+        inst->busy_until = t + inst->setup_ms;
+        return;
+    }
+    if (strcmp(header, "ERR?") == 0 || strcmp(header, "ERROR?") == 0 ||
+        strcmp(header, "SYST:ERR?") == 0) {
+        set_reply(inst, "ERR %d", inst->error_code);
+        inst->error_code = 0;
+        return;
+    }
+    if (strcmp(header, "*CLS") == 0) {
+        inst->error_code = 0;
+        inst->event = SIM_EVENT_NONE;
+        inst->rqs_pending = 0;
+        return;
+    }
+    if (strcmp(header, "*STB?") == 0) {
+        set_reply(inst, "%d", status_byte(inst, t));
+        return;
+    }
+    if (strcmp(header, "EVENT?") == 0) {
+        set_reply(inst, "EVENT %d", inst->event);
+        inst->event = SIM_EVENT_NONE;
+        return;
+    }
+    if (strcmp(header, "RQS") == 0) {
+        inst->rqs_on = is_on(arg);
+        return;
+    }
+
+    switch (inst->type) {
+        case SIM_DM5120: handled = dm5120_command(inst, header, arg, t); break;
+        case SIM_DM5010: handled = dm5010_command(inst, header, arg, t); break;
+        case SIM_PS5004: handled = ps5004_command(inst, header, arg, t); break;
+        case SIM_PS5010: handled = ps5010_command(inst, header, arg, t); break;
+        case SIM_DC5009:
+        case SIM_DC5010: handled = counter_command(inst, header, arg, t); break;
+        default: break;
+    }
+    if (handled) return;
+
+    /* Everything else is a setting: remember it and answer its query */
+    i = (int)strlen(header);
+    if (i > 1 && header[i - 1] == '?') {
+        header[i - 1] = '\0';
+        value = find_setting(inst, header);
+        if (value) {
+            set_reply(inst, "%s %s", header, value);
+        } else {
+            command_error(inst, 102, unit);
+        }
+        return;
+    }
+    store_setting(inst, header, arg);
+    if (t + inst->setup_ms > inst->busy_until) {
+        inst->busy_until = t + inst->setup_ms;
+    }
+    if (inst->opc_on) raise_event(inst, SIM_EVENT_OPC);
+}
+
+/* Trigger source set to the bus - TRIGGER GET on the DM5120, TRIG:SOUR
+ * BUS on the DM5010.  Such a meter converts on a Group Execute Trigger
+ * and not when addressed to talk; every other source ignores GET. */
+static int bus_triggered(sim_instrument *inst) {
+    const char *source;
+
+    if (inst->type == SIM_DM5120) {
+        source = find_setting(inst, "TRIGGER");
+    } else if (inst->type == SIM_DM5010) {
+        source = find_setting(inst, "TRIG:SOUR");
+    } else {
+        return 0;
+    }
+    return source && (strncmp(source, "GET", 3) == 0 || strncmp(source, "BUS", 3) == 0);
+}
+
+/* Measurement instruments in talk-triggered mode produce a reading when
+ * addressed to talk with nothing queued */
+static int talk_triggers(sim_instrument *inst) {
+    if (bus_triggered(inst)) return 0;
+    return inst->type == SIM_DM5120 || inst->type == SIM_DM5010 ||
+           inst->type == SIM_DC5009 || inst->type == SIM_DC5010 ||
+           inst->type == SIM_PS5004;
+}
+
+/* ----------------------------------------------------------------------- */
+/* Rack description                                                         */
+/* ----------------------------------------------------------------------- */
+
+static void add_instrument(int address, int type) {
+    sim_instrument *inst = &g_rack[address];
+
+    memset(inst, 0, sizeof(*inst));
+    inst->type = type;
+    inst->conv_ms = sim_types[type].conv_ms;
+    inst->setup_ms = sim_types[type].setup_ms;
+    inst->value = sim_types[type].value;
+    inst->noise = sim_types[type].noise;
+    inst->load_ohms = 100.0;
+    inst->srq_allowed = 1;
+    reset_instrument(inst);
+}
+
+static void default_rack(void) {
+    add_instrument(16, SIM_DM5120);
+    add_instrument(17, SIM_DM5010);
+    add_instrument(18, SIM_PS5004);
+    add_instrument(19, SIM_PS5010);
+    add_instrument(20, SIM_DC5009);
+    add_instrument(21, SIM_DC5010);
+    add_instrument(22, SIM_FG5010);
+}
+
+static int load_rack(const char *filename) {
+    FILE *fp;
+    char line[256];
+    int line_no = 0;
+    int count = 0;
+
+    fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "sim5000: cannot open %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *tok;
+        char *hash;
+        int address, type;
+        sim_instrument *inst;
+
+        line_no++;
+        if ((hash = strchr(line, '#')) != NULL) *hash = '\0';
+        tok = strtok(line, " \t\r\n");
+        if (!tok) continue;
+
+        address = atoi(tok);
+        tok = strtok(NULL, " \t\r\n");
+        if (address < 0 || address >= SIM_MAX_ADDRESS || !tok) {
+            fprintf(stderr, "sim5000: %s:%d: expected <address> <type>\n", filename, line_no);
+            fclose(fp);
+            return -1;
+        }
+        for (type = 1; type < SIM_NUM_TYPES; type++) {
+            if (strcasecmp(tok, sim_types[type].name) == 0) break;
+        }
+        if (type == SIM_NUM_TYPES) {
+            fprintf(stderr, "sim5000: %s:%d: unknown type %s\n", filename, line_no, tok);
+            fclose(fp);
+            return -1;
+        }
+        add_instrument(address, type);
+        inst = &g_rack[address];
+
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            char *eq = strchr(tok, '=');
+            if (!eq) continue;
+            *eq++ = '\0';
+            if (strcmp(tok, "conv") == 0)        inst->conv_ms = (unsigned int)atoi(eq);
+            else if (strcmp(tok, "setup") == 0)  inst->setup_ms = (unsigned int)atoi(eq);
+            else if (strcmp(tok, "jitter") == 0) inst->jitter_ms = (unsigned int)atoi(eq);
+            else if (strcmp(tok, "value") == 0)  inst->value = atof(eq);
+            else if (strcmp(tok, "noise") == 0)  inst->noise = atof(eq);
+            else if (strcmp(tok, "load") == 0)   inst->load_ohms = atof(eq);
+            else if (strcmp(tok, "srq") == 0)    inst->srq_allowed = atoi(eq);
+            else fprintf(stderr, "sim5000: %s:%d: unknown key %s\n", filename, line_no, tok);
+        }
+        reset_instrument(inst);
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+/* ----------------------------------------------------------------------- */
+/* Driver488 protocol                                                       */
+/* ----------------------------------------------------------------------- */
+
+static int g_cmd_fd = -1;       /* Program -> simulator (ieeeout) */
+static int g_reply_fd = -1;     /* Simulator -> program (ieeein) */
+
+/* One write per response so a reader sees the whole line at once,
+ * as it does from the real driver */
+static void send_line(const char *text) {
+    static char line[SIM_REPLY_SIZE + 2];
+    size_t len = strlen(text);
+
+    trace("  <- %s", text);
+    memcpy(line, text, len);
+    line[len++] = '\r';
+    line[len++] = '\n';
+    if (write(g_reply_fd, line, len) < 0) {
+        trace("  reply write failed: %s", strerror(errno));
+    }
+}
+
+static sim_instrument *instrument_at(int address) {
+    if (address < 0 || address >= SIM_MAX_ADDRESS) return NULL;
+    if (g_rack[address].type == SIM_NONE) return NULL;
+    return &g_rack[address];
+}
+
+/* "output 16;FUNCT DCV;RANGE AUTO" */
+static void driver_output(char *args, double t) {
+    char *data = strchr(args, ';');
+    char *unit;
+    sim_instrument *inst;
+
+    if (!data) return;
+    *data++ = '\0';
+    inst = instrument_at(atoi(args));
+    if (!inst) {
+        trace("  no instrument at %d", atoi(args));
+        return;
+    }
+    inst->remote = 1;
+    unit = strtok(data, ";");
+    while (unit) {
+        instrument_command(inst, unit, t);
+        unit = strtok(NULL, ";");
+    }
+}
+
+/* "enter 16" */
+static void driver_enter(char *args) {
+    sim_instrument *inst = instrument_at(atoi(args));
+
+    if (!inst) {
+        send_line("");
+        return;
+    }
+    inst->enters++;
+
+    /* Talk-triggered reading when nothing is queued */
+    if (!inst->reply_ready && !inst->reading_pending && talk_triggers(inst)) {
+        start_conversion(inst, now_ms());
+    }
+    if (inst->reading_pending) {
+        sleep_until(inst->busy_until);
+        update_instrument(inst, now_ms());
+    }
+    if (inst->reply_ready) {
+        inst->reply_ready = 0;
+        send_line(inst->reply);
+    } else {
+        send_line("");
+    }
+}
+
+/* "spoll 16", "spoll 16,17,18" or "spoll" (SRQ line state) */
+static void driver_spoll(char *args, double t) {
+    char reply[SIM_LINE_SIZE];
+    char *p = reply;
+    char *tok;
+    int a;
+
+    while (*args == ' ') args++;
+    if (*args == '\0') {
+        int srq = 0;
+        for (a = 0; a < SIM_MAX_ADDRESS; a++) {
+            if (g_rack[a].type != SIM_NONE && g_rack[a].rqs_pending) srq = 1;
+        }
+        send_line(srq ? "-1" : "0");
+        return;
+    }
+
+    reply[0] = '\0';
+    for (tok = strtok(args, ", "); tok; tok = strtok(NULL, ", ")) {
+        sim_instrument *inst = instrument_at(atoi(tok));
+        int stb = 0;
+
+        if (inst) {
+            inst->spolls++;
+            stb = status_byte(inst, t);
+            inst->rqs_pending = 0;
+        }
+        if (p != reply && p < reply + sizeof(reply) - 8) *p++ = ',';
+        p += sprintf(p, "%d", stb);
+    }
+    send_line(reply);
+}
+
+/* "remote 16", "local 16", "clear 16", "trigger 16,17" - no address means all */
+static void driver_address_command(const char *verb, char *args, double t) {
+    char *tok;
+    int a;
+    int any = 0;
+
+    for (tok = strtok(args, ", "); tok; tok = strtok(NULL, ", ")) {
+        sim_instrument *inst = instrument_at(atoi(tok));
+        any = 1;
+        if (!inst) continue;
+        if (strcmp(verb, "remote") == 0) {
+            inst->remote = 1;
+        } else if (strcmp(verb, "local") == 0) {
+            inst->remote = 0;
+        } else if (strcmp(verb, "clear") == 0) {
+            inst->reply_ready = 0;
+            inst->reading_pending = 0;
+            inst->busy_until = t + inst->setup_ms;
+        } else if (strcmp(verb, "trigger") == 0 && bus_triggered(inst)) {
+            start_conversion(inst, t);
+        }
+    }
+    if (!any) {
+        for (a = 0; a < SIM_MAX_ADDRESS; a++) {
+            if (g_rack[a].type == SIM_NONE) continue;
+            if (strcmp(verb, "remote") == 0) g_rack[a].remote = 1;
+            else if (strcmp(verb, "local") == 0) g_rack[a].remote = 0;
+        }
+    }
+}
+
+static void driver_command(char *line) {
+    char verb[16];
+    char *args;
+    double t;
+    int i = 0;
+
+    while (*line == ' ') line++;
+    if (*line == '\0') return;
+    trace("-> %s", line);
+
+    while (line[i] && line[i] != ' ' && i < (int)sizeof(verb) - 1) {
+        verb[i] = (char)tolower((unsigned char)line[i]);
+        i++;
+    }
+    verb[i] = '\0';
+    args = line + i;
+
+    sleep_ms(g_driver_ms);
+    t = now_ms();
+    update_rack(t);
+
+    if (strcmp(verb, "output") == 0) {
+        driver_output(args, t);
+    } else if (strcmp(verb, "enter") == 0) {
+        driver_enter(args);
+    } else if (strcmp(verb, "spoll") == 0) {
+        driver_spoll(args, t);
+    } else if (strcmp(verb, "remote") == 0 || strcmp(verb, "local") == 0 ||
+               strcmp(verb, "clear") == 0 || strcmp(verb, "trigger") == 0) {
+        driver_address_command(verb, args, t);
+    } else if (strcmp(verb, "hello") == 0) {
+        send_line("Driver488 simulator (sim5000) Revision 3.5");
+    } else if (strcmp(verb, "status") == 0) {
+        send_line("  C 21 S0 T0 L0 NO ERROR");
+    } else if (strcmp(verb, "abort") == 0 || strcmp(verb, "reset") == 0) {
+        for (i = 0; i < SIM_MAX_ADDRESS; i++) {
+            g_rack[i].reply_ready = 0;
+        }
+    } else {
+        /* fill, eol, timeout, term... accepted and ignored */
+        trace("  ignored");
+    }
+}
+
+/* ----------------------------------------------------------------------- */
+/* Endpoints and main loop                                                  */
+/* ----------------------------------------------------------------------- */
+
+static int make_fifo(const char *path) {
+    struct stat st;
+
+    if (stat(path, &st) == 0) {
+        if (S_ISFIFO(st.st_mode)) return 0;
+        fprintf(stderr, "sim5000: %s exists and is not a FIFO\n", path);
+        return -1;
+    }
+    if (mkfifo(path, 0666) < 0) {
+        fprintf(stderr, "sim5000: mkfifo %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Same order as init_gpib_system(): ieeeout first, then ieeein */
+static int open_fifos(const char *out_path, const char *in_path) {
+    g_cmd_fd = open(out_path, O_RDONLY);
+    if (g_cmd_fd < 0) return -1;
+    g_reply_fd = open(in_path, O_WRONLY);
+    if (g_reply_fd < 0) {
+        close(g_cmd_fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int open_pty(void) {
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+        fprintf(stderr, "sim5000: pty: %s\n", strerror(errno));
+        return -1;
+    }
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    printf("sim5000: TM5000_IEEEOUT=%s TM5000_IEEEIN=%s\n", ptsname(fd), ptsname(fd));
+    fflush(stdout);
+    g_cmd_fd = fd;
+    g_reply_fd = fd;
+    return 0;
+}
+
+/* Read commands until the program closes its end.  Returns 0 on EOF. */
+static int serve(void) {
+    char chunk[256];
+    char line[SIM_LINE_SIZE];
+    int len = 0;
+    ssize_t n;
+    ssize_t i;
+
+    while (!g_quit) {
+        n = read(g_cmd_fd, chunk, sizeof(chunk));
+        if (n == 0) return 0;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EIO) return 0;     /* pty slave closed */
+            return -1;
+        }
+        for (i = 0; i < n; i++) {
+            if (chunk[i] == '\n' || chunk[i] == '\r') {
+                line[len] = '\0';
+                if (len) driver_command(line);
+                len = 0;
+            } else if (len < (int)sizeof(line) - 1) {
+                line[len++] = chunk[i];
+            }
+        }
+    }
+    return 0;
+}
+
+static void print_statistics(void) {
+    int a;
+
+    fprintf(stderr, "\nsim5000: session statistics (%.1f s)\n", (now_ms() - g_start_ms) / 1000.0);
+    fprintf(stderr, "Addr Type    Commands   Enters   Spolls Readings   Stored Errors\n");
+    for (a = 0; a < SIM_MAX_ADDRESS; a++) {
+        sim_instrument *inst = &g_rack[a];
+        if (inst->type == SIM_NONE) continue;
+        fprintf(stderr, "%4d %-6s %9lu %8lu %8lu %8lu %8lu %6lu\n", a,
+                sim_types[inst->type].name, inst->commands, inst->enters,
+                inst->spolls, inst->readings, inst->stored, inst->errors);
+    }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_quit = 1;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: sim5000 [-c rack.cfg] [-o ieeeout] [-i ieeein] [-p] [-l ms] [-v] [-1]\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *rack_file = NULL;
+    const char *out_path = "ieeeout";
+    const char *in_path = "ieeein";
+    int use_pty = 0;
+    int once = 0;
+    int opt;
+    struct sigaction sa;
+
+    while ((opt = getopt(argc, argv, "c:o:i:pl:v1")) != -1) {
+        switch (opt) {
+            case 'c': rack_file = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'i': in_path = optarg; break;
+            case 'p': use_pty = 1; break;
+            case 'l': g_driver_ms = (unsigned int)atoi(optarg); break;
+            case 'v': g_verbose = 1; break;
+            case '1': once = 1; break;
+            default:  usage(); return 2;
+        }
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    srand((unsigned int)time(NULL));
+    g_start_ms = now_ms();
+
+    if (rack_file) {
+        if (load_rack(rack_file) <= 0) return 1;
+    } else {
+        default_rack();
+    }
+
+    if (use_pty) {
+        if (open_pty() < 0) return 1;
+        serve();
+    } else {
+        if (make_fifo(out_path) < 0 || make_fifo(in_path) < 0) return 1;
+        do {
+            fprintf(stderr, "sim5000: waiting on %s / %s\n", out_path, in_path);
+            if (open_fifos(out_path, in_path) < 0) {
+                if (errno == EINTR) break;
+                fprintf(stderr, "sim5000: open: %s\n", strerror(errno));
+                return 1;
+            }
+            serve();
+            close(g_cmd_fd);
+            close(g_reply_fd);
+        } while (!once && !g_quit);
+    }
+
+    print_statistics();
+    return 0;
+}
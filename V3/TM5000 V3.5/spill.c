@@ -0,0 +1,356 @@
+/*
+ * TM5000 GPIB Control System - Disk Spill Logging
+ * Version 3.5
+ * Session files that hold every sample of a spill slot while only the
+ * most recent window stays in the RAM ring
+ *
+ * A spill slot runs its buffer as a ring.  Samples that are not on disk
+ * yet are counted as pending; the monitor writes them out in chunks of
+ * SPILL_CHUNK_SAMPLES from its idle time, and store_module_sample forces
+ * a flush before the ring would overwrite an unwritten sample, so nothing
+ * is lost when the monitor is busy.  After the run the graph and math
+ * pages older windows back into the slot buffer from the file.
+ *
+ * Version History:
+ * 3.5 - Initial implementation for multi-day logging past the buffer size
+ * 3.5 - Chunks for every channel of a multi-channel slot (file version 2)
+ */
+
+#include "spill.h"
+#include "data.h"
+
+typedef struct {
+    unsigned long written;         /* Samples on disk */
+    unsigned long window_first;    /* Session sample number of buffer sample 0 */
+    long last_chunk;               /* Offset of the newest chunk, -1 if none */
+    unsigned int pending;          /* Samples in RAM not yet on disk */
+    unsigned int in_session:1;
+    unsigned int reserved:15;
+} spill_slot_state;
+
+static spill_slot_state g_spill_slot[10];
+static FILE *g_spill_fp = NULL;
+static char g_spill_name[13] = "";
+static int g_spill_writing = 0;
+static unsigned int g_spill_error_count = 0;
+static unsigned long g_spill_bytes = 0;
+
+/* One chunk staged in near memory so it goes out in a single fwrite */
+static spill_record g_spill_stage[SPILL_CHUNK_SAMPLES];
+
+/* Disk full or write error - stop spilling, the RAM ring carries on */
+static void spill_fail(void) {
+    g_spill_error_count++;
+    g_spill_writing = 0;
+    if (g_spill_fp) {
+        fclose(g_spill_fp);
+        g_spill_fp = NULL;
+    }
+}
+
+/* Write up to one chunk of the oldest pending samples of slot */
+static int write_chunk(int slot, unsigned int count) {
+    tm5000_module *m = &g_system->modules[slot];
+    spill_slot_state *s = &g_spill_slot[slot];
+    spill_chunk_header chunk;
+    unsigned int first;
+    unsigned int i;
+    long offset;
+    int c;
+
+    if (!g_spill_fp) return 0;
+    if (s->pending > m->module_data_count) s->pending = m->module_data_count;
+    if (count > s->pending) count = s->pending;
+    if (count > SPILL_CHUNK_SAMPLES) count = SPILL_CHUNK_SAMPLES;
+    if (count == 0) return 0;
+
+    first = m->module_data_count - s->pending;
+    offset = ftell(g_spill_fp);
+    if (offset < 0) {
+        spill_fail();
+        return 0;
+    }
+
+    chunk.magic[0] = 'C';
+    chunk.magic[1] = 'K';
+    chunk.slot = (unsigned char)slot;
+    chunk.count = count;
+    chunk.first_index = s->written;
+
+    for (c = 0; c < slot_channel_count(slot); c++) {
+        for (i = 0; i < count; i++) {
+            g_spill_stage[i].value = channel_data_at(slot, c, first + i);
+            g_spill_stage[i].time_ms = module_time_ms(slot, first + i);
+        }
+        chunk.channel = (unsigned char)c;
+        chunk.prev_offset = c == 0 ? s->last_chunk : offset;
+
+        if (fwrite(&chunk, sizeof(chunk), 1, g_spill_fp) != 1 ||
+            fwrite(g_spill_stage, sizeof(spill_record), count, g_spill_fp) != count) {
+            spill_fail();
+            return 0;
+        }
+        g_spill_bytes += sizeof(chunk) + (unsigned long)count * sizeof(spill_record);
+    }
+
+    s->last_chunk = offset;
+    s->written += count;
+    s->pending -= count;
+    return 1;
+}
+
+static void flush_slot(int slot) {
+    while (g_spill_slot[slot].pending > 0 &&
+           write_chunk(slot, g_spill_slot[slot].pending)) {
+    }
+}
+
+int spill_start(void) {
+    spill_file_header header;
+    unsigned int mask = 0;
+    unsigned int n;
+    FILE *probe;
+    int i;
+
+    spill_stop();
+    g_spill_error_count = 0;
+
+    for (i = 0; i < 10; i++) {
+        memset(&g_spill_slot[i], 0, sizeof(spill_slot_state));
+        g_spill_slot[i].last_chunk = -1;
+        if (g_system->modules[i].enabled && g_system->modules[i].spill &&
+            g_system->modules[i].module_data) {
+            mask |= 1 << i;
+        }
+    }
+    g_spill_name[0] = '\0';
+    g_spill_bytes = 0;
+    if (!mask) return 0;
+
+    /* Next unused session number - earlier sessions are kept */
+    for (n = 1; n < 10000; n++) {
+        sprintf(g_spill_name, "TM5S%04u.DAT", n);
+        probe = fopen(g_spill_name, "rb");
+        if (!probe) break;
+        fclose(probe);
+    }
+
+    g_spill_fp = fopen(g_spill_name, "wb");
+    if (!g_spill_fp) {
+        g_spill_error_count++;
+        g_spill_name[0] = '\0';
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "TM5SPILL", 8);
+    header.version = SPILL_VERSION;
+    header.chunk_samples = SPILL_CHUNK_SAMPLES;
+    header.start_time = (unsigned long)session_start_time();
+    header.sample_rate_ms = g_control_panel.sample_rate_ms;
+    header.slot_mask = mask;
+    if (fwrite(&header, sizeof(header), 1, g_spill_fp) != 1) {
+        spill_fail();
+        g_spill_name[0] = '\0';
+        return 0;
+    }
+    g_spill_bytes = sizeof(header);
+
+    for (i = 0; i < 10; i++) {
+        if (mask & (1 << i)) g_spill_slot[i].in_session = 1;
+    }
+    g_spill_writing = 1;
+    return 1;
+}
+
+void spill_stop(void) {
+    int i;
+
+    if (g_spill_writing) {
+        for (i = 0; i < 10; i++) {
+            if (g_spill_slot[i].in_session) flush_slot(i);
+        }
+    }
+    if (g_spill_fp) {
+        fclose(g_spill_fp);
+        g_spill_fp = NULL;
+    }
+    g_spill_writing = 0;
+
+    /* The buffer now holds the newest samples of the session */
+    for (i = 0; i < 10; i++) {
+        if (g_spill_slot[i].in_session) {
+            g_spill_slot[i].window_first = spill_total(i) -
+                                           g_system->modules[i].module_data_count;
+        }
+    }
+}
+
+void spill_sample_stored(int slot) {
+    spill_slot_state *s = &g_spill_slot[slot];
+
+    if (!g_spill_writing || !s->in_session) return;
+
+    s->pending++;
+    if (s->pending >= g_system->modules[slot].module_data_size) {
+        flush_slot(slot);
+    }
+}
+
+void spill_service(void) {
+    int i;
+
+    if (!g_spill_writing) return;
+
+    for (i = 0; i < 10; i++) {
+        if (g_spill_slot[i].in_session &&
+            g_spill_slot[i].pending >= SPILL_CHUNK_SAMPLES) {
+            write_chunk(i, SPILL_CHUNK_SAMPLES);
+        }
+    }
+}
+
+int spill_page_in(int slot, unsigned long first_index) {
+    tm5000_module *m;
+    spill_slot_state *s;
+    spill_chunk_header chunk;
+    spill_record record;
+    FILE *fp;
+    long offset;
+    unsigned long wanted, loaded = 0;
+    unsigned long index;
+    unsigned int i;
+    float last_reading;
+
+    if (slot < 0 || slot >= 10) return 0;
+    m = &g_system->modules[slot];
+    s = &g_spill_slot[slot];
+    if (g_spill_writing || !s->in_session || s->written == 0 ||
+        !m->module_data || g_spill_name[0] == '\0') {
+        return 0;
+    }
+
+    wanted = s->written < m->module_data_size ? s->written : m->module_data_size;
+    if (first_index > s->written - wanted) first_index = s->written - wanted;
+    if (first_index == s->window_first && m->module_data_count == wanted) return 0;
+
+    fp = fopen(g_spill_name, "rb");
+    if (!fp) return 0;
+
+    /* Follow this slot's chunks back to the one holding first_index */
+    offset = s->last_chunk;
+    while (offset >= 0) {
+        if (fseek(fp, offset, SEEK_SET) != 0 ||
+            fread(&chunk, sizeof(chunk), 1, fp) != 1) {
+            offset = -1;
+            break;
+        }
+        if (chunk.first_index <= first_index) break;
+        offset = chunk.prev_offset;
+    }
+    if (offset < 0 || fseek(fp, offset, SEEK_SET) != 0) {
+        fclose(fp);
+        return 0;
+    }
+
+    last_reading = m->last_reading;
+    clear_module_data(slot);
+
+    /* Then forward through the interleaved chunks of all slots, up to the
+     * channel chunks that follow the last channel 0 chunk read */
+    while (fread(&chunk, sizeof(chunk), 1, fp) == 1 &&
+           chunk.magic[0] == 'C' && chunk.magic[1] == 'K') {
+        if (chunk.slot == slot && chunk.channel > 0) {
+            for (i = 0; i < chunk.count; i++) {
+                if (fread(&record, sizeof(record), 1, fp) != 1) break;
+                index = chunk.first_index + i;
+                if (index >= first_index && index < first_index + loaded) {
+                    channel_store_at(slot, chunk.channel, (unsigned int)(index - first_index),
+                                     record.value);
+                }
+            }
+            if (i < chunk.count) break;                     /* Short read */
+            continue;
+        }
+        if (loaded >= wanted) break;
+        if (chunk.slot != slot || chunk.first_index + chunk.count <= first_index) {
+            if (fseek(fp, (long)chunk.count * (long)sizeof(spill_record), SEEK_CUR) != 0) break;
+            continue;
+        }
+        for (i = 0; i < chunk.count && loaded < wanted; i++) {
+            if (fread(&record, sizeof(record), 1, fp) != 1) break;
+            index = chunk.first_index + i;
+            if (index < first_index) continue;
+            store_module_sample(slot, record.value, record.time_ms);
+            loaded++;
+        }
+        if (i < chunk.count) {
+            if (loaded < wanted) break;                     /* Short read */
+            /* Window full part way in - step over the rest to its channels */
+            if (fseek(fp, (long)(chunk.count - i) * (long)sizeof(spill_record), SEEK_CUR) != 0) break;
+        }
+    }
+    fclose(fp);
+
+    m->last_reading = last_reading;
+    s->window_first = first_index;
+    return 1;
+}
+
+int spill_page_all(int direction) {
+    unsigned long first;
+    unsigned int step;
+    int paged = 0;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        if (!spill_has_history(i)) continue;
+
+        step = g_system->modules[i].module_data_size / 2;
+        if (step == 0) step = 1;
+        first = g_spill_slot[i].window_first;
+        if (direction < 0) {
+            first = first > step ? first - step : 0;
+        } else {
+            first += step;
+        }
+        if (spill_page_in(i, first)) paged++;
+    }
+    return paged;
+}
+
+int spill_active(void) {
+    return g_spill_writing;
+}
+
+/* Session samples exist outside the current buffer window */
+int spill_has_history(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    if (g_spill_writing || !g_spill_slot[slot].in_session || g_spill_name[0] == '\0') {
+        return 0;
+    }
+    return g_spill_slot[slot].written > g_system->modules[slot].module_data_count ||
+           g_spill_slot[slot].window_first > 0;
+}
+
+unsigned long spill_total(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return g_spill_slot[slot].written + g_spill_slot[slot].pending;
+}
+
+unsigned long spill_window_first(int slot) {
+    if (slot < 0 || slot >= 10) return 0;
+    return g_spill_slot[slot].window_first;
+}
+
+unsigned long spill_bytes_written(void) {
+    return g_spill_bytes;
+}
+
+unsigned int spill_errors(void) {
+    return g_spill_error_count;
+}
+
+const char *spill_file_name(void) {
+    return g_spill_name;
+}
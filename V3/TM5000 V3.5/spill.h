@@ -0,0 +1,79 @@
+/*
+ * TM5000 GPIB Control System - Disk Spill Logging
+ * Version 3.5
+ * Header file for session files that hold samples beyond the RAM window
+ *
+ * Version History:
+ * 3.5 - Initial implementation for multi-day logging past the buffer size
+ * 3.5 - Chunks for every channel of a multi-channel slot (file version 2)
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include "tm5000.h"
+
+#define SPILL_CHUNK_SAMPLES  256       /* Samples per chunk written by spill_service */
+#define SPILL_VERSION        2
+
+/* Session file header - one per file */
+typedef struct {
+    char magic[8];                 /* "TM5SPILL" */
+    unsigned int version;
+    unsigned int chunk_samples;
+    unsigned long start_time;      /* Wall clock at session start (time_t) */
+    unsigned int sample_rate_ms;
+    unsigned int slot_mask;        /* Slots spilled in this session */
+} spill_file_header;
+
+/* Chunk header - followed by count spill_record entries.  Chunks of all
+ * slots are interleaved in acquisition order; prev_offset links the chunks
+ * of one slot backwards so paging never scans the whole file.  Channels 1
+ * up of the same samples are written right after the channel 0 chunk and
+ * point back to it; only channel 0 chunks are in the slot's chain. */
+typedef struct {
+    char magic[2];                 /* "CK" */
+    unsigned char slot;
+    unsigned char channel;
+    unsigned int count;
+    unsigned long first_index;     /* Session sample number of the first record */
+    long prev_offset;              /* Previous chunk of this slot, -1 if none */
+} spill_chunk_header;
+
+typedef struct {
+    float value;
+    unsigned long time_ms;         /* ms from session start */
+} spill_record;
+
+/* Open a new session file if any slot has spill enabled.  Returns 1 when
+ * spilling. */
+int spill_start(void);
+
+/* Flush everything still in RAM and close the session file */
+void spill_stop(void);
+
+/* Called by store_module_sample for spill slots - flushes at once if the
+ * next store would overwrite a sample that is not on disk yet */
+void spill_sample_stored(int slot);
+
+/* Write one chunk for each slot with a full chunk pending - called from
+ * idle time in the monitor loop */
+void spill_service(void);
+
+/* Load the window starting at session sample first_index into the slot
+ * buffer.  Returns 1 when the window changed. */
+int spill_page_in(int slot, unsigned long first_index);
+
+/* Move the window of every spilled slot half a buffer back (-1) or
+ * forward (+1).  Returns the number of slots paged. */
+int spill_page_all(int direction);
+
+int spill_active(void);
+int spill_has_history(int slot);
+unsigned long spill_total(int slot);
+unsigned long spill_window_first(int slot);
+unsigned long spill_bytes_written(void);
+unsigned int spill_errors(void);
+const char *spill_file_name(void);
+
+#endif /* SPILL_H */
@@ -0,0 +1,178 @@
+/*
+ * TM5000 GPIB Control System - Timebase
+ * Version 3.5
+ * Millisecond/microsecond timestamps for acquisition pacing
+ *
+ * The BIOS tick at 0040:006C only moves every 54.9 ms, which made the
+ * 100 ms preset jitter between 55 and 110 ms.  On DOS the tick count is
+ * combined with the 8253 PIT channel 0 counter (1.193182 MHz, 0.838 us
+ * per count).  Channel 0 is switched from mode 3 to mode 2 with the same
+ * 65536 divisor so the counter runs down once per tick instead of twice;
+ * the tick rate and the BIOS clock are unchanged.  The Linux host build
+ * uses clock_gettime(CLOCK_MONOTONIC).
+ *
+ * Version History:
+ * 3.5 - Initial implementation replacing the 18.2 Hz BIOS tick
+ */
+
+#include "timebase.h"
+
+#ifdef __WATCOMC__
+
+#include <conio.h>
+#include <i86.h>
+
+#define PIT_CONTROL     0x43
+#define PIT_CHANNEL0    0x40
+#define PIC_COMMAND     0x20
+#define PIT_MODE2       0x34    /* Channel 0, lo/hi byte, rate generator */
+#define PIT_MODE3       0x36    /* Channel 0, lo/hi byte, square wave (BIOS default) */
+#define PIT_LATCH0      0x00    /* Counter latch, channel 0 */
+#define PIC_READ_IRR    0x0A
+#define TICKS_PER_DAY   0x1800B0L
+#define DAY_US_WRAP     500654080UL   /* 86400000000 mod 2^32 */
+
+#define BIOS_TICKS (*((unsigned long volatile far *)0x0040006CL))
+
+static int g_tb_pit_mode2 = 0;
+static unsigned long g_tb_last_ticks = 0;
+static unsigned long g_tb_day_ms = 0;     /* Midnight rollovers, ms */
+static unsigned long g_tb_day_us = 0;     /* Same, modulo 2^32 us */
+static unsigned long g_tb_base_ms = 0;
+static unsigned long g_tb_base_us = 0;
+
+/* Ticks since midnight and PIT counts elapsed within the current tick */
+static void tb_read(unsigned long *ticks, unsigned int *counts) {
+    unsigned char lo, hi, irr;
+    unsigned int remaining;
+
+    _disable();
+    outp(PIT_CONTROL, PIT_LATCH0);
+    lo = (unsigned char)inp(PIT_CHANNEL0);
+    hi = (unsigned char)inp(PIT_CHANNEL0);
+    *ticks = BIOS_TICKS;
+    outp(PIC_COMMAND, PIC_READ_IRR);
+    irr = (unsigned char)inp(PIC_COMMAND);
+    _enable();
+
+    remaining = ((unsigned int)hi << 8) | lo;
+    *counts = remaining ? (unsigned int)(65536L - remaining) : 0;
+
+    /* Counter wrapped but IRQ 0 has not run yet - the tick is stale */
+    if ((irr & 0x01) && *counts < 0x8000U) {
+        (*ticks)++;
+    }
+    if (!g_tb_pit_mode2) {
+        *counts = 0;    /* Mode 3 counts down twice per tick - unusable */
+    }
+
+    if (*ticks < g_tb_last_ticks) {
+        g_tb_day_ms += 86400000UL;
+        g_tb_day_us += DAY_US_WRAP;
+    }
+    g_tb_last_ticks = *ticks;
+}
+
+static unsigned long tb_raw_ms(void) {
+    unsigned long ticks;
+    unsigned int counts;
+
+    tb_read(&ticks, &counts);
+    /* 54.9254 ms per tick, 1193 counts per ms */
+    return g_tb_day_ms + ticks * 54L + (ticks * 37L) / 40L + counts / 1193U;
+}
+
+static unsigned long tb_raw_us(void) {
+    unsigned long ticks;
+    unsigned int counts;
+
+    tb_read(&ticks, &counts);
+    /* 54925.49 us per tick, 0.838 us per count - wraps modulo 2^32 */
+    return g_tb_day_us + ticks * 54925UL + (ticks * 493UL) / 1000UL +
+           ((unsigned long)counts * 838UL) / 1000UL;
+}
+
+void tb_init(void) {
+    _disable();
+    outp(PIT_CONTROL, PIT_MODE2);
+    outp(PIT_CHANNEL0, 0);      /* Divisor 0 = 65536, 18.2 Hz as before */
+    outp(PIT_CHANNEL0, 0);
+    _enable();
+    g_tb_pit_mode2 = 1;
+
+    g_tb_last_ticks = BIOS_TICKS;
+    g_tb_base_ms = tb_raw_ms();
+    g_tb_base_us = tb_raw_us();
+}
+
+void tb_shutdown(void) {
+    if (!g_tb_pit_mode2) return;
+    _disable();
+    outp(PIT_CONTROL, PIT_MODE3);
+    outp(PIT_CHANNEL0, 0);
+    outp(PIT_CHANNEL0, 0);
+    _enable();
+    g_tb_pit_mode2 = 0;
+}
+
+#else /* Linux host build */
+
+#include <time.h>
+
+static unsigned long g_tb_base_ms = 0;
+static unsigned long g_tb_base_us = 0;
+
+static unsigned long tb_raw_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000UL + (unsigned long)ts.tv_nsec / 1000000UL;
+}
+
+static unsigned long tb_raw_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000UL + (unsigned long)ts.tv_nsec / 1000UL;
+}
+
+void tb_init(void) {
+    g_tb_base_ms = tb_raw_ms();
+    g_tb_base_us = tb_raw_us();
+}
+
+void tb_shutdown(void) {
+}
+
+/* The OpenWatcom runtime's delay(), for the GPIB layer under make test */
+void delay(unsigned int milliseconds) {
+    struct timespec ts;
+
+    ts.tv_sec = milliseconds / 1000;
+    ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0) {
+        /* Interrupted - sleep the rest */
+    }
+}
+
+#endif
+
+unsigned long tb_now_ms(void) {
+    return tb_raw_ms() - g_tb_base_ms;
+}
+
+unsigned long tb_now_us(void) {
+    return tb_raw_us() - g_tb_base_us;
+}
+
+unsigned long tb_elapsed_ms(unsigned long start_ms) {
+    return tb_now_ms() - start_ms;
+}
+
+void tb_delay_ms(unsigned int milliseconds) {
+    unsigned long start = tb_now_ms();
+
+    while (tb_now_ms() - start < milliseconds) {
+        /* Busy wait */
+    }
+}
@@ -0,0 +1,25 @@
+/*
+ * TM5000 GPIB Control System - Timebase
+ * Version 3.5
+ * Header file for millisecond/microsecond timestamps
+ *
+ * Version History:
+ * 3.5 - Initial implementation replacing the 18.2 Hz BIOS tick
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+/* Program timestamps.  tb_now_ms() counts from tb_init() and is good for
+ * about 49 days; tb_now_us() wraps every 71 minutes and is only meant
+ * for differences over short intervals. */
+void tb_init(void);
+void tb_shutdown(void);
+unsigned long tb_now_ms(void);
+unsigned long tb_now_us(void);
+unsigned long tb_elapsed_ms(unsigned long start_ms);
+
+/* Busy wait with millisecond resolution */
+void tb_delay_ms(unsigned int milliseconds);
+
+#endif /* TIMEBASE_H */
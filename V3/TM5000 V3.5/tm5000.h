@@ -53,6 +53,14 @@
 #define DM5120_MAX_BUFFER_SIZE 500
 #define DM5120_MIN_BUFFER_SIZE 10
 #define DM5120_DEFAULT_BUFFER_SIZE 250
+#define DM5120_STREAM_MIN_STOINT 15   /* STOINT 1-14 ms is not allowed with BUFSZ CIRCULAR */
+
+/* Learned READ cycle times - one entry per function, digits, filter and
+ * range combination the meters have been run in */
+#define DM5120_TIMING_ENTRIES    24
+#define DM5120_TIMING_CALIBRATE  4    /* Timed cycles before the learned value is used */
+#define DM5120_TIMING_RECHECK    16   /* Then every Nth cycle is timed again */
+#define DM5120_TIMING_MARGIN_MS  10   /* Added to the learned time, plus 1/8 of it */
 
 /* GPIB buffer optimization - v3.4 memory optimization */
 #define GPIB_BUFFER_SIZE 128
@@ -94,6 +102,8 @@
 #define UNIT_CURRENT    4    /* A, mA, µA for current measurements */
 #define UNIT_RESISTANCE 5    /* Ω, mΩ, µΩ for resistance measurements */
 #define UNIT_POWER      6    /* Power spectrum units (V²/Hz) */
+#define UNIT_STATE      7    /* Regulation state - 1=CV, 2=CC, 3=UR */
+#define UNIT_COUNT      8    /* Readings in a block reduced on the meter */
 
 /* Mouse definitions */
 #define MOUSE_INT       0x33
@@ -125,11 +135,19 @@ typedef struct {
     float last_reading;          /* 4 bytes */
     unsigned int module_data_count;  /* 4 bytes - Count for this module */
     unsigned int module_data_size;   /* 4 bytes - Size allocated */
+    void far *module_time;       /* 4 bytes - Per-sample ms deltas, 16 or 32 bit */
+    unsigned long time_base_ms;  /* 4 bytes - Sample 0, ms from session start */
+    unsigned long time_last_ms;  /* 4 bytes - Last sample, ms from session start */
+    unsigned int module_time_count;  /* Samples with a timestamp */
+    unsigned int module_data_head;   /* Physical index of the oldest sample (ring mode) */
     unsigned char module_type;   /* 1 byte */
     unsigned char slot_number;   /* 1 byte */
     unsigned char gpib_address;  /* 1 byte */
     unsigned char enabled:1;     /* 1 bit - pack boolean flags */
-    unsigned char reserved:7;    /* 7 bits - reserved for future flags */
+    unsigned char time_wide:1;   /* module_time holds 32-bit deltas */
+    unsigned char ring:1;        /* Keep the most recent samples when full */
+    unsigned char spill:1;       /* Write every sample to the session file */
+    unsigned char reserved:4;    /* 4 bits - reserved for future flags */
 } tm5000_module;
 #pragma pack()
 
@@ -196,6 +214,7 @@ typedef struct {
     int slot;                    /* 4 bytes */
     int unit_type;               /* 4 bytes - 0=Voltage, 1=Frequency, 2=dB */
     unsigned char color;         /* 1 byte */
+    unsigned char channel;       /* 1 byte - channel of the slot shown, 0 = module_data */
     unsigned char enabled:1;     /* 1 bit - pack boolean flags */
     unsigned char reserved:7;    /* 7 bits - reserved */
 } trace_info;
@@ -216,9 +235,16 @@ typedef struct {
     
     /* Buffer state tracking for async operations */
     int buffer_state;      /* 0=idle, 1=filling, 2=half, 3=full */
-    unsigned long buffer_start_time; /* When buffer fill started (tick count) */
+    unsigned long buffer_start_time; /* When buffer fill started (tb_now_ms) */
     int samples_ready;     /* Number of samples currently in buffer */
     
+    /* Streaming - circular buffer drained on every HALF event */
+    unsigned long stream_next_ms;    /* Session ms of the next stored reading */
+    unsigned long stream_drain_time; /* When the buffer was last drained (tb_now_ms) */
+    unsigned long stream_samples;    /* Readings captured since the stream started */
+    unsigned int stream_interval_ms; /* STOINT period in use */
+    unsigned int stream_overruns;    /* Drains that found the buffer had wrapped */
+    
     /* Bit-packed boolean flags to save memory */
     unsigned int filter_enabled:1;     /* Filter ON/OFF */
     unsigned int null_enabled:1;      /* NULL function ON/OFF */
@@ -227,7 +253,9 @@ typedef struct {
     unsigned int min_max_enabled:1;   /* Track min/max values */
     unsigned int burst_mode:1;        /* 0=Normal, 1=Burst sampling */
     unsigned int lf_termination:1;    /* Use LF instead of CRLF for instruments showing "LF" */
-    unsigned int reserved:9;          /* Reserved for future use */
+    unsigned int stream_mode:1;       /* Monitor streams every stored reading */
+    unsigned int streaming:1;         /* Stream running on the instrument */
+    unsigned int reserved:7;          /* Reserved for future use */
 } dm5120_config;
 
 typedef struct {
@@ -273,7 +301,8 @@ typedef struct {
     unsigned int user_enabled:1;       /* INST ID button */
     unsigned int rqs_enabled:1;        /* Service requests */
     unsigned int lf_termination:1;     /* Use LF instead of CRLF for instruments showing "LF" */
-    unsigned int reserved:8;           /* Reserved for future use */
+    unsigned int log_both:1;           /* Monitor reads voltage and current every sample */
+    unsigned int reserved:7;           /* Reserved for future use */
 } ps5004_config;
 
 typedef struct {
@@ -366,7 +395,8 @@ typedef struct {
     unsigned int rise_fall_enabled:1;      /* Rise/fall time measurements (DC5010 specific) */
     unsigned int burst_mode:1;             /* Burst measurement mode (DC5010 specific) */
     unsigned int lf_termination:1;         /* Use LF instead of CRLF for instruments showing "LF" */
-    unsigned int reserved:7;               /* Reserved for future use */
+    unsigned int log_both:1;               /* Monitor reads channel A and B every sample */
+    unsigned int reserved:6;               /* Reserved for future use */
 } dc5010_config;
 
 typedef struct {
@@ -418,6 +448,7 @@ extern graph_scale g_graph_scale;
 extern trace_info __far g_traces[10];
 extern control_panel_state g_control_panel;
 extern fft_config g_fft_config;
+extern float g_fft_sample_rate;
 extern int g_has_287;
 
 /* Sample rate presets */
@@ -470,11 +501,87 @@ int dm5120_query_buffer_size(int address);
 float dm5120_read_one_stored(int address);
 int dm5120_read_all_stored(int address, float far *buffer, int max_samples);
 
+typedef struct {
+    char function[10];             /* FUNCT as configured */
+    unsigned char digits;
+    unsigned char filter;          /* Filter count, 0 when off */
+    unsigned char range;           /* 0 = AUTO, else manual range */
+    unsigned char reserved;
+    unsigned int learned_ms;       /* Running average of timed cycles */
+    unsigned int max_ms;           /* Longest timed cycle */
+    unsigned int samples;          /* Cycles timed */
+} dm5120_timing_entry;
+
+/* Per-slot counters and running statistics of the acquisition ingest */
+#define INGEST_ACCEPTED   0
+#define INGEST_DROPPED    1     /* Invalid value, failed read or full buffer */
+#define INGEST_DUPLICATE  2     /* Timestamp not newer than the last sample */
+
+typedef struct {
+    unsigned long accepted;
+    unsigned long dropped;
+    unsigned long duplicated;
+    unsigned long last_time_ms;    /* Session ms of the last accepted sample */
+    double mean;
+    double m2;                     /* Sum of squared deviations from the mean */
+    float min;
+    float max;
+} sample_ingest_stats;
+
+/* Named channels of one slot.  Channel 0 is module_data itself; the
+ * others are columns at the same positions with the same timestamps,
+ * filled from the bus transaction that produced the channel 0 sample -
+ * a PS5010's three outputs from one REG? or a PS5004's voltage and
+ * current. */
+#define MAX_SLOT_CHANNELS  4
+#define CHANNEL_NAME_LEN   6
+
+typedef struct {
+    char *name;
+    unsigned char unit_type;
+} channel_def;
+
+typedef struct {
+    char name[CHANNEL_NAME_LEN];   /* "V", "I", "MIN", "POS" */
+    unsigned char unit_type;       /* UNIT_* */
+    float far *data;               /* Channels 1 up - laid out like module_data */
+    float next;                    /* Value the next stored sample gets */
+    unsigned char valid;           /* next was given a good value since the last store */
+} slot_channel;
+
 /* From data.c */
 int allocate_module_buffer(int slot, unsigned int size);
 void free_module_buffer(int slot);
 void store_module_data(int slot, float value);
+int store_module_sample(int slot, float value, unsigned long time_ms);
 void clear_module_data(int slot);
+float module_data_at(int slot, unsigned int index);
+float trace_data_at(int trace, unsigned int index);
+void module_data_linearize(int slot);
+void set_module_ring(int slot, int enabled);
+void set_module_spill(int slot, int enabled);
+void reset_session_time(void);
+unsigned long session_time_ms(void);
+void ingest_reset(void);
+int ingest_sample(int slot, float value, unsigned long time_ms);
+int ingest_failed(int slot);
+sample_ingest_stats *ingest_get(int slot);
+float ingest_std_dev(int slot);
+sample_ingest_stats *ingest_channel_get(int slot, int channel);
+float ingest_channel_std_dev(int slot, int channel);
+int define_slot_channels(int slot, const channel_def *defs, int count);
+int slot_channel_count(int slot);
+slot_channel *slot_channel_get(int slot, int channel);
+void channel_put(int slot, int channel, float value);
+float channel_data_at(int slot, int channel, unsigned int index);
+void channel_store_at(int slot, int channel, unsigned int index, float value);
+float far *slot_channel_data(int slot, int channel);
+const char *unit_type_name(int unit_type);
+time_t session_start_time(void);
+int module_has_times(int slot);
+unsigned long module_time_ms(int slot, unsigned int index);
+float module_sample_rate_hz(int slot);
+void copy_module_times(int target_slot, int source_slot);
 void save_data(void);
 void load_data(void);
 
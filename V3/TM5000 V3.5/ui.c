@@ -9,6 +9,7 @@
  * 3.2 - Version update
  * 3.3 - Version update
  * 3.5 - Integrated enhanced file operations and math analysis menus
+ * 3.5 - K steps the selected trace through its slot's channels
  */
 
 #include "ui.h"
@@ -18,6 +19,9 @@
 #include "modules.h"
 #include "config_profiles.h"
 #include "data.h"
+#include "scheduler.h"
+#include "spill.h"
+#include "reduce.h"
 
 /* Main menu function */
 void main_menu(void) {
@@ -714,6 +718,9 @@ void continuous_monitor_setup(void) {
         printf("1. Set Sample Rate\n");
         printf("2. Select Modules to Monitor\n");
         printf("3. Start Monitoring\n");
+        printf("4. Per-Slot Sample Periods\n");
+        printf("5. Storage Mode (stop when full / keep most recent)\n");
+        printf("6. Instrument Reduction (average N readings on the meter)\n");
         printf("0. Return to Menu\n\n");
         printf("Choice: ");
         
@@ -732,6 +739,18 @@ void continuous_monitor_setup(void) {
                 continuous_monitor();
                 break;
                 
+            case '4':
+                slot_period_menu();
+                break;
+                
+            case '5':
+                storage_mode_menu();
+                break;
+                
+            case '6':
+                reduce_menu();
+                break;
+                
             case '0':
             case 27:  /* ESC */
                 done = 1;
@@ -740,6 +759,188 @@ void continuous_monitor_setup(void) {
     }
 }
 
+/* Per-slot storage mode - FILL stops storing at the buffer size, RING
+ * keeps the most recent samples for overnight runs, SPILL also logs every
+ * sample to a session file */
+void storage_mode_menu(void) {
+    int done = 0;
+    int i, key;
+    
+    while (!done) {
+        clrscr();
+        printf("Storage Mode\n");
+        printf("============\n\n");
+        printf("Slot  Module                Mode   Buffer\n");
+        
+        for (i = 0; i < 10; i++) {
+            if (g_system->modules[i].enabled &&
+                g_system->modules[i].module_type != MOD_NONE &&
+                strlen(g_system->modules[i].description) > 0) {
+                printf("  %d.  %-20s  %-5s  %u samples\n", i,
+                       g_system->modules[i].description,
+                       g_system->modules[i].spill ? "SPILL" :
+                       g_system->modules[i].ring ? "RING" : "FILL",
+                       g_system->modules[i].module_data_size ?
+                       g_system->modules[i].module_data_size : MAX_SAMPLES_PER_MODULE);
+            }
+        }
+        
+        printf("\nFILL: stop storing when the buffer is full\n");
+        printf("RING: keep the most recent samples, oldest are overwritten\n");
+        printf("SPILL: RING plus every sample logged to TM5Snnnn.DAT - page\n");
+        printf("       back through the whole run with [ and ] in the graph\n");
+        printf("\n0-9: Cycle slot mode   A: All RING   S: All SPILL   F: All FILL   ESC: Return\n");
+        
+        key = getch();
+        
+        if (key >= '0' && key <= '9') {
+            i = key - '0';
+            if (g_system->modules[i].enabled) {
+                /* FILL -> RING -> SPILL -> FILL */
+                if (g_system->modules[i].spill) {
+                    set_module_ring(i, 0);
+                } else if (g_system->modules[i].ring) {
+                    set_module_spill(i, 1);
+                } else {
+                    set_module_ring(i, 1);
+                }
+            }
+        } else if (toupper(key) == 'A' || toupper(key) == 'F') {
+            for (i = 0; i < 10; i++) {
+                set_module_ring(i, toupper(key) == 'A');
+                set_module_spill(i, 0);
+            }
+        } else if (toupper(key) == 'S') {
+            for (i = 0; i < 10; i++) {
+                set_module_spill(i, 1);
+            }
+        } else if (key == 27) {
+            done = 1;
+        }
+    }
+}
+
+/* Per-slot block size for instrument-side reduction - the meter collects
+ * N readings and the monitor fetches one reduced sample per block */
+void reduce_menu(void) {
+    int done = 0;
+    int i, key;
+    long count;
+    
+    while (!done) {
+        clrscr();
+        printf("Instrument Reduction\n");
+        printf("====================\n\n");
+        printf("Slot  Module                Block\n");
+        
+        for (i = 0; i < 10; i++) {
+            if (g_system->modules[i].enabled &&
+                g_system->modules[i].module_type != MOD_NONE &&
+                strlen(g_system->modules[i].description) > 0) {
+                printf("  %d.  %-20s  ", i, g_system->modules[i].description);
+                if (!reduce_supported(i)) {
+                    printf("n/a\n");
+                } else if (g_reduce_count[i] >= REDUCE_MIN_COUNT) {
+                    printf("%u readings%s\n", g_reduce_count[i],
+                           g_system->modules[i].module_type == MOD_DM5120 ?
+                           " (mean, min, max)" : " (mean)");
+                } else {
+                    printf("off\n");
+                }
+            }
+        }
+        
+        printf("\nThe meter takes N readings spread over the slot period and the\n");
+        printf("monitor stores their mean, stamped at the middle of the block.\n");
+        printf("DM5120 uses its buffer; DM5010 its averaging filter.\n");
+        printf("\n0-9: Set slot block size   O: All off   ESC: Return\n");
+        
+        key = getch();
+        
+        if (key >= '0' && key <= '9') {
+            i = key - '0';
+            if (!g_system->modules[i].enabled || !reduce_supported(i)) continue;
+            printf("\nReadings per block for slot %d (%d-%d, 0 = off): ",
+                   i, REDUCE_MIN_COUNT, REDUCE_MAX_COUNT);
+            if (scanf("%ld", &count) == 1) {
+                if (count == 0 ||
+                    (count >= REDUCE_MIN_COUNT && count <= REDUCE_MAX_COUNT)) {
+                    g_reduce_count[i] = (unsigned int)count;
+                } else {
+                    printf("Invalid block size!\n");
+                    printf("Press any key...");
+                    getch();
+                }
+            }
+        } else if (toupper(key) == 'O') {
+            for (i = 0; i < 10; i++) {
+                g_reduce_count[i] = 0;
+            }
+        } else if (key == 27) {
+            done = 1;
+        }
+    }
+}
+
+/* Per-slot periods for the monitor scheduler - a slot is never scheduled
+ * faster than its expected conversion time */
+void slot_period_menu(void) {
+    int done = 0;
+    int i, key;
+    long period;
+    
+    while (!done) {
+        clrscr();
+        printf("Per-Slot Sample Periods\n");
+        printf("=======================\n\n");
+        printf("Slot  Module                Period      Conversion\n");
+        
+        for (i = 0; i < 10; i++) {
+            if (g_system->modules[i].enabled &&
+                g_system->modules[i].module_type != MOD_NONE &&
+                g_system->modules[i].gpib_address >= 1 &&
+                g_system->modules[i].gpib_address <= 30 &&
+                strlen(g_system->modules[i].description) > 0) {
+                printf("  %d.  %-20s  ", i, g_system->modules[i].description);
+                if (g_slot_period_ms[i]) {
+                    printf("%5u ms    ", g_slot_period_ms[i]);
+                } else {
+                    printf("default     ");
+                }
+                printf("%5u ms\n", sched_conversion_ms(i));
+            }
+        }
+        
+        printf("\nDefault period: %d ms (sample rate)\n", g_control_panel.sample_rate_ms);
+        printf("\n0-9: Set slot period   D: All slots to default   ESC: Return\n");
+        
+        key = getch();
+        
+        if (key >= '0' && key <= '9') {
+            i = key - '0';
+            if (!g_system->modules[i].enabled) continue;
+            printf("\nPeriod for slot %d (%d-%d ms, 0 = default): ",
+                   i, SCHED_MIN_PERIOD_MS, SCHED_MAX_PERIOD_MS);
+            if (scanf("%ld", &period) == 1) {
+                if (period == 0 ||
+                    (period >= SCHED_MIN_PERIOD_MS && period <= SCHED_MAX_PERIOD_MS)) {
+                    g_slot_period_ms[i] = (unsigned int)period;
+                } else {
+                    printf("Invalid period!\n");
+                    printf("Press any key...");
+                    getch();
+                }
+            }
+        } else if (toupper(key) == 'D') {
+            for (i = 0; i < 10; i++) {
+                g_slot_period_ms[i] = 0;
+            }
+        } else if (key == 27) {
+            done = 1;
+        }
+    }
+}
+
 /* Sample rate configuration menu */
 void sample_rate_menu(void) {
     int choice;
@@ -778,6 +979,17 @@ void sample_rate_menu(void) {
             g_control_panel.use_custom = 1;
             sprintf(g_control_panel.custom_rate, "%d", custom_rate);
             printf("Custom rate set to %d ms\n", custom_rate);
+            
+            /* The scheduler stretches these slots to their conversion time */
+            for (i = 0; i < 10; i++) {
+                if (g_system->modules[i].enabled &&
+                    g_system->modules[i].module_type != MOD_NONE &&
+                    g_slot_period_ms[i] == 0 &&
+                    sched_conversion_ms(i) > (unsigned int)custom_rate) {
+                    printf("  S%d %s limited to %u ms by its conversion time\n",
+                           i, g_system->modules[i].description, sched_conversion_ms(i));
+                }
+            }
         } else {
             printf("Invalid rate! Must be 10-60000 ms\n");
         }
@@ -928,6 +1140,7 @@ void calculate_statistics(void) {
         return;
     }
     
+    module_data_linearize(slot);  /* Ring slots back in time order */
     data = g_system->modules[slot].module_data;
     count = g_system->modules[slot].module_data_count;
     
@@ -1644,14 +1857,14 @@ void graph_display(void) {
                         if (x_pos2 > GRAPH_RIGHT) x_pos2 = GRAPH_RIGHT;
                         
                         if (g_has_287) {
-                            normalized_y = (g_traces[i].data[sample_idx1] - g_graph_scale.min_value) * y_scale;
+                            normalized_y = (trace_data_at(i, sample_idx1) - g_graph_scale.min_value) * y_scale;
                             y_pos1 = GRAPH_BOTTOM - (int)normalized_y;
                             
-                            normalized_y = (g_traces[i].data[sample_idx2] - g_graph_scale.min_value) * y_scale;
+                            normalized_y = (trace_data_at(i, sample_idx2) - g_graph_scale.min_value) * y_scale;
                             y_pos2 = GRAPH_BOTTOM - (int)normalized_y;
                         } else {
-                            y_pos1 = value_to_y(g_traces[i].data[sample_idx1]);
-                            y_pos2 = value_to_y(g_traces[i].data[sample_idx2]);
+                            y_pos1 = value_to_y(trace_data_at(i, sample_idx1));
+                            y_pos2 = value_to_y(trace_data_at(i, sample_idx2));
                         }
                         
                         if (y_pos1 < GRAPH_TOP) y_pos1 = GRAPH_TOP;
@@ -1678,7 +1891,7 @@ void graph_display(void) {
             draw_gradient_rect(0, 185, SCREEN_WIDTH-1, 199, 1, 2);
             
             draw_text(2, 186, "A:AUTO +/-:ZOOM F:FINE/COARSE H:HELP", 3);
-            draw_text(2, 193, "0-9:SELECT ALT+#:TOGGLE ESC:EXIT", 3);
+            draw_text(2, 193, "0-9:SELECT ALT+#:TOGGLE K:CHAN ESC:EXIT", 3);
             
             if (selected_trace >= 0 && is_fft_trace[selected_trace]) {
                 float sample_rate = (g_control_panel.sample_rate_ms > 0) ? (1000.0 / g_control_panel.sample_rate_ms) : 1000.0;
@@ -1703,6 +1916,17 @@ void graph_display(void) {
                 draw_text(240, 193, "287", 3);
             }
             
+            /* Spilled history - first session sample of the window */
+            if (selected_trace >= 0 && spill_has_history(selected_trace)) {
+                unsigned long first = spill_window_first(selected_trace) + 1;
+                if (first < 1000000L) {
+                    sprintf(readout, "@%lu", first);
+                } else {
+                    sprintf(readout, "@%luK", first / 1000);
+                }
+                draw_text(196, 193, readout, 2);
+            }
+            
             if (selected_trace >= 0 && g_traces[selected_trace].enabled && 
                 g_traces[selected_trace].data_count >= 1000) {
                 draw_text(255, 193, "1K", 3);
@@ -1789,7 +2013,7 @@ void graph_display(void) {
                 
                 /* Bounds check for all data access */
                 if (sample_num >= 0 && sample_num < g_traces[selected_trace].data_count) {
-                    value = g_traces[selected_trace].data[sample_num];
+                    value = trace_data_at(selected_trace, sample_num);
                 } else {
                     value = 0.0;  /* Safe fallback */
                 }
@@ -1922,8 +2146,8 @@ void graph_display(void) {
                                         float x_scale_local = (float)GRAPH_WIDTH / (float)(g_traces[i].data_count - 1);
                                         int x_pos1 = GRAPH_LEFT + (int)(j * x_scale_local);
                                         int x_pos2 = GRAPH_LEFT + (int)((j + 1) * x_scale_local);
-                                        int y_pos1 = value_to_y(g_traces[i].data[j]);
-                                        int y_pos2 = value_to_y(g_traces[i].data[j + 1]);
+                                        int y_pos1 = value_to_y(trace_data_at(i, j));
+                                        int y_pos2 = value_to_y(trace_data_at(i, j + 1));
                                         
                                         /* Only redraw lines that intersect the cleared rectangle */
                                         if ((x_pos1 >= clear_x1 && x_pos1 <= clear_x2) ||
@@ -2547,6 +2771,28 @@ void graph_display(void) {
                     need_redraw = 1;
                     init_graphics();
                     break;
+                    
+                case 'K':  /* Next channel of the selected slot */
+                case 'k':
+                case '[':  /* Page spilled slots back through the session file */
+                case ']':
+                    if ((key == 'K' || key == 'k') ? trace_next_channel(selected_trace) :
+                        spill_page_all(key == '[' ? -1 : 1) > 0) {
+                        sync_traces_with_modules();
+                        if (g_graph_scale.auto_scale) {
+                            auto_scale_graph();
+                            y_range = g_graph_scale.max_value - g_graph_scale.min_value;
+                            display_scale_factor = get_engineering_scale(y_range, &per_div_value, &display_unit_str, &display_decimal_places);
+                            unit_str = display_unit_str;
+                            if (g_has_287) {
+                                float y_range_check = g_graph_scale.max_value - g_graph_scale.min_value;
+                                if (y_range_check == 0.0) y_range_check = 1.0;  /* Prevent divide by zero */
+                                y_scale = (float)GRAPH_HEIGHT / y_range_check;
+                            }
+                        }
+                        need_redraw = 1;
+                    }
+                    break;
             }
         }
         
@@ -50,6 +50,9 @@ void module_functions_menu(void);
 void continuous_monitor_setup(void);
 void sample_rate_menu(void);
 void module_selection_menu(void);
+void slot_period_menu(void);
+void storage_mode_menu(void);
+void reduce_menu(void);
 
 /* Data functions not defined elsewhere */
 void save_settings(void);
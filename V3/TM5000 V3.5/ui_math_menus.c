@@ -322,6 +322,7 @@ void curve_fitting_menu(void) {
                     g_system->modules[trace_slot].module_data &&
                     g_system->modules[trace_slot].module_data_count > 1) {
                     
+                    module_data_linearize(trace_slot);
                     y_data = g_system->modules[trace_slot].module_data;
                     count = g_system->modules[trace_slot].module_data_count;
                     